@@ -5,12 +5,16 @@
 //  Created by neo on 2016/2/1.
 //  Copyright © 2016年 njiot. All rights reserved.
 //
+//  Builds on macOS and Linux: g++ -O2 -o binfiletool binfiletool.cpp
+//
 
 #include <iostream>
 #include <stdio.h>
+#include <string.h>
+#include <ctype.h>
 #include <fstream>
-#include <copyfile.h>
 #include <vector>
+#include <algorithm>
 #include <stdlib.h>
 #include <sys/stat.h>
 
@@ -18,313 +22,548 @@ using namespace std;
 
 string tool_path;
 string build_path;
-string toolchain_prefix;
 
 unsigned long image2_pos=0;
 
+// target.axf, read once; the images and target.map come from it directly
+vector<char> axf;
 
-int copy_target_file(void)
+vector<char> ram1_bin;
+vector<char> ram2_bin;
+vector<char> ram1_prepend;
+vector<char> ram2_prepend;
+vector<char> ram_all;
+
+
+// ELF32 little endian, as written by arm-none-eabi-ld. Only the section
+// headers, the program headers and the symbol table are read.
+#define SHT_SYMTAB      2
+#define SHT_NOBITS      8
+
+#define SHF_WRITE       0x1
+#define SHF_ALLOC       0x2
+#define SHF_EXECINSTR   0x4
+
+#define PT_LOAD         1
+
+#define SHN_UNDEF       0
+#define SHN_ABS         0xfff1
+#define SHN_COMMON      0xfff2
+
+#define STB_LOCAL       0
+#define STB_WEAK        2
+#define STT_OBJECT      1
+#define STT_SECTION     3
+#define STT_FILE        4
+
+struct elf_section {
+    string name;
+    unsigned long type;
+    unsigned long flags;
+    unsigned long addr;
+    unsigned long lma;      // load address, what objcopy -Obinary lays out by
+    unsigned long offset;
+    unsigned long size;
+    unsigned long link;
+    unsigned long entsize;
+};
+
+vector<elf_section> sections;
+
+static unsigned long elf_get16(unsigned long offset)
 {
-    int ret;
-    string cmd;
-    
-    string file1 = build_path + "/target.axf";
-    string file2 = build_path + "/target.axf.bak";
-    string file3 = build_path + "/target_pure.axf";
-    copyfile_flags_t flags = COPYFILE_ALL;
-    
-    ret = copyfile(file1.c_str(), file2.c_str(), NULL, flags);
-    if ( ret != 0 ) {
-        cout << " copyfile : " << file1 << " - " << file2 << ", ret=" << ret << endl;
-        return ret;
+    const unsigned char *p = (const unsigned char *)&axf[offset];
+    return p[0] | (p[1] << 8);
+}
+
+static unsigned long elf_get32(unsigned long offset)
+{
+    const unsigned char *p = (const unsigned char *)&axf[offset];
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+static void put_le32(vector<char> &buf, size_t offset, unsigned long value)
+{
+    for (int i=0; i<4; i++) {
+        buf[offset + i] = (char)(value >> (8 * i));
     }
-    ret = copyfile(file1.c_str(), file3.c_str(), NULL, flags);
-    if ( ret == 0 ) {
-        cout << " CopyFile : " << file1 << " - " << file3 << ", ret=" << ret << endl;
-        return ret;
+}
+
+static bool elf_in_file(unsigned long offset, unsigned long size)
+{
+    return offset <= axf.size() && size <= axf.size() - offset;
+}
+
+int read_file(string filename, vector<char> &buf)
+{
+    ifstream infile(filename.c_str(), ios::binary);
+    if ( !infile ) {
+        cout << "ERR: Cannot open " << filename << endl;
+        return -1;
     }
-    return ret;
+
+    infile.seekg(0, ios::end);
+    long size = (long)infile.tellg();
+    infile.seekg(0, ios::beg);
+
+    buf.resize(size);
+    if (size > 0) {
+        infile.read(&buf[0], size);
+    }
+    if ( !infile ) {
+        cout << "ERR: Cannot read " << filename << endl;
+        return -1;
+    }
+    return 0;
 }
 
-void generate_binfiles(void)
+int write_file(string filename, const vector<char> &buf)
 {
-    string strip_command = toolchain_prefix + "-strip " + build_path + "/target_pure.axf ";
-    string make_bin1 = toolchain_prefix + "-objcopy -j .ram.start.table -j .ram_image1.text -Obinary " + build_path + "/target_pure.axf " + build_path + "/ram_1.bin ";
-    string make_bin2 = toolchain_prefix + "-objcopy -j .image2.start.table -j .ram_image2.text  -j .ARM.exidx -Obinary " + build_path + "/target_pure.axf " + build_path + "/ram_2.bin ";
-    //string make_bin3 = toolchain_prefix + "-objcopy -j .image3 -j .ARM.exidx -j .sdr_data -Obinary " + build_path + "/target_pure.axf " + build_path + "/ram_3.bin ";
-    
-    system(strip_command.c_str());
-    
-    system(make_bin1.c_str());
-    
-    system(make_bin2.c_str());
-    
-    //system(make_bin3.c_str());
-    
+    ofstream outfile(filename.c_str(), ios::binary);
+    if (buf.size() > 0) {
+        outfile.write(&buf[0], buf.size());
+    }
+    outfile.close();
+    if ( !outfile ) {
+        cout << "ERR: Cannot write " << filename << endl;
+        return -1;
+    }
+    return 0;
 }
 
-void sort_mapfile()
+int load_target_file(void)
 {
-    vector<string> lines;
-    
-    ifstream infile;
-    
-    string infilestr = build_path + "/target.nm";
-    infile.open( infilestr.c_str() );
-    
-    string line;
-    while ( getline(infile, line) )
-    {
-        lines.push_back(line);
-    }
-    infile.close();
-    
-    sort(lines.begin(), lines.end());
-    
-    string outfilestr = build_path + "/target.map";
-    ofstream outfile( outfilestr.c_str(), ios::out);
-    if ( !outfile)
-    {
-        cerr << "File cound not be opened: target.map" << endl;
-        return;
-    }
-    
-    for (size_t i=0; i < lines.size(); i++) {
-        if ( lines[i].find("__ram_image2_text_start__") != std::string::npos ) {
-            //cout << lines[i] << endl;
-            char pos_str[9];
-            memcpy(pos_str, lines[i].c_str(), 8);
-            pos_str[8] = 0;
-            image2_pos = strtoul(pos_str, NULL, 16);
-            //cout << "image2_pos=" << image2_pos << endl;
+    if (read_file(build_path + "/target.axf", axf) != 0) {
+        return -1;
+    }
+
+    if (axf.size() < 52 || memcmp(&axf[0], "\177ELF", 4) != 0 || axf[4] != 1 || axf[5] != 1) {
+        cout << "ERR: target.axf is not a 32-bit little endian ELF file" << endl;
+        return -1;
+    }
+
+    unsigned long phoff = elf_get32(28);
+    unsigned long shoff = elf_get32(32);
+    unsigned long phentsize = elf_get16(42);
+    unsigned long phnum = elf_get16(44);
+    unsigned long shentsize = elf_get16(46);
+    unsigned long shnum = elf_get16(48);
+    unsigned long shstrndx = elf_get16(50);
+
+    if (!elf_in_file(phoff, phnum * phentsize) || !elf_in_file(shoff, shnum * shentsize)
+        || shstrndx >= shnum || phentsize < 32 || shentsize < 40) {
+        cout << "ERR: target.axf is truncated" << endl;
+        return -1;
+    }
+
+    unsigned long names = elf_get32(shoff + shstrndx * shentsize + 16);
+    unsigned long names_size = elf_get32(shoff + shstrndx * shentsize + 20);
+    if (!elf_in_file(names, names_size)) {
+        cout << "ERR: target.axf is truncated" << endl;
+        return -1;
+    }
+
+    sections.clear();
+    for (unsigned long i=0; i<shnum; i++) {
+        unsigned long sh = shoff + i * shentsize;
+        elf_section sec;
+
+        unsigned long name = elf_get32(sh);
+        if (name < names_size) {
+            sec.name = string(&axf[names + name], strnlen(&axf[names + name], names_size - name));
         }
-        outfile << lines[i] << endl;
+        sec.type = elf_get32(sh + 4);
+        sec.flags = elf_get32(sh + 8);
+        sec.addr = elf_get32(sh + 12);
+        sec.offset = elf_get32(sh + 16);
+        sec.size = elf_get32(sh + 20);
+        sec.link = elf_get32(sh + 24);
+        sec.entsize = elf_get32(sh + 36);
+        sec.lma = sec.addr;
+
+        if (sec.type != SHT_NOBITS && !elf_in_file(sec.offset, sec.size)) {
+            cout << "ERR: target.axf is truncated" << endl;
+            return -1;
+        }
+
+        // a section placed with AT> loads somewhere else than it runs,
+        // the load segment holding it says where
+        if ((sec.flags & SHF_ALLOC) && sec.type != SHT_NOBITS) {
+            for (unsigned long j=0; j<phnum; j++) {
+                unsigned long ph = phoff + j * phentsize;
+                unsigned long p_offset = elf_get32(ph + 4);
+                unsigned long p_filesz = elf_get32(ph + 16);
+
+                if (elf_get32(ph) == PT_LOAD && sec.offset >= p_offset
+                    && sec.offset + sec.size <= p_offset + p_filesz) {
+                    sec.lma = elf_get32(ph + 12) + (sec.offset - p_offset);
+                    break;
+                }
+            }
+        }
+        sections.push_back(sec);
     }
+
+    return 0;
 }
 
-void generate_mapfile(void)
+// Same as objcopy -j <names> -Obinary: the sections at their load
+// addresses, gaps filled with 0
+int extract_sections(const char *names[], int count, vector<char> &image)
 {
-    string map_gen = toolchain_prefix + "-nm " + build_path + "/target.axf > " + build_path + "/target.nm ";
-    
-    system(map_gen.c_str());
-    sort_mapfile();
+    unsigned long low = 0xFFFFFFFF;
+    unsigned long high = 0;
+
+    for (size_t i=0; i<sections.size(); i++) {
+        elf_section &sec = sections[i];
+        if (find(names, names + count, sec.name) == names + count) continue;
+        if (sec.type == SHT_NOBITS || !(sec.flags & SHF_ALLOC) || sec.size == 0) continue;
+
+        low = min(low, sec.lma);
+        high = max(high, sec.lma + sec.size);
+    }
+    if (low > high) {
+        cout << "ERR: " << names[0] << " not found in target.axf" << endl;
+        return -1;
+    }
+
+    image.assign(high - low, 0);
+    for (size_t i=0; i<sections.size(); i++) {
+        elf_section &sec = sections[i];
+        if (find(names, names + count, sec.name) == names + count) continue;
+        if (sec.type == SHT_NOBITS || !(sec.flags & SHF_ALLOC) || sec.size == 0) continue;
+
+        memcpy(&image[sec.lma - low], &axf[sec.offset], sec.size);
+    }
+
+    return 0;
 }
 
-int get_binfile_size(const char *filename)
+int copy_target_file(void)
 {
-    ifstream infile(filename, ios::binary);
-    
-    infile.seekg(0, ios::end);
-    int size = (int)infile.tellg();
-    infile.seekg(0, ios::beg);
-    infile.close();
-    
-    return size;
+    return write_file(build_path + "/target.axf.bak", axf);
+}
+
+int generate_binfiles(void)
+{
+    const char *image1[] = { ".ram.start.table", ".ram_image1.text" };
+    const char *image2[] = { ".image2.start.table", ".ram_image2.text", ".ARM.exidx", ".tcm" };
+    //const char *image3[] = { ".image3", ".ARM.exidx", ".sdr_data" };
+
+    if (extract_sections(image1, 2, ram1_bin) != 0) return -1;
+    if (extract_sections(image2, 4, ram2_bin) != 0) return -1;
+
+    if (write_file(build_path + "/ram_1.bin", ram1_bin) != 0) return -1;
+    if (write_file(build_path + "/ram_2.bin", ram2_bin) != 0) return -1;
+
+    return 0;
+}
+
+// One line per symbol, in the format of nm, sorted by address
+int generate_mapfile(void)
+{
+    vector<string> lines;
+    bool found = false;
+
+    for (size_t i=0; i<sections.size(); i++) {
+        elf_section &symtab = sections[i];
+        if (symtab.type != SHT_SYMTAB || symtab.entsize < 16 || symtab.link >= sections.size()) continue;
+
+        elf_section &strtab = sections[symtab.link];
+
+        for (unsigned long sym = symtab.offset + symtab.entsize; sym + 16 <= symtab.offset + symtab.size; sym += symtab.entsize) {
+            unsigned long name = elf_get32(sym);
+            unsigned long value = elf_get32(sym + 4);
+            unsigned char info = axf[sym + 12];
+            unsigned long shndx = elf_get16(sym + 14);
+            unsigned char bind = info >> 4;
+            unsigned char type = info & 0xf;
+
+            if (type == STT_SECTION || type == STT_FILE || name == 0 || name >= strtab.size) continue;
+
+            const char *sym_name = &axf[strtab.offset + name];
+            size_t sym_len = strnlen(sym_name, strtab.size - name);
+
+            // ARM mapping symbols ($a, $t, $d), nm leaves them out too
+            if (sym_name[0] == '$' && strchr("atd", sym_name[1]) && sym_name[1] != 0
+                && (sym_name[2] == 0 || sym_name[2] == '.')) continue;
+
+            char letter;
+            if (shndx == SHN_UNDEF) {
+                letter = (bind == STB_WEAK) ? 'w' : 'U';
+            } else if (bind == STB_WEAK) {
+                letter = (type == STT_OBJECT) ? 'V' : 'W';
+            } else {
+                if (shndx == SHN_ABS) {
+                    letter = 'a';
+                } else if (shndx == SHN_COMMON) {
+                    letter = 'c';
+                } else if (shndx >= sections.size()) {
+                    letter = '?';
+                } else if (sections[shndx].type == SHT_NOBITS) {
+                    letter = 'b';
+                } else if (sections[shndx].flags & SHF_EXECINSTR) {
+                    letter = 't';
+                } else if (sections[shndx].flags & SHF_WRITE) {
+                    letter = 'd';
+                } else if (sections[shndx].flags & SHF_ALLOC) {
+                    letter = 'r';
+                } else {
+                    letter = 'n';
+                }
+                if (bind != STB_LOCAL && letter != '?') {
+                    letter = toupper(letter);
+                }
+            }
+
+            char prefix[12];
+            if (shndx == SHN_UNDEF) {
+                snprintf(prefix, sizeof(prefix), "%8s %c ", "", letter);
+            } else {
+                snprintf(prefix, sizeof(prefix), "%08lx %c ", value, letter);
+            }
+            lines.push_back(string(prefix) + string(sym_name, sym_len));
+
+            if (sym_len == 25 && memcmp(sym_name, "__ram_image2_text_start__", 25) == 0) {
+                image2_pos = value;
+                found = true;
+            }
+        }
+    }
+
+    if ( !found ) {
+        cout << "ERR: __ram_image2_text_start__ not found in target.axf" << endl;
+        return -1;
+    }
+
+    sort(lines.begin(), lines.end());
+
+    vector<char> map;
+    for (size_t i=0; i < lines.size(); i++) {
+        map.insert(map.end(), lines[i].begin(), lines[i].end());
+        map.push_back('\n');
+    }
+
+    return write_file(build_path + "/target.map", map);
 }
 
 void generate_ram1_bin(void)
 {
-    
-    string infilestr = build_path + "/ram_1.bin";
-    string outfilestr = build_path + "/ram_1_prepend.bin.pad";
-    
-    int filesize = get_binfile_size(infilestr.c_str());
-    //cout << "file size=" << filesize << endl;
-    
-    ifstream infile(infilestr.c_str(), ios::binary);
-    ofstream outfile(outfilestr.c_str(), ios::binary);
-    
     const unsigned char pattern[] = { 0x99, 0x99, 0x96, 0x96,
         0x3F, 0xCC, 0x66, 0xFC,
-							 0xC0, 0x33, 0xCC, 0x03,
-							 0xE5, 0xDC, 0x31, 0x62 };
-    
-    outfile.write((const char*)pattern, sizeof(pattern));
-    
+        0xC0, 0x33, 0xCC, 0x03,
+        0xE5, 0xDC, 0x31, 0x62 };
+
+    // 32 byte header, then the body padded with 0xFF to 44KB
+    size_t filesize = ram1_bin.size();
+    ram1_prepend.assign(32 + max(filesize, (size_t)(45056-32)), (char)0xFF);
+
+    memcpy(&ram1_prepend[0], pattern, sizeof(pattern));
+
     // write length
-    char lenHexStr[4];
-    memcpy(lenHexStr, (char*)&filesize, 4);
-    outfile.write(lenHexStr, sizeof(lenHexStr));
-    
+    put_le32(ram1_prepend, 16, filesize);
+
     // write address
-    int address = 0x10000bc8;
-    memcpy(lenHexStr, (char*)&address, 4);
-    outfile.write(lenHexStr, sizeof(lenHexStr));
-    
+    put_le32(ram1_prepend, 20, 0x10000bc8);
+
     // write header_len
-    short header_len = 44;
-    memcpy(lenHexStr, (char*)&header_len, 2);
-    outfile.write(lenHexStr, 2);
-    
-    for (int i=0; i<6; i++) {
-        outfile.put((char)(0xFF));
-    }
-    
+    ram1_prepend[24] = 44;
+    ram1_prepend[25] = 0;
+
     // write body
-    int bytes = filesize;
-    if (infile.is_open() && outfile.is_open() ) {
-        while ( bytes > 0 ) {
-            outfile.put(infile.get());
-            bytes--;
-        }
-    }
-    
-    for (int i=filesize; i<(45056-32); i++) {
-        outfile.put((char)(0xFF));
+    if (filesize > 0) {
+        memcpy(&ram1_prepend[32], &ram1_bin[0], filesize);
     }
-    
-    outfile.close();
-    infile.close();
+
+    write_file(build_path + "/ram_1_prepend.bin.pad", ram1_prepend);
 }
 
 void generate_ram2_bin(void)
 {
-    
-    string infilestr = build_path + "/ram_2.bin";
-    string outfilestr = build_path + "/ram_2_prepend.bin";
-    
-    int filesize = get_binfile_size(infilestr.c_str());
-    //cout << "file size=" << filesize << endl;
-    
-    ifstream infile(infilestr.c_str(), ios::binary);
-    ofstream outfile(outfilestr.c_str(), ios::binary);
-    //
-    
-    
+    // 16 byte header, then the body
+    size_t filesize = ram2_bin.size();
+    ram2_prepend.assign(16 + filesize, (char)0xFF);
+
     // write length
-    char lenHexStr[4];
-    memcpy(lenHexStr, (char*)&filesize, 4);
-    outfile.write(lenHexStr, sizeof(lenHexStr));
-    
+    put_le32(ram2_prepend, 0, filesize);
+
     // write address
-    memcpy(lenHexStr, (char*)&image2_pos, 4);
-    outfile.write(lenHexStr, sizeof(lenHexStr));
-    
-    for (int i=0; i<8; i++) {
-        outfile.put((char)(0xFF));
-    }
-    
+    put_le32(ram2_prepend, 4, image2_pos);
+
     // write body
-    int bytes = filesize;
-    if (infile.is_open() && outfile.is_open() ) {
-        while ( bytes > 0 ) {
-            outfile.put(infile.get());
-            bytes--;
-        }
+    if (filesize > 0) {
+        memcpy(&ram2_prepend[16], &ram2_bin[0], filesize);
     }
-    
-    outfile.close();
-    infile.close();
+
+    write_file(build_path + "/ram_2_prepend.bin", ram2_prepend);
 }
 
-#if 0
-void generate_ram3_bin(void)
+void merge_to_ram_all_bin(void)
 {
-    string infilestr = build_path + "/ram_3.bin";
-    string outfilestr = build_path + "/ram_3_prepend.bin";
-    
-    int filesize = get_binfile_size(infilestr.c_str());
-    //cout << "file size=" << filesize << endl;
-    
-    ifstream infile(infilestr.c_str(), ios::binary);
-    ofstream outfile(outfilestr.c_str(), ios::binary);
-    //
-    
-    // write length
-    char lenHexStr[4];
-    memcpy(lenHexStr, (char*)&filesize, 4);
-    outfile.write(lenHexStr, sizeof(lenHexStr));
-    
-    // write address
-    int address = 0x30000000;
-    memcpy(lenHexStr, (char*)&address, 4);
-    outfile.write(lenHexStr, sizeof(lenHexStr));
-    
-    for (int i=0; i<8; i++) {
-        outfile.put((char)(0xFF));
-    }
-    
-    // write body
-    int bytes = filesize;
-    if (infile.is_open() && outfile.is_open() ) {
-        while ( bytes > 0 ) {
-            outfile.put(infile.get());
-            bytes--;
+    ram_all.clear();
+    ram_all.reserve(ram1_prepend.size() + ram2_prepend.size());
+    ram_all.insert(ram_all.end(), ram1_prepend.begin(), ram1_prepend.end());
+    ram_all.insert(ram_all.end(), ram2_prepend.begin(), ram2_prepend.end());
+
+    write_file(build_path + "/ram_all.bin", ram_all);
+}
+
+// Delta images, applied on the board by FlashDelta (cores/arduino/FlashDelta.h).
+// ram_all.manifest keeps the CRC32 of every 4KB sector of the last ram_all.bin;
+// ram_all.delta holds the sectors that changed since.
+#define DELTA_MAGIC         0x544C4441  // "ADLT"
+#define DELTA_VERSION       1
+#define DELTA_SECTOR_SIZE   0x1000
+#define DELTA_HEADER_SIZE   32
+#define DELTA_RECORD_SIZE   12
+
+struct image_manifest {
+    unsigned long size;
+    unsigned long crc;
+    vector<unsigned long> sectors;
+};
+
+static unsigned long crc32(unsigned long crc, const char *data, size_t len)
+{
+    static unsigned long table[256];
+
+    if (table[1] == 0) {
+        for (unsigned long i=0; i<256; i++) {
+            unsigned long c = i;
+            for (int k=0; k<8; k++) {
+                c = (c >> 1) ^ (0xEDB88320 & (0 - (c & 1)));
+            }
+            table[i] = c;
         }
     }
-    
-    outfile.close();
-    infile.close();
+
+    crc = ~crc & 0xFFFFFFFF;
+    while (len--) {
+        crc = table[(crc ^ (unsigned char)*data++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc & 0xFFFFFFFF;
 }
-#endif
 
-void merge_to_ram_all_bin(void)
+void make_manifest(const vector<char> &image, image_manifest &manifest)
 {
-    string outfilestr = build_path + "/ram_all.bin";
-    
-    ofstream outfile(outfilestr.c_str(), ios::binary);
-    
-    // ram_1
-    string infilestr = build_path + "/ram_1_prepend.bin.pad";
-    int filesize = get_binfile_size(infilestr.c_str());
-    ifstream infile( infilestr.c_str(), ios::binary);
-    
-    // write body
-    int bytes = filesize;
-    if (infile.is_open() && outfile.is_open() ) {
-        while ( bytes > 0 ) {
-            outfile.put(infile.get());
-            bytes--;
-        }
+    manifest.size = image.size();
+    manifest.crc = crc32(0, image.empty() ? NULL : &image[0], image.size());
+    manifest.sectors.clear();
+    for (size_t offset=0; offset < image.size(); offset += DELTA_SECTOR_SIZE) {
+        size_t len = min((size_t)DELTA_SECTOR_SIZE, image.size() - offset);
+        manifest.sectors.push_back(crc32(0, &image[offset], len));
     }
-    infile.close();
-    
-    // ram_2
-    infilestr = build_path + "/ram_2_prepend.bin";
-    filesize = get_binfile_size(infilestr.c_str());
-    ifstream infile2(infilestr.c_str(), ios::binary);
-    
-    // write body
-    bytes = filesize;
-    if (infile2.is_open() && outfile.is_open() ) {
-        while ( bytes > 0 ) {
-            outfile.put(infile2.get());
-            bytes--;
-        }
+}
+
+int read_manifest(string filename, image_manifest &manifest)
+{
+    ifstream infile(filename.c_str());
+    string magic;
+    unsigned long crc;
+
+    if ( !(infile >> magic >> manifest.size >> hex >> manifest.crc) || magic != "ram_all.bin" ) {
+        return -1;
     }
-    infile2.close();
+    manifest.sectors.clear();
+    while (infile >> crc) {
+        manifest.sectors.push_back(crc);
+    }
+    if (manifest.sectors.size() != (manifest.size + DELTA_SECTOR_SIZE - 1) / DELTA_SECTOR_SIZE) {
+        return -1;
+    }
+    return 0;
+}
 
-#if 0
-    // ram_3
-    infilestr = build_path + "/ram_3_prepend.bin";
-    filesize = get_binfile_size( infilestr.c_str() );
-    ifstream infile3( infilestr.c_str(), ios::binary);
-    
-    // write body
-    bytes = filesize;
-    if (infile3.is_open() && outfile.is_open() ) {
-        while ( bytes > 0 ) {
-            outfile.put(infile3.get());
-            bytes--;
+int write_manifest(string filename, const image_manifest &manifest)
+{
+    vector<char> text;
+    char line[32];
+
+    snprintf(line, sizeof(line), "ram_all.bin %lu %08lx\n", manifest.size, manifest.crc);
+    text.insert(text.end(), line, line + strlen(line));
+    for (size_t i=0; i < manifest.sectors.size(); i++) {
+        snprintf(line, sizeof(line), "%08lx\n", manifest.sectors[i]);
+        text.insert(text.end(), line, line + strlen(line));
+    }
+    return write_file(filename, text);
+}
+
+// Every sector of image whose CRC32 or length differs from base; returns
+// the number of sectors
+unsigned long make_delta(const vector<char> &image, const image_manifest &base, vector<char> &delta)
+{
+    image_manifest manifest;
+    unsigned long records = 0;
+
+    make_manifest(image, manifest);
+
+    delta.assign(DELTA_HEADER_SIZE, 0);
+    for (size_t i=0; i < manifest.sectors.size(); i++) {
+        size_t offset = i * DELTA_SECTOR_SIZE;
+        size_t len = min((size_t)DELTA_SECTOR_SIZE, image.size() - offset);
+        size_t base_len = 0;
+
+        if (offset < base.size) {
+            base_len = min((size_t)DELTA_SECTOR_SIZE, (size_t)base.size - offset);
         }
+        if (len == base_len && manifest.sectors[i] == base.sectors[i]) continue;
+
+        size_t at = delta.size();
+        delta.resize(at + DELTA_RECORD_SIZE + len);
+        put_le32(delta, at, offset);
+        put_le32(delta, at + 4, len);
+        put_le32(delta, at + 8, manifest.sectors[i]);
+        memcpy(&delta[at + DELTA_RECORD_SIZE], &image[offset], len);
+        records++;
     }
-    infile3.close();
-#endif
-    outfile.close();
+
+    put_le32(delta, 0, DELTA_MAGIC);
+    put_le32(delta, 4, DELTA_VERSION);
+    put_le32(delta, 8, DELTA_SECTOR_SIZE);
+    put_le32(delta, 12, records);
+    put_le32(delta, 16, base.size);
+    put_le32(delta, 20, base.crc);
+    put_le32(delta, 24, manifest.size);
+    put_le32(delta, 28, manifest.crc);
+
+    return records;
+}
+
+void generate_delta(void)
+{
+    string manifest_path = build_path + "/ram_all.manifest";
+    string delta_path = build_path + "/ram_all.delta";
+    image_manifest base;
+    image_manifest manifest;
+
+    // a delta against an older image must not be left behind
+    remove(delta_path.c_str());
+
+    if (read_manifest(manifest_path, base) == 0) {
+        vector<char> delta;
+
+        unsigned long records = make_delta(ram_all, base, delta);
+        cout << "ram_all.delta: " << records << " of " << (ram_all.size() + DELTA_SECTOR_SIZE - 1) / DELTA_SECTOR_SIZE
+             << " sectors changed, " << delta.size() << " bytes instead of " << ram_all.size() << endl;
+        write_file(delta_path, delta);
+    }
+
+    make_manifest(ram_all, manifest);
+    write_manifest(manifest_path, manifest);
 }
 
 bool isFileExist(string path) {
     bool ret = false;
     struct stat info;
-    
+
     do {
         if (stat(path.c_str(), &info) != 0) {
             break;
         }
-        
+
         ret = true;
     } while (0);
-    
+
     return ret;
 }
 
@@ -332,65 +571,87 @@ void download_bin_file(void)
 {
     string filepath;
     string filepath_ram_all;
-    
+    string mbed_path;
+
     string cmd;
-    
+
     do {
-        filepath = "/Volumes/MBED/mbed.htm";
+#ifdef __APPLE__
+        mbed_path = "/Volumes/MBED";
+#else
+        const char *user = getenv("USER");
+        mbed_path = string("/media/") + (user ? user : "") + "/MBED";
+        if (!isFileExist(mbed_path + "/mbed.htm")) {
+            mbed_path = string("/run/media/") + (user ? user : "") + "/MBED";
+        }
+#endif
+        filepath = mbed_path + "/mbed.htm";
         if (!isFileExist(filepath)) {
             cout << "ERR: Cannot access mbed disk, please re-plug again" << endl;
             break;
         }
-        
+
         filepath_ram_all = build_path + "/ram_all.bin";
         if (!isFileExist(filepath_ram_all)) {
             cout << "ERR: Cannot access ram_all.bin, maybe compile error" << endl;
             break;
         }
-        
+
         cout << "uploading..." << endl;
-        cmd = "cp " + filepath_ram_all;
-        cmd.append(" /Volumes/MBED/;sync");
+        cmd = "cp " + filepath_ram_all + " " + mbed_path + "/;sync";
         cout << cmd << endl;
-        
+
         system(cmd.c_str());
-        
+
         cout << "upload finish" << endl;
     } while (0);
-    
-}
 
+}
 
 
+// system/deltabench builds the delta code on its own
+#ifndef BINFILETOOL_NO_MAIN
 int main(int argc, char* argv[])
 {
     int ret;
-    
+
     if (argc != 3) {
         cout << argv[0] << " <this tool path>" << " <build_path> " << endl;
         return -1;
     }
-    
+
+    // the toolchain is no longer run, the argument stays for platform.txt
     tool_path = argv[1];
-    
+
     build_path = argv[2];
-    
-    toolchain_prefix = tool_path + "/arm-none-eabi";
-    
-    
+
+    ret = load_target_file();
+    if ( ret != 0 ) {
+        return ret;
+    }
+
     ret = copy_target_file();
     if ( ret != 0 ) {
         cout << "Copy files error" << endl;
         return ret;
     }
-    
-    generate_binfiles();
-    generate_mapfile();
+
+    ret = generate_binfiles();
+    if ( ret != 0 ) {
+        return ret;
+    }
+    ret = generate_mapfile();
+    if ( ret != 0 ) {
+        return ret;
+    }
     generate_ram1_bin();
     generate_ram2_bin();
     //generate_ram3_bin();
     merge_to_ram_all_bin();
+    generate_delta();
     download_bin_file();
-    
+
     return 0;
 }
+#endif
+
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -18,314 +19,545 @@ using namespace std;
 
 string tool_path;
 string build_path;
-string toolchain_prefix;
 
-int image2_pos=0;
+unsigned long image2_pos=0;
 
-int copy_target_file(void)
-{
-	int ret;
+// target.axf, read once; the images and target.map come from it directly
+vector<char> axf;
 
-	string file1 = build_path + ".\\target.axf";
-	string file2 = build_path + ".\\target.axf.bak";
-	string file3 = build_path + ".\\target_pure.axf";
+vector<char> ram1_bin;
+vector<char> ram2_bin;
+vector<char> ram1_prepend;
+vector<char> ram2_prepend;
+vector<char> ram_all;
 
-	ret = CopyFile(file1.c_str(), file2.c_str(), false);
-	if ( ret == 0 ) {
-  	   cout << " CopyFile : " << file1 << " - " << file2 << ", ret=" << ret << endl;
-	   return -1;
-	}
-	ret = CopyFile(file1.c_str(), file3.c_str(), false);
-	if ( ret == 0 ) {
-  	   cout << " CopyFile : " << file1 << " - " << file3 << ", ret=" << ret << endl;
-	   return -1;
-	}
-	return 0;
-}
 
-void generate_binfiles(void)
-{
-	string build_path1 = "\"" + build_path;
-	
-	string strip_command = toolchain_prefix + "-strip.exe\" " + build_path1 + ".\\target_pure.axf\" ";
-    string make_bin1 = toolchain_prefix + "-objcopy.exe\" -j .ram.start.table -j .ram_image1.text -Obinary " + build_path1 + ".\\target_pure.axf\" " + build_path1 + ".\\ram_1.bin\" ";
-    string make_bin2 = toolchain_prefix + "-objcopy.exe\" -j .image2.start.table -j .ram_image2.text  -j .ARM.exidx  -Obinary " + build_path1 + ".\\target_pure.axf\" " + build_path1 + ".\\ram_2.bin\" ";
-//string make_bin3 = toolchain_prefix + "-objcopy.exe\" -j .image3 -j .sdr_data -Obinary " + build_path1 + ".\\target_pure.axf\" " + build_path1 + ".\\ram_3.bin\" ";
+// ELF32 little endian, as written by arm-none-eabi-ld. Only the section
+// headers, the program headers and the symbol table are read.
+#define SHT_SYMTAB      2
+#define SHT_NOBITS      8
 
-    strip_command = "\"" + strip_command + "\"";
-	//printf(strip_command.c_str());
-    system(strip_command.c_str());
+#define SHF_WRITE       0x1
+#define SHF_ALLOC       0x2
+#define SHF_EXECINSTR   0x4
 
-	make_bin1 = "\"" + make_bin1 + "\"";
-	//printf(make_bin1.c_str());
-	system(make_bin1.c_str());
+#define PT_LOAD         1
 
-	make_bin2 = "\"" + make_bin2 + "\"";
-	system(make_bin2.c_str());
+#define SHN_UNDEF       0
+#define SHN_ABS         0xfff1
+#define SHN_COMMON      0xfff2
 
+#define STB_LOCAL       0
+#define STB_WEAK        2
+#define STT_OBJECT      1
+#define STT_SECTION     3
+#define STT_FILE        4
 
-	//make_bin3 = "\"" + make_bin3 + "\"";
-	//system(make_bin3.c_str());
-    //string make_asm = toolchain_prefix + "-objdump -d " + build_path +".\\target.axf > " + build_path + ".\\target.asm";
+struct elf_section {
+	string name;
+	unsigned long type;
+	unsigned long flags;
+	unsigned long addr;
+	unsigned long lma;      // load address, what objcopy -Obinary lays out by
+	unsigned long offset;
+	unsigned long size;
+	unsigned long link;
+	unsigned long entsize;
+};
 
-}
+vector<elf_section> sections;
 
+static unsigned long elf_get16(unsigned long offset)
+{
+	const unsigned char *p = (const unsigned char *)&axf[offset];
+	return p[0] | (p[1] << 8);
+}
 
-void sort_mapfile()
+static unsigned long elf_get32(unsigned long offset)
 {
-	vector<string> lines;
+	const unsigned char *p = (const unsigned char *)&axf[offset];
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned long)p[3] << 24);
+}
 
-	ifstream infile;
+static void put_le32(vector<char> &buf, size_t offset, unsigned long value)
+{
+	for (int i=0; i<4; i++) {
+		buf[offset + i] = (char)(value >> (8 * i));
+	}
+}
 
-	string infilestr = build_path + ".\\target.nm";
-	infile.open( infilestr.c_str() );
+static bool elf_in_file(unsigned long offset, unsigned long size)
+{
+	return offset <= axf.size() && size <= axf.size() - offset;
+}
 
-	string line;
-	while ( getline(infile, line) )
-	{
-		lines.push_back(line);
+int read_file(string filename, vector<char> &buf)
+{
+	ifstream infile(filename.c_str(), ios::binary);
+	if ( !infile ) {
+		cout << "ERR: Cannot open " << filename << endl;
+		return -1;
 	}
-	infile.close();
 
-	sort(lines.begin(), lines.end());
+	infile.seekg(0, ios::end);
+	long size = (long)infile.tellg();
+	infile.seekg(0, ios::beg);
 
-	string outfilestr = build_path + ".\\target.map";
-	ofstream outfile( outfilestr.c_str(), ios::out);
-	if ( !outfile) 
-	{
-		cerr << "File cound not be opened: target.map" << endl;
-		return;
+	buf.resize(size);
+	if (size > 0) {
+		infile.read(&buf[0], size);
 	}
+	if ( !infile ) {
+		cout << "ERR: Cannot read " << filename << endl;
+		return -1;
+	}
+	return 0;
+}
 
-	for (size_t i=0; i < lines.size(); i++) {
-		if ( lines[i].find("__ram_image2_text_start__") != std::string::npos ) {
-			//cout << lines[i] << endl;
-			char pos_str[9];
-			memcpy(pos_str, lines[i].c_str(), 8);
-			pos_str[8] = 0;
-			image2_pos = strtoul(pos_str, NULL, 16);
-			//cout << "image2_pos=" << image2_pos << endl;
-		}
-		outfile << lines[i] << endl;
+int write_file(string filename, const vector<char> &buf)
+{
+	ofstream outfile(filename.c_str(), ios::binary);
+	if (buf.size() > 0) {
+		outfile.write(&buf[0], buf.size());
+	}
+	outfile.close();
+	if ( !outfile ) {
+		cout << "ERR: Cannot write " << filename << endl;
+		return -1;
 	}
+	return 0;
 }
 
+int load_target_file(void)
+{
+	if (read_file(build_path + ".\\target.axf", axf) != 0) {
+		return -1;
+	}
 
+	if (axf.size() < 52 || memcmp(&axf[0], "\177ELF", 4) != 0 || axf[4] != 1 || axf[5] != 1) {
+		cout << "ERR: target.axf is not a 32-bit little endian ELF file" << endl;
+		return -1;
+	}
 
+	unsigned long phoff = elf_get32(28);
+	unsigned long shoff = elf_get32(32);
+	unsigned long phentsize = elf_get16(42);
+	unsigned long phnum = elf_get16(44);
+	unsigned long shentsize = elf_get16(46);
+	unsigned long shnum = elf_get16(48);
+	unsigned long shstrndx = elf_get16(50);
+
+	if (!elf_in_file(phoff, phnum * phentsize) || !elf_in_file(shoff, shnum * shentsize)
+		|| shstrndx >= shnum || phentsize < 32 || shentsize < 40) {
+		cout << "ERR: target.axf is truncated" << endl;
+		return -1;
+	}
 
-void generate_mapfile(void)
-{
-	string build_path1 = "\"" + build_path;
-	string map_gen = toolchain_prefix + "-nm.exe\" " + build_path1 + ".\\target.axf\" > " + build_path1 + ".\\target.nm\" ";
+	unsigned long names = elf_get32(shoff + shstrndx * shentsize + 16);
+	unsigned long names_size = elf_get32(shoff + shstrndx * shentsize + 20);
+	if (!elf_in_file(names, names_size)) {
+		cout << "ERR: target.axf is truncated" << endl;
+		return -1;
+	}
+
+	sections.clear();
+	for (unsigned long i=0; i<shnum; i++) {
+		unsigned long sh = shoff + i * shentsize;
+		elf_section sec;
+
+		unsigned long name = elf_get32(sh);
+		if (name < names_size) {
+			sec.name = string(&axf[names + name], strnlen(&axf[names + name], names_size - name));
+		}
+		sec.type = elf_get32(sh + 4);
+		sec.flags = elf_get32(sh + 8);
+		sec.addr = elf_get32(sh + 12);
+		sec.offset = elf_get32(sh + 16);
+		sec.size = elf_get32(sh + 20);
+		sec.link = elf_get32(sh + 24);
+		sec.entsize = elf_get32(sh + 36);
+		sec.lma = sec.addr;
+
+		if (sec.type != SHT_NOBITS && !elf_in_file(sec.offset, sec.size)) {
+			cout << "ERR: target.axf is truncated" << endl;
+			return -1;
+		}
 
-	map_gen = "\"" + map_gen + "\"";
-	system(map_gen.c_str());
-	sort_mapfile();
+		// a section placed with AT> loads somewhere else than it runs,
+		// the load segment holding it says where
+		if ((sec.flags & SHF_ALLOC) && sec.type != SHT_NOBITS) {
+			for (unsigned long j=0; j<phnum; j++) {
+				unsigned long ph = phoff + j * phentsize;
+				unsigned long p_offset = elf_get32(ph + 4);
+				unsigned long p_filesz = elf_get32(ph + 16);
+
+				if (elf_get32(ph) == PT_LOAD && sec.offset >= p_offset
+					&& sec.offset + sec.size <= p_offset + p_filesz) {
+					sec.lma = elf_get32(ph + 12) + (sec.offset - p_offset);
+					break;
+				}
+			}
+		}
+		sections.push_back(sec);
+	}
+
+	return 0;
 }
 
-int get_binfile_size(const char *filename)
+// Same as objcopy -j <names> -Obinary: the sections at their load
+// addresses, gaps filled with 0
+int extract_sections(const char *names[], int count, vector<char> &image)
 {
-	ifstream infile(filename, ios::binary);
+	unsigned long low = 0xFFFFFFFF;
+	unsigned long high = 0;
 
-	infile.seekg(0, ios::end);
-	int size = infile.tellg();
-	infile.seekg(0, ios::beg);
-	infile.close();
+	for (size_t i=0; i<sections.size(); i++) {
+		elf_section &sec = sections[i];
+		if (find(names, names + count, sec.name) == names + count) continue;
+		if (sec.type == SHT_NOBITS || !(sec.flags & SHF_ALLOC) || sec.size == 0) continue;
 
-	return size;
-}
+		low = min(low, sec.lma);
+		high = max(high, sec.lma + sec.size);
+	}
+	if (low > high) {
+		cout << "ERR: " << names[0] << " not found in target.axf" << endl;
+		return -1;
+	}
 
+	image.assign(high - low, 0);
+	for (size_t i=0; i<sections.size(); i++) {
+		elf_section &sec = sections[i];
+		if (find(names, names + count, sec.name) == names + count) continue;
+		if (sec.type == SHT_NOBITS || !(sec.flags & SHF_ALLOC) || sec.size == 0) continue;
 
-void generate_ram1_bin(void)
-{
+		memcpy(&image[sec.lma - low], &axf[sec.offset], sec.size);
+	}
 
-	string infilestr = build_path + ".\\ram_1.bin";
-	string outfilestr = build_path + ".\\ram_1_prepend.bin.pad";
+	return 0;
+}
 
-	int filesize = get_binfile_size(infilestr.c_str());
-	//cout << "file size=" << filesize << endl;
+int copy_target_file(void)
+{
+	int ret;
 
-	ifstream infile(infilestr.c_str(), ios::binary);
-	ofstream outfile(outfilestr.c_str(), ios::binary);
+	string file1 = build_path + ".\\target.axf";
+	string file2 = build_path + ".\\target.axf.bak";
 
-	const unsigned char pattern[] = { 0x99, 0x99, 0x96, 0x96, 
-		                     0x3F, 0xCC, 0x66, 0xFC, 
-							 0xC0, 0x33, 0xCC, 0x03, 
-							 0xE5, 0xDC, 0x31, 0x62 };
+	ret = CopyFile(file1.c_str(), file2.c_str(), false);
+	if ( ret == 0 ) {
+  	   cout << " CopyFile : " << file1 << " - " << file2 << ", ret=" << ret << endl;
+	   return -1;
+	}
+	return 0;
+}
 
-	outfile.write((const char*)pattern, sizeof(pattern));
+int generate_binfiles(void)
+{
+	const char *image1[] = { ".ram.start.table", ".ram_image1.text" };
+	const char *image2[] = { ".image2.start.table", ".ram_image2.text", ".ARM.exidx", ".tcm" };
+	//const char *image3[] = { ".image3", ".ARM.exidx", ".sdr_data" };
 
-	// write length
-	char lenHexStr[4];
-	memcpy(lenHexStr, (char*)&filesize, 4);
-	outfile.write(lenHexStr, sizeof(lenHexStr));
+	if (extract_sections(image1, 2, ram1_bin) != 0) return -1;
+	if (extract_sections(image2, 4, ram2_bin) != 0) return -1;
 
-	// write address
-	int address = 0x10000bc8;
-	memcpy(lenHexStr, (char*)&address, 4);
-	outfile.write(lenHexStr, sizeof(lenHexStr));
+	if (write_file(build_path + ".\\ram_1.bin", ram1_bin) != 0) return -1;
+	if (write_file(build_path + ".\\ram_2.bin", ram2_bin) != 0) return -1;
 
-	// write header_len
-	short header_len = 44;
-	memcpy(lenHexStr, (char*)&header_len, 2);
-	outfile.write(lenHexStr, 2);
+	return 0;
+}
 
-	for (int i=0; i<6; i++) {
-		outfile.put((char)(0xFF));
+// One line per symbol, in the format of nm, sorted by address
+int generate_mapfile(void)
+{
+	vector<string> lines;
+	bool found = false;
+
+	for (size_t i=0; i<sections.size(); i++) {
+		elf_section &symtab = sections[i];
+		if (symtab.type != SHT_SYMTAB || symtab.entsize < 16 || symtab.link >= sections.size()) continue;
+
+		elf_section &strtab = sections[symtab.link];
+
+		for (unsigned long sym = symtab.offset + symtab.entsize; sym + 16 <= symtab.offset + symtab.size; sym += symtab.entsize) {
+			unsigned long name = elf_get32(sym);
+			unsigned long value = elf_get32(sym + 4);
+			unsigned char info = axf[sym + 12];
+			unsigned long shndx = elf_get16(sym + 14);
+			unsigned char bind = info >> 4;
+			unsigned char type = info & 0xf;
+
+			if (type == STT_SECTION || type == STT_FILE || name == 0 || name >= strtab.size) continue;
+
+			const char *sym_name = &axf[strtab.offset + name];
+			size_t sym_len = strnlen(sym_name, strtab.size - name);
+
+			// ARM mapping symbols ($a, $t, $d), nm leaves them out too
+			if (sym_name[0] == '$' && strchr("atd", sym_name[1]) && sym_name[1] != 0
+				&& (sym_name[2] == 0 || sym_name[2] == '.')) continue;
+
+			char letter;
+			if (shndx == SHN_UNDEF) {
+				letter = (bind == STB_WEAK) ? 'w' : 'U';
+			} else if (bind == STB_WEAK) {
+				letter = (type == STT_OBJECT) ? 'V' : 'W';
+			} else {
+				if (shndx == SHN_ABS) {
+					letter = 'a';
+				} else if (shndx == SHN_COMMON) {
+					letter = 'c';
+				} else if (shndx >= sections.size()) {
+					letter = '?';
+				} else if (sections[shndx].type == SHT_NOBITS) {
+					letter = 'b';
+				} else if (sections[shndx].flags & SHF_EXECINSTR) {
+					letter = 't';
+				} else if (sections[shndx].flags & SHF_WRITE) {
+					letter = 'd';
+				} else if (sections[shndx].flags & SHF_ALLOC) {
+					letter = 'r';
+				} else {
+					letter = 'n';
+				}
+				if (bind != STB_LOCAL && letter != '?') {
+					letter = toupper(letter);
+				}
+			}
+
+			char prefix[16];
+			if (shndx == SHN_UNDEF) {
+				sprintf(prefix, "%8s %c ", "", letter);
+			} else {
+				sprintf(prefix, "%08lx %c ", value, letter);
+			}
+			lines.push_back(string(prefix) + string(sym_name, sym_len));
+
+			if (sym_len == 25 && memcmp(sym_name, "__ram_image2_text_start__", 25) == 0) {
+				image2_pos = value;
+				found = true;
+			}
+		}
 	}
 
-	// write body
-	int bytes = filesize;
-	if (infile.is_open() && outfile.is_open() ) {
-		while ( bytes > 0 ) {
-			outfile.put(infile.get());
-			bytes--;
-		}
+	if ( !found ) {
+		cout << "ERR: __ram_image2_text_start__ not found in target.axf" << endl;
+		return -1;
 	}
 
-	for (int i=filesize; i<(45056-32); i++) {
-		outfile.put((char)(0xFF));
+	sort(lines.begin(), lines.end());
+
+	vector<char> map;
+	for (size_t i=0; i < lines.size(); i++) {
+		map.insert(map.end(), lines[i].begin(), lines[i].end());
+		map.push_back('\n');
 	}
 
-	outfile.close();
-	infile.close();
+	return write_file(build_path + ".\\target.map", map);
 }
 
-void generate_ram2_bin(void)
+void generate_ram1_bin(void)
 {
+	const unsigned char pattern[] = { 0x99, 0x99, 0x96, 0x96,
+		0x3F, 0xCC, 0x66, 0xFC,
+		0xC0, 0x33, 0xCC, 0x03,
+		0xE5, 0xDC, 0x31, 0x62 };
 
-	string infilestr = build_path + ".\\ram_2.bin";
-	string outfilestr = build_path + ".\\ram_2_prepend.bin";
-
-	int filesize = get_binfile_size(infilestr.c_str());
-	//cout << "file size=" << filesize << endl;
-
-	ifstream infile(infilestr.c_str(), ios::binary);
-	ofstream outfile(outfilestr.c_str(), ios::binary);
-//
+	// 32 byte header, then the body padded with 0xFF to 44KB
+	size_t filesize = ram1_bin.size();
+	ram1_prepend.assign(32 + max(filesize, (size_t)(45056-32)), (char)0xFF);
 
+	memcpy(&ram1_prepend[0], pattern, sizeof(pattern));
 
 	// write length
-	char lenHexStr[4];
-	memcpy(lenHexStr, (char*)&filesize, 4);
-	outfile.write(lenHexStr, sizeof(lenHexStr));
+	put_le32(ram1_prepend, 16, filesize);
 
 	// write address
-	memcpy(lenHexStr, (char*)&image2_pos, 4);
-	outfile.write(lenHexStr, sizeof(lenHexStr));
+	put_le32(ram1_prepend, 20, 0x10000bc8);
 
-	for (int i=0; i<8; i++) {
-		outfile.put((char)(0xFF));
-	}
+	// write header_len
+	ram1_prepend[24] = 44;
+	ram1_prepend[25] = 0;
 
 	// write body
-	int bytes = filesize;
-	if (infile.is_open() && outfile.is_open() ) {
-		while ( bytes > 0 ) {
-			outfile.put(infile.get());
-			bytes--;
-		}
+	if (filesize > 0) {
+		memcpy(&ram1_prepend[32], &ram1_bin[0], filesize);
 	}
 
-	outfile.close();
-	infile.close();
+	write_file(build_path + ".\\ram_1_prepend.bin.pad", ram1_prepend);
 }
 
-
-#if 0
-void generate_ram3_bin(void)
+void generate_ram2_bin(void)
 {
-	string infilestr = build_path + ".\\ram_3.bin";
-	string outfilestr = build_path + ".\\ram_3_prepend.bin";
-
-	int filesize = get_binfile_size(infilestr.c_str());
-	//cout << "file size=" << filesize << endl;
-
-	ifstream infile(infilestr.c_str(), ios::binary);
-	ofstream outfile(outfilestr.c_str(), ios::binary);
-//
+	// 16 byte header, then the body
+	size_t filesize = ram2_bin.size();
+	ram2_prepend.assign(16 + filesize, (char)0xFF);
 
 	// write length
-	char lenHexStr[4];
-	memcpy(lenHexStr, (char*)&filesize, 4);
-	outfile.write(lenHexStr, sizeof(lenHexStr));
+	put_le32(ram2_prepend, 0, filesize);
 
 	// write address
-	int address = 0x30000000;
-	memcpy(lenHexStr, (char*)&address, 4);
-	outfile.write(lenHexStr, sizeof(lenHexStr));
-
-	for (int i=0; i<8; i++) {
-		outfile.put((char)(0xFF));
-	}
+	put_le32(ram2_prepend, 4, image2_pos);
 
 	// write body
-	int bytes = filesize;
-	if (infile.is_open() && outfile.is_open() ) {
-		while ( bytes > 0 ) {
-			outfile.put(infile.get());
-			bytes--;
-		}
+	if (filesize > 0) {
+		memcpy(&ram2_prepend[16], &ram2_bin[0], filesize);
 	}
 
-	outfile.close();
-	infile.close();
+	write_file(build_path + ".\\ram_2_prepend.bin", ram2_prepend);
 }
-#endif //#if 0
 
 void merge_to_ram_all_bin(void)
 {
-	string outfilestr = build_path + ".\\ram_all.bin";
+	ram_all.clear();
+	ram_all.reserve(ram1_prepend.size() + ram2_prepend.size());
+	ram_all.insert(ram_all.end(), ram1_prepend.begin(), ram1_prepend.end());
+	ram_all.insert(ram_all.end(), ram2_prepend.begin(), ram2_prepend.end());
 
-	ofstream outfile(outfilestr.c_str(), ios::binary);
+	write_file(build_path + ".\\ram_all.bin", ram_all);
+}
 
-	// ram_1
-	string infilestr = build_path + ".\\ram_1_prepend.bin.pad";
-	int filesize = get_binfile_size(infilestr.c_str());
-	ifstream infile( infilestr.c_str(), ios::binary);
 
-	// write body
-	int bytes = filesize;
-	if (infile.is_open() && outfile.is_open() ) {
-		while ( bytes > 0 ) {
-			outfile.put(infile.get());
-			bytes--;
+// Delta images, applied on the board by FlashDelta (cores/arduino/FlashDelta.h).
+// ram_all.manifest keeps the CRC32 of every 4KB sector of the last ram_all.bin;
+// ram_all.delta holds the sectors that changed since.
+#define DELTA_MAGIC         0x544C4441  // "ADLT"
+#define DELTA_VERSION       1
+#define DELTA_SECTOR_SIZE   0x1000
+#define DELTA_HEADER_SIZE   32
+#define DELTA_RECORD_SIZE   12
+
+struct image_manifest {
+	unsigned long size;
+	unsigned long crc;
+	vector<unsigned long> sectors;
+};
+
+static unsigned long crc32(unsigned long crc, const char *data, size_t len)
+{
+	static unsigned long table[256];
+
+	if (table[1] == 0) {
+		for (unsigned long i=0; i<256; i++) {
+			unsigned long c = i;
+			for (int k=0; k<8; k++) {
+				c = (c >> 1) ^ (0xEDB88320 & (0 - (c & 1)));
+			}
+			table[i] = c;
 		}
 	}
-	infile.close();
 
-	// ram_2
-	infilestr = build_path + ".\\ram_2_prepend.bin";
-	filesize = get_binfile_size(infilestr.c_str());
-	ifstream infile2(infilestr.c_str(), ios::binary);
+	crc = ~crc & 0xFFFFFFFF;
+	while (len--) {
+		crc = table[(crc ^ (unsigned char)*data++) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc & 0xFFFFFFFF;
+}
 
-	// write body
-	bytes = filesize;
-	if (infile2.is_open() && outfile.is_open() ) {
-		while ( bytes > 0 ) {
-			outfile.put(infile2.get());
-			bytes--;
-		}
+void make_manifest(const vector<char> &image, image_manifest &manifest)
+{
+	manifest.size = image.size();
+	manifest.crc = crc32(0, image.empty() ? NULL : &image[0], image.size());
+	manifest.sectors.clear();
+	for (size_t offset=0; offset < image.size(); offset += DELTA_SECTOR_SIZE) {
+		size_t len = min((size_t)DELTA_SECTOR_SIZE, image.size() - offset);
+		manifest.sectors.push_back(crc32(0, &image[offset], len));
 	}
-	infile2.close();
+}
 
-#if 0
-	// ram_3
-	infilestr = build_path + ".\\ram_3_prepend.bin";
-	filesize = get_binfile_size( infilestr.c_str() );
-	ifstream infile3( infilestr.c_str(), ios::binary);
+int read_manifest(string filename, image_manifest &manifest)
+{
+	ifstream infile(filename.c_str());
+	string magic;
+	unsigned long crc;
 
-	// write body
-	bytes = filesize;
-	if (infile3.is_open() && outfile.is_open() ) {
-		while ( bytes > 0 ) {
-			outfile.put(infile3.get());
-			bytes--;
+	if ( !(infile >> magic >> manifest.size >> hex >> manifest.crc) || magic != "ram_all.bin" ) {
+		return -1;
+	}
+	manifest.sectors.clear();
+	while (infile >> crc) {
+		manifest.sectors.push_back(crc);
+	}
+	if (manifest.sectors.size() != (manifest.size + DELTA_SECTOR_SIZE - 1) / DELTA_SECTOR_SIZE) {
+		return -1;
+	}
+	return 0;
+}
+
+int write_manifest(string filename, const image_manifest &manifest)
+{
+	vector<char> text;
+	char line[32];
+
+	sprintf(line, "ram_all.bin %lu %08lx\n", manifest.size, manifest.crc);
+	text.insert(text.end(), line, line + strlen(line));
+	for (size_t i=0; i < manifest.sectors.size(); i++) {
+		sprintf(line, "%08lx\n", manifest.sectors[i]);
+		text.insert(text.end(), line, line + strlen(line));
+	}
+	return write_file(filename, text);
+}
+
+// Every sector of image whose CRC32 or length differs from base; returns
+// the number of sectors
+unsigned long make_delta(const vector<char> &image, const image_manifest &base, vector<char> &delta)
+{
+	image_manifest manifest;
+	unsigned long records = 0;
+
+	make_manifest(image, manifest);
+
+	delta.assign(DELTA_HEADER_SIZE, 0);
+	for (size_t i=0; i < manifest.sectors.size(); i++) {
+		size_t offset = i * DELTA_SECTOR_SIZE;
+		size_t len = min((size_t)DELTA_SECTOR_SIZE, image.size() - offset);
+		size_t base_len = 0;
+
+		if (offset < base.size) {
+			base_len = min((size_t)DELTA_SECTOR_SIZE, (size_t)base.size - offset);
 		}
+		if (len == base_len && manifest.sectors[i] == base.sectors[i]) continue;
+
+		size_t at = delta.size();
+		delta.resize(at + DELTA_RECORD_SIZE + len);
+		put_le32(delta, at, offset);
+		put_le32(delta, at + 4, len);
+		put_le32(delta, at + 8, manifest.sectors[i]);
+		memcpy(&delta[at + DELTA_RECORD_SIZE], &image[offset], len);
+		records++;
 	}
-	infile3.close();
-#endif
-	outfile.close();
+
+	put_le32(delta, 0, DELTA_MAGIC);
+	put_le32(delta, 4, DELTA_VERSION);
+	put_le32(delta, 8, DELTA_SECTOR_SIZE);
+	put_le32(delta, 12, records);
+	put_le32(delta, 16, base.size);
+	put_le32(delta, 20, base.crc);
+	put_le32(delta, 24, manifest.size);
+	put_le32(delta, 28, manifest.crc);
+
+	return records;
+}
+
+void generate_delta(void)
+{
+	string manifest_path = build_path + ".\\ram_all.manifest";
+	string delta_path = build_path + ".\\ram_all.delta";
+	image_manifest base;
+	image_manifest manifest;
+
+	// a delta against an older image must not be left behind
+	remove(delta_path.c_str());
+
+	if (read_manifest(manifest_path, base) == 0) {
+		vector<char> delta;
+
+		unsigned long records = make_delta(ram_all, base, delta);
+		cout << "ram_all.delta: " << records << " of " << (ram_all.size() + DELTA_SECTOR_SIZE - 1) / DELTA_SECTOR_SIZE
+			 << " sectors changed, " << delta.size() << " bytes instead of " << ram_all.size() << endl;
+		write_file(delta_path, delta);
+	}
+
+	make_manifest(ram_all, manifest);
+	write_manifest(manifest_path, manifest);
 }
 
 
@@ -373,6 +605,7 @@ int main(int argc, char* argv[])
 		return -1;
 	}
 
+	// the toolchain is no longer run, the argument stays for platform.txt
 	tool_path = argv[1];
 	tool_path.erase(std::find(tool_path.begin(), tool_path.end(), '\"'));
 	tool_path.erase(std::find(tool_path.begin(), tool_path.end(), '\"'));
@@ -383,8 +616,10 @@ int main(int argc, char* argv[])
 	build_path.erase(std::find(build_path.begin(), build_path.end(), '\"'));
 	build_path.append("\\");
 
-    toolchain_prefix = "\"" + tool_path + "\\bin\\arm-none-eabi";
-
+	ret = load_target_file();
+	if ( ret != 0 ) {
+		return ret;
+	}
 
 	ret = copy_target_file();
 	if ( ret != 0 ) {
@@ -392,12 +627,19 @@ int main(int argc, char* argv[])
 		return ret;
 	}
 
-	generate_binfiles();
-	generate_mapfile();
+	ret = generate_binfiles();
+	if ( ret != 0 ) {
+		return ret;
+	}
+	ret = generate_mapfile();
+	if ( ret != 0 ) {
+		return ret;
+	}
 	generate_ram1_bin();
 	generate_ram2_bin();
 	//generate_ram3_bin();
 	merge_to_ram_all_bin();
+	generate_delta();
 	download_bin_file();
 
 	return 0;
@@ -0,0 +1,62 @@
+/*
+ * Samples analog pin 2 at 8kHz into two buffer halves of 256 samples
+ * and prints the minimum, maximum and mean of every 16th half.
+ *
+ * The callback runs in the DMA interrupt. It only summarizes the
+ * half; loop() does the printing.
+ */
+
+#include "Arduino.h"
+#include "ADCSampler.h"
+
+#define RATE        8000
+#define FRAMES      256
+
+static const uint8_t pins[] = { 2 };
+
+static volatile uint16_t minimum, maximum;
+static volatile uint32_t mean;
+static volatile bool ready;
+
+static void onBuffer(const uint16_t *samples, uint32_t frames, void *arg)
+{
+    uint16_t lo = 0xFFFF, hi = 0;
+    uint32_t sum = 0;
+
+    if (ADCSampler.buffersFilled() % 16 != 0) return;
+
+    for (uint32_t i = 0; i < frames; i++) {
+        if (samples[i] < lo) lo = samples[i];
+        if (samples[i] > hi) hi = samples[i];
+        sum += samples[i];
+    }
+    minimum = lo;
+    maximum = hi;
+    mean = sum / frames;
+    ready = true;
+}
+
+void setup()
+{
+    if (!ADCSampler.begin(pins, 1, RATE, FRAMES, onBuffer)) {
+        Serial.println("ADCSampler.begin() failed");
+        return;
+    }
+}
+
+void loop()
+{
+    if (!ready) return;
+    ready = false;
+
+    Serial.print("rate ");
+    Serial.print(ADCSampler.sampleRate());
+    Serial.print(" min ");
+    Serial.print(minimum);
+    Serial.print(" max ");
+    Serial.print(maximum);
+    Serial.print(" mean ");
+    Serial.print(mean);
+    Serial.print(" overruns ");
+    Serial.println(ADCSampler.overruns());
+}
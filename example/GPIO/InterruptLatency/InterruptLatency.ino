@@ -0,0 +1,150 @@
+/*
+ * Measures GPIO interrupt latency, in CPU cycles, from the write that
+ * raises an output pin to the first line of the handler.
+ *
+ * Connect OUT_PIN to IN_PIN with a wire. Each path is timed over RUNS
+ * rising edges:
+ *
+ *  - bare:     an IRQ_HANDLE on GPIO_IRQ that only clears the edge, the
+ *              floor that hardware and NVIC allow
+ *  - direct:   attachInterrupt(), the handler called from the ISR
+ *  - HAL:      HAL_GPIO_UserRegIrq(), the path attachInterrupt() took
+ *              before, through HAL_GPIO_IrqHandler_8195a
+ *  - deferred: attachInterruptArg() with INTERRUPT_DEFERRED, the handler
+ *              called from the interrupt worker thread
+ *
+ * "direct" minus "bare" is what the dispatch costs.
+ */
+
+#include "Arduino.h"
+
+extern "C" {
+#include "rtl8195a.h"
+#include "hal_gpio.h"
+}
+
+#define OUT_PIN     2
+#define IN_PIN      13
+
+#define RUNS        1000
+
+static volatile uint32_t start;
+static volatile uint32_t cycles;
+static volatile int fired;
+
+static void handler(void)
+{
+    cycles = DWT->CYCCNT - start;
+    fired = 1;
+}
+
+static void handlerArg(void *arg, uint32_t timestamp)
+{
+    cycles = DWT->CYCCNT - start;
+    fired = 1;
+}
+
+static u32 bareIsr(VOID *Data)
+{
+    cycles = DWT->CYCCNT - start;
+    fired = 1;
+    HAL_WRITE32(GPIO_REG_BASE, GPIO_PORTA_EOI, HAL_READ32(GPIO_REG_BASE, GPIO_INT_STATUS));
+    return 0;
+}
+
+static void measure(const char *name)
+{
+    uint32_t total = 0, worst = 0, best = 0xFFFFFFFF;
+    int missed = 0;
+
+    for (int i = 0; i < RUNS; i++) {
+        digitalWrite(OUT_PIN, LOW);
+        delayMicroseconds(20);
+
+        fired = 0;
+        start = DWT->CYCCNT;
+        digitalWrite(OUT_PIN, HIGH);
+
+        uint32_t t = millis();
+        while (!fired && millis() - t < 10);
+        if (!fired) {
+            missed++;
+            continue;
+        }
+
+        total += cycles;
+        if (cycles > worst) worst = cycles;
+        if (cycles < best) best = cycles;
+    }
+
+    Serial.print(name);
+    if (missed == RUNS) {
+        Serial.println(": no interrupt, is OUT_PIN wired to IN_PIN?");
+        return;
+    }
+    Serial.print(": avg ");
+    Serial.print(total / (RUNS - missed));
+    Serial.print(", min ");
+    Serial.print(best);
+    Serial.print(", max ");
+    Serial.print(worst);
+    Serial.print(" cycles");
+    if (missed) {
+        Serial.print(", ");
+        Serial.print(missed);
+        Serial.print(" missed");
+    }
+    Serial.println();
+}
+
+void setup()
+{
+    // start the cycle counter
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    pinMode(OUT_PIN, OUTPUT);
+    pinMode(IN_PIN, INPUT);
+
+    // bare: let attachInterrupt() set up the pin, then take the vector
+    attachInterrupt(IN_PIN, handler, RISING);
+    IRQ_HANDLE bare;
+    bare.Data = 0;
+    bare.IrqNum = GPIO_IRQ;
+    bare.IrqFun = (IRQ_FUN)bareIsr;
+    bare.Priority = 0;
+    InterruptUnRegister(&bare);
+    InterruptRegister(&bare);
+    InterruptEn(&bare);
+    measure("bare    ");
+    detachInterrupt(IN_PIN);
+
+    // HAL
+    HAL_GPIO_PIN halPin;
+    halPin.pin_mode = INT_RISING;
+    halPin.pin_name = HAL_GPIO_PIN_NAME(GPIO_PORT_A, gpio_get_pin_num(IN_PIN));
+    HAL_GPIO_Irq_Init(&halPin);
+    HAL_GPIO_UserRegIrq(&halPin, (VOID *)handler, NULL);
+    HAL_GPIO_IntCtrl(&halPin, _TRUE);
+    HAL_GPIO_UnMaskIrq(&halPin);
+    measure("HAL     ");
+    HAL_GPIO_UserUnRegIrq(&halPin);
+
+    // direct, after the HAL path so that it has the vector back
+    attachInterrupt(IN_PIN, handler, RISING);
+    measure("direct  ");
+    detachInterrupt(IN_PIN);
+
+    attachInterruptArg(IN_PIN, handlerArg, NULL, RISING, INTERRUPT_DEFERRED);
+    measure("deferred");
+    detachInterrupt(IN_PIN);
+
+    Serial.print("deferred interrupts dropped: ");
+    Serial.println(interruptsDropped());
+}
+
+void loop()
+{
+    delay(1000);
+}
@@ -0,0 +1,81 @@
+/*
+ * Streams a 16 kHz I2S microphone over WiFi: each RX page, 32 ms of
+ * 16-bit mono audio, goes out as one UDP datagram, straight from the
+ * page the I2S DMA filled.
+ *
+ * Connect the microphone's WS, SCK and SD to D10, D13 and PC_4 (see
+ * I2S.h). On the receiving side, e.g.:
+ *
+ *   nc -lu 5000 | aplay -f S16_LE -r 16000 -c 1
+ *
+ * The page callback runs in the I2S interrupt and only counts pages;
+ * loop() sends them. Underruns stay 0, nothing is sent on the TX side.
+ */
+
+#include "Arduino.h"
+#include "I2S.h"
+#include <WiFi.h>
+#include <WiFiUdp.h>
+
+#define RATE        16000
+#define PAGE_WORDS  256     // 512 samples, 32 ms
+#define PAGES       4
+
+char ssid[] = "YourAPName";
+char pass[] = "YourPassword";
+IPAddress host(192, 168, 1, 100);
+#define PORT        5000
+
+WiFiUDP udp;
+
+static volatile uint32_t pagesReady;
+
+static void onPage(int mode, void *arg)
+{
+    pagesReady++;
+}
+
+void setup()
+{
+    Serial.begin(38400);
+
+    if (WiFi.begin(ssid, pass) != WL_CONNECTED) {
+        Serial.println("Couldn't get a wifi connection");
+        while (true);
+    }
+    delay(3000);
+    udp.begin(PORT);
+
+    I2S.onPage(onPage);
+    if (!I2S.begin(RATE, 16, 1, I2S_MODE_RX, PAGE_WORDS, PAGES)) {
+        Serial.println("I2S.begin() failed");
+        while (true);
+    }
+}
+
+void loop()
+{
+    static uint32_t sent, lastReport;
+    uint8_t *page = (uint8_t *)I2S.rxAcquire();
+
+    if (page == NULL) {
+        delay(1);
+        return;
+    }
+
+    udp.beginPacket(host, PORT);
+    udp.write(page, I2S.pageBytes());
+    udp.endPacket();
+    I2S.rxRelease();
+    sent++;
+
+    if (millis() - lastReport >= 10000) {
+        lastReport = millis();
+        Serial.print("pages ");
+        Serial.print(pagesReady);
+        Serial.print(" sent ");
+        Serial.print(sent);
+        Serial.print(" overruns ");
+        Serial.println(I2S.overruns());
+    }
+}
@@ -0,0 +1,132 @@
+/*
+ * Measures what TCM placement buys, in CPU cycles:
+ *
+ *  - interrupt latency: a software-pended IRQ, from NVIC_SetPendingIRQ()
+ *    to the first instruction of the handler, for a handler in TCM and
+ *    the same handler in BD_RAM.
+ *  - context switch: two threads passing a signal back and forth. The
+ *    kernel is in BD_RAM, as librtos.a is prebuilt, and the pong thread
+ *    stack is in TCM when PONG_STACK_IN_TCM is 1. Run it both ways to
+ *    compare.
+ */
+
+#include "Arduino.h"
+
+extern "C" {
+#include "rtl8195a.h"
+}
+
+#define PONG_STACK_IN_TCM   1
+#define PONG_STACK_SIZE     1024
+
+#define RUNS                1000
+
+// not used on this board, so free to be pended by software
+#define BENCH_IRQ           GMAC_IRQ
+
+extern "C" void PendSV_Handler(void);
+
+static volatile uint32_t isrCycles;
+static volatile uint32_t isrStart;
+
+TCM_TEXT_SECTION
+static u32 isrInTcm(VOID *Data)
+{
+    isrCycles = DWT->CYCCNT - isrStart;
+    return 0;
+}
+
+static u32 isrInRam(VOID *Data)
+{
+    isrCycles = DWT->CYCCNT - isrStart;
+    return 0;
+}
+
+static uint32_t measureIsr(IRQ_FUN fun)
+{
+    IRQ_HANDLE handle;
+    uint32_t total = 0;
+
+    handle.IrqFun = fun;
+    handle.IrqNum = BENCH_IRQ;
+    handle.Data = NULL;
+    handle.Priority = 0;
+    InterruptRegister(&handle);
+    InterruptEn(&handle);
+
+    for (int i = 0; i < RUNS; i++) {
+        isrStart = DWT->CYCCNT;
+        NVIC_SetPendingIRQ(BENCH_IRQ);
+        __DSB();
+        __ISB();
+        total += isrCycles;
+    }
+
+    InterruptDis(&handle);
+    InterruptUnRegister(&handle);
+    return total / RUNS;
+}
+
+#if PONG_STACK_IN_TCM
+TCM_BSS_SECTION __attribute__((aligned(8)))
+#endif
+static unsigned char pongStack[PONG_STACK_SIZE];
+
+static osThreadId pingId;
+
+static void pong(void const *argument)
+{
+    for (;;) {
+        Thread::signal_wait(0x1);
+        osSignalSet(pingId, 0x1);
+    }
+}
+
+static uint32_t measureSwitch(Thread &pongThread)
+{
+    uint32_t start = DWT->CYCCNT;
+
+    for (int i = 0; i < RUNS; i++) {
+        // pong runs at a higher priority: we switch to it here...
+        pongThread.signal_set(0x1);
+        // ...and back once it waits again, with our signal already set
+        Thread::signal_wait(0x1);
+    }
+    return (DWT->CYCCNT - start) / (2 * RUNS);
+}
+
+static const char *where(const void *p)
+{
+    return ((uint32_t)p >= 0x1FFF0000) ? "TCM" : "BD_RAM";
+}
+
+void setup()
+{
+    // start the cycle counter
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    pingId = osThreadGetId();
+    Thread pongThread(pong, NULL, osPriorityAboveNormal, PONG_STACK_SIZE, pongStack);
+
+    Serial.print("ISR latency, handler in TCM:    ");
+    Serial.print(measureIsr(isrInTcm));
+    Serial.println(" cycles");
+    Serial.print("ISR latency, handler in BD_RAM: ");
+    Serial.print(measureIsr(isrInRam));
+    Serial.println(" cycles");
+
+    Serial.print("Context switch, kernel in ");
+    Serial.print(where((const void *)PendSV_Handler));
+    Serial.print(", stack in ");
+    Serial.print(where(pongStack));
+    Serial.print(": ");
+    Serial.print(measureSwitch(pongThread));
+    Serial.println(" cycles");
+}
+
+void loop()
+{
+    delay(1000);
+}
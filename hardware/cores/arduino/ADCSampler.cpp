@@ -0,0 +1,298 @@
+/*
+  ADCSampler.cpp - Continuous ADC sampling into ping-pong buffers
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ADCSampler.h"
+#include "us_ticker_api.h"
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+#define RAW_WORDS	(ADC_SAMPLER_DMA_FRAMES * 2)
+
+/*
+ * Hardware side: the board code at the end of this file, a model of the
+ * ADC in system/adctest on the host.
+ */
+int  adc_sampler_hw_begin(uint8_t channel);
+void adc_sampler_hw_receive(uint32_t *buf, uint32_t words);
+void adc_sampler_hw_end(void);
+
+/* GDMA can not reach TCM, keep these in BD_RAM */
+static uint32_t adc_raw[2][RAW_WORDS];
+
+/* ADC channel of each analog pin, as analogRead() maps them */
+static const uint8_t adc_pin_channel[] = { 2, 2, 3 };
+
+ADCSamplerClass ADCSampler;
+
+/******************************************************************************
+ * ADCSamplerClass
+ ******************************************************************************/
+
+ADCSamplerClass::ADCSamplerClass() :
+	_state(STATE_IDLE),
+	_averaging(true),
+	_count(0),
+	_out(NULL)
+{
+}
+
+int ADCSamplerClass::begin(const uint8_t *pins, uint8_t count, uint32_t rate, uint32_t frames,
+	adc_sampler_callback_t callback, void *arg)
+{
+	end();
+
+	if (count == 0 || count > ADC_SAMPLER_MAX_PINS || frames == 0 || callback == NULL) return 0;
+
+	for (int i = 0; i < count; i++) {
+		if (pins[i] >= sizeof(adc_pin_channel)) return 0;
+		_channels[i] = adc_pin_channel[pins[i]];
+	}
+
+	_out = (uint16_t *)malloc(2 * frames * count * sizeof(uint16_t));
+	if (_out == NULL) return 0;
+
+	_count = count;
+	_rate = rate;
+	_frames = frames;
+	_callback = callback;
+	_arg = arg;
+
+	_half = _out;
+	_pos = 0;
+	memset(_acc, 0, sizeof(_acc));
+	_accFrames = 0;
+
+	_block = 0;
+	_calBlocks = 0;
+	_sampleRate = 0;
+	_decimation = 1;
+	_buffersFilled = 0;
+	_overruns = 0;
+
+	_state = STATE_CALIBRATING;
+	if (adc_sampler_hw_begin(_channels[0]) != 0) {
+		_state = STATE_IDLE;
+		free(_out);
+		_out = NULL;
+		return 0;
+	}
+	adc_sampler_hw_receive(adc_raw[_block], RAW_WORDS);
+
+	return 1;
+}
+
+void ADCSamplerClass::end(void)
+{
+	if (_state == STATE_IDLE) return;
+
+	// a DMA interrupt from here on does nothing
+	_state = STATE_IDLE;
+	adc_sampler_hw_end();
+
+	free(_out);
+	_out = NULL;
+}
+
+void ADCSamplerClass::dmaDone(void)
+{
+	uint32_t now = us_ticker_read();
+	int full = _block;
+
+	if (_state == STATE_IDLE) return;
+
+	// restart the DMA first, the FIFO only holds a few frames
+	_block ^= 1;
+	adc_sampler_hw_receive(adc_raw[_block], RAW_WORDS);
+
+	if (_state == STATE_CALIBRATING) {
+		calibrate(now);
+		return;
+	}
+
+	// two block times or more since the last one: the FIFO ran over
+	if (now - _lastDone >= 2 * _blockUs) _overruns++;
+	_lastDone = now;
+
+	process(adc_raw[full]);
+}
+
+void ADCSamplerClass::calibrate(uint32_t now)
+{
+	uint32_t elapsed;
+	uint64_t native;
+
+	// the first block also holds the start-up of the ADC, time the next ones
+	if (_calBlocks++ == 0) {
+		_calStart = now;
+		return;
+	}
+	if (_calBlocks <= ADC_SAMPLER_CAL_BLOCKS) return;
+
+	elapsed = now - _calStart;
+	if (elapsed == 0) elapsed = 1;
+	_blockUs = (elapsed + ADC_SAMPLER_CAL_BLOCKS / 2) / ADC_SAMPLER_CAL_BLOCKS;
+	if (_blockUs == 0) _blockUs = 1;
+
+	// conversion frames per second
+	native = ((uint64_t)ADC_SAMPLER_DMA_FRAMES * ADC_SAMPLER_CAL_BLOCKS * 1000000 + elapsed / 2) / elapsed;
+
+	_decimation = 1;
+	if (_rate != 0 && _rate < native) {
+		_decimation = (uint32_t)((native + _rate / 2) / _rate);
+	}
+	_sampleRate = (uint32_t)((native + _decimation / 2) / _decimation);
+
+	_lastDone = now;
+	_state = STATE_RUNNING;
+}
+
+void ADCSamplerClass::process(const uint32_t *raw)
+{
+	uint32_t samples = _frames * _count;
+
+	for (int f = 0; f < ADC_SAMPLER_DMA_FRAMES; f++, raw += 2) {
+		if (_averaging || _accFrames == 0) {
+			for (int i = 0; i < _count; i++) {
+				uint8_t ch = _channels[i];
+				uint32_t value = (raw[ch >> 1] >> ((ch & 1) * 16)) & 0xFFFF;
+
+				if (_averaging)
+					_acc[i] += value;
+				else
+					_acc[i] = value;
+			}
+		}
+		if (++_accFrames < _decimation) continue;
+
+		for (int i = 0; i < _count; i++) {
+			_half[_pos++] = _averaging ? _acc[i] / _decimation : _acc[i];
+			_acc[i] = 0;
+		}
+		_accFrames = 0;
+
+		if (_pos == samples) {
+			const uint16_t *full = _half;
+
+			_half = (_half == _out) ? _out + samples : _out;
+			_pos = 0;
+			_buffersFilled++;
+			_callback(full, _frames, _arg);
+		}
+	}
+}
+
+/******************************************************************************
+ * Hardware
+ ******************************************************************************/
+
+#ifndef ADC_SAMPLER_HOST
+
+#include "Arduino.h"
+
+extern "C" {
+#include "objects.h"
+#include "hal_adc.h"
+#include "analogin_api.h"
+}
+
+/*
+ * The ADC set up the way analogin_init() does it, but in DMA mode: for
+ * each RtkADCReceive() the SAL moves pRXBuf->DataLen words from the FIFO
+ * by GDMA and then calls the pDMARXCCB user callback from
+ * ADCGDMAISRHandle(), as DAC1 sends with RtkDACSend().
+ */
+static analogin_t adc_dma;
+static SAL_ADC_USERCB_ADPT adc_dma_cb[SAL_ADC_USER_CB_NUM];
+static SAL_ADC_TRANSFER_BUF adc_dma_buf;
+
+static VOID adc_sampler_hw_done(VOID *Data)
+{
+	ADCSampler.dmaDone();
+}
+
+int adc_sampler_hw_begin(uint8_t channel)
+{
+	PSAL_ADC_MNGT_ADPT pSalADCMngtAdpt = &adc_dma.SalADCMngtAdpt;
+	PSAL_ADC_USER_CB pUserCB = &adc_dma.SalADCUserCB;
+	PSAL_ADC_USERCB_ADPT *ppUserCB = (PSAL_ADC_USERCB_ADPT *)pUserCB;
+	PSAL_ADC_HND pSalADCHND;
+
+	memset(&adc_dma, 0, sizeof(adc_dma));
+	memset(adc_dma_cb, 0, sizeof(adc_dma_cb));
+
+	pSalADCMngtAdpt->pSalHndPriv = &adc_dma.SalADCHndPriv;
+	pSalADCMngtAdpt->pSalHndPriv->ppSalADCHnd = (void **)&pSalADCMngtAdpt->pSalHndPriv;
+	pSalADCMngtAdpt->pHalOpInit = &HalADCOpInit;
+	pSalADCMngtAdpt->pHalGdmaOpInit = &HalGdmaOpInit;
+	pSalADCMngtAdpt->pSalIrqFunc = &ADCISRHandle;
+	pSalADCMngtAdpt->pSalDMAIrqFunc = &ADCGDMAISRHandle;
+	pSalADCMngtAdpt->pHalInitDat = &adc_dma.HalADCInitData;
+	pSalADCMngtAdpt->pHalOp = &adc_dma.HalADCOp;
+	pSalADCMngtAdpt->pIrqHnd = &adc_dma.ADCIrqHandleDat;
+	pSalADCMngtAdpt->pHalGdmaAdp = &adc_dma.HalADCGdmaAdpt;
+	pSalADCMngtAdpt->pHalGdmaOp = &adc_dma.HalADCGdmaOp;
+	pSalADCMngtAdpt->pIrqGdmaHnd = &adc_dma.ADCGdmaIrqHandleDat;
+	pSalADCMngtAdpt->pUserCB = pUserCB;
+
+	for (unsigned i = 0; i < SAL_ADC_USER_CB_NUM; i++) {
+		ppUserCB[i] = &adc_dma_cb[i];
+	}
+	pUserCB->pDMARXCCB->USERCB = adc_sampler_hw_done;
+
+	pSalADCHND = &pSalADCMngtAdpt->pSalHndPriv->SalADCHndPriv;
+	pSalADCHND->pInitDat = pSalADCMngtAdpt->pHalInitDat;
+	pSalADCHND->pUserCB = pUserCB;
+	pSalADCHND->DevNum = channel;
+	RtkADCLoadDefault(pSalADCHND);
+
+	pSalADCHND->PinMux = 0;
+	pSalADCHND->OpType = ADC_DMA_TYPE;
+	pSalADCHND->pInitDat->ADCBurstSz = 8;
+	pSalADCHND->pInitDat->ADCOneShotTD = 8;
+	pSalADCHND->pRXBuf = &adc_dma_buf;
+
+	return (RtkADCInit(pSalADCHND) == _EXIT_SUCCESS) ? 0 : -1;
+}
+
+void adc_sampler_hw_receive(uint32_t *buf, uint32_t words)
+{
+	adc_dma_buf.DataLen = words;
+	adc_dma_buf.pDataBuf = buf;
+	RtkADCReceive(&adc_dma.SalADCHndPriv.SalADCHndPriv);
+}
+
+void adc_sampler_hw_end(void)
+{
+	RtkADCDeInit(&adc_dma.SalADCHndPriv.SalADCHndPriv);
+
+	// back to register mode for analogRead()
+	analogin_init(&adc1, AD_1);
+	analogin_init(&adc2, AD_2);
+	analogin_init(&adc3, AD_3);
+}
+
+#endif
@@ -0,0 +1,136 @@
+/*
+  ADCSampler.h - Continuous ADC sampling into ping-pong buffers
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ADCSampler_h
+#define ADCSampler_h
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/*
+ * The ADC converts its channels round-robin on its own clock and queues
+ * every round in its FIFO as one frame: two words, channel 0 and 1 in the
+ * first, 2 and 3 in the second, 16 bits each. GDMA drains the FIFO into
+ * two raw blocks in turn; the DMA interrupt restarts the transfer into
+ * the other block, then picks the channels of the sketch out of the one
+ * that is full and decimates them into the output buffer.
+ *
+ * There is no timer trigger for conversions, the ADC clock paces them,
+ * without jitter. The first blocks after begin() measure that clock with
+ * us_ticker_read(); every "decimation" frames then make one sample, their
+ * average or the first of them, closest to the requested rate.
+ * sampleRate() tells the rate actually used.
+ *
+ * The output buffer has two halves of "frames" samples per pin. The
+ * callback gets each half as it fills, from the DMA interrupt: keep it
+ * short. The half stays untouched until the other one is full.
+ *
+ * analogRead() can not be used while sampling, it shares the FIFO.
+ */
+
+#define ADC_SAMPLER_MAX_PINS		4
+
+/* Conversion frames per DMA block */
+#ifndef ADC_SAMPLER_DMA_FRAMES
+#define ADC_SAMPLER_DMA_FRAMES		64
+#endif
+
+/* DMA blocks timed by begin() before the first sample */
+#define ADC_SAMPLER_CAL_BLOCKS		8
+
+/* One buffer half, ADC values as analogin_read_u16() gives them, pins interleaved */
+typedef void (*adc_sampler_callback_t)(const uint16_t *samples, uint32_t frames, void *arg);
+
+class ADCSamplerClass
+{
+public:
+	ADCSamplerClass();
+
+	/*
+	 * Start sampling.
+	 * pins: analog pins, as for analogRead(), at most ADC_SAMPLER_MAX_PINS
+	 * rate: samples per second and pin, 0 for every conversion
+	 * frames: samples per pin in each buffer half
+	 * result: 1 on success, 0 on bad arguments or no memory
+	 */
+	int begin(const uint8_t *pins, uint8_t count, uint32_t rate, uint32_t frames,
+		adc_sampler_callback_t callback, void *arg = NULL);
+
+	/* Stop sampling and hand the ADC back to analogRead() */
+	void end(void);
+
+	/* Average the frames of each sample (default), or keep the first */
+	void setAveraging(bool on) { _averaging = on; }
+
+	bool running(void) { return _state != STATE_IDLE; }
+
+	/* Samples per second and pin, 0 until the ADC clock is measured */
+	uint32_t sampleRate(void) { return _sampleRate; }
+	uint32_t decimation(void) { return _decimation; }
+
+	/* Buffer halves passed to the callback */
+	uint32_t buffersFilled(void) { return _buffersFilled; }
+
+	/* DMA blocks that came late: the FIFO overflowed and frames were lost */
+	uint32_t overruns(void) { return _overruns; }
+
+	/* From the DMA interrupt, when a raw block is full */
+	void dmaDone(void);
+
+private:
+	enum State {
+		STATE_IDLE,
+		STATE_CALIBRATING,
+		STATE_RUNNING,
+	};
+
+	void calibrate(uint32_t now);
+	void process(const uint32_t *raw);
+
+	volatile State _state;
+	bool _averaging;
+
+	uint8_t _channels[ADC_SAMPLER_MAX_PINS];
+	uint8_t _count;
+	uint32_t _rate;
+	uint32_t _frames;
+	adc_sampler_callback_t _callback;
+	void *_arg;
+
+	uint16_t *_out;		// two halves of _frames * _count
+	uint16_t *_half;	// the half being filled
+	uint32_t _pos;		// samples in _half
+
+	uint32_t _acc[ADC_SAMPLER_MAX_PINS];
+	uint32_t _accFrames;
+
+	int _block;		// raw block the DMA is filling
+	uint32_t _calBlocks;
+	uint32_t _calStart;
+	uint32_t _lastDone;
+	uint32_t _blockUs;	// time the ADC takes for one raw block
+
+	uint32_t _sampleRate;
+	uint32_t _decimation;
+	uint32_t _buffersFilled;
+	uint32_t _overruns;
+};
+
+extern ADCSamplerClass ADCSampler;
+
+#endif
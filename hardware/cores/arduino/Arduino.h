@@ -104,6 +104,7 @@ extern PinDescription g_APinDescription[] ;
 
 #include "wiring.h"
 #include "wiring_digital.h"
+#include "WInterrupts.h"
 #include "wiring_analog.h"
 
 // C++ functions
@@ -0,0 +1,42 @@
+/*
+  Client.cpp - waitFor() for clients that cannot sleep on their connection
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "Arduino.h"
+#include "Client.h"
+
+int Client::waitFor(int events, uint32_t timeout)
+{
+    uint32_t start = millis();
+
+    for (;;) {
+        int ready = 0;
+
+        if (!connected()) {
+            ready |= SOCKET_CLOSED;
+        } else if (events & SOCKET_WRITABLE) {
+            ready |= SOCKET_WRITABLE;
+        }
+        if ((events & SOCKET_READABLE) && available() > 0) {
+            ready |= SOCKET_READABLE;
+        }
+        if (ready != 0 || millis() - start >= timeout) {
+            return ready;
+        }
+        yield();
+    }
+}
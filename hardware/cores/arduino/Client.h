@@ -23,6 +23,11 @@
 #include "Stream.h"
 #include "IPAddress.h"
 
+// Events for waitFor(). SOCKET_CLOSED is reported whether it is asked for or not.
+#define SOCKET_READABLE 0x01
+#define SOCKET_WRITABLE 0x02
+#define SOCKET_CLOSED   0x04
+
 class Client : public Stream {
 
 public:
@@ -38,6 +43,10 @@ public:
   virtual void stop() = 0;
   virtual uint8_t connected() = 0;
   virtual operator bool() = 0;
+  // Wait up to timeout ms until the connection has one of the events.
+  // Returns the events that are set, 0 on timeout. This one polls
+  // available() and connected(); clients that can sleep override it.
+  virtual int waitFor(int events, uint32_t timeout);
 protected:
   uint8_t* rawIPAddress(IPAddress& addr) { return addr.raw_address(); };
 };
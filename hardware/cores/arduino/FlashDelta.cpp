@@ -0,0 +1,275 @@
+/*
+  FlashDelta.cpp - Apply a sector delta of the flash image
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "FlashDelta.h"
+#include "flash_api.h"
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+#if FLASH_DELTA_BASE % FLASH_DELTA_SECTOR_SIZE
+#error "FLASH_DELTA_BASE must be sector aligned"
+#endif
+
+static inline uint32_t delta_get32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t delta_crc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+	crc = ~crc;
+	while (len--) {
+		crc ^= *data++;
+		for (int i = 0; i < 8; i++) {
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+		}
+	}
+	return ~crc;
+}
+
+// CRC32 of len bytes of flash, read in small pieces to keep the stack short
+static uint32_t delta_crc32_flash(uint32_t addr, uint32_t len)
+{
+	uint8_t chunk[64];
+	uint32_t crc = 0;
+
+	while (len) {
+		uint32_t n = len < sizeof(chunk) ? len : sizeof(chunk);
+		flash_stream_read(&flash, addr, n, chunk);
+		crc = delta_crc32(crc, chunk, n);
+		addr += n;
+		len -= n;
+	}
+	return crc;
+}
+
+static bool delta_flash_equal(uint32_t addr, const uint8_t *data, uint32_t len)
+{
+	uint8_t chunk[64];
+
+	while (len) {
+		uint32_t n = len < sizeof(chunk) ? len : sizeof(chunk);
+		flash_stream_read(&flash, addr, n, chunk);
+		if (memcmp(chunk, data, n) != 0) {
+			return false;
+		}
+		addr += n;
+		data += n;
+		len -= n;
+	}
+	return true;
+}
+
+/******************************************************************************
+ * Class
+ ******************************************************************************/
+
+FlashDeltaClass::FlashDeltaClass()
+{
+	_buf = NULL;
+	_fill = 0;
+	_need = 0;
+	_state = STATE_IDLE;
+	_error = FLASH_DELTA_OK;
+	_applied = false;
+	_records = 0;
+	_newSize = 0;
+	_newCrc = 0;
+	_offset = 0;
+	_length = 0;
+	_crc = 0;
+	_sectorsWritten = 0;
+	_sectorsSkipped = 0;
+}
+
+int FlashDeltaClass::begin(void)
+{
+	if (_buf == NULL) {
+		_buf = (uint8_t *)malloc(FLASH_DELTA_SECTOR_SIZE);
+	}
+	if (_buf == NULL) {
+		return fail(FLASH_DELTA_ERR_MEMORY);
+	}
+
+	_fill = 0;
+	_need = FLASH_DELTA_HEADER_SIZE;
+	_state = STATE_HEADER;
+	_error = FLASH_DELTA_OK;
+	_applied = false;
+	_records = 0;
+	_sectorsWritten = 0;
+	_sectorsSkipped = 0;
+	return 1;
+}
+
+size_t FlashDeltaClass::write(const uint8_t *buf, size_t size)
+{
+	size_t done = 0;
+
+	if (_state == STATE_IDLE || _state == STATE_FAILED) {
+		return 0;
+	}
+
+	while (done < size) {
+		if (_state == STATE_RECORD && _records == 0) {
+			// data after the last record
+			fail(FLASH_DELTA_ERR_FORMAT);
+			return 0;
+		}
+
+		uint32_t n = _need - _fill;
+		if (n > size - done) {
+			n = size - done;
+		}
+		memcpy(_buf + _fill, buf + done, n);
+		_fill += n;
+		done += n;
+		if (_fill < _need) {
+			break;
+		}
+
+		_fill = 0;
+		int ok = 0;
+		switch (_state) {
+		case STATE_HEADER:
+			ok = parseHeader();
+			break;
+		case STATE_RECORD:
+			ok = parseRecord();
+			break;
+		case STATE_DATA:
+			ok = applyRecord();
+			break;
+		default:
+			break;
+		}
+		if (!ok) {
+			return 0;
+		}
+	}
+	return size;
+}
+
+int FlashDeltaClass::end(void)
+{
+	if (_state == STATE_IDLE || _state == STATE_FAILED) {
+		return 0;
+	}
+	if (_state != STATE_RECORD || _records != 0) {
+		// cut short
+		return fail(FLASH_DELTA_ERR_FORMAT);
+	}
+	if (delta_crc32_flash(FLASH_DELTA_BASE, _newSize) != _newCrc) {
+		return fail(FLASH_DELTA_ERR_CRC);
+	}
+
+	free(_buf);
+	_buf = NULL;
+	_state = STATE_IDLE;
+	return 1;
+}
+
+int FlashDeltaClass::fail(int error)
+{
+	free(_buf);
+	_buf = NULL;
+	_state = STATE_FAILED;
+	_error = error;
+	return 0;
+}
+
+int FlashDeltaClass::parseHeader(void)
+{
+	uint32_t sectorSize = delta_get32(_buf + 8);
+	uint32_t baseSize = delta_get32(_buf + 16);
+	uint32_t baseCrc = delta_get32(_buf + 20);
+
+	_records = delta_get32(_buf + 12);
+	_newSize = delta_get32(_buf + 24);
+	_newCrc = delta_get32(_buf + 28);
+
+	if (delta_get32(_buf) != FLASH_DELTA_MAGIC || delta_get32(_buf + 4) != FLASH_DELTA_VERSION ||
+	    sectorSize != FLASH_DELTA_SECTOR_SIZE ||
+	    baseSize > FLASH_DELTA_LIMIT - FLASH_DELTA_BASE || _newSize > FLASH_DELTA_LIMIT - FLASH_DELTA_BASE) {
+		return fail(FLASH_DELTA_ERR_FORMAT);
+	}
+
+	// A delta sent twice finds the new image already there
+	if (delta_crc32_flash(FLASH_DELTA_BASE, baseSize) != baseCrc) {
+		if (delta_crc32_flash(FLASH_DELTA_BASE, _newSize) != _newCrc) {
+			return fail(FLASH_DELTA_ERR_BASE);
+		}
+		_applied = true;
+	}
+
+	_state = STATE_RECORD;
+	_need = FLASH_DELTA_RECORD_SIZE;
+	return 1;
+}
+
+int FlashDeltaClass::parseRecord(void)
+{
+	_offset = delta_get32(_buf);
+	_length = delta_get32(_buf + 4);
+	_crc = delta_get32(_buf + 8);
+
+	if (_offset % FLASH_DELTA_SECTOR_SIZE != 0 || _length == 0 || _length > FLASH_DELTA_SECTOR_SIZE ||
+	    _offset >= _newSize || _length > _newSize - _offset) {
+		return fail(FLASH_DELTA_ERR_FORMAT);
+	}
+
+	_state = STATE_DATA;
+	_need = _length;
+	return 1;
+}
+
+int FlashDeltaClass::applyRecord(void)
+{
+	uint32_t addr = FLASH_DELTA_BASE + _offset;
+
+	if (delta_crc32(0, _buf, _length) != _crc) {
+		return fail(FLASH_DELTA_ERR_CRC);
+	}
+
+	if (_applied || delta_flash_equal(addr, _buf, _length)) {
+		_sectorsSkipped++;
+	} else {
+		flash_erase_sector(&flash, addr);
+		flash_stream_write(&flash, addr, _length, _buf);
+		if (!delta_flash_equal(addr, _buf, _length)) {
+			return fail(FLASH_DELTA_ERR_FLASH);
+		}
+		_sectorsWritten++;
+	}
+
+	_records--;
+	_state = STATE_RECORD;
+	_need = FLASH_DELTA_RECORD_SIZE;
+	return 1;
+}
+
+FlashDeltaClass flashDelta;
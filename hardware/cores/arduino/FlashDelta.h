@@ -0,0 +1,136 @@
+/*
+  FlashDelta.h - Apply a sector delta of the flash image
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef FlashDelta_h
+#define FlashDelta_h
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/*
+ * binfiletool remembers a CRC32 per 4KB sector of the last ram_all.bin it
+ * built (ram_all.manifest) and writes ram_all.delta next to ram_all.bin,
+ * holding only the sectors that changed since then. A sketch receives the
+ * delta over any transport and feeds it to write(); each sector is erased
+ * and rewritten with flash_stream_write(), then read back. The running
+ * program is in RAM, so its own image can be rewritten; reset afterwards
+ * to boot the new one.
+ *
+ * Nothing is written unless the flash holds the image the delta was made
+ * against, and end() only succeeds if the whole new image checks out. A
+ * reset in the middle leaves a broken image behind: flash the full
+ * ram_all.bin through the DAP drive to recover.
+ *
+ * Delta layout, little endian:
+ *
+ *   header   magic "ADLT", version, sector size, record count,
+ *            base size, base CRC32, new size, new CRC32
+ *   records  offset, length, CRC32 of the data, data
+ */
+
+#define FLASH_DELTA_MAGIC		0x544C4441	// "ADLT"
+#define FLASH_DELTA_VERSION		1
+#define FLASH_DELTA_SECTOR_SIZE		0x1000
+#define FLASH_DELTA_HEADER_SIZE		32
+#define FLASH_DELTA_RECORD_SIZE		12
+
+/* Flash address of ram_all.bin */
+#ifndef FLASH_DELTA_BASE
+#define FLASH_DELTA_BASE		0
+#endif
+
+/* Images may not reach past this, it keeps FlashKV and FlashEEPROM safe */
+#ifndef FLASH_DELTA_LIMIT
+#define FLASH_DELTA_LIMIT		0x1F0000
+#endif
+
+enum {
+	FLASH_DELTA_OK = 0,
+	FLASH_DELTA_ERR_FORMAT,		// not a delta, or a malformed record
+	FLASH_DELTA_ERR_BASE,		// flash does not hold the base image
+	FLASH_DELTA_ERR_CRC,		// a record or the final image is corrupt
+	FLASH_DELTA_ERR_FLASH,		// a sector did not read back as written
+	FLASH_DELTA_ERR_MEMORY,
+};
+
+class FlashDeltaClass
+{
+public:
+	FlashDeltaClass();
+
+	/*
+	 * Start a new delta, dropping one in progress.
+	 * result: 1 on success, 0 if the sector buffer can not be allocated
+	 */
+	int begin(void);
+
+	/*
+	 * Feed the next piece of the delta, of any length.
+	 * result: size, or 0 after an error (see error())
+	 */
+	size_t write(const uint8_t *buf, size_t size);
+
+	/*
+	 * Finish: check that the whole delta was received and that the flash
+	 * now holds the new image.
+	 * result: 1 on success, else 0
+	 */
+	int end(void);
+
+	/* FLASH_DELTA_OK or the first error seen */
+	int error(void) { return _error; }
+
+	/* Sectors rewritten; a sector that already matches is skipped */
+	uint32_t sectorsWritten(void) { return _sectorsWritten; }
+	uint32_t sectorsSkipped(void) { return _sectorsSkipped; }
+
+private:
+	enum State {
+		STATE_IDLE,
+		STATE_HEADER,
+		STATE_RECORD,
+		STATE_DATA,
+		STATE_FAILED,
+	};
+
+	int parseHeader(void);
+	int parseRecord(void);
+	int applyRecord(void);
+	int fail(int error);
+
+	uint8_t *_buf;		// header, record header, then sector data
+	uint32_t _fill;		// bytes of _buf received
+	uint32_t _need;		// bytes _buf needs before the next step
+	State _state;
+	int _error;
+	bool _applied;		// flash already holds the new image
+
+	uint32_t _records;	// records left
+	uint32_t _newSize;
+	uint32_t _newCrc;
+	uint32_t _offset;	// current record
+	uint32_t _length;
+	uint32_t _crc;
+
+	uint32_t _sectorsWritten;
+	uint32_t _sectorsSkipped;
+};
+
+extern FlashDeltaClass flashDelta;
+
+#endif
@@ -23,12 +23,20 @@
 
 #include "Arduino.h"
 #include "FlashEEPROM.h"
+#include "FlashKV.h"
 #include "flash_api.h"
 
 /******************************************************************************
  * Definitions
  ******************************************************************************/
 
+/*
+ * data[] is kept in FlashKV as flashEEPROM_chunks values, so that a save
+ * only appends the chunks that changed instead of erasing a sector.
+ */
+#define flashEEPROM_chunk_size	64
+#define flashEEPROM_chunks	(flashEEPROM_size / flashEEPROM_chunk_size)
+
 /******************************************************************************
  * Constructors
  ******************************************************************************/
@@ -37,24 +45,36 @@
  * User API
  ******************************************************************************/
 
+// Where data[] was stored before FlashKV; still read for chunks never saved since
 static uint32_t flashEEPROM_start_pos = 0x200000-flashEEPROM_size;
 
+static void flashEEPROM_key(char *key, int chunk)
+{
+	strcpy(key, "eeprom0");
+	key[6] = '0' + chunk;
+}
+
 void FlashEEPROMClass::read_from_flashEEPROM(void)
 {
-   int address =0;
-   while (address < flashEEPROM_size) {
-	   flash_read_word(&flash, flashEEPROM_start_pos+address, (uint32_t*)(&data[address]));
-	   address = address + 4;
+   char key[8];
+   int chunk;
+   for (chunk = 0; chunk < flashEEPROM_chunks; chunk++) {
+	   int address = chunk * flashEEPROM_chunk_size;
+	   flashEEPROM_key(key, chunk);
+	   if (flashKV.get(key, &data[address], flashEEPROM_chunk_size) != flashEEPROM_chunk_size) {
+		   flash_stream_read(&flash, flashEEPROM_start_pos+address, flashEEPROM_chunk_size, &data[address]);
+	   }
    }
 }
 
 void FlashEEPROMClass::write_to_flashEEPROM(void)
 {
-   int address =0;
-   flash_erase_sector(&flash, flashEEPROM_start_pos);
-   while (address < flashEEPROM_size) {
-	   flash_write_word(&flash, flashEEPROM_start_pos+address, *((uint32_t*)(&data[address])));
-	   address = address + 4;
+   char key[8];
+   int chunk;
+   for (chunk = 0; chunk < flashEEPROM_chunks; chunk++) {
+	   flashEEPROM_key(key, chunk);
+	   // unchanged chunks are not written again
+	   flashKV.put(key, &data[chunk * flashEEPROM_chunk_size], flashEEPROM_chunk_size);
    }
 }
 
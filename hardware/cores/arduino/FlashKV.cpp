@@ -0,0 +1,605 @@
+/*
+  FlashKV.cpp - Wear-levelled key/value store in SPI flash
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include "Arduino.h"
+#include "FlashKV.h"
+#include "flash_api.h"
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+#if FLASH_KV_SECTORS < 3
+#error "FLASH_KV_SECTORS must be at least 3"
+#endif
+
+#if (FLASH_KV_INDEX_SIZE & (FLASH_KV_INDEX_SIZE - 1)) != 0
+#error "FLASH_KV_INDEX_SIZE must be a power of two"
+#endif
+
+#define KV_MAGIC		0x3156464B	// "KFV1"
+#define KV_FLAG_VALUE		0x00
+#define KV_FLAG_TOMBSTONE	0x01
+
+#define KV_SECTOR_HEADER	8
+#define KV_RECORD_HEADER	8
+#define KV_SECTOR_ROOM		(FLASH_KV_SECTOR_SIZE - KV_SECTOR_HEADER)
+// live data is limited so that one sector can always be reclaimed
+#define KV_CAPACITY		((FLASH_KV_SECTORS - 2) * KV_SECTOR_ROOM)
+
+#define KV_HASH_EMPTY		0
+#define KV_HASH_DELETED		1
+
+struct kv_sector_header {
+	uint32_t magic;
+	uint32_t seq;
+};
+
+// Followed by the key (no terminating zero), the value and padding to a
+// multiple of 4 bytes. An erased header has keyLen 0xFF.
+struct kv_record_header {
+	uint8_t keyLen;
+	uint8_t flags;
+	uint16_t valueLen;
+	uint32_t crc;		// CRC32 of keyLen, flags, valueLen, key and value
+};
+
+static osMutexId kv_mutex_id = NULL;
+osMutexDef(kv_mutex);
+
+static inline uint32_t kv_sector_addr(int sector)
+{
+	return FLASH_KV_BASE + sector * FLASH_KV_SECTOR_SIZE;
+}
+
+static inline int kv_sector_of(uint32_t addr)
+{
+	return (addr - FLASH_KV_BASE) / FLASH_KV_SECTOR_SIZE;
+}
+
+static inline uint32_t kv_record_size(uint32_t keyLen, uint32_t valueLen)
+{
+	return (KV_RECORD_HEADER + keyLen + valueLen + 3) & ~3;
+}
+
+static uint32_t kv_crc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+	crc = ~crc;
+	while (len--) {
+		crc ^= *data++;
+		for (int i = 0; i < 8; i++) {
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+		}
+	}
+	return ~crc;
+}
+
+// CRC32 of len bytes of flash, read in small pieces to keep the stack short
+static uint32_t kv_crc32_flash(uint32_t crc, uint32_t addr, uint32_t len)
+{
+	uint8_t chunk[32];
+
+	while (len) {
+		uint32_t n = len < sizeof(chunk) ? len : sizeof(chunk);
+		flash_stream_read(&flash, addr, n, chunk);
+		crc = kv_crc32(crc, chunk, n);
+		addr += n;
+		len -= n;
+	}
+	return crc;
+}
+
+static uint16_t kv_hash(const char *key)
+{
+	uint32_t h = 2166136261UL;	// FNV-1a
+
+	while (*key) {
+		h = (h ^ (uint8_t)*key++) * 16777619UL;
+	}
+	h = (h >> 16) ^ (h & 0xFFFF);
+	return h > KV_HASH_DELETED ? h : h + 2;
+}
+
+static void kv_lock(void)
+{
+	if (kv_mutex_id == NULL) {
+		kv_mutex_id = osMutexCreate(osMutex(kv_mutex));
+	}
+	osMutexWait(kv_mutex_id, osWaitForever);
+}
+
+static void kv_unlock(void)
+{
+	osMutexRelease(kv_mutex_id);
+}
+
+/******************************************************************************
+ * Constructors
+ ******************************************************************************/
+
+FlashKVClass::FlashKVClass()
+	: _head(0), _keys(0), _mounted(false), _bytesWritten(0), _sectorErases(0)
+{
+	memset(_index, 0, sizeof(_index));
+	memset(_seq, 0, sizeof(_seq));
+	memset(_used, 0, sizeof(_used));
+	memset(_live, 0, sizeof(_live));
+}
+
+/******************************************************************************
+ * Private Methods
+ ******************************************************************************/
+
+int FlashKVClass::find(const char *key, uint16_t hash)
+{
+	struct {
+		kv_record_header header;
+		char key[FLASH_KV_KEY_LENGTH];
+	} record;
+	size_t keyLen = strlen(key);
+	int slot = hash & (FLASH_KV_INDEX_SIZE - 1);
+
+	if (keyLen > FLASH_KV_KEY_LENGTH) {
+		return -1;
+	}
+	for (int i = 0; i < FLASH_KV_INDEX_SIZE; i++) {
+		IndexEntry &entry = _index[slot];
+		if (entry.hash == KV_HASH_EMPTY) {
+			break;
+		}
+		if (entry.hash == hash) {
+			flash_stream_read(&flash, entry.addr, KV_RECORD_HEADER + keyLen, (uint8_t *)&record);
+			if (record.header.keyLen == keyLen && memcmp(record.key, key, keyLen) == 0) {
+				return slot;
+			}
+		}
+		slot = (slot + 1) & (FLASH_KV_INDEX_SIZE - 1);
+	}
+	return -1;
+}
+
+int FlashKVClass::insert(const char *key, uint16_t hash, uint32_t addr, uint16_t size)
+{
+	int slot = hash & (FLASH_KV_INDEX_SIZE - 1);
+
+	if (_keys >= FLASH_KV_INDEX_SIZE - 1) {
+		return -1;
+	}
+	while (_index[slot].hash > KV_HASH_DELETED) {
+		slot = (slot + 1) & (FLASH_KV_INDEX_SIZE - 1);
+	}
+	_index[slot].addr = addr;
+	_index[slot].hash = hash;
+	_index[slot].size = size;
+	_keys++;
+	return slot;
+}
+
+// Erase the next free sector and make it the head of the log
+int FlashKVClass::openSector(void)
+{
+	kv_sector_header header;
+
+	for (int i = 1; i <= FLASH_KV_SECTORS; i++) {
+		int sector = (_head + i) % FLASH_KV_SECTORS;
+		if (_seq[sector] != 0) {
+			continue;
+		}
+		header.magic = KV_MAGIC;
+		header.seq = _seq[_head] + 1;
+		flash_erase_sector(&flash, kv_sector_addr(sector));
+		// magic last, so a half written seq is never taken as valid
+		flash_stream_write(&flash, kv_sector_addr(sector) + 4, 4, (uint8_t *)&header.seq);
+		flash_stream_write(&flash, kv_sector_addr(sector), 4, (uint8_t *)&header.magic);
+		_sectorErases++;
+		_seq[sector] = header.seq;
+		_used[sector] = KV_SECTOR_HEADER;
+		_live[sector] = 0;
+		_head = sector;
+		return 1;
+	}
+	return 0;
+}
+
+// Move the live records of the oldest sector to the head and erase it
+int FlashKVClass::collect(void)
+{
+	uint8_t chunk[32];
+	int tail = -1;
+
+	for (int i = 0; i < FLASH_KV_SECTORS; i++) {
+		if (_seq[i] != 0 && i != _head && (tail < 0 || _seq[i] < _seq[tail])) {
+			tail = i;
+		}
+	}
+	if (tail < 0) {
+		return 0;
+	}
+
+	for (int i = 0; i < FLASH_KV_INDEX_SIZE; i++) {
+		IndexEntry &entry = _index[i];
+		if (entry.hash <= KV_HASH_DELETED || kv_sector_of(entry.addr) != tail) {
+			continue;
+		}
+		if (_used[_head] + entry.size > FLASH_KV_SECTOR_SIZE && !openSector()) {
+			return 0;
+		}
+		// the CRC does not cover the address, so records are copied verbatim
+		uint32_t from = entry.addr;
+		uint32_t to = kv_sector_addr(_head) + _used[_head];
+		for (uint32_t done = 0; done < entry.size; done += sizeof(chunk)) {
+			uint32_t n = entry.size - done < sizeof(chunk) ? entry.size - done : sizeof(chunk);
+			flash_stream_read(&flash, from + done, n, chunk);
+			flash_stream_write(&flash, to + done, n, chunk);
+		}
+		_used[_head] += entry.size;
+		_live[_head] += entry.size;
+		_live[tail] -= entry.size;
+		_bytesWritten += entry.size;
+		entry.addr = to;
+	}
+
+	// the tail is the oldest sector, so its tombstones have nothing left
+	// to hide and are dropped with it. Clearing the magic first keeps an
+	// interrupted erase from leaving a sector that still looks valid.
+	uint32_t magic = 0;
+	flash_stream_write(&flash, kv_sector_addr(tail), 4, (uint8_t *)&magic);
+	flash_erase_sector(&flash, kv_sector_addr(tail));
+	_sectorErases++;
+	_seq[tail] = 0;
+	_used[tail] = 0;
+	_live[tail] = 0;
+	return 1;
+}
+
+int FlashKVClass::makeRoom(uint32_t size)
+{
+	int freeSectors;
+
+	if (size > KV_SECTOR_ROOM) {
+		return 0;
+	}
+	for (int tries = 0; _used[_head] + size > FLASH_KV_SECTOR_SIZE; tries++) {
+		if (tries > FLASH_KV_SECTORS) {
+			return 0;
+		}
+		freeSectors = 0;
+		for (int i = 0; i < FLASH_KV_SECTORS; i++) {
+			if (_seq[i] == 0) {
+				freeSectors++;
+			}
+		}
+		// one free sector is kept so collect() always has somewhere to copy to
+		if (freeSectors > 1) {
+			if (!openSector()) {
+				return 0;
+			}
+		} else if (!collect()) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// Write one record at the head. Returns its address, or 0 when out of room.
+uint32_t FlashKVClass::append(const char *key, uint8_t keyLen, uint8_t flags, const void *buf, uint16_t size)
+{
+	struct {
+		kv_record_header header;
+		char key[FLASH_KV_KEY_LENGTH];
+	} record;
+	uint32_t recordSize = kv_record_size(keyLen, size);
+
+	if (!makeRoom(recordSize)) {
+		return 0;
+	}
+
+	record.header.keyLen = keyLen;
+	record.header.flags = flags;
+	record.header.valueLen = size;
+	memcpy(record.key, key, keyLen);
+	record.header.crc = kv_crc32(0, (uint8_t *)&record.header, 4);
+	record.header.crc = kv_crc32(record.header.crc, (uint8_t *)record.key, keyLen);
+	record.header.crc = kv_crc32(record.header.crc, (const uint8_t *)buf, size);
+
+	// header first: a reset part way leaves a record that fails its CRC
+	uint32_t addr = kv_sector_addr(_head) + _used[_head];
+	flash_stream_write(&flash, addr, KV_RECORD_HEADER + keyLen, (uint8_t *)&record);
+	if (size) {
+		flash_stream_write(&flash, addr + KV_RECORD_HEADER + keyLen, size, (uint8_t *)buf);
+	}
+	_used[_head] += recordSize;
+	_bytesWritten += recordSize;
+	return addr;
+}
+
+int FlashKVClass::mount(void)
+{
+	kv_sector_header sectorHeader;
+	kv_record_header header;
+	char key[FLASH_KV_KEY_LENGTH + 1];
+	int order[FLASH_KV_SECTORS];
+	int count = 0;
+
+	memset(_index, 0, sizeof(_index));
+	_keys = 0;
+	for (int i = 0; i < FLASH_KV_SECTORS; i++) {
+		flash_stream_read(&flash, kv_sector_addr(i), sizeof(sectorHeader), (uint8_t *)&sectorHeader);
+		_used[i] = 0;
+		_live[i] = 0;
+		if (sectorHeader.magic != KV_MAGIC || sectorHeader.seq == 0 || sectorHeader.seq == 0xFFFFFFFF) {
+			_seq[i] = 0;
+			continue;
+		}
+		_seq[i] = sectorHeader.seq;
+		// insertion sort, oldest first
+		int j = count++;
+		for (; j > 0 && _seq[order[j - 1]] > _seq[i]; j--) {
+			order[j] = order[j - 1];
+		}
+		order[j] = i;
+	}
+
+	if (count == 0) {
+		format();
+		return _mounted;
+	}
+	if (count == FLASH_KV_SECTORS) {
+		// collect() was cut short after filling the spare sector. That
+		// sector only holds copies of records still in the oldest one, so
+		// drop it and let the next collect() start over.
+		count--;
+		flash_erase_sector(&flash, kv_sector_addr(order[count]));
+		_sectorErases++;
+		_seq[order[count]] = 0;
+	}
+
+	// replay the log; newer records replace older ones
+	for (int n = 0; n < count; n++) {
+		int sector = order[n];
+		uint32_t base = kv_sector_addr(sector);
+		uint32_t offset = KV_SECTOR_HEADER;
+
+		while (offset + KV_RECORD_HEADER <= FLASH_KV_SECTOR_SIZE) {
+			flash_stream_read(&flash, base + offset, sizeof(header), (uint8_t *)&header);
+			if (header.keyLen == 0xFF && header.flags == 0xFF && header.valueLen == 0xFFFF && header.crc == 0xFFFFFFFF) {
+				break;		// end of log in this sector
+			}
+			uint32_t size = kv_record_size(header.keyLen, header.valueLen);
+			uint32_t crc = kv_crc32(0, (uint8_t *)&header, 4);
+			if (header.keyLen == 0 || header.keyLen > FLASH_KV_KEY_LENGTH || header.flags > KV_FLAG_TOMBSTONE ||
+			    offset + size > FLASH_KV_SECTOR_SIZE ||
+			    kv_crc32_flash(crc, base + offset + KV_RECORD_HEADER, header.keyLen + header.valueLen) != header.crc) {
+				// torn write: nothing after it can be trusted, close the sector
+				offset = FLASH_KV_SECTOR_SIZE;
+				break;
+			}
+
+			flash_stream_read(&flash, base + offset + KV_RECORD_HEADER, header.keyLen, (uint8_t *)key);
+			key[header.keyLen] = 0;
+			uint16_t hash = kv_hash(key);
+			int slot = find(key, hash);
+			if (slot >= 0) {
+				_live[kv_sector_of(_index[slot].addr)] -= _index[slot].size;
+				if (header.flags == KV_FLAG_TOMBSTONE) {
+					_index[slot].hash = KV_HASH_DELETED;
+					_keys--;
+				} else {
+					_index[slot].addr = base + offset;
+					_index[slot].size = size;
+					_live[sector] += size;
+				}
+			} else if (header.flags == KV_FLAG_VALUE && insert(key, hash, base + offset, size) >= 0) {
+				_live[sector] += size;
+			}
+			offset += size;
+		}
+		_used[sector] = offset;
+	}
+	_head = order[count - 1];
+	_mounted = true;
+	return 1;
+}
+
+/******************************************************************************
+ * User API
+ ******************************************************************************/
+
+int FlashKVClass::begin(void)
+{
+	int ret;
+
+	kv_lock();
+	ret = _mounted ? 1 : mount();
+	kv_unlock();
+	return ret;
+}
+
+int FlashKVClass::get(const char *key, void *buf, size_t size)
+{
+	kv_record_header header;
+	int ret = -1;
+
+	kv_lock();
+	if (_mounted || mount()) {
+		int slot = find(key, kv_hash(key));
+		if (slot >= 0) {
+			uint32_t addr = _index[slot].addr;
+			flash_stream_read(&flash, addr, sizeof(header), (uint8_t *)&header);
+			if (size > header.valueLen) {
+				size = header.valueLen;
+			}
+			if (size) {
+				flash_stream_read(&flash, addr + KV_RECORD_HEADER + header.keyLen, size, (uint8_t *)buf);
+			}
+			ret = header.valueLen;
+		}
+	}
+	kv_unlock();
+	return ret;
+}
+
+int FlashKVClass::put(const char *key, const void *buf, size_t size)
+{
+	kv_record_header header;
+	size_t keyLen = strlen(key);
+	int ret = 0;
+
+	if (keyLen == 0 || keyLen > FLASH_KV_KEY_LENGTH || kv_record_size(keyLen, size) > KV_SECTOR_ROOM) {
+		return 0;
+	}
+
+	kv_lock();
+	if (!_mounted && !mount()) {
+		kv_unlock();
+		return 0;
+	}
+
+	uint16_t hash = kv_hash(key);
+	int slot = find(key, hash);
+	uint32_t live = 0;
+	for (int i = 0; i < FLASH_KV_SECTORS; i++) {
+		live += _live[i];
+	}
+
+	if (slot >= 0) {
+		// rewriting an unchanged value would only wear the flash
+		uint32_t addr = _index[slot].addr;
+		flash_stream_read(&flash, addr, sizeof(header), (uint8_t *)&header);
+		if (header.valueLen == size) {
+			const uint8_t *value = (const uint8_t *)buf;
+			uint8_t chunk[32];
+			uint32_t done = 0;
+			addr += KV_RECORD_HEADER + keyLen;
+			while (done < size) {
+				uint32_t n = size - done < sizeof(chunk) ? size - done : sizeof(chunk);
+				flash_stream_read(&flash, addr + done, n, chunk);
+				if (memcmp(chunk, value + done, n) != 0) {
+					break;
+				}
+				done += n;
+			}
+			if (done == size) {
+				kv_unlock();
+				return 1;
+			}
+		}
+		live -= _index[slot].size;
+	} else if (_keys >= FLASH_KV_INDEX_SIZE - 1) {
+		kv_unlock();
+		return 0;
+	}
+
+	uint32_t recordSize = kv_record_size(keyLen, size);
+	if (live + recordSize <= KV_CAPACITY) {
+		// append() may compact, which moves records but keeps index slots
+		uint32_t addr = append(key, keyLen, KV_FLAG_VALUE, buf, size);
+		if (addr) {
+			if (slot >= 0) {
+				_live[kv_sector_of(_index[slot].addr)] -= _index[slot].size;
+				_index[slot].addr = addr;
+				_index[slot].size = recordSize;
+			} else {
+				insert(key, hash, addr, recordSize);
+			}
+			_live[_head] += recordSize;
+			ret = 1;
+		}
+	}
+	kv_unlock();
+	return ret;
+}
+
+int FlashKVClass::remove(const char *key)
+{
+	int ret = 0;
+
+	kv_lock();
+	if (_mounted || mount()) {
+		int slot = find(key, kv_hash(key));
+		if (slot >= 0 && append(key, strlen(key), KV_FLAG_TOMBSTONE, NULL, 0)) {
+			_live[kv_sector_of(_index[slot].addr)] -= _index[slot].size;
+			_index[slot].hash = KV_HASH_DELETED;
+			_keys--;
+			ret = 1;
+		}
+	}
+	kv_unlock();
+	return ret;
+}
+
+int FlashKVClass::compact(void)
+{
+	int tail = -1;
+	int ret = 0;
+
+	kv_lock();
+	if (_mounted || mount()) {
+		for (int i = 0; i < FLASH_KV_SECTORS; i++) {
+			if (_seq[i] != 0 && i != _head && (tail < 0 || _seq[i] < _seq[tail])) {
+				tail = i;
+			}
+		}
+		if (tail >= 0 && (_used[tail] - KV_SECTOR_HEADER - _live[tail]) * 2 >= KV_SECTOR_ROOM) {
+			ret = collect();
+		}
+	}
+	kv_unlock();
+	return ret;
+}
+
+void FlashKVClass::format(void)
+{
+	kv_lock();
+	for (int i = 0; i < FLASH_KV_SECTORS; i++) {
+		if (_seq[i] != 0) {
+			flash_erase_sector(&flash, kv_sector_addr(i));
+			_sectorErases++;
+		}
+		_seq[i] = 0;
+		_used[i] = 0;
+		_live[i] = 0;
+	}
+	memset(_index, 0, sizeof(_index));
+	_keys = 0;
+	_head = FLASH_KV_SECTORS - 1;
+	_mounted = openSector();
+	kv_unlock();
+}
+
+size_t FlashKVClass::available(void)
+{
+	uint32_t live = 0;
+
+	kv_lock();
+	if (_mounted || mount()) {
+		for (int i = 0; i < FLASH_KV_SECTORS; i++) {
+			live += _live[i];
+		}
+	} else {
+		live = KV_CAPACITY;
+	}
+	kv_unlock();
+	return KV_CAPACITY - live;
+}
+
+FlashKVClass flashKV;
@@ -0,0 +1,136 @@
+/*
+  FlashKV.h - Wear-levelled key/value store in SPI flash
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef FlashKV_h
+#define FlashKV_h
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/*
+ * Records are appended to a log spread over FLASH_KV_SECTORS sectors; an
+ * update writes one new record instead of erasing anything. When the log
+ * runs out of room, the live records of the oldest sector are copied to
+ * the head and that sector is erased, so erases rotate over the region.
+ * Every record carries a CRC32, and a record cut short by a reset is
+ * ignored on the next begin().
+ *
+ * The default region sits just below the last flash sector, which keeps
+ * the data written by the old FlashEEPROM implementation.
+ */
+
+#ifndef FLASH_KV_SECTOR_SIZE
+#define FLASH_KV_SECTOR_SIZE	0x1000
+#endif
+
+/* Number of sectors used, at least 3 */
+#ifndef FLASH_KV_SECTORS
+#define FLASH_KV_SECTORS	4
+#endif
+
+#ifndef FLASH_KV_BASE
+#define FLASH_KV_BASE		(0x200000 - (FLASH_KV_SECTORS + 1) * FLASH_KV_SECTOR_SIZE)
+#endif
+
+/* Slots of the RAM index, a power of two; one key less can be stored */
+#ifndef FLASH_KV_INDEX_SIZE
+#define FLASH_KV_INDEX_SIZE	64
+#endif
+
+/* Longest key, not counting the terminating zero */
+#define FLASH_KV_KEY_LENGTH	32
+
+class FlashKVClass
+{
+public:
+	FlashKVClass();
+
+	/*
+	 * Scan the region and build the index, formatting it if it holds no
+	 * store yet. Called by the other functions if needed.
+	 * result: 1 on success, else 0
+	 */
+	int begin(void);
+
+	/*
+	 * Read a value.
+	 * param key: Key of the value
+	 * param buf: Receives up to size bytes of the value
+	 * result: Full length of the stored value, -1 if the key is not found
+	 */
+	int get(const char *key, void *buf, size_t size);
+
+	/*
+	 * Store a value, replacing any previous value of the key.
+	 * result: 1 on success, 0 if the key is too long or the store is full
+	 */
+	int put(const char *key, const void *buf, size_t size);
+
+	/*
+	 * Delete a key.
+	 * result: 1 if the key was found and deleted, else 0
+	 */
+	int remove(const char *key);
+
+	/*
+	 * Reclaim the oldest sector if at least half of it is stale, so that
+	 * a later put() does not have to. Meant to be called from loop() or a
+	 * low priority thread.
+	 * result: 1 if a sector was reclaimed, else 0
+	 */
+	int compact(void);
+
+	/* Erase every key */
+	void format(void);
+
+	/* Bytes that put() can still store, counting record overhead */
+	size_t available(void);
+
+	/* Usage counters, e.g. to measure write amplification */
+	uint32_t bytesWritten(void) { return _bytesWritten; }
+	uint32_t sectorErases(void) { return _sectorErases; }
+
+private:
+	struct IndexEntry {
+		uint32_t addr;		// flash address of the record
+		uint16_t hash;		// 0: empty slot, 1: deleted slot
+		uint16_t size;		// record size in flash
+	};
+
+	int find(const char *key, uint16_t hash);
+	int insert(const char *key, uint16_t hash, uint32_t addr, uint16_t size);
+	uint32_t append(const char *key, uint8_t keyLen, uint8_t flags, const void *buf, uint16_t size);
+	int makeRoom(uint32_t size);
+	int openSector(void);
+	int collect(void);
+	int mount(void);
+
+	IndexEntry _index[FLASH_KV_INDEX_SIZE];
+	uint32_t _seq[FLASH_KV_SECTORS];	// 0: sector is free
+	uint16_t _used[FLASH_KV_SECTORS];	// write offset inside the sector
+	uint16_t _live[FLASH_KV_SECTORS];	// bytes of records still indexed
+	int _head;
+	int _keys;
+	bool _mounted;
+	uint32_t _bytesWritten;
+	uint32_t _sectorErases;
+};
+
+extern FlashKVClass flashKV;
+
+#endif
@@ -0,0 +1,378 @@
+/*
+  I2S.cpp - I2S audio streaming through the page rings of the I2S DMA
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include <string.h>
+
+#include "I2S.h"
+#include "heap_caps.h"
+
+#ifdef I2S_HOST
+#define I2S_LOCK()		uint32_t primask = 0
+#define I2S_UNLOCK()		(void)primask
+#else
+#include "cmsis.h"
+#define I2S_LOCK()		uint32_t primask = __get_PRIMASK(); __disable_irq()
+#define I2S_UNLOCK()		__set_PRIMASK(primask)
+#endif
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+/*
+ * Hardware side: the board code at the end of this file, a model of the
+ * I2S in system/i2stest on the host. i2s_hw_begin() sets the I2S up
+ * without starting it, i2s_hw_give() hands a page to it.
+ */
+int  i2s_hw_begin(uint32_t rateCode, uint8_t bits, uint8_t channels, int mode,
+	uint8_t *tx, uint8_t *rx, uint16_t pageWords, uint8_t pages);
+void i2s_hw_give(int mode, uint32_t page);
+void i2s_hw_start(void);
+void i2s_hw_end(void);
+
+/* Low bits: REG_I2S_SETTING rate field, 0x10: 44.1 kHz clock source */
+static const struct {
+	uint32_t rate;
+	uint8_t code;
+} i2s_rates[] = {
+	{ 8000,  0x00 },
+	{ 16000, 0x01 },
+	{ 24000, 0x02 },
+	{ 32000, 0x03 },
+	{ 48000, 0x05 },
+	{ 96000, 0x06 },
+	{ 44100, 0x15 },
+	{ 88200, 0x16 },
+};
+
+I2SClass I2S;
+
+/******************************************************************************
+ * I2SClass
+ ******************************************************************************/
+
+I2SClass::I2SClass() :
+	_pages(0),
+	_pageWords(0),
+	_mem(NULL),
+	_callback(NULL),
+	_arg(NULL),
+	_underruns(0),
+	_overruns(0)
+{
+	memset(&_tx, 0, sizeof(_tx));
+	memset(&_rx, 0, sizeof(_rx));
+}
+
+int I2SClass::begin(uint32_t rate, uint8_t bits, uint8_t channels, int mode, uint16_t pageWords, uint8_t pages)
+{
+	int code = -1;
+	uint32_t ringBytes = (uint32_t)pageWords * 4 * pages;
+
+	end();
+
+	for (unsigned i = 0; i < sizeof(i2s_rates) / sizeof(i2s_rates[0]); i++) {
+		if (i2s_rates[i].rate == rate) code = i2s_rates[i].code;
+	}
+	if (code < 0 || (bits != 16 && bits != 24) || (channels != 1 && channels != 2)) return 0;
+	if (mode < I2S_MODE_RX || mode > I2S_MODE_DUPLEX) return 0;
+	if (pageWords == 0 || pageWords > I2S_MAX_PAGE_WORDS || pages < 2 || pages > I2S_MAX_PAGES) return 0;
+
+	// both rings in BD_RAM, the I2S DMA can not reach TCM
+	_mem = (uint8_t *)malloc_caps(mode == I2S_MODE_DUPLEX ? 2 * ringBytes : ringBytes, MALLOC_CAP_DMA);
+	if (_mem == NULL) return 0;
+
+	memset(&_tx, 0, sizeof(_tx));
+	memset(&_rx, 0, sizeof(_rx));
+	_tx.base = (mode != I2S_MODE_RX) ? _mem : NULL;
+	_rx.base = (mode == I2S_MODE_RX) ? _mem : (mode == I2S_MODE_DUPLEX) ? _mem + ringBytes : NULL;
+
+	_mode = mode;
+	_bits = bits;
+	_channels = channels;
+	_pageWords = pageWords;
+	_underruns = 0;
+	_overruns = 0;
+
+	if (i2s_hw_begin(code, bits, channels, mode, _tx.base, _rx.base, pageWords, pages) != 0) {
+		free_caps(_mem);
+		_mem = NULL;
+		return 0;
+	}
+	_pages = pages;
+
+	// the hardware starts with every page: silence to send, room to receive
+	if (_tx.base != NULL) {
+		memset(_tx.base, 0, ringBytes);
+		for (int i = 0; i < pages; i++) give(_tx, I2S_MODE_TX);
+	}
+	if (_rx.base != NULL) {
+		for (int i = 0; i < pages; i++) give(_rx, I2S_MODE_RX);
+	}
+	i2s_hw_start();
+
+	return 1;
+}
+
+void I2SClass::end(void)
+{
+	if (_pages == 0) return;
+
+	// an I2S interrupt from here on does nothing
+	_pages = 0;
+	i2s_hw_end();
+
+	free_caps(_mem);
+	_mem = NULL;
+	memset(&_tx, 0, sizeof(_tx));
+	memset(&_rx, 0, sizeof(_rx));
+}
+
+void I2SClass::onPage(i2s_callback_t callback, void *arg)
+{
+	I2S_LOCK();
+	_callback = callback;
+	_arg = arg;
+	I2S_UNLOCK();
+}
+
+uint32_t I2SClass::pageFrames(void)
+{
+	uint32_t frameBytes = (_bits == 16 ? 2 : 4) * _channels;
+
+	return _pages ? pageBytes() / frameBytes : 0;
+}
+
+/* Hand the first page of the sketch's part of the ring to the hardware */
+void I2SClass::give(Ring &ring, int mode)
+{
+	i2s_hw_give(mode, (ring.hw + ring.owned) % _pages);
+	ring.owned++;
+}
+
+void *I2SClass::rxAcquire(void)
+{
+	void *p = NULL;
+
+	I2S_LOCK();
+	if (_rx.base != NULL && _pages != 0 && !_rx.lent && _rx.owned < _pages) {
+		_rx.lent = true;
+		p = page(_rx, _rx.hw + _rx.owned);
+	}
+	I2S_UNLOCK();
+	return p;
+}
+
+void I2SClass::rxRelease(void)
+{
+	I2S_LOCK();
+	if (_pages != 0 && _rx.lent) {
+		_rx.lent = false;
+		give(_rx, I2S_MODE_RX);
+	}
+	I2S_UNLOCK();
+}
+
+void *I2SClass::txAcquire(void)
+{
+	void *p = NULL;
+
+	I2S_LOCK();
+	if (_tx.base != NULL && _pages != 0 && !_tx.lent && _tx.owned < _pages) {
+		_tx.lent = true;
+		p = page(_tx, _tx.hw + _tx.owned);
+	}
+	I2S_UNLOCK();
+	return p;
+}
+
+void I2SClass::txCommit(void)
+{
+	I2S_LOCK();
+	if (_pages != 0 && _tx.lent) {
+		_tx.lent = false;
+		give(_tx, I2S_MODE_TX);
+	}
+	I2S_UNLOCK();
+}
+
+void I2SClass::txPageDone(void)
+{
+	if (_pages == 0 || _tx.base == NULL || _tx.owned == 0) return;
+
+	_tx.hw = (_tx.hw + 1) % _pages;
+	_tx.owned--;
+
+	// nothing queued behind it: send silence rather than stall
+	if (_tx.owned == 0) {
+		_underruns++;
+		if (!_tx.lent) {
+			memset(page(_tx, _tx.hw), 0, pageBytes());
+			give(_tx, I2S_MODE_TX);
+		}
+	}
+
+	if (_callback != NULL) _callback(I2S_MODE_TX, _arg);
+}
+
+void I2SClass::rxPageDone(void)
+{
+	if (_pages == 0 || _rx.base == NULL || _rx.owned == 0) return;
+
+	_rx.hw = (_rx.hw + 1) % _pages;
+	_rx.owned--;
+
+	// every page full: drop the oldest, unless the sketch is reading it
+	if (_rx.owned == 0) {
+		_overruns++;
+		if (!_rx.lent) give(_rx, I2S_MODE_RX);
+	}
+
+	if (_callback != NULL) _callback(I2S_MODE_RX, _arg);
+}
+
+/******************************************************************************
+ * Hardware
+ ******************************************************************************/
+
+#ifndef I2S_HOST
+
+extern "C" {
+#include "rtl8195a.h"
+#include "rtl8195a_i2s.h"
+#include "hal_peri_on.h"
+#include "hal_pinmux.h"
+}
+
+/*
+ * The registers are driven here directly: RtkI2SInit() in the SDK library
+ * needs HalI2SSetRateRtl8195a() and the other HAL I2S calls, which neither
+ * the library nor the ROM provide.
+ */
+#define I2S_REG_BASE		I2S1_REG_BASE
+#define I2S_PAGE_OK_BITS	0x0F
+
+static IRQ_HANDLE i2s_irq;
+
+static inline void i2s_write(uint32_t reg, uint32_t value)
+{
+	HAL_WRITE32(I2S_REG_BASE, reg, value);
+}
+
+static inline uint32_t i2s_read(uint32_t reg)
+{
+	return HAL_READ32(I2S_REG_BASE, reg);
+}
+
+/* One call per page done, the hardware finishes them in ring order */
+static u32 i2s_irq_handler(VOID *Data)
+{
+	uint32_t tx = i2s_read(REG_I2S_TX_STATUS_INT);
+	uint32_t rx = i2s_read(REG_I2S_RX_STATUS_INT);
+
+	i2s_write(REG_I2S_TX_STATUS_INT, tx);
+	i2s_write(REG_I2S_RX_STATUS_INT, rx);
+
+	for (tx &= I2S_PAGE_OK_BITS; tx != 0; tx &= tx - 1) I2S.txPageDone();
+	for (rx &= I2S_PAGE_OK_BITS; rx != 0; rx &= rx - 1) I2S.rxPageDone();
+
+	return 0;
+}
+
+int i2s_hw_begin(uint32_t rateCode, uint8_t bits, uint8_t channels, int mode,
+	uint8_t *tx, uint8_t *rx, uint16_t pageWords, uint8_t pages)
+{
+	uint32_t ctl;
+
+	ACTCK_I2S_CCTRL(ON);
+	SLPCK_I2S_CCTRL(ON);
+	LXBUS_FCTRL(ON);
+	I2S1_FCTRL(ON);
+	if (HalPinCtrlRtl8195A(I2S1, 0, ON) != _TRUE) return -1;
+	I2S1_MCK_CTRL(ON);
+
+	// disabled, through a software reset
+	i2s_write(REG_I2S_CTL, BIT_CTLX_I2S_SW_RSTN);
+	i2s_write(REG_I2S_CTL, 0);
+	i2s_write(REG_I2S_CTL, BIT_CTLX_I2S_SW_RSTN);
+
+	i2s_write(REG_I2S_SETTING,
+		BIT_CTRL_SETTING_I2S_PAGE_SZ(pageWords - 1) |
+		BIT_CTRL_SETTING_I2S_PAGE_NUM(pages - 1) |
+		BIT_CTRL_SETTING_I2S_SAMPLE_RATE(rateCode & 0x7));
+
+	ctl = BIT_CTLX_I2S_SW_RSTN |
+		BIT_CTRL_CTLX_I2S_TRX_ACT(mode) |
+		BIT_CTRL_CTLX_I2S_CH_NUM(channels == 1 ? ChannelMono : ChannelStereo) |
+		BIT_CTRL_CTLX_I2S_WL(bits == 24 ? 1 : 0);
+	if (rateCode & 0x10) ctl |= BIT_CTLX_I2S_CLK_SRC;
+	i2s_write(REG_I2S_CTL, ctl);
+
+	i2s_write(REG_I2S_TX_PAGE_PTR, (uint32_t)tx);
+	i2s_write(REG_I2S_RX_PAGE_PTR, (uint32_t)rx);
+
+	for (int i = 0; i < I2S_MAX_PAGES; i++) {
+		i2s_write(REG_I2S_TX_PAGE0_OWN + i * 4, 0);
+		i2s_write(REG_I2S_RX_PAGE0_OWN + i * 4, 0);
+	}
+	i2s_write(REG_I2S_TX_STATUS_INT, 0xFF);
+	i2s_write(REG_I2S_RX_STATUS_INT, 0xFF);
+	i2s_write(REG_I2S_TX_MASK_INT, tx != NULL ? I2S_PAGE_OK_BITS : 0);
+	i2s_write(REG_I2S_RX_MASK_INT, rx != NULL ? I2S_PAGE_OK_BITS : 0);
+
+	i2s_irq.Data = 0;
+	i2s_irq.IrqNum = I2S1_PCM1_IRQ;
+	i2s_irq.IrqFun = (IRQ_FUN)i2s_irq_handler;
+	i2s_irq.Priority = 3;
+	InterruptUnRegister(&i2s_irq);
+	InterruptRegister(&i2s_irq);
+	InterruptEn(&i2s_irq);
+
+	return 0;
+}
+
+void i2s_hw_give(int mode, uint32_t page)
+{
+	uint32_t reg = (mode == I2S_MODE_TX) ? REG_I2S_TX_PAGE0_OWN : REG_I2S_RX_PAGE0_OWN;
+
+	i2s_write(reg + page * 4, BIT_PAGE_I2S_OWN_BIT);
+}
+
+void i2s_hw_start(void)
+{
+	i2s_write(REG_I2S_CTL, i2s_read(REG_I2S_CTL) | BIT_CTLX_I2S_EN);
+}
+
+void i2s_hw_end(void)
+{
+	i2s_write(REG_I2S_CTL, i2s_read(REG_I2S_CTL) & ~BIT_CTLX_I2S_EN);
+	i2s_write(REG_I2S_TX_MASK_INT, 0);
+	i2s_write(REG_I2S_RX_MASK_INT, 0);
+	InterruptDis(&i2s_irq);
+	InterruptUnRegister(&i2s_irq);
+
+	I2S1_MCK_CTRL(OFF);
+	HalPinCtrlRtl8195A(I2S1, 0, OFF);
+	I2S1_FCTRL(OFF);
+}
+
+#endif
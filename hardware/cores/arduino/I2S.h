@@ -0,0 +1,148 @@
+/*
+  I2S.h - I2S audio streaming through the page rings of the I2S DMA
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef I2S_h
+#define I2S_h
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/*
+ * The I2S block has its own DMA. It sends from a ring of 2 to 4 TX pages
+ * and receives into a ring of as many RX pages, in page order, and only
+ * touches a page while the page's own bit gives it to the hardware. It
+ * clears the bit and raises an interrupt when it is done with a page.
+ *
+ * The pages are the buffers of the sketch, nothing is copied:
+ *
+ *  - rxAcquire() lends the oldest full RX page, rxRelease() gives it
+ *    back to the hardware to fill again.
+ *  - txAcquire() lends the next free TX page, txCommit() queues it to be
+ *    sent after the pages queued before it.
+ *
+ * One page per direction can be lent at a time. Both calls return NULL
+ * while no page is ready; onPage() sets a callback, run from the I2S
+ * interrupt as pages come ready, to wake the task that waits for them.
+ *
+ * When the hardware reaches a TX page that was never committed, the
+ * interrupt sends silence in its place and counts an underrun. When it
+ * needs an RX page and all are full, it drops the oldest one unread and
+ * counts an overrun. A page that is lent is never taken back: the
+ * hardware waits for it instead, and the data of that time is lost.
+ *
+ * A page holds pageBytes(): frames of 2 bytes per channel at 16 bits,
+ * 4 bytes per channel at 24 bits (right aligned), channels interleaved.
+ *
+ * Pins: I2S1 on pin mux S0, WS PC_0 (D10), SCK PC_1 (D13), SD TX
+ * PC_2 (D11), MCK PC_3 (D12), SD RX PC_4.
+ */
+
+#define I2S_MAX_PAGES			4
+#define I2S_MAX_PAGE_WORDS		4096
+
+/* begin() direction, numbered as the hardware's TRX_ACT field */
+#define I2S_MODE_RX			0
+#define I2S_MODE_TX			1
+#define I2S_MODE_DUPLEX			2
+
+/* Page-ready callback, from the interrupt; mode is I2S_MODE_RX or I2S_MODE_TX */
+typedef void (*i2s_callback_t)(int mode, void *arg);
+
+class I2SClass
+{
+public:
+	I2SClass();
+
+	/*
+	 * Start the I2S as master.
+	 * rate: 8000, 16000, 24000, 32000, 48000, 96000, 44100 or 88200
+	 * bits: 16 or 24
+	 * channels: 1 or 2
+	 * pageWords: 32-bit words per page, 1 to I2S_MAX_PAGE_WORDS
+	 * pages: pages per ring, 2 to I2S_MAX_PAGES
+	 * result: 1 on success, 0 on bad arguments or no memory
+	 */
+	int begin(uint32_t rate, uint8_t bits = 16, uint8_t channels = 2, int mode = I2S_MODE_DUPLEX,
+		uint16_t pageWords = 256, uint8_t pages = I2S_MAX_PAGES);
+
+	/* Stop the I2S and free the pages; lent pages are gone too */
+	void end(void);
+
+	void onPage(i2s_callback_t callback, void *arg = NULL);
+
+	bool running(void) { return _pages != 0; }
+
+	uint32_t pageBytes(void) { return _pageWords * 4; }
+	uint32_t pageFrames(void);
+
+	/* Oldest full RX page, NULL if none or one is lent already */
+	void *rxAcquire(void);
+	void rxRelease(void);
+
+	/* Next free TX page, NULL if none or one is lent already */
+	void *txAcquire(void);
+	void txCommit(void);
+
+	/* Full RX pages waiting, free TX pages, including a lent one */
+	uint32_t rxAvailable(void) { return _rx.base != NULL ? _pages - _rx.owned : 0; }
+	uint32_t txAvailable(void) { return _tx.base != NULL ? _pages - _tx.owned : 0; }
+
+	/* TX pages sent as silence, RX pages dropped unread */
+	uint32_t underruns(void) { return _underruns; }
+	uint32_t overruns(void) { return _overruns; }
+
+	/* From the I2S interrupt, once per page the hardware is done with */
+	void txPageDone(void);
+	void rxPageDone(void);
+
+private:
+	/*
+	 * The hardware owns pages [hw, hw + owned) of a ring. The rest, from
+	 * hw + owned on, are the sketch's: full RX or free TX pages, the first
+	 * of them lent while "lent" is set.
+	 */
+	struct Ring {
+		uint8_t *base;
+		volatile uint8_t hw;
+		volatile uint8_t owned;
+		volatile bool lent;
+	};
+
+	uint8_t *page(const Ring &ring, uint32_t index) { return ring.base + (index % _pages) * _pageWords * 4; }
+	void give(Ring &ring, int mode);
+
+	int _mode;
+	uint8_t _bits;
+	uint8_t _channels;
+	volatile uint8_t _pages;	// 0 while stopped
+	uint16_t _pageWords;
+
+	Ring _tx;
+	Ring _rx;
+	uint8_t *_mem;
+
+	i2s_callback_t _callback;
+	void *_arg;
+
+	volatile uint32_t _underruns;
+	volatile uint32_t _overruns;
+};
+
+extern I2SClass I2S;
+
+#endif
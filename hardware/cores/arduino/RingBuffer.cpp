@@ -19,6 +19,10 @@
 #include "RingBuffer.h"
 #include <string.h>
 
+extern "C" {
+#include "section_config.h"
+}
+
 RingBuffer::RingBuffer( void )
 {
     memset( _aucBuffer, 0, SERIAL_BUFFER_SIZE ) ;
@@ -26,6 +30,8 @@ RingBuffer::RingBuffer( void )
     _iTail=0 ;
 }
 
+// called from the UART interrupts
+TCM_TEXT_SECTION
 void RingBuffer::store_char( uint8_t c )
 {
   int i = (uint32_t)(_iHead + 1) % SERIAL_BUFFER_SIZE ;
@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Scheduler1.h"
+
+#define NUM_REGS 10	// r4-r11, r12 holding sp, lr
+
+#define STACK_FILL 0xA5	// marks stack bytes never used, for the high-water mark
+
+typedef struct CoopTask {
+	uint32_t regs[NUM_REGS];	// must stay first, see coopDoYield()
+	struct CoopTask *next;
+	struct CoopTask *prev;
+	uint8_t *stackPtr;
+	uint32_t stackSize;
+	SchedulerParametricTask func;
+	void *arg;
+	uint32_t wakeTime;
+	uint8_t sleeping;
+	uint8_t id;
+	// stats
+	uint64_t runTime;		// microseconds spent running
+	uint32_t switches;		// times this loop was switched to
+} CoopTask;
+
+static CoopTask mainTask;		// the sketch's own loop(), on the thread stack
+static CoopTask *cur = NULL;		// NULL until the first loop is started
+static osThreadId coopThread;
+static uint32_t sliceStart;
+static uint8_t nextId = 1;
+static CoopTask *deadTask = NULL;	// a loop that returned, freed off its stack
+
+/*
+ * Free the loop that returned last. Only called on the stack of another
+ * loop: the one that died is out of the list, so it never runs again.
+ */
+static void coopReap(void)
+{
+	if (deadTask != NULL) {
+		free(deadTask->stackPtr);
+		free(deadTask);
+		deadTask = NULL;
+	}
+}
+
+extern "C" {
+
+/*
+ * Pick the next loop to run, after the current one yielded or returned.
+ * Called from assembly on the stack of the loop being left.
+ */
+CoopTask * __attribute__((used)) coopSchedule(char taskDied)
+{
+	CoopTask *prev = cur;
+	CoopTask *first = prev->next;	// the sketch's loop never dies, so this is not prev
+
+	prev->runTime += micros() - sliceStart;
+
+	coopReap();
+	if (taskDied) {
+		// we are still running on its stack: unlink it now, free it
+		// once the next loop runs
+		prev->prev->next = prev->next;
+		prev->next->prev = prev->prev;
+		deadTask = prev;
+	}
+
+	for (;;) {
+		CoopTask *task = first;
+		int32_t wait = -1;
+
+		// round robin, ending with prev itself if it only yielded
+		do {
+			int32_t left = (int32_t)(task->wakeTime - millis());
+			if (!task->sleeping || left <= 0) {
+				task->sleeping = 0;
+				if (task != prev) {
+					task->switches++;
+				}
+				cur = task;
+				sliceStart = micros();
+				return task;
+			}
+			if (wait < 0 || left < wait) {
+				wait = left;
+			}
+			task = task->next;
+		} while (task != first);
+
+		// every loop is in delay(): let the rest of the system run
+		osDelay(wait);
+	}
+}
+
+/*
+ * First code run by a new loop: call func(arg), and drop the loop if it
+ * ever returns.
+ */
+static void __attribute__((naked)) __attribute__((noinline)) coopTaskStart(void)
+{
+	asm volatile (
+		"mov   r0, r5\n"
+		"blx   r4\n"
+		"mov   r0, #1\n"		// the task returned, it is done
+		"bl    coopSchedule\n"
+		"ldmia r0, {r4-r12, lr}\n"
+		"mov   sp, r12\n"
+		"bx    lr\n"
+	);
+}
+
+/*
+ * Save the callee-saved registers of the current loop in *task and resume
+ * the loop chosen by coopSchedule(). Returns when task is resumed.
+ */
+static void __attribute__((naked)) __attribute__((noinline)) coopDoYield(CoopTask *task)
+{
+	asm volatile (
+		"mov   r12, sp\n"
+		"stmia r0, {r4-r12, lr}\n"
+		"mov   r0, #0\n"		// the task is still alive
+		"bl    coopSchedule\n"
+		"ldmia r0, {r4-r12, lr}\n"
+		"mov   sp, r12\n"
+		"bx    lr\n"
+	);
+}
+
+// Replaces the empty yield() in hooks.c when the scheduler is linked in
+void yield(void)
+{
+	if (cur == NULL || osThreadGetId() != coopThread) {
+		return;
+	}
+	coopDoYield(cur);
+	coopReap();
+}
+
+// Called by delay(); returns 0 to let it block the thread as before
+int delayHook(uint32_t ms)
+{
+	if (cur == NULL || osThreadGetId() != coopThread) {
+		return 0;
+	}
+	cur->wakeTime = millis() + ms;
+	cur->sleeping = 1;
+	coopDoYield(cur);
+	coopReap();
+	return 1;
+}
+
+} // extern "C"
+
+static void startLoopHelper(void *taskData)
+{
+	SchedulerTask task = reinterpret_cast<SchedulerTask>(taskData);
+	for (;;) {
+		task();
+		yield();
+	}
+}
+
+static void startTask(SchedulerParametricTask func, void *arg, uint32_t stackSize)
+{
+	if (cur == NULL) {
+		// adopt the running sketch as the first loop
+		coopThread = osThreadGetId();
+		mainTask.next = &mainTask;
+		mainTask.prev = &mainTask;
+		cur = &mainTask;
+		sliceStart = micros();
+	}
+
+	CoopTask *task = reinterpret_cast<CoopTask *>(malloc(sizeof(CoopTask)));
+	if (!task) {
+		return;
+	}
+	stackSize = (stackSize + 7) & ~7;	// AAPCS wants sp 8-byte aligned
+	uint8_t *stack = reinterpret_cast<uint8_t *>(malloc(stackSize));
+	if (!stack) {
+		free(task);
+		return;
+	}
+	memset(stack, STACK_FILL, stackSize);
+	memset(task, 0, sizeof(CoopTask));
+
+	task->stackPtr = stack;
+	task->stackSize = stackSize;
+	task->func = func;
+	task->arg = arg;
+	task->id = nextId++;
+	task->regs[0] = reinterpret_cast<uint32_t>(func);	// r4
+	task->regs[1] = reinterpret_cast<uint32_t>(arg);	// r5
+	task->regs[8] = (reinterpret_cast<uint32_t>(stack) + stackSize) & ~7;	// r12 -> sp
+	task->regs[9] = reinterpret_cast<uint32_t>(&coopTaskStart);	// lr
+
+	// run it right before the loop that started it comes round again
+	task->next = cur;
+	task->prev = cur->prev;
+	cur->prev->next = task;
+	cur->prev = task;
+}
+
+SchedulerClass1::SchedulerClass1()
+{
+}
+
+void SchedulerClass1::startLoop(SchedulerTask task, uint32_t stackSize)
+{
+	startTask(startLoopHelper, reinterpret_cast<void *>(task), stackSize);
+}
+
+void SchedulerClass1::start(SchedulerTask task, uint32_t stackSize)
+{
+	startTask(reinterpret_cast<SchedulerParametricTask>(task), NULL, stackSize);
+}
+
+void SchedulerClass1::start(SchedulerParametricTask task, void *taskData, uint32_t stackSize)
+{
+	startTask(task, taskData, stackSize);
+}
+
+void SchedulerClass1::printStats(Print &out)
+{
+	if (cur == NULL) {
+		return;
+	}
+	cur->runTime += micros() - sliceStart;
+	sliceStart = micros();
+
+	out.println("loop\trun ms\tswitches\tstack used/size");
+	CoopTask *task = &mainTask;
+	do {
+		out.print(task->id);
+		out.print('\t');
+		out.print((uint32_t)(task->runTime / 1000));
+		out.print('\t');
+		out.print(task->switches);
+		out.print('\t');
+		if (task->stackPtr) {
+			uint32_t unused = 0;
+			while (unused < task->stackSize && task->stackPtr[unused] == STACK_FILL) {
+				unused++;
+			}
+			out.print(task->stackSize - unused);
+			out.print('/');
+			out.println(task->stackSize);
+		} else {
+			out.println("-");	// thread stack
+		}
+		task = task->next;
+	} while (task != &mainTask);
+}
+
+SchedulerClass1 Scheduler1;
@@ -18,21 +18,33 @@
 #define _SCHEDULDER_H_
 
 #include <Arduino.h>
+#include "Print.h"
 
 extern "C" {
 	typedef void (*SchedulerTask)(void);
 	typedef void (*SchedulerParametricTask)(void *);
 }
 
+/*
+ * Cooperative loops that share the sketch's RTX thread. Each loop has its
+ * own small stack and runs until it calls yield() or delay(), which switch
+ * to the next loop that is ready. When every loop is in delay(), the
+ * thread sleeps until the earliest one is due.
+ *
+ * Loops must only be started from, and only switch on, the sketch thread;
+ * delay() in any other thread still blocks just that thread.
+ */
 class SchedulerClass1 {
 public:
 	SchedulerClass1();
-	static void startLoop(SchedulerTask task, uint32_t stackSize = 1024);
-//	static void start(SchedulerTask task, uint32_t stackSize = 1024);
-//	static void start(SchedulerParametricTask task, void *data, uint32_t stackSize = 1024);
+	static void startLoop(SchedulerTask task, uint32_t stackSize = 512);
+	static void start(SchedulerTask task, uint32_t stackSize = 512);
+	static void start(SchedulerParametricTask task, void *data, uint32_t stackSize = 512);
 
 	static void yield() { ::yield(); };
 
+	/* Run time, switch count and peak stack use of every loop */
+	static void printStats(Print &out);
 };
 
 extern SchedulerClass1 Scheduler1;
@@ -50,6 +50,7 @@ UARTClass::UARTClass(IRQn_Type dwIrq, RingBuffer* pRx_buffer )
 // Public Methods //////////////////////////////////////////////////////////////
 
 
+TCM_TEXT_SECTION
 void UARTClass::IrqHandler( void )
 {
 
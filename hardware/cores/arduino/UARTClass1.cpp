@@ -47,6 +47,7 @@ extern "C" {
 
 
 
+TCM_TEXT_SECTION
 void uart_irq(uint32_t id, SerialIrq event)
 {
 	Serial1.IrqHandler(event);
@@ -63,6 +64,7 @@ UARTClass1::UARTClass1(RingBuffer* pRx_buffer )
 }
 
 
+TCM_TEXT_SECTION
 void UARTClass1::IrqHandler(SerialIrq event)
 {
     PHAL_RUART_ADAPTER pHalRuartAdapter=(PHAL_RUART_ADAPTER)&(this->sobj.hal_uart_adp);
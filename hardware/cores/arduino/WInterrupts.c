@@ -0,0 +1,377 @@
+/*
+  Copyright (c) 2011-2012 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "Arduino.h"
+#include "WInterrupts.h"
+
+#include "PinNames.h"
+#include "objects.h"
+#include "hal_gpio.h"
+#include "section_config.h"
+#include "us_ticker_api.h"
+
+/*
+ * Only GPIO port A raises interrupts, one status bit per pin. GPIO_IRQ
+ * goes straight to gpio_irq_handler(), which looks the pin up in
+ * irq_slots[] by bit number and calls the handler: no HAL or mbed
+ * layers in between. Pins attached through the mbed gpio_irq API are
+ * still served, through the HAL handler table.
+ *
+ * The port has no both-edges setting. CHANGE is an edge interrupt whose
+ * polarity the ISR sets to the opposite of the pin level on every edge,
+ * so a pulse shorter than the interrupt latency can be missed.
+ */
+
+#define IRQ_QUEUE_SIZE		64	/* power of 2 */
+
+#define IRQ_WORKER_PRIORITY	osPriorityHigh
+
+typedef struct {
+	interrupt_handler_t handler;
+	void *arg;
+	uint32_t debounce;	/* us, edges only */
+	uint32_t last;		/* us_ticker_read() of the last edge passed on */
+	uint8_t mode;
+	uint8_t flags;
+} gpio_irq_slot_t;
+
+typedef struct {
+	uint32_t bit;
+	uint32_t timestamp;
+} gpio_irq_event_t;
+
+TCM_BSS_SECTION
+static gpio_irq_slot_t irq_slots[32];
+
+/* single producer (the GPIO ISR), single consumer (the worker thread) */
+TCM_BSS_SECTION
+static gpio_irq_event_t irq_queue[IRQ_QUEUE_SIZE];
+static volatile uint32_t irq_queue_head;
+static volatile uint32_t irq_queue_tail;
+static volatile uint32_t irq_dropped;
+
+static _sema irq_worker_sema;
+static osThreadId irq_worker_id;
+static osThreadDef_t irq_worker_def;
+static unsigned char irq_worker_stack[DEFAULT_STACK_SIZE];
+
+/* in ROM, set up by HAL_GPIO_Init() */
+extern PHAL_GPIO_ADAPTER _pHAL_Gpio_Adapter;
+
+#define GPIO_IRQ_LOCK()		uint32_t primask = __get_PRIMASK(); __disable_irq()
+#define GPIO_IRQ_UNLOCK()	__set_PRIMASK(primask)
+
+static inline void gpio_irq_set_bits(u32 reg, uint32_t mask, int set)
+{
+	u32 RegValue = HAL_READ32(GPIO_REG_BASE, reg);
+
+	if (set)
+		RegValue |= mask;
+	else
+		RegValue &= ~mask;
+	HAL_WRITE32(GPIO_REG_BASE, reg, RegValue);
+}
+
+TCM_TEXT_SECTION
+static void gpio_irq_fire(uint32_t bit, uint32_t now)
+{
+	gpio_irq_slot_t *slot = &irq_slots[bit];
+	uint32_t mask = 1UL << bit;
+
+	if (slot->mode == CHANGE) {
+		uint32_t level = HAL_READ32(GPIO_REG_BASE, GPIO_EXT_PORTA) & mask;
+
+		gpio_irq_set_bits(GPIO_INT_POLARITY, mask, !level);
+		HAL_WRITE32(GPIO_REG_BASE, GPIO_PORTA_EOI, mask);
+	}
+
+	if (slot->mode != LOW && slot->mode != HIGH) {
+		if (slot->debounce != 0 && (now - slot->last) < slot->debounce)
+			return;
+	}
+	slot->last = now;
+
+	if (slot->flags & INTERRUPT_DEFERRED) {
+		uint32_t head = irq_queue_head;
+
+		if (head - irq_queue_tail >= IRQ_QUEUE_SIZE) {
+			irq_dropped++;
+			return;
+		}
+		irq_queue[head & (IRQ_QUEUE_SIZE - 1)].bit = bit;
+		irq_queue[head & (IRQ_QUEUE_SIZE - 1)].timestamp = now;
+		__DMB();
+		irq_queue_head = head + 1;
+
+		// a level keeps firing until the worker has run the handler
+		if (slot->mode == LOW || slot->mode == HIGH)
+			gpio_irq_set_bits(GPIO_INT_MASK, mask, 1);
+
+		rtw_up_sema(&irq_worker_sema);
+		return;
+	}
+
+	slot->handler(slot->arg, now);
+}
+
+TCM_TEXT_SECTION
+static u32 gpio_irq_handler(VOID *Data)
+{
+	uint32_t status = HAL_READ32(GPIO_REG_BASE, GPIO_INT_STATUS);
+	uint32_t edges = status & HAL_READ32(GPIO_REG_BASE, GPIO_INT_TYPE);
+	uint32_t now = us_ticker_read();
+
+	// clear before the handlers run, so an edge that comes in meanwhile is kept
+	if (edges)
+		HAL_WRITE32(GPIO_REG_BASE, GPIO_PORTA_EOI, edges);
+
+	while (status) {
+		uint32_t bit = 31 - __CLZ(status);
+
+		status &= ~(1UL << bit);
+		if (irq_slots[bit].handler != NULL) {
+			gpio_irq_fire(bit, now);
+		} else if (_pHAL_Gpio_Adapter != NULL && _pHAL_Gpio_Adapter->PortA_IrqHandler[bit] != NULL) {
+			_pHAL_Gpio_Adapter->PortA_IrqHandler[bit](_pHAL_Gpio_Adapter->PortA_IrqData[bit]);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * gpio_irq_init() of mbed registers the HAL handler on GPIO_IRQ again.
+ * Until the next attachInterrupt() takes the vector back, the HAL
+ * handler reaches our pins through here.
+ */
+static void gpio_irq_hal_entry(VOID *Data)
+{
+	gpio_irq_fire((uint32_t)Data, us_ticker_read());
+}
+
+static void gpio_irq_register(void)
+{
+	IRQ_HANDLE GpioIrqHandle;
+
+	GpioIrqHandle.Data = 0;
+	GpioIrqHandle.IrqNum = GPIO_IRQ;
+	GpioIrqHandle.IrqFun = (IRQ_FUN)gpio_irq_handler;
+	GpioIrqHandle.Priority = 0;
+
+	InterruptUnRegister(&GpioIrqHandle);
+	InterruptRegister(&GpioIrqHandle);
+	InterruptEn(&GpioIrqHandle);
+}
+
+static void gpio_irq_worker(void const *argument)
+{
+	while (1) {
+		rtw_down_sema(&irq_worker_sema);
+
+		while (irq_queue_tail != irq_queue_head) {
+			gpio_irq_event_t event = irq_queue[irq_queue_tail & (IRQ_QUEUE_SIZE - 1)];
+			gpio_irq_slot_t *slot = &irq_slots[event.bit];
+			interrupt_handler_t handler = slot->handler;
+
+			__DMB();
+			irq_queue_tail++;
+
+			// skip events of a pin that was detached or attached again since
+			if (handler == NULL || !(slot->flags & INTERRUPT_DEFERRED))
+				continue;
+
+			handler(slot->arg, event.timestamp);
+
+			if (slot->mode == LOW || slot->mode == HIGH) {
+				GPIO_IRQ_LOCK();
+				gpio_irq_set_bits(GPIO_INT_MASK, 1UL << event.bit, 0);
+				GPIO_IRQ_UNLOCK();
+			}
+		}
+	}
+}
+
+static int gpio_irq_worker_start(void)
+{
+	if (irq_worker_id != NULL) return 0;
+
+	rtw_init_sema(&irq_worker_sema, 0);
+
+	irq_worker_def.pthread = (os_pthread)gpio_irq_worker;
+	irq_worker_def.tpriority = IRQ_WORKER_PRIORITY;
+	irq_worker_def.stacksize = sizeof(irq_worker_stack);
+	irq_worker_def.stack_pointer = irq_worker_stack;
+
+	irq_worker_id = osThreadCreate(&irq_worker_def, NULL);
+	if (irq_worker_id == NULL) {
+		DiagPrintf(" %s : can not start the interrupt worker \r\n", __FUNCTION__);
+		return -1;
+	}
+
+	return 0;
+}
+
+// the port A bit of an Arduino pin, or -1
+static int gpio_irq_bit(uint32_t ulPin)
+{
+	if ( ulPin >= TOTAL_GPIO_PIN_NUM ) return -1;
+
+	if ( g_APinDescription[ulPin].ulPinType != PIO_GPIO )
+	{
+		DiagPrintf(" %s : not GPIO pin, please do pinMode first \r\n", __FUNCTION__);
+		return -1;
+	}
+
+	if ( gpio_get_port_num(ulPin) != GPIO_PORT_A )
+	{
+		DiagPrintf(" %s : pin %d can not be interrupt \r\n", __FUNCTION__, ulPin);
+		return -1;
+	}
+
+	return gpio_get_pin_num(ulPin);
+}
+
+void attachInterruptArg(uint32_t pin, interrupt_handler_t handler, void *arg, uint32_t mode, uint32_t flags)
+{
+	int bit;
+	uint32_t mask;
+	int edge, active_high;
+
+	bit = gpio_irq_bit(pin);
+	if (bit < 0 || handler == NULL) return;
+	mask = 1UL << bit;
+
+	switch (mode) {
+		case LOW:
+			edge = 0;
+			active_high = 0;
+			break;
+		case HIGH:
+			edge = 0;
+			active_high = 1;
+			break;
+		case FALLING:
+			edge = 1;
+			active_high = 0;
+			break;
+		case RISING:
+			edge = 1;
+			active_high = 1;
+			break;
+		case CHANGE:
+			edge = 1;
+			active_high = !(HAL_READ32(GPIO_REG_BASE, GPIO_EXT_PORTA) & mask);
+			break;
+		default:
+			DiagPrintf(" %s : unknown mode : %d \r\n", __FUNCTION__, mode);
+			return;
+	}
+
+	if ((flags & INTERRUPT_DEFERRED) && gpio_irq_worker_start() != 0) return;
+
+	{
+		GPIO_IRQ_LOCK();
+
+		gpio_irq_set_bits(GPIO_INT_EN, mask, 0);
+
+		irq_slots[bit].handler = handler;
+		irq_slots[bit].arg = arg;
+		irq_slots[bit].mode = mode;
+		irq_slots[bit].flags = flags;
+		irq_slots[bit].last = us_ticker_read();
+
+		gpio_irq_set_bits(GPIO_INT_TYPE, mask, edge);
+		gpio_irq_set_bits(GPIO_INT_POLARITY, mask, active_high);
+		HAL_WRITE32(GPIO_REG_BASE, GPIO_PORTA_EOI, mask);
+		gpio_irq_set_bits(GPIO_INT_MASK, mask, 0);
+		gpio_irq_set_bits(GPIO_INT_EN, mask, 1);
+
+		if (_pHAL_Gpio_Adapter != NULL) {
+			_pHAL_Gpio_Adapter->PortA_IrqHandler[bit] = gpio_irq_hal_entry;
+			_pHAL_Gpio_Adapter->PortA_IrqData[bit] = (VOID *)bit;
+		}
+
+		GPIO_IRQ_UNLOCK();
+	}
+
+	gpio_irq_register();
+}
+
+/*
+ * void (*)(void) callbacks share the slot with interrupt_handler_t: the
+ * two arguments they are called with go in r0/r1 and are ignored.
+ */
+void attachInterrupt(uint32_t pin, void (*callback)(void), uint32_t mode)
+{
+	attachInterruptArg(pin, (interrupt_handler_t)callback, NULL, mode, 0);
+}
+
+void digital_isr( uint32_t ulPin, void* handler, void* data, int mode)
+{
+	attachInterruptArg(ulPin, (interrupt_handler_t)handler, data, mode, 0);
+}
+
+void detachInterrupt(uint32_t pin)
+{
+	int bit;
+	uint32_t mask;
+
+	bit = gpio_irq_bit(pin);
+	if (bit < 0) return;
+	mask = 1UL << bit;
+
+	{
+		GPIO_IRQ_LOCK();
+
+		gpio_irq_set_bits(GPIO_INT_EN, mask, 0);
+		gpio_irq_set_bits(GPIO_INT_MASK, mask, 1);
+		HAL_WRITE32(GPIO_REG_BASE, GPIO_PORTA_EOI, mask);
+
+		irq_slots[bit].handler = NULL;
+		irq_slots[bit].arg = NULL;
+		irq_slots[bit].flags = 0;
+
+		if (_pHAL_Gpio_Adapter != NULL && _pHAL_Gpio_Adapter->PortA_IrqHandler[bit] == gpio_irq_hal_entry) {
+			_pHAL_Gpio_Adapter->PortA_IrqHandler[bit] = NULL;
+			_pHAL_Gpio_Adapter->PortA_IrqData[bit] = NULL;
+		}
+
+		GPIO_IRQ_UNLOCK();
+	}
+}
+
+void setInterruptDebounce(uint32_t pin, uint32_t us)
+{
+	int bit = gpio_irq_bit(pin);
+
+	if (bit < 0) return;
+	irq_slots[bit].debounce = us;
+}
+
+uint32_t interruptTimestamp(uint32_t pin)
+{
+	int bit = gpio_irq_bit(pin);
+
+	if (bit < 0) return 0;
+	return irq_slots[bit].last;
+}
+
+uint32_t interruptsDropped(void)
+{
+	return irq_dropped;
+}
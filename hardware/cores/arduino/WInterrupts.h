@@ -25,10 +25,30 @@
 extern "C" {
 #endif
 
+// attachInterruptArg() flags
+#define INTERRUPT_DEFERRED	0x01	// call the handler from the interrupt worker thread, not the ISR
+
+/*
+ * timestamp is us_ticker_read() at interrupt entry. In deferred mode it
+ * is still the time of the edge, not of the call.
+ */
+typedef void (*interrupt_handler_t)(void *arg, uint32_t timestamp);
+
 void attachInterrupt(uint32_t pin, void (*callback)(void), uint32_t mode);
 
+void attachInterruptArg(uint32_t pin, interrupt_handler_t handler, void *arg, uint32_t mode, uint32_t flags);
+
 void detachInterrupt(uint32_t pin);
 
+// ignore edges that come less than us after the last one; 0 turns it off
+void setInterruptDebounce(uint32_t pin, uint32_t us);
+
+// us_ticker_read() of the last edge that was passed on
+uint32_t interruptTimestamp(uint32_t pin);
+
+// deferred interrupts lost because the worker fell behind
+uint32_t interruptsDropped(void);
+
 #ifdef __cplusplus
 }
 #endif
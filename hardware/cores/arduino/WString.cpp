@@ -23,6 +23,9 @@
 #include "itoa.h"
 #include "arm/dtostrf.h"
 
+// heap used once a String outgrows its inline buffer, see setAllocator()
+static String::ReallocFunc string_realloc = realloc;
+static String::FreeFunc string_free = free;
 
 /*********************************************/
 /*  Constructors                             */
@@ -124,7 +127,7 @@ String::String(double value, unsigned char decimalPlaces)
 
 String::~String()
 {
-	free(buffer);
+	freeBuffer();
 }
 
 /*********************************************/
@@ -138,13 +141,24 @@ inline void String::init(void)
 	len = 0;
 }
 
+void String::freeBuffer(void)
+{
+	if (buffer && !isInline()) string_free(buffer);
+}
+
 void String::invalidate(void)
 {
-	if (buffer) free(buffer);
+	freeBuffer();
 	buffer = NULL;
 	capacity = len = 0;
 }
 
+void String::setAllocator(ReallocFunc reallocFunc, FreeFunc freeFunc)
+{
+	string_realloc = reallocFunc ? reallocFunc : realloc;
+	string_free = freeFunc ? freeFunc : free;
+}
+
 unsigned char String::reserve(unsigned int size)
 {
 	if (buffer && capacity >= size) return 1;
@@ -155,9 +169,30 @@ unsigned char String::reserve(unsigned int size)
 	return 0;
 }
 
+// like reserve(), but grows by half the current capacity at least, so a
+// string built up with repeated concat() is reallocated O(log n) times
+unsigned char String::grow(unsigned int size)
+{
+	if (buffer && capacity >= size) return 1;
+	unsigned int newCapacity = capacity + (capacity >> 1);
+	if (newCapacity > size && reserve(newCapacity)) return 1;
+	return reserve(size);
+}
+
 unsigned char String::changeBuffer(unsigned int maxStrLen)
 {
-	char *newbuffer = (char *)realloc(buffer, maxStrLen + 1);
+	if (!buffer && maxStrLen < STRING_INLINE_SIZE) {
+		buffer = inlineBuffer;
+		capacity = STRING_INLINE_SIZE - 1;
+		return 1;
+	}
+	char *newbuffer;
+	if (isInline()) {
+		newbuffer = (char *)string_realloc(NULL, maxStrLen + 1);
+		if (newbuffer) memcpy(newbuffer, inlineBuffer, len + 1);
+	} else {
+		newbuffer = (char *)string_realloc(buffer, maxStrLen + 1);
+	}
 	if (newbuffer) {
 		buffer = newbuffer;
 		capacity = maxStrLen;
@@ -195,22 +230,24 @@ String & String::copy(const __FlashStringHelper *pstr, unsigned int length)
 #if __cplusplus >= 201103L || defined(__GXX_EXPERIMENTAL_CXX0X__)
 void String::move(String &rhs)
 {
-	if (buffer) {
-		if (capacity >= rhs.len) {
-			strcpy(buffer, rhs.buffer);
+	if (rhs.buffer && (rhs.isInline() || (buffer && capacity >= rhs.len))) {
+		// inline contents can't be taken over, and copying into a buffer
+		// we already own is cheaper than freeing it
+		if (reserve(rhs.len)) {
+			memcpy(buffer, rhs.buffer, rhs.len + 1);
 			len = rhs.len;
-			rhs.len = 0;
-			return;
 		} else {
-			free(buffer);
+			invalidate();
 		}
+		rhs.len = 0;
+		rhs.buffer[0] = 0;
+		return;
 	}
+	freeBuffer();
 	buffer = rhs.buffer;
 	capacity = rhs.capacity;
 	len = rhs.len;
-	rhs.buffer = NULL;
-	rhs.capacity = 0;
-	rhs.len = 0;
+	rhs.init();
 }
 #endif
 
@@ -268,7 +305,7 @@ unsigned char String::concat(const char *cstr, unsigned int length)
 	unsigned int newlen = len + length;
 	if (!cstr) return 0;
 	if (length == 0) return 1;
-	if (!reserve(newlen)) return 0;
+	if (!grow(newlen)) return 0;
 	strcpy(buffer + len, cstr);
 	len = newlen;
 	return 1;
@@ -343,7 +380,7 @@ unsigned char String::concat(const __FlashStringHelper * str)
 	int length = strlen_P((const char *) str);
 	if (length == 0) return 1;
 	unsigned int newlen = len + length;
-	if (!reserve(newlen)) return 0;
+	if (!grow(newlen)) return 0;
 	strcpy_P(buffer + len, (const char *) str);
 	len = newlen;
 	return 1;
@@ -37,6 +37,13 @@
 class __FlashStringHelper;
 #define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(PSTR(string_literal)))
 
+// Strings up to STRING_INLINE_SIZE - 1 characters are kept inside the
+// String object itself and never touch the heap.  This makes every String
+// STRING_INLINE_SIZE bytes bigger: 28 bytes instead of 12 on the board.
+#ifndef STRING_INLINE_SIZE
+#define STRING_INLINE_SIZE 16
+#endif
+
 // An inherited class for holding the result of a concatenation.  These
 // result objects are assumed to be writable by subsequent concatenations.
 class StringSumHelper;
@@ -80,6 +87,13 @@ public:
 	unsigned char reserve(unsigned int size);
 	inline unsigned int length(void) const {return len;}
 
+	// route the heap storage of every String through another allocator,
+	// e.g. a dedicated arena.  must be called before any String has
+	// grown past the inline buffer; NULL restores realloc()/free().
+	typedef void * (*ReallocFunc)(void *ptr, size_t size);
+	typedef void (*FreeFunc)(void *ptr);
+	static void setAllocator(ReallocFunc reallocFunc, FreeFunc freeFunc);
+
 	// creates a copy of the assigned value.  if the value is null or
 	// invalid, or if the memory allocation fails, the string will be 
 	// marked as invalid ("if (s)" will be false).
@@ -191,10 +205,14 @@ protected:
 	char *buffer;	        // the actual char array
 	unsigned int capacity;  // the array length minus one (for the '\0')
 	unsigned int len;       // the String length (not counting the '\0')
+	char inlineBuffer[STRING_INLINE_SIZE]; // used instead of the heap for short strings
 protected:
 	void init(void);
 	void invalidate(void);
+	void freeBuffer(void);
+	inline bool isInline(void) const {return buffer == inlineBuffer;}
 	unsigned char changeBuffer(unsigned int maxStrLen);
+	unsigned char grow(unsigned int size);
 	unsigned char concat(const char *cstr, unsigned int length);
 
 	// copy and move
@@ -0,0 +1,613 @@
+/*
+  heap_caps.c - Heap over the BD_RAM, TCM and SDRAM regions
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Every region is a run of blocks, each with an 8 byte header holding
+ * its own size and the size of the block below it, so a freed block
+ * merges with both neighbours in constant time. Free blocks are kept in
+ * address order and the first one that fits is taken, which keeps the
+ * low end of a region packed and the large holes at the top.
+ *
+ * Built with HEAP_CAPS_HOST, no region is added by heap_caps_init() and
+ * a pthread mutex takes the place of masking interrupts; system/heapbench
+ * uses that to replay traces, and system/hostsim to run lwIP on the host.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "heap_caps.h"
+
+#ifdef HEAP_CAPS_HOST
+#include <pthread.h>
+#else
+#include "rtl8195a.h"
+#endif
+
+/* Replaces lwIP's ram_heap, which was the same size */
+#ifndef HEAP_BDRAM_SIZE
+#define HEAP_BDRAM_SIZE		(128*1024)
+#endif
+
+/* Give SDRAM to the heap when the boot code has enabled it */
+#ifndef HEAP_CAPS_SDRAM
+#define HEAP_CAPS_SDRAM		1
+#endif
+
+#define HEAP_ALIGN		8
+#define HEAP_HDR		8
+#define HEAP_MIN_BLOCK		((HEAP_HDR + 2 * sizeof(void *) + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1))
+#define HEAP_MAX_REQUEST	0x7fff0000
+#define HEAP_USED		1u
+
+typedef struct heap_block {
+	uint32_t size;			/* whole block, HEAP_USED in bit 0 */
+	uint32_t prev_size;		/* block just below, 0 for the first one */
+	struct heap_block *next;	/* free list, only in free blocks */
+	struct heap_block *prev;
+} heap_block_t;
+
+typedef struct {
+	const char *name;
+	uint32_t caps;
+	uint8_t *start;
+	uint8_t *end;
+	heap_block_t *free;		/* in address order */
+	uint32_t used;
+	uint32_t peak;
+	uint32_t allocs;
+	uint32_t frees;
+	uint32_t misses;
+} heap_region_t;
+
+static heap_region_t regions[HEAP_CAPS_MAX_REGIONS];
+static int region_count;
+static int initialized;
+static heap_caps_trace_fn trace_fn;
+
+#ifdef HEAP_CAPS_HOST
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define HEAP_LOCK()		pthread_mutex_lock(&heap_lock)
+#define HEAP_UNLOCK()		pthread_mutex_unlock(&heap_lock)
+#else
+#define HEAP_LOCK()		uint32_t primask = __get_PRIMASK(); __disable_irq()
+#define HEAP_UNLOCK()		__set_PRIMASK(primask)
+
+static uint8_t heap_bdram[HEAP_BDRAM_SIZE] __attribute__((aligned(HEAP_ALIGN)));
+
+/* see rlx8195A.ld */
+extern uint8_t __tcm_heap_start__[];
+extern uint8_t __tcm_heap_end__[];
+extern uint8_t __sdram_heap_start__[];
+extern uint8_t __sdram_heap_end__[];
+#endif
+
+#define BLOCK_SIZE(b)		((b)->size & ~HEAP_USED)
+#define BLOCK_AT(p, off)	((heap_block_t *)((uint8_t *)(p) + (off)))
+
+static heap_region_t *region_of(const void *ptr)
+{
+	int i;
+
+	for (i = 0; i < region_count; i++) {
+		if ((const uint8_t *)ptr >= regions[i].start && (const uint8_t *)ptr < regions[i].end) {
+			return &regions[i];
+		}
+	}
+	return NULL;
+}
+
+static void list_insert(heap_region_t *r, heap_block_t *b)
+{
+	heap_block_t *prev = NULL;
+	heap_block_t *next = r->free;
+
+	while (next && next < b) {
+		prev = next;
+		next = next->next;
+	}
+	b->prev = prev;
+	b->next = next;
+	if (prev) {
+		prev->next = b;
+	} else {
+		r->free = b;
+	}
+	if (next) {
+		next->prev = b;
+	}
+}
+
+static void list_remove(heap_region_t *r, heap_block_t *b)
+{
+	if (b->prev) {
+		b->prev->next = b->next;
+	} else {
+		r->free = b->next;
+	}
+	if (b->next) {
+		b->next->prev = b->prev;
+	}
+}
+
+/* Put b where old was in the list. b may overlap old's header. */
+static void list_replace(heap_region_t *r, heap_block_t *old, heap_block_t *b)
+{
+	heap_block_t *prev = old->prev;
+	heap_block_t *next = old->next;
+
+	b->prev = prev;
+	b->next = next;
+	if (prev) {
+		prev->next = b;
+	} else {
+		r->free = b;
+	}
+	if (next) {
+		next->prev = b;
+	}
+}
+
+/* Tell the block above b how large b is */
+static void link_next(heap_region_t *r, heap_block_t *b)
+{
+	heap_block_t *n = BLOCK_AT(b, BLOCK_SIZE(b));
+
+	if ((uint8_t *)n < r->end) {
+		n->prev_size = BLOCK_SIZE(b);
+	}
+}
+
+static uint32_t block_need(size_t size)
+{
+	uint32_t need;
+
+	if (size > HEAP_MAX_REQUEST) {
+		return 0;
+	}
+	need = (size + HEAP_HDR + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1);
+	return (need < HEAP_MIN_BLOCK) ? HEAP_MIN_BLOCK : need;
+}
+
+static void account_used(heap_region_t *r, int32_t delta)
+{
+	r->used += delta;
+	if (r->used > r->peak) {
+		r->peak = r->used;
+	}
+}
+
+/* Mark the free block b used, splitting off what is above need */
+static heap_block_t *block_take(heap_region_t *r, heap_block_t *b, uint32_t need)
+{
+	uint32_t size = b->size;
+
+	if (size - need >= HEAP_MIN_BLOCK) {
+		heap_block_t *rest = BLOCK_AT(b, need);
+
+		list_replace(r, b, rest);
+		rest->size = size - need;
+		rest->prev_size = need;
+		link_next(r, rest);
+		size = need;
+	} else {
+		list_remove(r, b);
+	}
+	b->size = size | HEAP_USED;
+	account_used(r, size);
+	r->allocs++;
+	return b;
+}
+
+/* Return b to the free list, merged with free neighbours. The caller
+ * has taken it out of r->used. */
+static void block_release(heap_region_t *r, heap_block_t *b)
+{
+	uint32_t size = BLOCK_SIZE(b);
+	heap_block_t *next = BLOCK_AT(b, size);
+	heap_block_t *prev = b->prev_size ? BLOCK_AT(b, -(int32_t)b->prev_size) : NULL;
+	int next_free = ((uint8_t *)next < r->end) && !(next->size & HEAP_USED);
+
+	b->size = size;
+	if (prev && !(prev->size & HEAP_USED)) {
+		prev->size += size;
+		b = prev;
+		if (next_free) {
+			list_remove(r, next);
+			b->size += next->size;
+		}
+	} else if (next_free) {
+		b->size += next->size;
+		list_replace(r, next, b);
+	} else {
+		list_insert(r, b);
+	}
+	link_next(r, b);
+}
+
+static int region_add(const char *name, void *start, size_t size, uint32_t caps)
+{
+	uintptr_t s = ((uintptr_t)start + HEAP_ALIGN - 1) & ~(uintptr_t)(HEAP_ALIGN - 1);
+	uintptr_t e = ((uintptr_t)start + size) & ~(uintptr_t)(HEAP_ALIGN - 1);
+	heap_region_t *r;
+	heap_block_t *b;
+
+	if (region_count == HEAP_CAPS_MAX_REGIONS || e <= s ||
+	    e - s < HEAP_MIN_BLOCK || e - s > HEAP_MAX_REQUEST) {
+		return -1;
+	}
+	r = &regions[region_count];
+	memset(r, 0, sizeof(*r));
+	r->name = name;
+	r->caps = caps;
+	r->start = (uint8_t *)s;
+	r->end = (uint8_t *)e;
+
+	b = (heap_block_t *)s;
+	b->size = e - s;
+	b->prev_size = 0;
+	b->next = NULL;
+	b->prev = NULL;
+	r->free = b;
+	return region_count++;
+}
+
+#if !defined(HEAP_CAPS_HOST) && HEAP_CAPS_SDRAM
+/* Only the RTL8195AM has SDRAM, and only if image1 turned it on */
+static int sdram_ready(void)
+{
+	volatile uint32_t *p = (volatile uint32_t *)__sdram_heap_start__;
+
+	if (!(HAL_READ32(PERI_ON_BASE, REG_SOC_FUNC_EN) & BIT_SOC_MEM_CTRL_EN)) {
+		return 0;
+	}
+	p[0] = 0x5AA5C33C;
+	p[1] = ~0x5AA5C33C;
+	return (p[0] == 0x5AA5C33C) && (p[1] == ~0x5AA5C33C);
+}
+#endif
+
+void heap_caps_init(void)
+{
+	HEAP_LOCK();
+	if (!initialized) {
+		initialized = 1;
+#ifndef HEAP_CAPS_HOST
+		region_add("BD_RAM", heap_bdram, sizeof(heap_bdram),
+			   MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+		region_add("TCM", __tcm_heap_start__, __tcm_heap_end__ - __tcm_heap_start__,
+			   MALLOC_CAP_INTERNAL | MALLOC_CAP_TCM);
+#if HEAP_CAPS_SDRAM
+		if (sdram_ready()) {
+			region_add("SDRAM", __sdram_heap_start__, __sdram_heap_end__ - __sdram_heap_start__,
+				   MALLOC_CAP_SDRAM);
+		}
+#endif
+#endif
+	}
+	HEAP_UNLOCK();
+}
+
+int heap_caps_add_region(const char *name, void *start, size_t size, uint32_t caps)
+{
+	int idx;
+
+	heap_caps_init();
+	HEAP_LOCK();
+	idx = region_add(name, start, size, caps);
+	HEAP_UNLOCK();
+	return idx;
+}
+
+/* Regions in the order a request tries them */
+static int region_order(size_t size, uint32_t caps, heap_region_t **order)
+{
+	int bulk = (caps == MALLOC_CAP_DEFAULT) && (size >= HEAP_CAPS_BULK_SIZE);
+	int n = 0;
+	int i;
+
+	if (bulk) {
+		for (i = 0; i < region_count; i++) {
+			if (regions[i].caps & MALLOC_CAP_SDRAM) {
+				order[n++] = &regions[i];
+			}
+		}
+	}
+	for (i = 0; i < region_count; i++) {
+		if ((regions[i].caps & caps) != caps) {
+			continue;
+		}
+		if (bulk && (regions[i].caps & MALLOC_CAP_SDRAM)) {
+			continue;
+		}
+		order[n++] = &regions[i];
+	}
+	return n;
+}
+
+static void *heap_alloc(size_t size, uint32_t caps)
+{
+	heap_region_t *order[HEAP_CAPS_MAX_REGIONS];
+	uint32_t need = block_need(size);
+	void *ptr = NULL;
+	int n;
+	int i;
+
+	if (!initialized) {
+		heap_caps_init();
+	}
+	if (need == 0) {
+		return NULL;
+	}
+
+	HEAP_LOCK();
+	n = region_order(size, caps, order);
+	for (i = 0; i < n && !ptr; i++) {
+		heap_block_t *b;
+
+		for (b = order[i]->free; b; b = b->next) {
+			if (b->size >= need) {
+				ptr = BLOCK_AT(block_take(order[i], b, need), HEAP_HDR);
+				break;
+			}
+		}
+		if (!ptr) {
+			order[i]->misses++;
+		}
+	}
+	HEAP_UNLOCK();
+	return ptr;
+}
+
+static void heap_free(heap_region_t *r, void *ptr)
+{
+	heap_block_t *b = BLOCK_AT(ptr, -HEAP_HDR);
+
+	HEAP_LOCK();
+	if (b->size & HEAP_USED) {
+		account_used(r, -(int32_t)BLOCK_SIZE(b));
+		r->frees++;
+		block_release(r, b);
+	}
+	HEAP_UNLOCK();
+}
+
+/* Resize in place, returns 0 if the block would have to move */
+static int heap_resize(heap_region_t *r, void *ptr, uint32_t need)
+{
+	heap_block_t *b = BLOCK_AT(ptr, -HEAP_HDR);
+	uint32_t cur;
+	int done = 1;
+
+	HEAP_LOCK();
+	cur = BLOCK_SIZE(b);
+	if (need <= cur) {
+		if (cur - need >= HEAP_MIN_BLOCK) {
+			heap_block_t *rest = BLOCK_AT(b, need);
+
+			b->size = need | HEAP_USED;
+			rest->size = cur - need;
+			rest->prev_size = need;
+			account_used(r, -(int32_t)(cur - need));
+			block_release(r, rest);
+		}
+	} else {
+		heap_block_t *next = BLOCK_AT(b, cur);
+
+		if ((uint8_t *)next < r->end && !(next->size & HEAP_USED) && cur + next->size >= need) {
+			uint32_t total = cur + next->size;
+
+			if (total - need >= HEAP_MIN_BLOCK) {
+				heap_block_t *rest = BLOCK_AT(b, need);
+
+				list_replace(r, next, rest);
+				rest->size = total - need;
+				rest->prev_size = need;
+				link_next(r, rest);
+				total = need;
+			} else {
+				list_remove(r, next);
+			}
+			b->size = total | HEAP_USED;
+			link_next(r, b);
+			account_used(r, total - cur);
+		} else {
+			done = 0;
+		}
+	}
+	HEAP_UNLOCK();
+	return done;
+}
+
+static void trace(char op, void *ptr, void *old, size_t size, uint32_t caps)
+{
+	heap_caps_trace_fn fn = trace_fn;
+
+	if (fn) {
+		fn(op, ptr, old, size, caps);
+	}
+}
+
+void *malloc_caps(size_t size, uint32_t caps)
+{
+	void *ptr = heap_alloc(size, caps);
+
+	trace('m', ptr, NULL, size, caps);
+	return ptr;
+}
+
+void *calloc_caps(size_t count, size_t size, uint32_t caps)
+{
+	void *ptr;
+
+	if (size && count > HEAP_MAX_REQUEST / size) {
+		return NULL;
+	}
+	ptr = malloc_caps(count * size, caps);
+	if (ptr) {
+		memset(ptr, 0, count * size);
+	}
+	return ptr;
+}
+
+void *realloc_caps(void *ptr, size_t size, uint32_t caps)
+{
+	heap_region_t *r;
+	uint32_t need;
+	void *moved;
+
+	if (ptr == NULL) {
+		return malloc_caps(size, caps);
+	}
+	r = region_of(ptr);
+	if (r == NULL) {
+		return realloc(ptr, size);
+	}
+	need = block_need(size);
+	if (need == 0) {
+		return NULL;
+	}
+
+	if (heap_resize(r, ptr, need)) {
+		trace('r', ptr, ptr, size, caps);
+		return ptr;
+	}
+	moved = heap_alloc(size, caps);
+	if (moved) {
+		memcpy(moved, ptr, BLOCK_SIZE(BLOCK_AT(ptr, -HEAP_HDR)) - HEAP_HDR);
+		heap_free(r, ptr);
+	}
+	trace('r', moved, ptr, size, caps);
+	return moved;
+}
+
+void free_caps(void *ptr)
+{
+	heap_region_t *r;
+
+	if (ptr == NULL) {
+		return;
+	}
+	r = region_of(ptr);
+	if (r == NULL) {
+		free(ptr);
+		return;
+	}
+	heap_free(r, ptr);
+	trace('f', NULL, ptr, 0, 0);
+}
+
+void *heap_caps_realloc(void *ptr, size_t size)
+{
+	return realloc_caps(ptr, size, MALLOC_CAP_DEFAULT);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+	size_t total = 0;
+	int i;
+
+	if (!initialized) {
+		heap_caps_init();
+	}
+	for (i = 0; i < region_count; i++) {
+		if ((regions[i].caps & caps) == caps) {
+			total += (regions[i].end - regions[i].start) - regions[i].used;
+		}
+	}
+	return total;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+	size_t largest = 0;
+	int i;
+
+	if (!initialized) {
+		heap_caps_init();
+	}
+	HEAP_LOCK();
+	for (i = 0; i < region_count; i++) {
+		heap_block_t *b;
+
+		if ((regions[i].caps & caps) != caps) {
+			continue;
+		}
+		for (b = regions[i].free; b; b = b->next) {
+			if (b->size - HEAP_HDR > largest) {
+				largest = b->size - HEAP_HDR;
+			}
+		}
+	}
+	HEAP_UNLOCK();
+	return largest;
+}
+
+int heap_caps_region_count(void)
+{
+	if (!initialized) {
+		heap_caps_init();
+	}
+	return region_count;
+}
+
+int heap_caps_get_stats(int region, heap_caps_stats_t *stats)
+{
+	heap_region_t *r;
+	heap_block_t *b;
+
+	if (region < 0 || region >= heap_caps_region_count()) {
+		return -1;
+	}
+	r = &regions[region];
+	memset(stats, 0, sizeof(*stats));
+
+	HEAP_LOCK();
+	stats->name = r->name;
+	stats->caps = r->caps;
+	stats->size = r->end - r->start;
+	stats->used = r->used;
+	stats->peak = r->peak;
+	stats->allocs = r->allocs;
+	stats->frees = r->frees;
+	stats->misses = r->misses;
+	for (b = r->free; b; b = b->next) {
+		stats->free_blocks++;
+		if (b->size - HEAP_HDR > stats->largest_free) {
+			stats->largest_free = b->size - HEAP_HDR;
+		}
+	}
+	HEAP_UNLOCK();
+	return 0;
+}
+
+void heap_caps_set_trace(heap_caps_trace_fn fn)
+{
+	trace_fn = fn;
+}
+
+#ifdef HEAP_CAPS_HOST
+/* Forget every region, for the next run of the host benchmark */
+void heap_caps_reset(void)
+{
+	region_count = 0;
+	initialized = 1;
+	trace_fn = NULL;
+}
+#endif
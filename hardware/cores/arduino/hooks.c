@@ -16,6 +16,8 @@
   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
+#include <stdint.h>
+
 /**
  * Empty yield() hook.
  *
@@ -42,6 +44,14 @@ static int __false() {
 }
 int sysTickHook(void) __attribute__ ((weak, alias("__false")));
 
+/**
+ * delay() hook
+ *
+ * Called by delay() before it blocks the thread. Returns non-zero if the
+ * wait was already spent running other cooperative loops.
+ */
+int delayHook(uint32_t ms) __attribute__ ((weak, alias("__false")));
+
 /**
  * SVC hook
  * PendSV hook
@@ -85,6 +85,7 @@ int main( void )
 	{
 		loop();
 		if (serialEventRun) serialEventRun();
+		yield();
         osThreadYield();
 	}
 
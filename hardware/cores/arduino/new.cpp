@@ -0,0 +1,62 @@
+/*
+  new.cpp - operator new and delete, optionally on the region heap
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdlib.h>
+
+#include "heap_caps.h"
+
+// malloc() until heap_caps_route_new() is called
+static volatile bool new_routed = false;
+static volatile uint32_t new_caps = MALLOC_CAP_DEFAULT;
+
+extern "C" void heap_caps_route_new(uint32_t caps)
+{
+	new_caps = caps;
+	new_routed = true;
+}
+
+extern "C" void heap_caps_unroute_new(void)
+{
+	new_routed = false;
+}
+
+static inline void *new_alloc(size_t size)
+{
+	return new_routed ? malloc_caps(size, new_caps) : malloc(size);
+}
+
+void *operator new(size_t size)
+{
+	return new_alloc(size);
+}
+
+void *operator new[](size_t size)
+{
+	return new_alloc(size);
+}
+
+// free_caps() hands blocks it does not own to free()
+void operator delete(void *ptr)
+{
+	free_caps(ptr);
+}
+
+void operator delete[](void *ptr)
+{
+	free_caps(ptr);
+}
@@ -28,11 +28,18 @@ extern "C" {
 #include "us_ticker_api.h"
 #include "section_config.h"
 
+extern int delayHook( uint32_t ms );
+
 IMAGE2_TEXT_SECTION
 void delay( uint32_t ms )
 {
 	osStatus ret;
 
+	// run other cooperative loops instead, see Scheduler1
+	if (delayHook(ms)) {
+		return;
+	}
+
 	//HalDelayUs(ms*1000);
 	ret = osDelay(ms);
 	if ( (ret != osEventTimeout) && (ret != osOK) ) {
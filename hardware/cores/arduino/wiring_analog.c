@@ -208,6 +208,49 @@ void analogWrite(uint32_t ulPin, uint32_t ulValue)
 
 }
 
+int analogWritePulse(uint32_t ulPin, uint32_t ulPeriodUs, uint32_t ulPulseUs)
+{
+	pwmout_t *pObj;
+	uint32_t peripheral;
+	uint32_t i;
+
+	if ( ulPin > 13 ) return 0;
+
+	if ( g_APinDescription[ulPin].ulPinType != PIO_PWM )
+	{
+		peripheral = pinmap_peripheral(g_APinDescription[ulPin].pinname, PinMap_PWM);
+		if ( peripheral == NC ) return 0;
+
+		// each PWM channel can be routed to one pin at a time
+		for ( i = 0; i <= 13; i++ ) {
+			if ( g_APinDescription[i].ulPinType == PIO_PWM && pwm_pins[i].pwm_idx == RTL_GET_PERI_IDX(peripheral) ) {
+				return 0;
+			}
+		}
+
+		pwmout_init(&pwm_pins[ulPin], g_APinDescription[ulPin].pinname);
+		g_APinDescription[ulPin].ulPinType = PIO_PWM;
+	}
+
+	pObj = &pwm_pins[ulPin];
+	pObj->period = ulPeriodUs;
+	pObj->pulse = ulPulseUs;
+	HAL_Pwm_SetDuty(pObj->pwm_idx, pObj->period, pObj->pulse);
+	return 1;
+}
+
+void analogWriteStop(uint32_t ulPin)
+{
+	if ( ulPin > 13 ) return;
+
+	if ( g_APinDescription[ulPin].ulPinType == PIO_PWM )
+	{
+		HAL_Pwm_Disable(pwm_pins[ulPin].pwm_idx);
+		pwm_pins[ulPin].period = 20000;
+		g_APinDescription[ulPin].ulPinType = NOT_INITIAL;
+	}
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -47,6 +47,24 @@ extern void analogReference( eAnalogReference ulMode ) ;
  */
 extern void analogWrite( uint32_t ulPin, uint32_t ulValue ) ;
 
+/*
+ * \brief Outputs pulses of a given width and period on a pin with hardware PWM, e.g. for servos.
+ *
+ * \param ulPin
+ * \param ulPeriodUs Period in microseconds
+ * \param ulPulseUs Pulse width in microseconds
+ *
+ * \return 1 on success, 0 if the pin has no PWM output or its PWM channel drives another pin.
+ */
+extern int analogWritePulse( uint32_t ulPin, uint32_t ulPeriodUs, uint32_t ulPulseUs ) ;
+
+/*
+ * \brief Stops the PWM output started by analogWrite() or analogWritePulse() on a pin.
+ *
+ * \param ulPin
+ */
+extern void analogWriteStop( uint32_t ulPin ) ;
+
 /*
  * \brief Reads the value from the specified analog pin.
  *
@@ -72,6 +72,8 @@ extern void digital_isr( uint32_t ulPin, void* handler, void* data, int mode);
 
 extern u8 gpio_get_pin_num(uint32_t ulPin);
 
+extern u8 gpio_get_port_num(uint32_t ulPin);
+
 extern void digital_change_dir( uint32_t ulPin, uint8_t direction);
 
 
@@ -26,6 +26,8 @@
 #ifndef WL_DEFINITIONS_H_
 #define WL_DEFINITIONS_H_
 
+#include <stdint.h>
+
 // Maximum size of a SSID
 #define WL_SSID_MAX_LENGTH 32
 // Length of passphrase. Valid lengths are 8-63.
@@ -72,5 +74,14 @@ enum wl_enc_type {  /* Values map to 802.11 encryption suites... */
         ENC_TYPE_AUTO = 8
 };
 
+/* Timing of the last WiFi.begin(), in ms */
+typedef struct {
+	uint32_t joinMs;	// scan, join and DHCP as far as the driver waits for it
+	uint32_t totalMs;	// until DHCP bound an address, 0 if it did not
+	uint8_t leaseOffered;	// the lease saved by an earlier begin() was asked for
+	uint8_t leaseResumed;	// and the DHCP server confirmed it
+	uint8_t sameAp;		// joined the same access point as last time
+} wl_connect_stats_t;
+
 
 #endif /* WL_DEFINITIONS_H_ */
@@ -5,25 +5,139 @@ written by Adafruit Industries
 */
 
 #include "DHT.h"
+#include "TimerEvent.h"
 
 #define MIN_INTERVAL 2000
 
+// Start pulse: DHT11 wants at least 18ms low, DHT21/DHT22 at least 1ms.
+#define START_US_DHT11 20000
+#define START_US_DHT22 1100
+
+// Longest frame: 160us of response, then 40 bits of at most 120us each.
+#define FRAME_US 6000
+
+// A bit is a 50us low pulse followed by 26-28us high for a 0 or 70us for
+// a 1, so the time from one falling edge to the next is ~77us or ~120us.
+#define BIT_SPLIT_US 100
+
+// One falling edge starts the response, one starts each bit and one ends
+// the last bit.
+#define FRAME_EDGES 42
+
+// Pins with edge interrupts: those on GPIO port A, the same check as
+// attachInterrupt(). The port is known once pinMode() has set the pin up.
+#define DHT_IRQ_PIN(p) (gpio_get_port_num(p) == GPIO_PORT_A)
+
 #ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
 
+#include "hal_gpio.h"
 #include "section_config.h"
 
 #ifdef __cplusplus
 }
 #endif // __cplusplus
 
-IMAGE2_DATA_SECTION
-static uint8_t data[5];
+/*
+ * Edge capture engine shared by every sensor. The start pulse is timed by
+ * the us ticker instead of delay(); then falling edges are timestamped by
+ * the GPIO interrupt into one buffer and decoded once the frame is over.
+ * Only one sensor is on the buffer at a time, the others wait in a queue.
+ */
+class DHTEngine : public TimerEvent
+{
+public:
+  void enqueue(DHT *sensor);
+
+protected:
+  virtual void handler();
+
+private:
+  void startNext(void);
+
+  DHT *_head;
+  DHT *_tail;
+  bool _capturing;
+};
+
+static DHTEngine engine;
+
+static volatile uint32_t edges[FRAME_EDGES];
+static volatile uint8_t edgeCount;
+
+static void dht_edge_irq(uint32_t id, gpio_irq_event event) {
+  if (edgeCount < FRAME_EDGES) {
+    edges[edgeCount++] = us_ticker_read();
+  }
+}
+
+void DHTEngine::enqueue(DHT *sensor) {
+  bool idle;
+
+  sensor->_next = NULL;
+  noInterrupts();
+  idle = (_head == NULL);
+  if (idle) {
+    _head = sensor;
+  } else {
+    _tail->_next = sensor;
+  }
+  _tail = sensor;
+  interrupts();
+
+  if (idle) {
+    startNext();
+  }
+}
+
+// Pull the line low for the start pulse of the sensor at the head
+void DHTEngine::startNext(void) {
+  DHT *sensor = _head;
+
+  _capturing = false;
+  digital_change_dir(sensor->_pin, OUTPUT);
+  digitalWrite(sensor->_pin, LOW);
+  insert(us_ticker_read() + (sensor->_type == DHT11 ? START_US_DHT11 : START_US_DHT22));
+}
+
+void DHTEngine::handler() {
+  DHT *sensor = _head;
+
+  if (!_capturing) {
+    // end of the start pulse: release the line, then listen. Releasing
+    // is a rising edge, and the sensor answers 20-40us later.
+    _capturing = true;
+    edgeCount = 0;
+    digital_change_dir(sensor->_pin, INPUT);
+    gpio_irq_set(&sensor->_irq, IRQ_FALL, 1);
+    gpio_irq_enable(&sensor->_irq);
+    insert(us_ticker_read() + FRAME_US);
+    return;
+  }
+
+  gpio_irq_disable(&sensor->_irq);
+  sensor->_lastresult = sensor->decode();
+  DHTCallback cb = sensor->_callback;
+
+  _head = sensor->_next;
+  sensor->_busy = false;
+  if (_head != NULL) {
+    startNext();
+  }
+
+  if (cb) {
+    cb(sensor, sensor->_lastresult);
+  }
+}
 
 DHT::DHT(uint8_t pin, uint8_t type, uint8_t count) {
   _pin = pin;
   _type = type;
+  _hasIrq = false;
+  _busy = false;
+  _callback = NULL;
+  _next = NULL;
   #ifdef __AVR
     _bit = digitalPinToBitMask(pin);
     _port = digitalPinToPort(pin);
@@ -35,8 +149,13 @@ DHT::DHT(uint8_t pin, uint8_t type, uint8_t count) {
 }
 
 void DHT::begin(void) {
-  // set up the pins!
-  pinMode(_pin, OUTPUT);
+  // set up the pins! The line idles high, held by the pull-up.
+  pinMode(_pin, INPUT);
+  if (DHT_IRQ_PIN(_pin) &&
+      gpio_irq_init(&_irq, (PinName)g_APinDescription[_pin].pinname, dht_edge_irq, (uint32_t)this) == 0) {
+    gpio_irq_disable(&_irq);
+    _hasIrq = true;
+  }
   // Using this value makes sure that millis() - lastreadtime will be
   // >= MIN_INTERVAL right away. Note that this assignment wraps around,
   // but so will the subtraction.
@@ -46,9 +165,14 @@ void DHT::begin(void) {
 
 //boolean S == Scale.  True == Fahrenheit; False == Celcius
 float DHT::readTemperature(bool S, bool force) {
+  read(force);
+  return getTemperature(S);
+}
+
+float DHT::getTemperature(bool S) {
   float f = NAN;
 
-  if (read(force)) {
+  if (_lastresult) {
     switch (_type) {
     case DHT11:
       f = data[2];
@@ -83,8 +207,13 @@ float DHT::convertFtoC(float f) {
 }
 
 float DHT::readHumidity(bool force) {
+  read(force);
+  return getHumidity();
+}
+
+float DHT::getHumidity(void) {
   float f = NAN;
-  if (read()) {
+  if (_lastresult) {
     switch (_type) {
     case DHT11:
       f = data[0];
@@ -137,29 +266,93 @@ float DHT::computeHeatIndex(float temperature, float percentHumidity, bool isFah
 IMAGE2_DATA_SECTION
 static uint32_t cycles[80];
 
-IMAGE2_TEXT_SECTION
 boolean DHT::read(bool force) {
   // Check if sensor was read less than two seconds ago and return early
   // to use last reading.
   uint32_t currenttime = millis();
-  if (!force && ((currenttime - _lastreadtime) < 2000)) {
+  if (!force && ((currenttime - _lastreadtime) < MIN_INTERVAL)) {
     return _lastresult; // return last correct measurement
   }
+
+  if (!_hasIrq) {
+    _lastreadtime = currenttime;
+    _lastresult = readPolling();
+    return _lastresult;
+  }
+
+  // Sleep through the start pulse and the frame; delay() lets the other
+  // threads run. The wait also covers sensors queued ahead of this one.
+  readAsync(NULL, true);
+  while (_busy) {
+    delay(1);
+  }
+  return _lastresult;
+}
+
+bool DHT::readAsync(DHTCallback cb, bool force) {
+  uint32_t currenttime = millis();
+  if (!force && ((currenttime - _lastreadtime) < MIN_INTERVAL)) {
+    if (cb) {
+      cb(this, _lastresult);
+    }
+    return true;
+  }
+
+  if (!_hasIrq) {
+    _lastreadtime = currenttime;
+    _lastresult = readPolling();
+    if (cb) {
+      cb(this, _lastresult);
+    }
+    return true;
+  }
+
+  if (_busy) {
+    return false;
+  }
   _lastreadtime = currenttime;
+  _callback = cb;
+  _busy = true;
+  engine.enqueue(this);
+  return true;
+}
 
+// Turn the captured falling edges into the 40 data bits
+bool DHT::decode(void) {
+  data[0] = data[1] = data[2] = data[3] = data[4] = 0;
+
+  if (edgeCount < FRAME_EDGES) {
+    DEBUG_PRINTLN(F("Timeout waiting for pulse."));
+    return false;
+  }
+
+  for (int i = 0; i < 40; ++i) {
+    data[i/8] <<= 1;
+    if (edges[i+2] - edges[i+1] > BIT_SPLIT_US) {
+      data[i/8] |= 1;
+    }
+  }
+
+  if (data[4] != ((data[0] + data[1] + data[2] + data[3]) & 0xFF)) {
+    DEBUG_PRINTLN(F("Checksum failure!"));
+    return false;
+  }
+  return true;
+}
+
+// Bit-banged read for pins without edge interrupts. Interrupts are off for
+// the ~5ms of the frame.
+IMAGE2_TEXT_SECTION
+boolean DHT::readPolling(void) {
   // Reset 40 bits of received data to zero.
   data[0] = data[1] = data[2] = data[3] = data[4] = 0;
 
   // Send start signal.  See DHT datasheet for full signal diagram:
   //   http://www.adafruit.com/datasheets/Digital%20humidity%20and%20temperature%20sensor%20AM2302.pdf
 
-  // Go into high impedence state to let pull-up raise data line level and
-  // start the reading process.
-  pinMode(_pin, OUTPUT);
-  digitalWrite(_pin, HIGH);
-  delay(250);
-
+  // The line is already high, held by the pull-up since begin().
   // First set data line low for 20 milliseconds.
+  pinMode(_pin, OUTPUT);
   digitalWrite(_pin, LOW);
   delay(20);
 
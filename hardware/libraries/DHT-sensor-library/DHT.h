@@ -12,6 +12,11 @@ written by Adafruit Industries
  #include "WProgram.h"
 #endif
 
+extern "C" {
+#include "objects.h"
+#include "gpio_irq_api.h"
+}
+
 
 // Uncomment to enable printing out nice debug messages.
 //#define DHT_DEBUG
@@ -34,6 +39,16 @@ written by Adafruit Industries
 #define DHT21 21
 #define AM2301 21
 
+class DHT;
+
+// Called when a readAsync() completes, with ok set if the frame was valid.
+// It runs in the TimerEvent handler, which is the us ticker interrupt:
+// read the values with getTemperature() and getHumidity(), and hand them
+// to a thread with a signal or a message rather than printing them or
+// calling delay(). When readAsync() has nothing to wait for, it calls cb
+// itself, in the caller's thread.
+typedef void (*DHTCallback)(DHT *sensor, bool ok);
+
 
 class DHT {
   public:
@@ -46,13 +61,37 @@ class DHT {
    float readHumidity(bool force=false);
    boolean read(bool force=false);
 
+   // Start a reading and return at once; cb is called when it is done,
+   // from the us ticker interrupt (see DHTCallback).
+   // The start pulse and the frame are timed by interrupts, so the CPU
+   // is free meanwhile. Sensors are read one after another, in the order
+   // readAsync() was called. Returns false if this sensor is still busy.
+   // A pin without edge interrupts falls back to a blocking read().
+   bool readAsync(DHTCallback cb, bool force=false);
+   bool busy(void) { return _busy; }
+
+   // Values of the last reading, without starting a new one
+   float getTemperature(bool S=false);
+   float getHumidity(void);
+
  private:  
-  //uint8_t data[5];
+  uint8_t data[5];
   uint8_t _pin, _type;
   uint32_t _lastreadtime, _maxcycles;
   bool _lastresult;
 
+  // edge capture state, see DHT.cpp
+  bool _hasIrq;
+  volatile bool _busy;
+  DHTCallback _callback;
+  DHT *_next;
+  gpio_irq_t _irq;
+
   uint32_t expectPulse(bool level);
+  boolean readPolling(void);
+  bool decode(void);
+
+  friend class DHTEngine;
 
 };
 
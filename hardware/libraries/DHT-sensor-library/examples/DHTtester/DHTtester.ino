@@ -34,7 +34,8 @@ void loop() {
   // Wait a few seconds between measurements.
   delay(2000);
 
-  // Reading temperature or humidity takes about 250 milliseconds!
+  // Reading temperature or humidity takes about 25 milliseconds, during which
+  // other threads run. See readAsync() to not wait at all.
   // Sensor readings may also be up to 2 seconds 'old' (its a very slow sensor)
   float h = dht.readHumidity();
   // Read temperature as Celsius (the default)
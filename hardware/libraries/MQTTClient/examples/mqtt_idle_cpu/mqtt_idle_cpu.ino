@@ -0,0 +1,113 @@
+/*
+ MQTT idle CPU example
+
+ This sketch shows how much CPU an idle MQTT client leaves to the rest of
+ the board. A thread at osPriorityIdle counts as fast as it can, so it only
+ counts while every other thread sleeps. Before connecting, the sketch
+ counts for one second while loop() sleeps in delay(): that is 100% idle.
+ Then it prints the idle share every 10 seconds.
+
+ With WAIT_FOR set to 0, loop() calls client.loop() back to back, and each
+ call asks the tcpip thread whether data arrived: the idle share is close
+ to 0%. With WAIT_FOR set to 1, client.loop(1000) sleeps on the socket
+ until a message arrives, a second passes or a keepalive is due, and the
+ idle share is close to 100%.
+*/
+
+#include <WiFi.h>
+#include <PubSubClient.h>
+
+#define WAIT_FOR  1
+
+// Update these with values suitable for your network.
+
+char ssid[] = "yourNetwork";     // your network SSID (name)
+char pass[] = "secretPassword";  // your network password
+int status  = WL_IDLE_STATUS;    // the Wifi radio's status
+
+char mqttServer[]     = "iot.eclipse.org";
+char clientId[]       = "AnyClientID";
+char subscribeTopic[] = "TopicYouWant";
+
+volatile uint32_t idleCount = 0;
+uint32_t idlePerSecond;
+
+void idleCounter(void const *argument) {
+  while (true) {
+    idleCount++;
+  }
+}
+
+Thread idleThread(idleCounter, NULL, osPriorityIdle, 512);
+
+void callback(char* topic, byte* payload, unsigned int length) {
+  Serial.print("Message arrived [");
+  Serial.print(topic);
+  Serial.println("]");
+}
+
+WiFiClient wifiClient;
+PubSubClient client(wifiClient);
+
+void reconnect() {
+  // Loop until we're reconnected
+  while (!client.connected()) {
+    Serial.print("Attempting MQTT connection...");
+    if (client.connect(clientId)) {
+      Serial.println("connected");
+      client.subscribe(subscribeTopic);
+    } else {
+      Serial.print("failed, rc=");
+      Serial.print(client.state());
+      Serial.println(" try again in 5 seconds");
+      delay(5000);
+    }
+  }
+}
+
+void setup()
+{
+  Serial.begin(38400);
+
+  idleThread.start();
+  uint32_t start = idleCount;
+  delay(1000);
+  idlePerSecond = idleCount - start;
+
+  while (status != WL_CONNECTED) {
+    Serial.print("Attempting to connect to SSID: ");
+    Serial.println(ssid);
+    status = WiFi.begin(ssid, pass);
+
+    // wait 10 seconds for connection:
+    delay(10000);
+  }
+
+  client.setServer(mqttServer, 1883);
+  client.setCallback(callback);
+}
+
+void loop()
+{
+  static uint32_t lastReport = millis();
+  static uint32_t lastCount = idleCount;
+
+  if (!client.connected()) {
+    reconnect();
+  }
+#if WAIT_FOR
+  client.loop(1000);
+#else
+  client.loop();
+#endif
+
+  uint32_t elapsed = millis() - lastReport;
+  if (elapsed >= 10000) {
+    uint32_t count = idleCount - lastCount;
+    Serial.print("idle ");
+    Serial.print((uint32_t)(100ULL * count * 1000 / elapsed / idlePerSecond));
+    Serial.println("%");
+    lastReport = millis();
+    lastCount = idleCount;
+  }
+}
@@ -182,6 +182,12 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
                     _client->stop();
                     return false;
                 }
+                int ready = _client->waitFor(SOCKET_READABLE, MQTT_SOCKET_TIMEOUT*1000UL - (t-lastInActivity));
+                if (ready > 0 && (ready & SOCKET_CLOSED) && !_client->available()) {
+                    _state = MQTT_CONNECTION_LOST;
+                    _client->stop();
+                    return false;
+                }
             }
             uint8_t llen;
             uint16_t len = readPacket(&llen);
@@ -213,6 +219,11 @@ boolean PubSubClient::readByte(uint8_t * result) {
      if(currentMillis - previousMillis >= ((int32_t) MQTT_SOCKET_TIMEOUT * 1000)){
        return false;
      }
+     // Sleep until data arrives instead of polling
+     int ready = _client->waitFor(SOCKET_READABLE, MQTT_SOCKET_TIMEOUT * 1000 - (currentMillis - previousMillis));
+     if (ready > 0 && (ready & SOCKET_CLOSED) && !_client->available()) {
+       return false;
+     }
    }
    *result = _client->read();
    return true;
@@ -279,6 +290,16 @@ uint16_t PubSubClient::readPacket(uint8_t* lengthLength) {
     return len;
 }
 
+boolean PubSubClient::loop(unsigned long timeout) {
+    if (connected() && !_client->available()) {
+        unsigned long t = millis();
+        unsigned long idle = max(t - lastInActivity, t - lastOutActivity);
+        unsigned long due = (idle < MQTT_KEEPALIVE*1000UL) ? MQTT_KEEPALIVE*1000UL - idle : 0;
+        _client->waitFor(SOCKET_READABLE, min(timeout, due + 1));
+    }
+    return loop();
+}
+
 boolean PubSubClient::loop() {
     if (connected()) {
         unsigned long t = millis();
@@ -123,6 +123,9 @@ public:
    boolean subscribe(const char* topic, uint8_t qos);
    boolean unsubscribe(const char* topic);
    boolean loop();
+   // Sleeps up to timeout ms, or until the next keepalive is due, for data
+   // from the server, then does what loop() does
+   boolean loop(unsigned long timeout);
    boolean connected();
    int state();
 };
@@ -115,6 +115,7 @@ sample code bearing this copyright.
 */
 
 #include "OneWire.h"
+#include "OneWireUART.h"
 
 #ifdef __cplusplus
  extern "C" {
@@ -289,6 +290,7 @@ OneWire::OneWire(uint8_t pin1)
 
 	DiagPrintf("OneWire : pin = %d \r\n", pin1);
 	this->pin = pin1;
+	this->uart = NULL;
 	
 	pinMode(this->pin, INPUT_PULLUP);
 
@@ -304,6 +306,16 @@ OneWire::OneWire(uint8_t pin1)
 #endif
 }
 
+OneWire::OneWire(uint8_t txPin, uint8_t rxPin)
+{
+	this->pin = txPin;
+	this->uart = new OneWireUART(txPin, rxPin);
+
+#if ONEWIRE_SEARCH
+	reset_search();
+#endif
+}
+
 
 // Perform the onewire reset function.  We will wait up to 250uS for
 // the bus to come high, if it doesn't then it is broken or shorted
@@ -316,6 +328,10 @@ uint8_t OneWire::reset(void)
 	uint8_t r;
 	uint32_t retries = 125;
 
+	if (uart) {
+		return uart->reset();
+	}
+
 	noInterrupts();	
 	pinMode(this->pin, INPUT);
 	interrupts();
@@ -352,6 +368,10 @@ uint8_t OneWire::reset(void)
 IMAGE2_TEXT_SECTION
 void OneWire::write_bit(uint8_t v)
 {
+	if (uart) {
+		uart->write_bit(v);
+		return;
+	}
 
 	if (v & 1) {
 		noInterrupts();
@@ -380,6 +400,10 @@ uint8_t OneWire::read_bit(void)
 {
 	uint8_t r;
 
+	if (uart) {
+		return uart->read_bit();
+	}
+
 	noInterrupts();
 	digital_change_dir(this->pin,OUTPUT); // 8 us
 	direct_write(0);
@@ -401,6 +425,12 @@ IMAGE2_TEXT_SECTION
 void OneWire::write(uint8_t v, uint8_t power) {
     uint8_t bitMask;
 
+    if (uart) {
+		// the UART idles high, so 'power' has nothing to do
+		uart->write(v);
+		return;
+    }
+
     for (bitMask = 0x01; bitMask; bitMask <<= 1) {
 		OneWire::write_bit( (bitMask & v)?1:0);
     }
@@ -412,6 +442,10 @@ void OneWire::write(uint8_t v, uint8_t power) {
 }
 
 void OneWire::write_bytes(const uint8_t *buf, uint16_t count, bool power) {
+  if (uart) {
+    uart->write_bytes(buf, count);
+    return;
+  }
   for (uint16_t i = 0 ; i < count ; i++)
     write(buf[i]);
   if (!power) {
@@ -428,6 +462,10 @@ uint8_t OneWire::read() {
     uint8_t bitMask;
     uint8_t r = 0;
 
+    if (uart) {
+	return uart->read();
+    }
+
     for (bitMask = 0x01; bitMask; bitMask <<= 1) {
 	if ( OneWire::read_bit()) r |= bitMask;
     }
@@ -435,6 +473,10 @@ uint8_t OneWire::read() {
 }
 
 void OneWire::read_bytes(uint8_t *buf, uint16_t count) {
+  if (uart) {
+    uart->read_bytes(buf, count);
+    return;
+  }
   for (uint16_t i = 0 ; i < count ; i++)
     buf[i] = read();
 }
@@ -459,6 +501,29 @@ void OneWire::skip()
     write(0xCC);           // Skip ROM
 }
 
+//
+// Start a command on every device of the bus
+//
+uint8_t OneWire::broadcast(uint8_t command, uint8_t power)
+{
+    if (!reset()) return 0;
+    skip();
+    write(command, power);
+    return 1;
+}
+
+//
+// Send a command to one device and read its answer
+//
+uint8_t OneWire::read_from(const uint8_t rom[8], uint8_t command, uint8_t *buf, uint16_t count)
+{
+    if (!reset()) return 0;
+    select(rom);
+    write(command);
+    read_bytes(buf, count);
+    return 1;
+}
+
 //
 // You need to use this function to start a search again from the beginning.
 // You do not need to do it for the first search, though you could.
@@ -624,6 +689,26 @@ uint8_t OneWire::search(uint8_t *newAddr)
    return search_result;
 }
 
+//
+// Enumerate the whole bus. The search is restarted, so this must not be
+// mixed with a search() in progress.
+//
+uint8_t OneWire::search_all(uint8_t (*roms)[8], uint8_t max)
+{
+   uint8_t found = 0;
+
+   reset_search();
+   while (found < max && search(roms[found]))
+   {
+#if ONEWIRE_CRC
+      if (crc8(roms[found], 7) != roms[found][7])
+         continue;
+#endif
+      found++;
+   }
+   return found;
+}
+
 
 #if ONEWIRE_CRC
 // The 1-Wire CRC scheme is described in Maxim Application Note 27:
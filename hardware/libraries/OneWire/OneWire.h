@@ -52,6 +52,8 @@
 
 
 
+class OneWireUART;
+
 class OneWire
 {
   private:
@@ -70,9 +72,16 @@ class OneWire
 	uint8_t direct_read();
 	uint8_t direct_write(uint8_t pin_state);
 
+	// set when the bus is driven by a UART, see OneWireUART.h
+	OneWireUART *uart;
+
   public:
 	  OneWire( uint8_t pin);
 
+    // Drive the bus with the UART on txPin/rxPin instead of bit-banging
+    // a GPIO, which keeps interrupts enabled during every slot.
+    OneWire(uint8_t txPin, uint8_t rxPin);
+
     // Perform a 1-Wire reset cycle. Returns 1 if a device responds
     // with a presence pulse.  Returns 0 if there is no device or the
     // bus is shorted or otherwise held low for more than 250uS
@@ -84,6 +93,16 @@ class OneWire
     // Issue a 1-Wire rom skip command, to address all on bus.
     void skip(void);
 
+    // Reset, skip ROM and send a command to every device at once, e.g.
+    // 0x44 to start all DS18x20 conversions together. Returns the
+    // presence result of the reset.
+    uint8_t broadcast(uint8_t command, uint8_t power = 0);
+
+    // Reset, select one device, send a command and read count bytes,
+    // e.g. 0xBE reads a DS18x20 scratchpad. Returns the presence result
+    // of the reset.
+    uint8_t read_from(const uint8_t rom[8], uint8_t command, uint8_t *buf, uint16_t count);
+
     // Write a byte. If 'power' is one then the wire is held high at
     // the end for parasitically powered devices. You are responsible
     // for eventually depowering it by calling depower() or doing
@@ -120,6 +139,10 @@ class OneWire
     // get garbage.  The order is deterministic. You will always get
     // the same devices in the same order.
     uint8_t search(uint8_t *newAddr);
+
+    // Run a whole search from the beginning, storing up to max ROMs
+    // whose CRC is valid. Returns the number of ROMs stored.
+    uint8_t search_all(uint8_t (*roms)[8], uint8_t max);
 #endif
 
 #if ONEWIRE_CRC
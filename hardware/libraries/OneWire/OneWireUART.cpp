@@ -0,0 +1,177 @@
+#include "Arduino.h"
+#include "OneWireUART.h"
+
+#define OW_RESET_BAUD	9600
+#define OW_SLOT_BAUD	115200
+
+#define OW_RESET_SLOT	0xF0
+#define OW_WRITE1_SLOT	0xFF	// also a read slot
+#define OW_WRITE0_SLOT	0x00
+
+// Longest wait for the echoes of one transfer, in ms. A byte takes 1ms at
+// 9600 baud and 87us at 115200.
+#define OW_ECHO_TIMEOUT	5
+
+// Keeps rx_irq() off the receive state while a transfer sets it up or
+// gives it up
+#define OW_IRQ_LOCK()		uint32_t primask = __get_PRIMASK(); __disable_irq()
+#define OW_IRQ_UNLOCK()		__set_PRIMASK(primask)
+
+extern "C" {
+
+static void onewire_uart_irq(uint32_t id, SerialIrq event)
+{
+	if (event == RxIrq) {
+		((OneWireUART *)id)->rx_irq();
+	}
+}
+
+} // extern C
+
+OneWireUART::OneWireUART(uint8_t txPin, uint8_t rxPin)
+{
+	rx_buf = NULL;
+	rx_count = 0;
+	rx_expected = 0;
+
+	sem_def.semaphore = sem_data;
+	sem = osSemaphoreCreate(&sem_def, 0);
+
+	serial_init(&sobj, (PinName)g_APinDescription[txPin].pinname, (PinName)g_APinDescription[rxPin].pinname);
+	baud = OW_SLOT_BAUD;
+	serial_baud(&sobj, baud);
+	serial_format(&sobj, 8, ParityNone, 1);
+
+	serial_irq_handler(&sobj, onewire_uart_irq, (uint32_t)this);
+	serial_irq_set(&sobj, RxIrq, 1);
+}
+
+void OneWireUART::rx_irq(void)
+{
+	while (serial_readable(&sobj)) {
+		uint8_t c = serial_getc(&sobj);
+		if (rx_count < rx_expected) {
+			rx_buf[rx_count++] = c;
+			if (rx_count == rx_expected) {
+				osSemaphoreRelease(sem);
+			}
+		}
+	}
+}
+
+uint8_t OneWireUART::transfer(const uint8_t *tx, uint8_t *rx, uint8_t count, uint32_t new_baud)
+{
+	uint8_t i;
+
+	// the line is idle here: the previous transfer waited for its echoes
+	if (baud != new_baud) {
+		baud = new_baud;
+		serial_baud(&sobj, baud);
+	}
+
+	// drop a token left by echoes that came in after a timeout
+	while (osSemaphoreWait(sem, 0) > 0);
+
+	OW_IRQ_LOCK();
+	// and echoes of that transfer still in the UART
+	while (serial_readable(&sobj)) {
+		serial_getc(&sobj);
+	}
+	rx_buf = rx;
+	rx_count = 0;
+	rx_expected = count;
+	OW_IRQ_UNLOCK();
+
+	for (i = 0; i < count; i++) {
+		serial_putc(&sobj, tx[i]);
+	}
+
+	if (osSemaphoreWait(sem, OW_ECHO_TIMEOUT) <= 0) {
+		// rx is gone once this returns: the echoes still to come must
+		// not be stored in it
+		OW_IRQ_LOCK();
+		rx_buf = NULL;
+		rx_expected = 0;
+		OW_IRQ_UNLOCK();
+		return 0;
+	}
+	return 1;
+}
+
+uint8_t OneWireUART::reset(void)
+{
+	uint8_t tx = OW_RESET_SLOT;
+	uint8_t rx;
+
+	if (!transfer(&tx, &rx, 1, OW_RESET_BAUD)) {
+		return 0;
+	}
+	// 0x00 means the bus is shorted, not that a device is present
+	return (rx != OW_RESET_SLOT && rx != 0x00);
+}
+
+void OneWireUART::write_bit(uint8_t v)
+{
+	uint8_t tx = (v & 1) ? OW_WRITE1_SLOT : OW_WRITE0_SLOT;
+	uint8_t rx;
+
+	transfer(&tx, &rx, 1, OW_SLOT_BAUD);
+}
+
+uint8_t OneWireUART::read_bit(void)
+{
+	uint8_t tx = OW_WRITE1_SLOT;
+	uint8_t rx = 0;
+
+	transfer(&tx, &rx, 1, OW_SLOT_BAUD);
+	return (rx == OW_WRITE1_SLOT);
+}
+
+//
+// A byte is eight slots sent back to back, least significant bit first.
+// A read is the same as writing 0xFF.
+//
+uint8_t OneWireUART::read(void)
+{
+	uint8_t slots[8];
+	uint8_t r = 0;
+	uint8_t i;
+
+	for (i = 0; i < 8; i++) {
+		slots[i] = OW_WRITE1_SLOT;
+	}
+	if (!transfer(slots, slots, 8, OW_SLOT_BAUD)) {
+		return 0xFF;
+	}
+	for (i = 0; i < 8; i++) {
+		if (slots[i] == OW_WRITE1_SLOT) {
+			r |= 1 << i;
+		}
+	}
+	return r;
+}
+
+void OneWireUART::write(uint8_t v)
+{
+	uint8_t slots[8];
+	uint8_t i;
+
+	for (i = 0; i < 8; i++) {
+		slots[i] = (v & (1 << i)) ? OW_WRITE1_SLOT : OW_WRITE0_SLOT;
+	}
+	transfer(slots, slots, 8, OW_SLOT_BAUD);
+}
+
+void OneWireUART::write_bytes(const uint8_t *buf, uint16_t count)
+{
+	for (uint16_t i = 0; i < count; i++) {
+		write(buf[i]);
+	}
+}
+
+void OneWireUART::read_bytes(uint8_t *buf, uint16_t count)
+{
+	for (uint16_t i = 0; i < count; i++) {
+		buf[i] = read();
+	}
+}
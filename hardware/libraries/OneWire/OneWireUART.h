@@ -0,0 +1,59 @@
+#ifndef OneWireUART_h
+#define OneWireUART_h
+
+#include <inttypes.h>
+
+extern "C" {
+#include "serial_api.h"
+#include "cmsis_os.h"
+}
+
+// 1-Wire slots generated by a UART instead of bit-banging a GPIO.
+//
+// TX drives the bus through an open drain buffer (or a diode, cathode to
+// TX) and RX reads it back, with the usual pull-up on the bus. Every slot
+// is one UART byte, and the byte read back tells what the bus did:
+//
+//   reset:       0xF0 at 9600 baud, a 520us low pulse. Any other echo
+//                means a device answered with a presence pulse.
+//   write 1/read: 0xFF at 115200 baud, only the start bit is low (8.7us).
+//                The echo is 0xFF unless a device held the bus low.
+//   write 0:     0x00 at 115200 baud, low for 78us.
+//
+// Timing is kept by the UART, so interrupts stay enabled. The calling
+// thread sleeps on a semaphore while the slots are on the wire and the
+// RX interrupt collects the echoes.
+class OneWireUART
+{
+  public:
+    OneWireUART(uint8_t txPin, uint8_t rxPin);
+
+    // Same meaning as the OneWire functions of the same name
+    uint8_t reset(void);
+    void write_bit(uint8_t v);
+    uint8_t read_bit(void);
+    void write(uint8_t v);
+    uint8_t read(void);
+    void write_bytes(const uint8_t *buf, uint16_t count);
+    void read_bytes(uint8_t *buf, uint16_t count);
+
+    void rx_irq(void);
+
+  private:
+    // Send count slot bytes and wait for their echoes. Returns 0 if the
+    // echoes did not come back, e.g. when RX is not wired to the bus.
+    uint8_t transfer(const uint8_t *tx, uint8_t *rx, uint8_t count, uint32_t baud);
+
+    serial_t sobj;
+    uint32_t baud;
+
+    uint8_t *rx_buf;
+    volatile uint8_t rx_count;
+    uint8_t rx_expected;
+
+    osSemaphoreId sem;
+    osSemaphoreDef_t sem_def;
+    uint32_t sem_data[2];
+};
+
+#endif
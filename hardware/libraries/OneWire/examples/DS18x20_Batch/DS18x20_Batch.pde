@@ -0,0 +1,58 @@
+#include <OneWire.h>
+
+// Read every DS18S20, DS18B20 or DS1822 on a bus driven by a UART.
+//
+// All sensors convert at the same time, so a round takes one conversion
+// time however many sensors there are. The slots are timed by the UART,
+// so interrupts stay enabled and Serial and WiFi keep working meanwhile.
+//
+// Wiring: UART TX (pin 12) drives the bus through a diode, cathode to TX,
+// UART RX (pin 10) is tied to the bus, and the bus has a 4.7K pull-up.
+
+#define MAX_SENSORS 8
+
+OneWire  ds(12, 10);  // UART TX, UART RX
+
+byte roms[MAX_SENSORS][8];
+byte count;
+
+void setup(void) {
+  Serial.begin(9600);
+  count = ds.search_all(roms, MAX_SENSORS);
+  Serial.print("Found ");
+  Serial.print(count);
+  Serial.println(" sensors");
+}
+
+void loop(void) {
+  byte data[9];
+
+  if (!ds.broadcast(0x44)) {  // start all conversions
+    Serial.println("No sensors");
+    delay(1000);
+    return;
+  }
+  delay(750);                 // 12 bit conversion time
+
+  for (byte s = 0; s < count; s++) {
+    if (!ds.read_from(roms[s], 0xBE, data, 9) || OneWire::crc8(data, 8) != data[8]) {
+      Serial.println("Read error");
+      continue;
+    }
+
+    int16_t raw = (data[1] << 8) | data[0];
+    if (roms[s][0] == 0x10) {
+      // DS18S20: 9 bit resolution, extended with COUNT_REMAIN
+      raw = raw << 3;
+      if (data[7] == 0x10) {
+        raw = (raw & 0xFFF0) + 12 - data[6];
+      }
+    }
+
+    Serial.print("Sensor ");
+    Serial.print(s);
+    Serial.print(": ");
+    Serial.print((float)raw / 16.0);
+    Serial.println(" Celsius");
+  }
+}
@@ -20,86 +20,118 @@
 #include <Arduino.h>
 #include <Servo.h>
 
-#include "rt_os_service.h"
+#include "TimerEvent.h"
 
 
 static servo_t servos[MAX_SERVOS];                          // static array of servo structures
 
 uint8_t ServoCount = 0;                                     // the total number of attached servos
 
-static volatile int8_t Channel[_Nbr_16timers ];             // counter for the servo being pulsed for each timer (or -1 if refresh interval)
-
 // convenience macros
-#define SERVO_INDEX_TO_TIMER(_servo_nbr) ((timer16_Sequence_t)(_servo_nbr / SERVOS_PER_TIMER)) // returns the timer controlling this servo
-#define SERVO_INDEX_TO_CHANNEL(_servo_nbr) (_servo_nbr % SERVOS_PER_TIMER)       // returns the index of the servo on this timer
-#define SERVO_INDEX(_timer,_channel)  ((_timer*SERVOS_PER_TIMER) + _channel)     // macro to access servo index by timer and channel
-#define SERVO(_timer,_channel)  (servos[SERVO_INDEX(_timer,_channel)])            // macro to access servo class by timer and channel
-
-
 #define SERVO_MIN() (MIN_PULSE_WIDTH - this->min * 4)  // minimum value in uS for this servo
 #define SERVO_MAX() (MAX_PULSE_WIDTH - this->max * 4)  // maximum value in uS for this servo
 
+// an edge due this soon is waited for in the interrupt instead of rescheduled
+#define SERVO_EDGE_SPIN_US     10
+
 /************ static functions common to all instances ***********************/
 
-static uint8_t isThreadCreated = false;
+/*
+ * Sorted-edge engine for servos without a PWM channel. At the start of
+ * each frame all channels are raised, shortest pulse first, and the
+ * timer is set for the first falling edge; every interrupt then lowers
+ * all channels that are due. Each frame is due a period after the one
+ * before was due, so interrupt latency delays an edge but never
+ * accumulates. system/hostsim/servotest.cpp simulates it.
+ */
+class ServoEdgeTimer : public TimerEvent
+{
+public:
+  void start(timestamp_t timestamp) { insert(timestamp); }
 
-static const int delta_time = 28;
-static osThreadDef_t g_servo_task;
+protected:
+  virtual void handler();
+};
 
-//NeoJou
-static uint8_t timer_id;
+static ServoEdgeTimer edgeTimer;
+static volatile bool edgeTimerRunning = false;
 
+// snapshot of the current frame, sorted by pulse width
+static uint8_t edgePin[MAX_SERVOS];
+static timestamp_t edgeTime[MAX_SERVOS];
+static uint8_t edgeCount = 0;
+static uint8_t edgeNext = 0;
+static timestamp_t frameStart;                              // when the frame was due, not when it began
 
-void Servo_Handler(void)
+static void startFrame(void)
 {
-	static uint32_t last_time;
-	uint32_t cur_time;
-	uint32_t diff_time;
-
-    timer16_Sequence_t timer = _timer1;
-		
-	rtw_cancel_timer(timer_id);
-	
-    if (Channel[timer] < 0) {
-        // channel set to -1 indicated that refresh interval completed so reset the timer
-        last_time = us_ticker_read();
-    } else {
-        if (SERVO_INDEX(timer,Channel[timer]) < ServoCount && SERVO(timer,Channel[timer]).Pin.isActive == true) {
-            digitalWrite(SERVO(timer,Channel[timer]).Pin.nbr, LOW); // pulse this channel low if activated
-        }
+  unsigned int width[MAX_SERVOS];
+  uint8_t i, j;
+
+  edgeCount = 0;
+  for (i = 0; i < ServoCount; i++) {
+    if (servos[i].Pin.isActive == true && servos[i].Pin.isPwm == false) {
+      unsigned int us = servos[i].us;
+      for (j = edgeCount; j > 0 && width[j - 1] > us; j--) {
+        width[j] = width[j - 1];
+        edgePin[j] = edgePin[j - 1];
+      }
+      width[j] = us;
+      edgePin[j] = servos[i].Pin.nbr;
+      edgeCount++;
     }
+  }
+
+  for (i = 0; i < edgeCount; i++) {
+    // time each rise, so pins raised later are also lowered later
+    edgeTime[i] = us_ticker_read() + width[i];
+    digitalWrite(edgePin[i], HIGH);
+  }
+  edgeNext = 0;
+}
 
-    Channel[timer]++;    // increment to the next channel
-    if( SERVO_INDEX(timer,Channel[timer]) < ServoCount && Channel[timer] < SERVOS_PER_TIMER) {
-		rtw_set_timer(timer_id, SERVO(timer,Channel[timer]).us);
-        if(SERVO(timer,Channel[timer]).Pin.isActive == true) {    // check if activated
-            digitalWrite( SERVO(timer,Channel[timer]).Pin.nbr,HIGH); // its an active channel so pulse it high
-        }
+void ServoEdgeTimer::handler(void)
+{
+  if (edgeNext >= edgeCount) {
+    startFrame();
+    if (edgeCount == 0) {
+      edgeTimerRunning = false;   // nothing left to pulse
+      return;
     }
-    else {
-		cur_time = us_ticker_read();
-		diff_time = ( cur_time >= last_time )? (cur_time-last_time) : (0xFFFFFFFF-last_time+cur_time);
-		if ( diff_time >= REFRESH_INTERVAL) diff_time = REFRESH_INTERVAL-40; 
-		else if ( diff_time < 40 ) diff_time = 40;
-		
-        rtw_set_timer(timer_id, REFRESH_INTERVAL - diff_time);
-        Channel[timer] = -1; // this will get incremented at the end of the refresh period to start again at the first channel
+  }
+
+  while (edgeNext < edgeCount) {
+    int32_t left = (int32_t)(edgeTime[edgeNext] - us_ticker_read());
+    if (left > SERVO_EDGE_SPIN_US) {
+      insert(edgeTime[edgeNext]);
+      return;
     }
-}
+    if (left > 0) {                 // one already due costs no more reads
+      while ((int32_t)(edgeTime[edgeNext] - us_ticker_read()) > 0)
+        ;
+    }
+    digitalWrite(edgePin[edgeNext], LOW);
+    edgeNext++;
+  }
 
+  // the next frame is due a period after this one was, however late this
+  // one began; after a stall it starts afresh rather than in the past
+  frameStart += REFRESH_INTERVAL;
+  if ((int32_t)(frameStart - us_ticker_read()) < SERVO_EDGE_SPIN_US)
+    frameStart = us_ticker_read() + SERVO_EDGE_SPIN_US;
+  insert(frameStart);
+}
 
-static boolean isTimerActive(timer16_Sequence_t timer)
+static void startEdgeTimer(void)
 {
-  // returns true if any servo is active on this timer
-  for(uint8_t channel=0; channel < SERVOS_PER_TIMER; channel++) {
-    if(SERVO(timer,channel).Pin.isActive == true)
-      return true;
+  if (edgeTimerRunning == false) {
+    edgeTimerRunning = true;
+    edgeNext = edgeCount = 0;
+    frameStart = us_ticker_read() + 1000;
+    edgeTimer.start(frameStart);              // start at 1ms later
   }
-  return false;
 }
 
-
-
 /****************** end of static functions ******************************/
 
 Servo::Servo()
@@ -121,30 +153,36 @@ uint8_t Servo::attach(int pin)
 
 uint8_t Servo::attach(int pin, int min, int max)
 {
-  timer16_Sequence_t timer;
-
   if (this->servoIndex < MAX_SERVOS) {
-    pinMode(pin, OUTPUT);                                   // set servo pin to output
     servos[this->servoIndex].Pin.nbr = pin;
     // todo min/max check: abs(min - MIN_PULSE_WIDTH) /4 < 128
     this->min  = (MIN_PULSE_WIDTH - min)/4; //resolution of min/max is 4 uS
     this->max  = (MAX_PULSE_WIDTH - max)/4;
-	
-    // initialize the timer if it has not already been initialized
-    timer = SERVO_INDEX_TO_TIMER(servoIndex);
-    if (isTimerActive(timer) == false) {
-      rtw_init_timer(&timer_id, (void*)Servo_Handler, NULL, "Servo_Timer");
-	  rtw_set_timer(timer_id, 1000); // start at 1ms later 
+
+    // prefer a hardware PWM channel, fall back to the shared timer
+    if (analogWritePulse(pin, REFRESH_INTERVAL, servos[this->servoIndex].us)) {
+      servos[this->servoIndex].Pin.isPwm = true;
+      servos[this->servoIndex].Pin.isActive = true;
+    } else {
+      pinMode(pin, OUTPUT);                                 // set servo pin to output
+      servos[this->servoIndex].Pin.isPwm = false;
+      servos[this->servoIndex].Pin.isActive = true;         // must be set before the timer looks for channels
+      startEdgeTimer();
     }
-    servos[this->servoIndex].Pin.isActive = true;  // this must be set after the check for isTimerActive
   }
   return this->servoIndex;
 }
 
 void Servo::detach()
 {
-	rtw_cancel_timer(timer_id);
-    servos[this->servoIndex].Pin.isActive = false;
+  if (this->servoIndex >= MAX_SERVOS)
+    return;
+
+  servos[this->servoIndex].Pin.isActive = false;          // the timer stops on its own once no channel is left
+  if (servos[this->servoIndex].Pin.isPwm == true) {
+    analogWriteStop(servos[this->servoIndex].Pin.nbr);
+    servos[this->servoIndex].Pin.isPwm = false;
+  }
 }
 
 void Servo::write(int value)
@@ -174,6 +212,8 @@ void Servo::writeMicroseconds(int value)
       value = SERVO_MAX();
 
     servos[channel].us = value;
+    if (servos[channel].Pin.isActive == true && servos[channel].Pin.isPwm == true)
+      analogWritePulse(servos[channel].Pin.nbr, REFRESH_INTERVAL, value);
   }
 }
 
@@ -23,11 +23,11 @@
   The servos are pulsed in the background using the value most recently 
   written using the write() method.
 
-  Note that analogWrite of PWM on pins associated with the timer are 
-  disabled when the first servo is attached.
-  Timers are seized as needed in groups of 12 servos - 24 servos use two 
-  timers, 48 servos will use four.
-  The sequence used to sieze timers is defined in timers.h
+  Servos on pins with a free hardware PWM channel are pulsed by that
+  channel and cost no CPU time. All other servos share one hardware
+  timer: every frame raises their pins together and lowers each one from
+  the timer interrupt when its width has elapsed, shortest first.
+  Up to 12 servos can be attached.
 
   The methods are:
 
@@ -67,6 +67,7 @@
 typedef struct  {
   uint8_t nbr        :6 ;             // a pin number from 0 to 63
   uint8_t isActive   :1 ;             // true if this channel is enabled, pin not pulsed if false 
+  uint8_t isPwm      :1 ;             // true if pulsed by a hardware PWM channel instead of the timer
 } ServoPin_t   ;  
 
 typedef struct {
@@ -0,0 +1,72 @@
+/*
+  Delta update over WiFi
+
+  Every upload leaves ram_all.delta in the build folder, next to
+  ram_all.bin: the 4KB flash sectors that changed since the previous
+  upload. This sketch takes such a delta on TCP port 5000, writes the
+  changed sectors to flash and restarts into the new image:
+
+    nc -q 1 <board ip> 5000 < ram_all.delta
+
+  The delta is only accepted if the board still runs the image it was
+  made against; otherwise nothing is written and the full ram_all.bin
+  has to go through the DAP drive. The new image has to include this
+  sketch again, or the next delta can not be received.
+*/
+
+#include <WiFi.h>
+#include "FlashDelta.h"
+
+char ssid[] = "yourNetwork";      //  your network SSID (name)
+char pass[] = "secretPassword";   // your network password
+
+int status = WL_IDLE_STATUS;
+WiFiServer server(5000);
+
+void setup() {
+  Serial.begin(9600);
+
+  // attempt to connect to Wifi network:
+  while ( status != WL_CONNECTED) {
+    Serial.print("Attempting to connect to Network named: ");
+    Serial.println(ssid);
+
+    status = WiFi.begin(ssid, pass);
+    // wait 10 seconds for connection:
+    delay(10000);
+  }
+  server.begin();
+
+  Serial.print("Send ram_all.delta to ");
+  Serial.print(WiFi.localIP());
+  Serial.println(" port 5000");
+}
+
+uint8_t buffer[1024];
+
+void loop() {
+  WiFiClient client = server.available();
+
+  Serial.println("Receiving delta");
+  flashDelta.begin();
+  while (true) {
+    int n = client.read(buffer, sizeof(buffer));
+    if (n <= 0) break;
+
+    if (flashDelta.write(buffer, n) != (size_t)n) break;
+  }
+  client.stop();
+
+  if (flashDelta.end()) {
+    Serial.print("Sectors written: ");
+    Serial.print(flashDelta.sectorsWritten());
+    Serial.print(", unchanged: ");
+    Serial.println(flashDelta.sectorsSkipped());
+    Serial.println("Restarting");
+    delay(100);
+    NVIC_SystemReset();
+  }
+
+  Serial.print("Delta refused, error ");
+  Serial.println(flashDelta.error());
+}
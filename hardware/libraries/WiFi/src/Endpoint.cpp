@@ -42,15 +42,19 @@ int Endpoint::set_address(const char* host, const int port) {
     reset_address();
     
     // IP Address
-    char address[5];
+    unsigned int octets[4];
+    char address[4];
     char *p_address = address;
     
-    // Dot-decimal notation
+    // Dot-decimal notation: %u stores a whole unsigned int, so not
+    // straight into address[]
     int result = std::sscanf(host, "%3u.%3u.%3u.%3u",
-        (unsigned int*)&address[0], (unsigned int*)&address[1],
-        (unsigned int*)&address[2], (unsigned int*)&address[3]);
+        &octets[0], &octets[1], &octets[2], &octets[3]);
     
-    if (result != 4) {
+    if (result == 4) {
+        for (int i = 0; i < 4; i++)
+            address[i] = (char)octets[i];
+    } else {
         // Resolve address with DNS
         struct hostent *host_address = lwip_gethostbyname(host);
         if (host_address == NULL)
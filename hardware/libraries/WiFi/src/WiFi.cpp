@@ -25,6 +25,11 @@
 #include "wifi_drv.h"
 #include "wiring.h"
 
+#include "lwip/stats.h"
+#include "lwip/memp.h"
+#include "lwip/netstats.h"
+#include "heap_caps.h"
+
 
 int16_t 	WiFiClass::_state[MAX_SOCK_NUM] = { NA_STATE, NA_STATE, NA_STATE, NA_STATE };
 
@@ -50,8 +55,7 @@ char* WiFiClass::firmwareVersion()
 
 int WiFiClass::begin(char* ssid)
 {
-	WiFiClass::init();
-	this->begin(ssid, NULL);
+	return this->begin(ssid, NULL);
 }
 
 int WiFiClass::begin(char* ssid, const char *passphrase)
@@ -66,6 +70,8 @@ int WiFiClass::begin(char* ssid, const char *passphrase)
 		ret =  wiFiDrv.wifiSetPassphrase(ssid, strlen(ssid), passphrase, strlen(passphrase));
 	
 	if ( ret == WL_SUCCESS ) {
+		// Names cached on a previous network may not be valid here
+		wiFiResolver.flush();
 		ret = this->status();
 	}
 	return ret;
@@ -73,6 +79,16 @@ int WiFiClass::begin(char* ssid, const char *passphrase)
 
 }
 
+void WiFiClass::forgetNetwork()
+{
+	wiFiDrv.forgetNetwork();
+}
+
+const wl_connect_stats_t& WiFiClass::connectStats()
+{
+	return wiFiDrv.getConnectStats();
+}
+
 int WiFiClass::disconnect()
 {
     return wiFiDrv.disconnect();
@@ -166,7 +182,179 @@ uint8_t WiFiClass::status()
 
 int WiFiClass::hostByName(const char* aHostname, IPAddress& aResult)
 {
-	return wiFiDrv.getHostByName(aHostname, aResult);
+	return wiFiResolver.hostByName(aHostname, aResult);
+}
+
+int WiFiClass::resolveAsync(const char* aHostname, WiFiResolveCallback aCallback, void* aArg)
+{
+	return wiFiResolver.resolveAsync(aHostname, aCallback, aArg);
+}
+
+#if LWIP_STATS
+static void printProto(Print& aPrint, const char* aName, struct stats_proto* aProto)
+{
+	aPrint.print(aName);
+	aPrint.print(": xmit=");
+	aPrint.print(aProto->xmit);
+	aPrint.print(" recv=");
+	aPrint.print(aProto->recv);
+	aPrint.print(" drop=");
+	aPrint.print(aProto->drop);
+	aPrint.print(" chkerr=");
+	aPrint.print(aProto->chkerr);
+	aPrint.print(" memerr=");
+	aPrint.print(aProto->memerr);
+	aPrint.print(" err=");
+	aPrint.println(aProto->err + aProto->lenerr + aProto->proterr + aProto->opterr + aProto->rterr);
+}
+
+static void printMem(Print& aPrint, const char* aName, struct stats_mem* aMem)
+{
+	aPrint.print(aName);
+	aPrint.print(": used=");
+	aPrint.print(aMem->used);
+	aPrint.print("/");
+	aPrint.print(aMem->avail);
+	aPrint.print(" max=");
+	aPrint.print(aMem->max);
+	aPrint.print(" err=");
+	aPrint.println(aMem->err);
+}
+#endif
+
+void WiFiClass::netStats(Print& aPrint)
+{
+#if LWIP_STATS
+#if LINK_STATS
+	printProto(aPrint, "LINK", &lwip_stats.link);
+#endif
+#if ETHARP_STATS
+	printProto(aPrint, "ARP", &lwip_stats.etharp);
+#endif
+#if IP_STATS
+	printProto(aPrint, "IP", &lwip_stats.ip);
+#endif
+#if ICMP_STATS
+	printProto(aPrint, "ICMP", &lwip_stats.icmp);
+#endif
+#if UDP_STATS
+	printProto(aPrint, "UDP", &lwip_stats.udp);
+#endif
+#if TCP_STATS
+	printProto(aPrint, "TCP", &lwip_stats.tcp);
+#endif
+#if MEM_STATS
+	printMem(aPrint, "HEAP", &lwip_stats.mem);
+#endif
+#if MEMP_STATS
+	static const char* const memp_names[] = {
+#define LWIP_MEMPOOL(name,num,size,desc) desc,
+#include "lwip/memp_std.h"
+	};
+	for (int i = 0; i < MEMP_MAX; i++)
+		printMem(aPrint, memp_names[i], &lwip_stats.memp[i]);
+#endif
+#endif
+
+	const wl_connect_stats_t& conn = wiFiDrv.getConnectStats();
+	aPrint.print("Connect: join=");
+	aPrint.print(conn.joinMs);
+	aPrint.print("ms bound=");
+	aPrint.print(conn.totalMs);
+	aPrint.print("ms lease=");
+	aPrint.print(conn.leaseResumed ? "resumed" : (conn.leaseOffered ? "refused" : "new"));
+	aPrint.print(" ap=");
+	aPrint.println(conn.sameAp ? "same" : "new");
+
+#if NETSTATS
+	aPrint.print("TCPIP mbox: posted=");
+	aPrint.print(netstats.tcpip.posted);
+	aPrint.print(" max_depth=");
+	aPrint.print(netstats.tcpip.max_depth);
+	aPrint.print("/");
+	aPrint.print(TCPIP_MBOX_SIZE);
+	aPrint.print(" full=");
+	aPrint.println(netstats.tcpip.full);
+	aPrint.print("TCP rexmit: rto=");
+	aPrint.print(netstats.tcp.rexmit_rto);
+	aPrint.print(" fast=");
+	aPrint.println(netstats.tcp.rexmit_fast);
+	aPrint.print("TCP ooseq: rcvd=");
+	aPrint.print(netstats.tcp.ooseq_rcvd);
+	aPrint.print(" dropped=");
+	aPrint.print(netstats.tcp.ooseq_dropped);
+	aPrint.print(" evicted=");
+	aPrint.println(netstats.tcp.ooseq_evicted);
+	aPrint.print("DHCP: discover=");
+	aPrint.print(netstats.dhcp.discover);
+	aPrint.print(" reboot=");
+	aPrint.print(netstats.dhcp.reboot);
+	aPrint.print(" reboot_acked=");
+	aPrint.print(netstats.dhcp.reboot_acked);
+	aPrint.print(" nak=");
+	aPrint.println(netstats.dhcp.nak);
+#if LWIP_TCPIP_CORE_LOCKING
+	aPrint.print("Core lock: taken=");
+	aPrint.print(netstats.core.locks);
+	aPrint.print(" contended=");
+	aPrint.print(netstats.core.contended);
+	aPrint.print(" wait_us=");
+	aPrint.print(netstats.core.wait_us);
+	aPrint.print(" max_wait_us=");
+	aPrint.println(netstats.core.max_wait_us);
+#endif
+
+	for (int s = 0; s < MEMP_NUM_NETCONN; s++) {
+		struct netstats_socket sock;
+
+		if (netstats_socket_get(s, &sock) != 0)
+			continue;
+		aPrint.print("socket ");
+		aPrint.print(s);
+		aPrint.print(": state=");
+		aPrint.print(sock.state);
+		aPrint.print(" srtt=");
+		aPrint.print(sock.srtt);
+		aPrint.print("ms rttvar=");
+		aPrint.print(sock.rttvar);
+		aPrint.print("ms rto=");
+		aPrint.print(sock.rto);
+		aPrint.print("ms rexmit=");
+		aPrint.print(sock.rexmit);
+		aPrint.print(" cwnd=");
+		aPrint.print(sock.cwnd);
+		aPrint.print(" snd_wnd=");
+		aPrint.print(sock.snd_wnd);
+		aPrint.print(" rcv_wnd=");
+		aPrint.print(sock.rcv_wnd);
+		aPrint.print('/');
+		aPrint.print(sock.rcv_wnd_max);
+		aPrint.print(" snd_buf=");
+		aPrint.print(sock.snd_buf);
+		aPrint.print('/');
+		aPrint.println(sock.snd_buf_max);
+	}
+#endif
+
+	for (int r = 0; r < heap_caps_region_count(); r++) {
+		heap_caps_stats_t heap;
+
+		heap_caps_get_stats(r, &heap);
+		aPrint.print("Heap ");
+		aPrint.print(heap.name);
+		aPrint.print(": used=");
+		aPrint.print(heap.used);
+		aPrint.print('/');
+		aPrint.print(heap.size);
+		aPrint.print(" peak=");
+		aPrint.print(heap.peak);
+		aPrint.print(" largest_free=");
+		aPrint.print(heap.largest_free);
+		aPrint.print(" free_blocks=");
+		aPrint.print(heap.free_blocks);
+		aPrint.print(" misses=");
+		aPrint.println(heap.misses);
+	}
 }
 
 WiFiClass WiFi;
@@ -29,6 +29,7 @@ extern "C" {
 #include "IPAddress.h"
 #include "WiFiClient.h"
 #include "WiFiServer.h"
+#include "wifi_resolver.h"
 
 
 class WiFiClass
@@ -64,6 +65,24 @@ public:
      */
 	int begin(char* ssid, const char *passphrase);
 
+	/*
+	 * begin() saves the network it joined and the DHCP lease in flash, and
+	 * on the next call with the same SSID asks the server to confirm that
+	 * lease (DHCP INIT-REBOOT) instead of negotiating a new one. Falls
+	 * back to a full DHCP exchange if the server refuses or stays silent.
+	 * Asking for the saved lease needs lwIP rebuilt with
+	 * LWIP_DHCP_REBOOT_HINT; the prebuilt lwIP always negotiates.
+	 *
+	 * Forget the saved network, e.g. after the DHCP server was replaced.
+	 */
+	void forgetNetwork(void);
+
+	/*
+	 * Timing of the last begin(): time to join, time until an address was
+	 * bound, and whether the saved lease was offered and confirmed.
+	 */
+	const wl_connect_stats_t& connectStats(void);
+
 	  /*
 	   * Disconnect from the network
 	   *
@@ -173,13 +192,36 @@ public:
 
 	/*
 	 * Resolve the given hostname to an IP address.
+	 * Only blocks when the name is not in the DNS cache.
 	 * param aHostname: Name to be resolved
 	 * param aResult: IPAddress structure to store the returned IP address
 	 * result: 1 if aIPAddrString was successfully converted to an IP address,
-	 *			else error code
+	 *			else 0
 	 */
 	int hostByName(const char* aHostname, IPAddress& aResult);
 
+	/*
+	 * Resolve the given hostname without blocking.
+	 * Names are cached for their DNS TTL (failures for a short while), and
+	 * names in use are refreshed in the background before they expire.
+	 * param aHostname: Name to be resolved
+	 * param aCallback: Called with the result, see WiFiResolveCallback
+	 * param aArg: Passed through to aCallback
+	 * result: 1 if answered from the cache, 0 if the lookup is in progress,
+	 *			-1 on failure
+	 */
+	int resolveAsync(const char* aHostname, WiFiResolveCallback aCallback, void* aArg = NULL);
+
+	/*
+	 * Print the lwIP counters: per-protocol traffic and errors, heap and
+	 * pool usage with high-water marks, tcpip mailbox depth, core lock
+	 * contention, out of order segments kept and dropped, DHCP exchanges
+	 * and the timing of the last begin(), and the RTT and retransmissions
+	 * of each open TCP socket.
+	 * param aPrint: Where to print, e.g. Serial
+	 */
+	void netStats(Print& aPrint);
+
     friend class WiFiClient;
     friend class WiFiServer;
 };
@@ -20,13 +20,18 @@
 #include "WiFi.h"
 #include "WiFiClient.h"
 
+#if (SOCKET_READABLE != LWIP_WAIT_READ) || (SOCKET_WRITABLE != LWIP_WAIT_WRITE) || \
+    (SOCKET_CLOSED != LWIP_WAIT_CLOSED)
+#error waitFor() passes its events to lwip_waitfor() as they are
+#endif
 
 
-WiFiClient::WiFiClient()  : _sock(MAX_SOCK_NUM){
+
+WiFiClient::WiFiClient()  : _sock(MAX_SOCK_NUM), _noDelay(false){
 	_pTcpSocket = new TCPSocketConnection();
 }
 
-WiFiClient::WiFiClient(TCPSocketConnection* s)  
+WiFiClient::WiFiClient(TCPSocketConnection* s)  : _noDelay(false)
 {	
 	_pTcpSocket = s;
 	_sock = _pTcpSocket->get_socket_fd();
@@ -67,8 +72,8 @@ int WiFiClient::connect(IPAddress ip, uint16_t port)
 
 		_sock = _pTcpSocket->get_socket_fd();
 		WiFiClass::_state[_sock] = _sock;
-	
-		
+		if (_noDelay)
+			setNoDelay(true);
     }
 	else{
     
@@ -142,6 +147,33 @@ uint8_t WiFiClient::connected() {
   }
 }
 
+// Sleeps in lwip_waitfor() until the connection has one of the events: no
+// polling, and no socket call until then. Returns -1 if another thread
+// already waits on this connection.
+int WiFiClient::waitFor(int events, uint32_t timeout) {
+  int ret;
+
+  if (_sock == 255)
+    return SOCKET_CLOSED;
+
+  ret = _pTcpSocket->wait_for(events, timeout);
+  if (ret < 0 && !_pTcpSocket->is_connected())
+    return SOCKET_CLOSED;
+  return ret;
+}
+
+// Turns Nagle's algorithm off, or on again: with it off, each write goes
+// out at once instead of waiting for the ACK of the data before it. Kept
+// for the connections that connect() makes later. Returns 0 on success.
+int WiFiClient::setNoDelay(bool noDelay) {
+  int on = noDelay ? 1 : 0;
+
+  _noDelay = noDelay;
+  if (_sock == 255 || !_pTcpSocket->is_connected())
+    return 0;
+  return _pTcpSocket->set_option(IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
 WiFiClient::operator bool() {
   if ( _sock == 255 ) return false;
   return _pTcpSocket->is_connected();
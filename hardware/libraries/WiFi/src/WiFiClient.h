@@ -27,6 +27,8 @@ public:
   virtual void stop();
   virtual uint8_t connected();
   virtual operator bool();
+  virtual int waitFor(int events, uint32_t timeout);
+  int setNoDelay(bool noDelay);
 
   char* get_address(void);
 
@@ -39,6 +41,7 @@ private:
 	//char _readchar;
 	//bool _readchar_set;
 	uint8_t _sock;	 
+	bool _noDelay;
 
 	uint8_t getFirstSocket();
 
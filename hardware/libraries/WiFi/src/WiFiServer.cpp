@@ -45,6 +45,13 @@ WiFiClient WiFiServer::available(byte* status)
 
 
 
+int WiFiServer::waitFor(int events, uint32_t timeout)
+{
+	int ret = this->_server.wait_for(events, timeout);
+
+	return (ret < 0 && this->_server.get_socket_fd() < 0) ? SOCKET_CLOSED : ret;
+}
+
 size_t WiFiServer::write(uint8_t b)
 {
     return write(&b, 1);
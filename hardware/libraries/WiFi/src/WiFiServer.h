@@ -35,6 +35,8 @@ public:
   WiFiServer(uint16_t);
   WiFiClient available(uint8_t* status = NULL);
   void begin();
+  // Wait up to timeout ms for a connection to accept (SOCKET_READABLE)
+  int waitFor(int events, uint32_t timeout);
   virtual size_t write(uint8_t);
   virtual size_t write(const uint8_t *buf, size_t size);
 
@@ -46,7 +46,7 @@ uint8_t WiFiUDP::begin(uint16_t port) {
 	int ret;
 
 	if ( _sock < 0 ) {
-		_pUdpSocket->init();
+		_pUdpSocket->bind(port);
 		_sock = _pUdpSocket->get_socket_fd();
 		_pUdpSocket->set_blocking(false, 5000); // 5 sec. timeout 
 	}
@@ -108,8 +108,9 @@ int WiFiUDP::beginPacket(IPAddress ip, uint16_t port)
     if ( _sock >= 0 )
     {
     	_pEndPoint->set_address(ip.get_address(), port);
+    	return 1;
     }	
-		
+	return 0;
 }
 
 int WiFiUDP::endPacket()
@@ -131,6 +132,13 @@ size_t WiFiUDP::write(const uint8_t *buffer, size_t size)
 }
 
 
+int WiFiUDP::waitFor(int events, uint32_t timeout)
+{
+	if ( _sock < 0 ) return SOCKET_CLOSED;
+
+	return _pUdpSocket->wait_for(events, timeout);
+}
+
 int WiFiUDP::parsePacket()
 {
     return available();
@@ -22,7 +22,7 @@
 
 #include <Udp.h>
 // NeoJou : for mbed
-#include "UdpSocket.h"
+#include "UDPSocket.h"
 #include "Endpoint.h"
 
 #define UDP_TX_PACKET_MAX_SIZE 24
@@ -76,6 +76,9 @@ public:
   // Return the next byte from the current packet without moving on to the next byte
   virtual int peek();
   virtual void flush();	// Finish reading the current packet
+  // Wait up to timeout ms until a packet arrives (SOCKET_READABLE) or one can be sent (SOCKET_WRITABLE)
+  // Returns the events that are set, 0 on timeout, SOCKET_CLOSED before begin()
+  int waitFor(int events, uint32_t timeout);
 
   // Return the IP address of the host who sent the current incoming packet
   virtual IPAddress remoteIP();
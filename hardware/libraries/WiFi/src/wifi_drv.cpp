@@ -28,8 +28,11 @@
 
 #include "lwip/err.h"
 #include "lwip/tcpip.h"
+#include "lwip/dhcp.h"
+#include "lwip/netstats.h"
 #include "netif/etharp.h"
 #include "rt_os_service.h"
+#include "FlashKV.h"
 
 #include "wifi_intfs.h"
 #include "wl_definitions.h"
@@ -57,6 +60,27 @@ static char networkmask[17] = "\0";
 static bool use_dhcp = false;
 static bool if_enabled = false;
 
+// Last network joined, kept in flashKV so that the next begin(), after a
+// reset or a power cycle, can ask the DHCP server for the same lease.
+#define WIFI_AP_KEY		"wifi.ap"
+#define WIFI_AP_VERSION		1
+
+// Longest wait for DHCP after the join, in ms
+#define WIFI_DHCP_TIMEOUT	15000
+
+struct wifi_ap_record {
+	uint8_t version;
+	uint8_t ssidLen;
+	uint8_t bssid[WL_MAC_ADDR_LENGTH];
+	char ssid[WL_SSID_MAX_LENGTH];
+	uint32_t security;	// rtw_security_t used for the join
+	uint32_t ip;		// leased address, network order
+	uint32_t server;	// DHCP server, network order
+	uint32_t lease;		// lease time in seconds
+};
+
+static wl_connect_stats_t _connectStats;
+
 //static Semaphore tcpip_inited(0);
 
 
@@ -110,20 +134,162 @@ uint8_t WiFiDrv::getScanNetworks()
 
 }
 
+static bool loadAp(struct wifi_ap_record *rec, const char *ssid, uint8_t ssid_len, rtw_security_t security)
+{
+	if (flashKV.get(WIFI_AP_KEY, rec, sizeof(*rec)) != sizeof(*rec))
+		return false;
+	return rec->version == WIFI_AP_VERSION && rec->ssidLen == ssid_len &&
+		memcmp(rec->ssid, ssid, ssid_len) == 0 && rec->security == (uint32_t)security &&
+		rec->ip != 0;
+}
+
+struct lease_read {
+	struct netif *netif;
+	struct wifi_ap_record *rec;
+	bool bound;
+#if !LWIP_TCPIP_CORE_LOCKING
+	sys_sem_t done;
+#endif
+};
+
+// Runs in the tcpip thread, or under the core lock
+static void readLease(void *arg)
+{
+	struct lease_read *lr = (struct lease_read *)arg;
+	struct dhcp *dhcp = lr->netif->dhcp;
+
+	if (dhcp != NULL && dhcp->state == DHCP_BOUND) {
+		lr->rec->ip = ip4_addr_get_u32(&dhcp->offered_ip_addr);
+		lr->rec->server = ip4_addr_get_u32(&dhcp->server_ip_addr);
+		lr->rec->lease = dhcp->offered_t0_lease;
+		lr->bound = true;
+	}
+#if !LWIP_TCPIP_CORE_LOCKING
+	sys_sem_signal(&lr->done);
+#endif
+}
+
+// Wait for DHCP to bind, then save the lease if it is not the one in flash
+void WiFiDrv::saveAp(const char *ssid, uint8_t ssid_len, rtw_security_t security, uint32_t start)
+{
+	struct wifi_ap_record rec, old;
+	struct lease_read lr;
+	bool haveOld;
+
+	memset(&rec, 0, sizeof(rec));
+	lr.netif = (struct netif *)pnetif;
+	lr.rec = &rec;
+	lr.bound = false;
+#if !LWIP_TCPIP_CORE_LOCKING
+	// The prebuilt lwIP has no core lock: read the lease in its thread
+	if (sys_sem_new(&lr.done, 0) != ERR_OK)
+		return;
+#endif
+	for (;;) {
+#if LWIP_TCPIP_CORE_LOCKING
+		LOCK_TCPIP_CORE();
+		readLease(&lr);
+		UNLOCK_TCPIP_CORE();
+#else
+		if (tcpip_callback_with_block(readLease, &lr, 1) == ERR_OK)
+			sys_arch_sem_wait(&lr.done, 0);
+#endif
+		if (lr.bound || millis() - start >= WIFI_DHCP_TIMEOUT)
+			break;
+		delay(10);
+	}
+#if !LWIP_TCPIP_CORE_LOCKING
+	sys_sem_free(&lr.done);
+#endif
+	if (!lr.bound)
+		return;
+	_connectStats.totalMs = millis() - start;
+
+	rec.version = WIFI_AP_VERSION;
+	rec.ssidLen = ssid_len;
+	memcpy(rec.ssid, ssid, ssid_len);
+	rec.security = security;
+	wl_wifi_get_current_bssid(padapter, rec.bssid);
+
+	haveOld = (flashKV.get(WIFI_AP_KEY, &old, sizeof(old)) == sizeof(old) &&
+		old.version == WIFI_AP_VERSION);
+	_connectStats.sameAp = (haveOld &&
+		memcmp(old.bssid, rec.bssid, WL_MAC_ADDR_LENGTH) == 0);
+	// most wakeups find everything unchanged, spare the flash
+	if (haveOld && memcmp(&old, &rec, sizeof(rec)) == 0)
+		return;
+	flashKV.put(WIFI_AP_KEY, &rec, sizeof(rec));
+}
+
 int8_t WiFiDrv::wifiSetPassphrase(char* ssid, uint8_t ssid_len, const char *passphrase, const uint8_t passphrase_len)
 {
 	wl_err_t ret = WL_SUCCESS;
-
-	if ( passphrase == NULL || passphrase_len == 0 ) 
-		ret = wl_wifi_connect(padapter, ssid, ssid_len,RTW_SECURITY_OPEN, NULL, 0);
+	rtw_security_t security;
+#if LWIP_DHCP_REBOOT_HINT
+	struct wifi_ap_record rec;
+#endif
+	uint32_t start = millis();
+#if NETSTATS
+	uint32_t acked = netstats.dhcp.reboot_acked;
+#endif
+
+	if ( passphrase == NULL || passphrase_len == 0 )
+		security = RTW_SECURITY_OPEN;
 	else
-		ret = wl_wifi_connect(padapter, ssid, ssid_len,RTW_SECURITY_WPA2_AES_PSK, passphrase, passphrase_len);
-	
-	if ( ret == WL_SUCCESS ) 
+		security = RTW_SECURITY_WPA2_AES_PSK;
+
+	memset(&_connectStats, 0, sizeof(_connectStats));
+#if LWIP_DHCP_REBOOT_HINT
+	// wl_wifi_connect() starts DHCP right after the join: have it confirm
+	// the saved lease instead of looking for a new one. Needs lwIP rebuilt
+	// from the tree, the prebuilt one always discovers.
+	if (use_dhcp && loadAp(&rec, ssid, ssid_len, security)) {
+		ip_addr_t ip;
+
+		ip4_addr_set_u32(&ip, rec.ip);
+		LOCK_TCPIP_CORE();
+		dhcp_set_reboot_hint(&ip);
+		UNLOCK_TCPIP_CORE();
+		_connectStats.leaseOffered = 1;
+	}
+#endif
+
+	if (security == RTW_SECURITY_OPEN)
+		ret = wl_wifi_connect(padapter, ssid, ssid_len, security, NULL, 0);
+	else
+		ret = wl_wifi_connect(padapter, ssid, ssid_len, security, passphrase, passphrase_len);
+	_connectStats.joinMs = millis() - start;
+
+	if ( ret == WL_SUCCESS ) {
 		if_enabled = true;
+		if (use_dhcp) {
+			saveAp(ssid, ssid_len, security, start);
+#if NETSTATS
+			_connectStats.leaseResumed = (netstats.dhcp.reboot_acked != acked);
+#endif
+		}
+	}
+#if LWIP_DHCP_REBOOT_HINT
+	else if (_connectStats.leaseOffered) {
+		// the join failed before DHCP took the hint
+		LOCK_TCPIP_CORE();
+		dhcp_set_reboot_hint(NULL);
+		UNLOCK_TCPIP_CORE();
+	}
+#endif
     return ret;
 }
 
+void WiFiDrv::forgetNetwork()
+{
+	flashKV.remove(WIFI_AP_KEY);
+}
+
+const wl_connect_stats_t& WiFiDrv::getConnectStats()
+{
+	return _connectStats;
+}
+
 uint8_t* WiFiDrv::getMacAddress()
 {
 	wl_wifi_get_mac_address(padapter, (uint8_t*)_mac);
@@ -36,6 +36,7 @@ class WiFiDrv
 protected: 
 	
 	void getNetworkData(uint8_t *ip, uint8_t *mask, uint8_t *gwip);
+	void saveAp(const char *ssid, uint8_t ssid_len, rtw_security_t security, uint32_t start);
 		
 public:
 
@@ -80,6 +81,17 @@ public:
      */
    int8_t wifiSetPassphrase(char* ssid, uint8_t ssid_len, const char *passphrase, const uint8_t len);
 
+   /*
+	* Erase the network saved by wifiSetPassphrase(), so that the next
+	* join starts DHCP from DISCOVER.
+	*/
+   void forgetNetwork();
+
+   /*
+	* Timing of the last wifiSetPassphrase()
+	*/
+   const wl_connect_stats_t& getConnectStats();
+
    /*
 	* Disconnect from the network
 	*
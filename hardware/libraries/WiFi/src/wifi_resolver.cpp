@@ -0,0 +1,618 @@
+/*
+  wifi_resolver.cpp - Caching DNS resolver for the Ameba WiFi library.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <ctype.h>
+#include <string.h>
+
+#include "lwip/sys.h"
+#include "lwip/ip_addr.h"
+#include "lwip/dns.h"
+#include "lwip/udp.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcpip.h"
+#include "lwip/timers.h"
+
+#include "wifi_intfs.h"
+#include "wifi_resolver.h"
+
+// Entry states
+#define DNS_CACHE_EMPTY     0
+#define DNS_CACHE_PENDING   1
+#define DNS_CACHE_VALID     2
+#define DNS_CACHE_FAILED    3
+
+// Wrap-safe "a is before b" for sys_now() timestamps
+#define DNS_CACHE_BEFORE(a, b)  ((int32_t)((a) - (b)) < 0)
+
+// How a lookup ended, for complete()
+#define DNS_RESULT_ANSWER   0   // the server gave an address
+#define DNS_RESULT_NO_NAME  1   // the server says there is none: cached
+#define DNS_RESULT_ERROR    2   // no answer or out of resources: not cached
+
+// The parts of RFC 1035 the resolver needs
+#define DNS_PORT            53
+#define DNS_HEADER_SIZE     12
+#define DNS_FLAG1_RESPONSE  0x80
+#define DNS_FLAG1_RD        0x01
+#define DNS_RCODE_MASK      0x0f
+#define DNS_RCODE_NXDOMAIN  3
+#define DNS_TYPE_A          1
+#define DNS_CLASS_IN        1
+
+// Blocking hostByName() waits on one of these through resolveAsync()
+struct resolve_wait {
+	sys_sem_t sem;
+	uint32_t addr;
+	int status;
+};
+
+static void resolveWaitDone(const char* aHostname, IPAddress aResult, int aStatus, void* aArg)
+{
+	struct resolve_wait* wait = (struct resolve_wait*)aArg;
+
+	wait->addr = (uint32_t)aResult;
+	wait->status = aStatus;
+	sys_sem_signal(&wait->sem);
+}
+
+
+WiFiResolver::WiFiResolver()
+	: _pcb(NULL), _sweeping(false), _hits(0), _misses(0), _prefetches(0)
+{
+	memset(_entries, 0, sizeof(_entries));
+	memset(_waiters, 0, sizeof(_waiters));
+}
+
+int WiFiResolver::hostByName(const char* aHostname, IPAddress& aResult, uint32_t aTimeout)
+{
+	struct resolve_wait wait;
+	int ret;
+
+	wait.addr = 0;
+	wait.status = WL_FAILURE;
+	sys_sem_new(&wait.sem, 0);
+
+	ret = resolveAsync(aHostname, resolveWaitDone, &wait);
+	if ( ret == 0 ) {
+		// Pending: the callback signals us from the tcpip thread
+		if ( sys_arch_sem_wait(&wait.sem, aTimeout) == SYS_ARCH_TIMEOUT ) {
+			if ( removeWaiter(&wait) ) {
+				sys_sem_free(&wait.sem);
+				return 0;
+			}
+			// The result raced with the timeout and is being delivered now
+			sys_arch_sem_wait(&wait.sem, 0);
+		}
+	}
+	sys_sem_free(&wait.sem);
+
+	if ( wait.status != WL_SUCCESS )
+		return 0;
+	aResult = wait.addr;
+	return 1;
+}
+
+int WiFiResolver::resolveAsync(const char* aHostname, WiFiResolveCallback aCallback, void* aArg)
+{
+	SYS_ARCH_DECL_PROTECT(lev);
+	uint32_t now = sys_now();
+	uint32_t addr;
+	int i;
+
+	if ( aHostname == NULL || aHostname[0] == 0 ) {
+		aCallback(aHostname, INADDR_NONE, WL_FAILURE, aArg);
+		return -1;
+	}
+
+	// Dotted-quad names never need the network
+	addr = ipaddr_addr(aHostname);
+	if ( addr != IPADDR_NONE ) {
+		aCallback(aHostname, IPAddress(addr), WL_SUCCESS, aArg);
+		return 1;
+	}
+
+	// Names that don't fit the cache go straight to lwIP, uncached
+	if ( strlen(aHostname) >= DNS_CACHE_NAME_LENGTH ) {
+		aCallback(aHostname, INADDR_NONE, WL_FAILURE, aArg);
+		return -1;
+	}
+
+	SYS_ARCH_PROTECT(lev);
+	i = find(aHostname);
+	if ( i >= 0 && _entries[i].state != DNS_CACHE_PENDING && DNS_CACHE_BEFORE(_entries[i].expires, now) ) {
+		// Expired, unless a refresh is still on its way
+		if ( !_entries[i].refreshing )
+			_entries[i].state = DNS_CACHE_EMPTY;
+		else
+			_entries[i].state = DNS_CACHE_PENDING;
+	}
+
+	if ( i >= 0 && _entries[i].state == DNS_CACHE_VALID ) {
+		Entry* e = &_entries[i];
+		bool prefetch = false;
+
+		_hits++;
+		e->lastUsed = now;
+		e->used = 1;
+		if ( !e->refreshing && DNS_CACHE_BEFORE(e->expires, now + DNS_CACHE_PREFETCH_WINDOW) ) {
+			e->refreshing = 1;
+			prefetch = true;
+			_prefetches++;
+		}
+		addr = e->addr;
+		SYS_ARCH_UNPROTECT(lev);
+
+		if ( prefetch )
+			startQuery(i);
+		aCallback(aHostname, IPAddress(addr), WL_SUCCESS, aArg);
+		return 1;
+	}
+
+	if ( i >= 0 && _entries[i].state == DNS_CACHE_FAILED ) {
+		_hits++;
+		SYS_ARCH_UNPROTECT(lev);
+		aCallback(aHostname, INADDR_NONE, WL_FAILURE, aArg);
+		return -1;
+	}
+
+	_misses++;
+	if ( i >= 0 && _entries[i].state == DNS_CACHE_PENDING ) {
+		// Someone already asked, just wait for the same answer
+		if ( !addWaiter(i, aCallback, aArg) ) {
+			SYS_ARCH_UNPROTECT(lev);
+			return -1;
+		}
+		SYS_ARCH_UNPROTECT(lev);
+		return 0;
+	}
+
+	i = allocate(aHostname, now);
+	if ( i < 0 || !addWaiter(i, aCallback, aArg) ) {
+		if ( i >= 0 )
+			_entries[i].state = DNS_CACHE_EMPTY;
+		SYS_ARCH_UNPROTECT(lev);
+		return -1;
+	}
+	SYS_ARCH_UNPROTECT(lev);
+
+	// On failure the waiters, aCallback among them, have been answered
+	return startQuery(i) ? 0 : -1;
+}
+
+void WiFiResolver::flush()
+{
+	SYS_ARCH_DECL_PROTECT(lev);
+	int i;
+
+	SYS_ARCH_PROTECT(lev);
+	for ( i = 0; i < DNS_CACHE_SIZE; i++ ) {
+		// Pending lookups still have waiters to answer
+		if ( _entries[i].state != DNS_CACHE_PENDING ) {
+			_entries[i].state = DNS_CACHE_EMPTY;
+			_entries[i].refreshing = 0;
+			_entries[i].tries = 0;
+		}
+	}
+	SYS_ARCH_UNPROTECT(lev);
+}
+
+// Must be called with the cache protected
+int WiFiResolver::find(const char* aHostname)
+{
+	int i;
+
+	for ( i = 0; i < DNS_CACHE_SIZE; i++ ) {
+		if ( _entries[i].state != DNS_CACHE_EMPTY && strcmp(_entries[i].name, aHostname) == 0 )
+			return i;
+	}
+	return -1;
+}
+
+// Must be called with the cache protected. Reuses an empty slot, else the
+// least recently used entry that has no lookup in flight.
+int WiFiResolver::allocate(const char* aHostname, uint32_t aNow)
+{
+	int i, victim = -1;
+
+	for ( i = 0; i < DNS_CACHE_SIZE; i++ ) {
+		Entry* e = &_entries[i];
+
+		if ( e->state == DNS_CACHE_EMPTY ) {
+			victim = i;
+			break;
+		}
+		if ( e->state == DNS_CACHE_PENDING || e->refreshing )
+			continue;
+		if ( victim < 0 || DNS_CACHE_BEFORE(e->lastUsed, _entries[victim].lastUsed) )
+			victim = i;
+	}
+	if ( victim < 0 )
+		return -1;
+
+	strcpy(_entries[victim].name, aHostname);
+	_entries[victim].state = DNS_CACHE_PENDING;
+	_entries[victim].refreshing = 0;
+	_entries[victim].tries = 0;
+	_entries[victim].used = 1;
+	_entries[victim].lastUsed = aNow;
+	return victim;
+}
+
+// Must be called with the cache protected
+bool WiFiResolver::addWaiter(int aEntry, WiFiResolveCallback aCallback, void* aArg)
+{
+	int i;
+
+	for ( i = 0; i < DNS_CACHE_WAITERS; i++ ) {
+		if ( _waiters[i].callback == NULL ) {
+			_waiters[i].callback = aCallback;
+			_waiters[i].arg = aArg;
+			_waiters[i].entry = aEntry;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool WiFiResolver::removeWaiter(void* aArg)
+{
+	SYS_ARCH_DECL_PROTECT(lev);
+	bool removed = false;
+	int i;
+
+	SYS_ARCH_PROTECT(lev);
+	for ( i = 0; i < DNS_CACHE_WAITERS; i++ ) {
+		if ( _waiters[i].callback != NULL && _waiters[i].arg == aArg ) {
+			_waiters[i].callback = NULL;
+			removed = true;
+		}
+	}
+	SYS_ARCH_UNPROTECT(lev);
+	return removed;
+}
+
+bool WiFiResolver::startQuery(int aEntry)
+{
+	// The query runs in the tcpip thread. Don't block if its mailbox is
+	// full: fail the lookup, but don't cache that.
+	if ( tcpip_callback_with_block(doQuery, (void*)(intptr_t)aEntry, 0) != ERR_OK ) {
+		complete(aEntry, 0, 0, DNS_RESULT_ERROR);
+		return false;
+	}
+	return true;
+}
+
+// Runs in the tcpip thread. The query goes out on the resolver's own pcb
+// rather than through dns_gethostbyname(), which would answer from lwIP's
+// dns_table with the address and TTL it already has: a refresh must ask
+// the server.
+void WiFiResolver::doQuery(void* aCtx)
+{
+	WiFiResolver* self = &wiFiResolver;
+	int i = (int)(intptr_t)aCtx;
+
+	if ( !self->_sweeping ) {
+		self->_sweeping = true;
+		sys_timeout(DNS_CACHE_SWEEP_INTERVAL, sweep, NULL);
+	}
+	if ( self->_pcb == NULL ) {
+		self->_pcb = udp_new();
+		if ( self->_pcb == NULL ) {
+			self->complete(i, 0, 0, DNS_RESULT_ERROR);
+			return;
+		}
+		udp_bind(self->_pcb, IP_ADDR_ANY, 0);
+		udp_recv(self->_pcb, recvCallback, NULL);
+	}
+	self->_entries[i].tries = 0;
+	self->sendQuery(i);
+}
+
+// Runs in the tcpip thread: (re)send the query of an entry, each try to
+// the next configured server
+void WiFiResolver::sendQuery(int aEntry)
+{
+	Entry* e = &_entries[aEntry];
+	ip_addr_t server;
+	struct pbuf* p;
+	uint8_t* q;
+	const char* label;
+	int len = strlen(e->name);
+
+	server = dns_getserver(e->tries % DNS_MAX_SERVERS);
+	if ( ip_addr_isany(&server) )
+		server = dns_getserver(0);
+	if ( ip_addr_isany(&server) ) {
+		complete(aEntry, 0, 0, DNS_RESULT_ERROR);
+		return;
+	}
+
+	// Header, the name as labels with a length byte each, type and class
+	p = pbuf_alloc(PBUF_TRANSPORT, DNS_HEADER_SIZE + len + 2 + 4, PBUF_RAM);
+	if ( p == NULL ) {
+		complete(aEntry, 0, 0, DNS_RESULT_ERROR);
+		return;
+	}
+	e->txid = (uint16_t)LWIP_RAND();
+	q = (uint8_t*)p->payload;
+	memset(q, 0, DNS_HEADER_SIZE);
+	q[0] = e->txid >> 8;
+	q[1] = e->txid & 0xff;
+	q[2] = DNS_FLAG1_RD;
+	q[5] = 1;                       // one question
+	q += DNS_HEADER_SIZE;
+	label = e->name;
+	while ( *label != 0 ) {
+		const char* dot = strchr(label, '.');
+		int n = (dot != NULL) ? dot - label : strlen(label);
+
+		if ( n == 0 || n > 63 ) {
+			pbuf_free(p);
+			complete(aEntry, 0, 0, DNS_RESULT_NO_NAME);
+			return;
+		}
+		*q++ = n;
+		memcpy(q, label, n);
+		q += n;
+		label += n;
+		if ( *label == '.' )
+			label++;
+	}
+	*q++ = 0;
+	*q++ = 0;
+	*q++ = DNS_TYPE_A;
+	*q++ = 0;
+	*q++ = DNS_CLASS_IN;
+	// A trailing dot leaves the buffer one byte longer than the query
+	pbuf_realloc(p, q - (uint8_t*)p->payload);
+
+	udp_sendto(_pcb, p, &server, DNS_PORT);
+	pbuf_free(p);
+	e->tries++;
+	e->sent = sys_now();
+}
+
+// Name at *aOffset in a response, in labels, against a dotted name.
+// Moves *aOffset past it. Compression is not followed: a question is
+// never compressed.
+static bool matchName(struct pbuf* aP, uint16_t* aOffset, const char* aName)
+{
+	uint16_t off = *aOffset;
+	uint8_t n;
+
+	for ( ;; ) {
+		if ( off >= aP->tot_len )
+			return false;
+		n = pbuf_get_at(aP, off++);
+		if ( n == 0 )
+			break;
+		if ( n > 63 || off + n > aP->tot_len )
+			return false;
+		while ( n-- > 0 ) {
+			if ( tolower(pbuf_get_at(aP, off++)) != tolower((unsigned char)*aName++) )
+				return false;
+		}
+		if ( *aName == '.' )
+			aName++;
+		else if ( *aName != 0 )
+			return false;
+	}
+	*aOffset = off;
+	return *aName == 0;
+}
+
+// Moves *aOffset past a name in a response, compressed or not
+static bool skipName(struct pbuf* aP, uint16_t* aOffset)
+{
+	uint16_t off = *aOffset;
+	uint8_t n;
+
+	for ( ;; ) {
+		if ( off >= aP->tot_len )
+			return false;
+		n = pbuf_get_at(aP, off);
+		if ( (n & 0xc0) == 0xc0 ) {
+			off += 2;
+			break;
+		}
+		off += 1 + n;
+		if ( n == 0 )
+			break;
+	}
+	*aOffset = off;
+	return off <= aP->tot_len;
+}
+
+static uint16_t get16(struct pbuf* aP, uint16_t aOffset)
+{
+	return (pbuf_get_at(aP, aOffset) << 8) | pbuf_get_at(aP, aOffset + 1);
+}
+
+// Runs in the tcpip thread, for every datagram to the resolver's pcb
+void WiFiResolver::recvCallback(void* aArg, struct udp_pcb* aPcb, struct pbuf* aP, ip_addr_t* aAddr, uint16_t aPort)
+{
+	WiFiResolver* self = &wiFiResolver;
+	uint16_t txid, answers, off = DNS_HEADER_SIZE;
+	uint8_t flags1, rcode;
+	uint32_t ttl = DNS_CACHE_MAX_TTL;
+	int i;
+
+	if ( aPort != DNS_PORT || aP->tot_len < DNS_HEADER_SIZE )
+		goto done;
+	txid = get16(aP, 0);
+	flags1 = pbuf_get_at(aP, 2);
+	rcode = pbuf_get_at(aP, 3) & DNS_RCODE_MASK;
+	answers = get16(aP, 6);
+	if ( !(flags1 & DNS_FLAG1_RESPONSE) || get16(aP, 4) != 1 )
+		goto done;
+
+	// The entry that asked, by id and name
+	for ( i = 0; i < DNS_CACHE_SIZE; i++ ) {
+		Entry* e = &self->_entries[i];
+
+		if ( e->tries > 0 && e->txid == txid &&
+				(e->state == DNS_CACHE_PENDING || e->refreshing) )
+			break;
+	}
+	if ( i == DNS_CACHE_SIZE || !matchName(aP, &off, self->_entries[i].name) )
+		goto done;
+	off += 4;                       // type and class of the question
+
+	if ( rcode == DNS_RCODE_NXDOMAIN ) {
+		self->complete(i, 0, 0, DNS_RESULT_NO_NAME);
+		goto done;
+	}
+	if ( rcode != 0 ) {
+		// Server failure or refusal: the next server may know
+		if ( self->_entries[i].tries < DNS_CACHE_RETRIES )
+			self->sendQuery(i);
+		else
+			self->complete(i, 0, 0, DNS_RESULT_ERROR);
+		goto done;
+	}
+
+	// The first A record, after any CNAMEs: the shortest TTL on the way
+	// is how long the whole chain holds
+	while ( answers-- > 0 ) {
+		uint16_t type, cls, len;
+		uint32_t t;
+
+		if ( !skipName(aP, &off) || off + 10 > aP->tot_len )
+			break;
+		type = get16(aP, off);
+		cls = get16(aP, off + 2);
+		t = ((uint32_t)get16(aP, off + 4) << 16) | get16(aP, off + 6);
+		len = get16(aP, off + 8);
+		off += 10;
+		if ( off + len > aP->tot_len )
+			break;
+		if ( cls == DNS_CLASS_IN && t < ttl )
+			ttl = t;
+		if ( type == DNS_TYPE_A && cls == DNS_CLASS_IN && len == 4 ) {
+			uint32_t addr;
+
+			pbuf_copy_partial(aP, &addr, 4, off);
+			self->complete(i, addr, ttl, DNS_RESULT_ANSWER);
+			goto done;
+		}
+		off += len;
+	}
+	// The name exists, but has no address
+	self->complete(i, 0, 0, DNS_RESULT_NO_NAME);
+
+done:
+	pbuf_free(aP);
+}
+
+void WiFiResolver::complete(int aEntry, uint32_t aAddr, uint32_t aTtl, int aResult)
+{
+	SYS_ARCH_DECL_PROTECT(lev);
+	Entry* e = &_entries[aEntry];
+	Waiter done[DNS_CACHE_WAITERS];
+	char name[DNS_CACHE_NAME_LENGTH];
+	uint32_t now = sys_now();
+	bool success;
+	int i, n = 0;
+
+	if ( aTtl < DNS_CACHE_MIN_TTL )
+		aTtl = DNS_CACHE_MIN_TTL;
+	if ( aTtl > DNS_CACHE_MAX_TTL )
+		aTtl = DNS_CACHE_MAX_TTL;
+
+	SYS_ARCH_PROTECT(lev);
+	if ( aResult == DNS_RESULT_ANSWER ) {
+		e->addr = aAddr;
+		e->expires = now + aTtl * 1000;
+		e->state = DNS_CACHE_VALID;
+	} else if ( e->refreshing && e->state == DNS_CACHE_VALID ) {
+		// A failed prefetch keeps serving the old address until it expires
+	} else if ( aResult == DNS_RESULT_NO_NAME ) {
+		e->addr = 0;
+		e->expires = now + DNS_CACHE_NEGATIVE_TTL * 1000;
+		e->state = DNS_CACHE_FAILED;
+	} else {
+		// A timeout or a full mailbox says nothing about the name: the
+		// next lookup asks again
+		e->state = DNS_CACHE_EMPTY;
+	}
+	e->refreshing = 0;
+	e->used = 0;
+	e->tries = 0;
+	strcpy(name, e->name);
+
+	for ( i = 0; i < DNS_CACHE_WAITERS; i++ ) {
+		if ( _waiters[i].callback != NULL && _waiters[i].entry == aEntry ) {
+			done[n++] = _waiters[i];
+			_waiters[i].callback = NULL;
+		}
+	}
+	aAddr = e->addr;
+	success = (e->state == DNS_CACHE_VALID);
+	SYS_ARCH_UNPROTECT(lev);
+
+	for ( i = 0; i < n; i++ )
+		done[i].callback(name, success ? IPAddress(aAddr) : INADDR_NONE, success ? WL_SUCCESS : WL_FAILURE, done[i].arg);
+}
+
+// Runs in the tcpip thread: resend unanswered queries, expire stale entries
+// and refresh the ones in use before they run out, so connect() to a known
+// host never waits on DNS.
+void WiFiResolver::sweep(void* aArg)
+{
+	WiFiResolver* self = &wiFiResolver;
+	SYS_ARCH_DECL_PROTECT(lev);
+	uint32_t now = sys_now();
+	int i;
+
+	for ( i = 0; i < DNS_CACHE_SIZE; i++ ) {
+		Entry* e = &self->_entries[i];
+		bool prefetch = false;
+
+		if ( e->tries > 0 && (e->state == DNS_CACHE_PENDING || e->refreshing) ) {
+			if ( now - e->sent >= DNS_CACHE_RETRY_INTERVAL ) {
+				if ( e->tries < DNS_CACHE_RETRIES )
+					self->sendQuery(i);
+				else
+					self->complete(i, 0, 0, DNS_RESULT_ERROR);
+			}
+			continue;
+		}
+		// A query flushed away, its answer no longer matters
+		e->tries = 0;
+
+		SYS_ARCH_PROTECT(lev);
+		if ( e->state == DNS_CACHE_VALID || e->state == DNS_CACHE_FAILED ) {
+			if ( DNS_CACHE_BEFORE(e->expires, now) && !e->refreshing ) {
+				e->state = DNS_CACHE_EMPTY;
+			} else if ( e->state == DNS_CACHE_VALID && e->used && !e->refreshing &&
+					DNS_CACHE_BEFORE(e->expires, now + DNS_CACHE_PREFETCH_WINDOW) ) {
+				e->refreshing = 1;
+				prefetch = true;
+				self->_prefetches++;
+			}
+		}
+		SYS_ARCH_UNPROTECT(lev);
+
+		if ( prefetch )
+			doQuery((void*)(intptr_t)i);
+	}
+	sys_timeout(DNS_CACHE_SWEEP_INTERVAL, sweep, NULL);
+}
+
+
+WiFiResolver wiFiResolver;
@@ -0,0 +1,178 @@
+/*
+  wifi_resolver.h - Caching DNS resolver for the Ameba WiFi library.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef WiFi_Resolver_h
+#define WiFi_Resolver_h
+
+#include <inttypes.h>
+
+#include "lwip/ip_addr.h"
+
+#include "IPAddress.h"
+
+struct udp_pcb;
+struct pbuf;
+
+/* Number of hostnames kept in the cache (lwIP's own dns_table only holds
+ * DNS_TABLE_SIZE in-flight and recent names) */
+#ifndef DNS_CACHE_SIZE
+#define DNS_CACHE_SIZE              16
+#endif
+
+/* Longest hostname that can be cached, including the terminating zero */
+#ifndef DNS_CACHE_NAME_LENGTH
+#define DNS_CACHE_NAME_LENGTH       64
+#endif
+
+/* Number of callers that may wait on pending lookups at the same time */
+#ifndef DNS_CACHE_WAITERS
+#define DNS_CACHE_WAITERS           8
+#endif
+
+/* Bounds applied to the TTL reported by the server, in seconds */
+#ifndef DNS_CACHE_MIN_TTL
+#define DNS_CACHE_MIN_TTL           1
+#endif
+#ifndef DNS_CACHE_MAX_TTL
+#define DNS_CACHE_MAX_TTL           86400
+#endif
+
+/* How long a failed lookup is remembered, in seconds */
+#ifndef DNS_CACHE_NEGATIVE_TTL
+#define DNS_CACHE_NEGATIVE_TTL      30
+#endif
+
+/* Entries that were used and expire within this window are refreshed in
+ * the background, in milliseconds */
+#ifndef DNS_CACHE_PREFETCH_WINDOW
+#define DNS_CACHE_PREFETCH_WINDOW   10000
+#endif
+
+/* Period of the prefetch/expiry sweep in the tcpip thread, in milliseconds */
+#ifndef DNS_CACHE_SWEEP_INTERVAL
+#define DNS_CACHE_SWEEP_INTERVAL    1000
+#endif
+
+/* A query unanswered for this long is sent again, to the next DNS server,
+ * in milliseconds. Checked at each sweep. */
+#ifndef DNS_CACHE_RETRY_INTERVAL
+#define DNS_CACHE_RETRY_INTERVAL    2000
+#endif
+
+/* Queries sent for one lookup before it fails */
+#ifndef DNS_CACHE_RETRIES
+#define DNS_CACHE_RETRIES           3
+#endif
+
+/* Longest time hostByName() blocks for an uncached name, in milliseconds */
+#ifndef DNS_CACHE_TIMEOUT
+#define DNS_CACHE_TIMEOUT           10000
+#endif
+
+/*
+ * Called when a lookup completes.
+ * param aHostname: Name that was resolved
+ * param aResult: Resolved address, INADDR_NONE on failure
+ * param aStatus: WL_SUCCESS or WL_FAILURE
+ * param aArg: Argument given to resolveAsync
+ *
+ * Cache hits are reported from the calling thread, all other results from
+ * the tcpip thread, so the callback must not block.
+ */
+typedef void (*WiFiResolveCallback)(const char* aHostname, IPAddress aResult, int aStatus, void* aArg);
+
+class WiFiResolver
+{
+public:
+	WiFiResolver();
+
+	/*
+	 * Resolve a hostname, blocking only when it is not cached.
+	 * param aHostname: Name to be resolved
+	 * param aResult: IPAddress structure to store the returned IP address
+	 * param aTimeout: Longest time to wait for the DNS server, in milliseconds
+	 * result: 1 if the name was resolved, else 0
+	 */
+	int hostByName(const char* aHostname, IPAddress& aResult, uint32_t aTimeout = DNS_CACHE_TIMEOUT);
+
+	/*
+	 * Resolve a hostname without blocking.
+	 * param aHostname: Name to be resolved
+	 * param aCallback: Called with the result
+	 * param aArg: Passed through to aCallback
+	 * result: 1 if answered from the cache (aCallback has already run),
+	 *         0 if a lookup is in progress, -1 on failure (aCallback has
+	 *         already run, or was not registered when out of waiter slots)
+	 */
+	int resolveAsync(const char* aHostname, WiFiResolveCallback aCallback, void* aArg = NULL);
+
+	/*
+	 * Drop every cached entry, e.g. after joining another network.
+	 */
+	void flush();
+
+	/* Lookup counters, for tuning DNS_CACHE_SIZE */
+	uint32_t hits() { return _hits; };
+	uint32_t misses() { return _misses; };
+	uint32_t prefetches() { return _prefetches; };
+
+private:
+	struct Entry {
+		char name[DNS_CACHE_NAME_LENGTH];
+		uint32_t addr;
+		uint32_t expires;
+		uint32_t lastUsed;
+		uint8_t state;
+		uint8_t refreshing;
+		uint8_t used;
+		// Query in flight, only used in the tcpip thread
+		uint8_t tries;
+		uint16_t txid;
+		uint32_t sent;
+	};
+
+	struct Waiter {
+		WiFiResolveCallback callback;
+		void* arg;
+		int8_t entry;
+	};
+
+	int find(const char* aHostname);
+	int allocate(const char* aHostname, uint32_t aNow);
+	bool addWaiter(int aEntry, WiFiResolveCallback aCallback, void* aArg);
+	bool removeWaiter(void* aArg);
+	bool startQuery(int aEntry);
+	void sendQuery(int aEntry);
+	void complete(int aEntry, uint32_t aAddr, uint32_t aTtl, int aResult);
+
+	static void doQuery(void* aCtx);
+	static void recvCallback(void* aArg, struct udp_pcb* aPcb, struct pbuf* aP, ip_addr_t* aAddr, uint16_t aPort);
+	static void sweep(void* aArg);
+
+	Entry _entries[DNS_CACHE_SIZE];
+	Waiter _waiters[DNS_CACHE_WAITERS];
+	struct udp_pcb* _pcb;
+	bool _sweeping;
+	uint32_t _hits;
+	uint32_t _misses;
+	uint32_t _prefetches;
+};
+
+extern WiFiResolver wiFiResolver;
+
+#endif
@@ -10,7 +10,7 @@ const char* HttpClient::kUserAgent = "Arduino/2.2.0";
 const char* HttpClient::kContentLengthPrefix = HTTP_HEADER_CONTENT_LENGTH ": ";
 
 HttpClient::HttpClient(Client& aClient)
- : iClient(&aClient), iProxyPort(0)
+ : iClient(&aClient), iHeaders(&aClient), iProxyPort(0)
 {
   resetState();
 }
@@ -23,6 +23,7 @@ void HttpClient::resetState()
   iBodyLengthConsumed = 0;
   iContentLengthPtr = kContentLengthPrefix;
   iHttpResponseTimeout = kHttpResponseTimeout;
+  iHeaders.reset();
 }
 
 void HttpClient::stop()
@@ -96,43 +97,43 @@ int HttpClient::sendInitialHeaders(const char* aServerName, IPAddress aServerIP,
     Serial.println("Connected");
 #endif
     // Send the HTTP command, i.e. "GET /somepath/ HTTP/1.0"
-    iClient->print(aHttpMethod);
-    iClient->print(" ");
+    iHeaders.print(aHttpMethod);
+    iHeaders.print(" ");
 #ifdef PROXY_ENABLED
     if (iProxyPort)
     {
       // We're going through a proxy, send a full URL
-      iClient->print("http://");
+      iHeaders.print("http://");
       if (aServerName)
       {
         // We've got a server name, so use it
-        iClient->print(aServerName);
+        iHeaders.print(aServerName);
       }
       else
       {
         // We'll have to use the IP address
-        iClient->print(aServerIP);
+        iHeaders.print(aServerIP);
       }
       if (aPort != kHttpPort)
       {
-        iClient->print(":");
-        iClient->print(aPort);
+        iHeaders.print(":");
+        iHeaders.print(aPort);
       }
     }
 #endif
-    iClient->print(aURLPath);
-    iClient->println(" HTTP/1.1");
+    iHeaders.print(aURLPath);
+    iHeaders.println(" HTTP/1.1");
     // The host header, if required
     if (aServerName)
     {
-        iClient->print("Host: ");
-        iClient->print(aServerName);
+        iHeaders.print("Host: ");
+        iHeaders.print(aServerName);
         if (aPort != kHttpPort)
         {
-          iClient->print(":");
-          iClient->print(aPort);
+          iHeaders.print(":");
+          iHeaders.print(aPort);
         }
-        iClient->println();
+        iHeaders.println();
     }
     // And user-agent string
     if (aUserAgent)
@@ -154,27 +155,27 @@ int HttpClient::sendInitialHeaders(const char* aServerName, IPAddress aServerIP,
 
 void HttpClient::sendHeader(const char* aHeader)
 {
-    iClient->println(aHeader);
+    iHeaders.println(aHeader);
 }
 
 void HttpClient::sendHeader(const char* aHeaderName, const char* aHeaderValue)
 {
-    iClient->print(aHeaderName);
-    iClient->print(": ");
-    iClient->println(aHeaderValue);
+    iHeaders.print(aHeaderName);
+    iHeaders.print(": ");
+    iHeaders.println(aHeaderValue);
 }
 
 void HttpClient::sendHeader(const char* aHeaderName, const int aHeaderValue)
 {
-    iClient->print(aHeaderName);
-    iClient->print(": ");
-    iClient->println(aHeaderValue);
+    iHeaders.print(aHeaderName);
+    iHeaders.print(": ");
+    iHeaders.println(aHeaderValue);
 }
 
 void HttpClient::sendBasicAuth(const char* aUser, const char* aPassword)
 {
     // Send the initial part of this header line
-    iClient->print("Authorization: Basic ");
+    iHeaders.print("Authorization: Basic ");
     // Now Base64 encode "aUser:aPassword" and send that
     // This seems trickier than it should be but it's mostly to avoid either
     // (a) some arbitrarily sized buffer which hopes to be big enough, or
@@ -210,19 +211,20 @@ void HttpClient::sendBasicAuth(const char* aUser, const char* aPassword)
             // NUL-terminate the output string
             output[4] = '\0';
             // And write it out
-            iClient->print((char*)output);
+            iHeaders.print((char*)output);
 // FIXME We might want to fill output with '=' characters if b64_encode doesn't
 // FIXME do it for us when we're encoding the final chunk
             inputOffset = 0;
         }
     }
     // And end the header we've sent
-    iClient->println();
+    iHeaders.println();
 }
 
 void HttpClient::finishHeaders()
 {
-    iClient->println();
+    iHeaders.println();
+    iHeaders.send();
     iState = eRequestSent;
 }
 
@@ -236,6 +238,34 @@ void HttpClient::endRequest()
     // else the end of headers has already been sent, so nothing to do here
 }
 
+size_t HttpClient::HeaderBuffer::write(const uint8_t *aBuffer, size_t aSize)
+{
+    size_t left = aSize;
+
+    while (left > 0)
+    {
+        if (iLength == kHeaderBufferSize)
+        {
+            send();
+        }
+        size_t n = min(left, kHeaderBufferSize - iLength);
+        memcpy(iBuffer + iLength, aBuffer, n);
+        iLength += n;
+        aBuffer += n;
+        left -= n;
+    }
+    return aSize;
+}
+
+void HttpClient::HeaderBuffer::send()
+{
+    if (iLength > 0)
+    {
+        iClient->write(iBuffer, iLength);
+        iLength = 0;
+    }
+}
+
 int HttpClient::responseStatusCode()
 {
     if (iState < eRequestSent)
@@ -313,9 +343,13 @@ int HttpClient::responseStatusCode()
             }
             else
             {
-                // We haven't got any data, so let's pause to allow some to
-                // arrive
-                delay(kHttpWaitForDataDelay);
+                // We haven't got any data, so let's wait for some to
+                // arrive. On a closed connection that returns at once,
+                // so pause instead
+                if (waitFor(SOCKET_READABLE, kHttpWaitForDataDelay) & SOCKET_CLOSED)
+                {
+                    delay(kHttpWaitForDataDelay);
+                }
             }
         }
         if ( (c == '\n') && (iStatusCode < 200) )
@@ -362,9 +396,13 @@ int HttpClient::skipResponseHeaders()
         }
         else
         {
-            // We haven't got any data, so let's pause to allow some to
-            // arrive
-            delay(kHttpWaitForDataDelay);
+            // We haven't got any data, so let's wait for some to
+            // arrive. On a closed connection that returns at once,
+            // so pause instead
+            if (waitFor(SOCKET_READABLE, kHttpWaitForDataDelay) & SOCKET_CLOSED)
+            {
+                delay(kHttpWaitForDataDelay);
+            }
         }
     }
     if (endOfHeadersReached())
@@ -376,6 +376,7 @@ public:
     virtual void stop();
     virtual uint8_t connected() { return iClient->connected(); };
     virtual operator bool() { return bool(iClient); };
+    virtual int waitFor(int events, uint32_t timeout) { return iClient->waitFor(events, timeout); };
     virtual uint32_t httpResponseTimeout() { return iHttpResponseTimeout; };
     virtual void setHttpResponseTimeout(uint32_t timeout) { iHttpResponseTimeout = timeout; };
 protected:
@@ -414,6 +415,28 @@ protected:
     // processing)
     static const int kHttpResponseTimeout = 30*1000;
     static const char* kContentLengthPrefix;
+    // Room for the request line and headers of a Xively request
+    static const size_t kHeaderBufferSize = 256;
+
+    // Gathers the request line and headers, so that a request goes to the
+    // client in one write instead of one per piece. Each piece is a TCP
+    // segment of its own, or, under Nagle, waits for the ACK of the ones
+    // before it. Headers longer than the buffer go in several writes.
+    class HeaderBuffer : public Print
+    {
+    public:
+      HeaderBuffer(Client* aClient) : iClient(aClient), iLength(0) {};
+      virtual size_t write(uint8_t aByte) { return write(&aByte, 1); };
+      virtual size_t write(const uint8_t *aBuffer, size_t aSize);
+      // Write what has been gathered to the client
+      void send();
+      void reset() { iLength = 0; };
+    protected:
+      Client* iClient;
+      uint8_t iBuffer[kHeaderBufferSize];
+      size_t iLength;
+    };
+
     typedef enum {
         eIdle,
         eRequestStarted,
@@ -427,6 +450,8 @@ protected:
     } tHttpState;
     // Ethernet client we're using
     Client* iClient;
+    // The headers of the request, until finishHeaders() sends them
+    HeaderBuffer iHeaders;
     // Current state of the finite-state-machine
     tHttpState iState;
     // Stores the status code for the response, once known
@@ -0,0 +1,61 @@
+#include <XivelyBuffer.h>
+#include <stdlib.h>
+#include <string.h>
+
+XivelyBuffer::XivelyBuffer(size_t aMaxSize)
+  : _buffer(NULL), _capacity(0), _length(0), _maxSize(aMaxSize), _overflow(false)
+{
+}
+
+XivelyBuffer::~XivelyBuffer()
+{
+  free(_buffer);
+}
+
+bool XivelyBuffer::reserve(size_t aSize)
+{
+  if (aSize <= _capacity)
+  {
+    return true;
+  }
+  if (aSize > _maxSize)
+  {
+    return false;
+  }
+  // Grow geometrically so a feed settles on one allocation after a few uploads
+  size_t newCapacity = (_capacity ? _capacity : 256);
+  while (newCapacity < aSize)
+  {
+    newCapacity *= 2;
+  }
+  if (newCapacity > _maxSize)
+  {
+    newCapacity = _maxSize;
+  }
+  uint8_t* newBuffer = (uint8_t*)realloc(_buffer, newCapacity);
+  if (newBuffer == NULL)
+  {
+    return false;
+  }
+  _buffer = newBuffer;
+  _capacity = newCapacity;
+  return true;
+}
+
+size_t XivelyBuffer::write(uint8_t aByte)
+{
+  return write(&aByte, 1);
+}
+
+size_t XivelyBuffer::write(const uint8_t *aBuffer, size_t aSize)
+{
+  if (_overflow || !reserve(_length + aSize))
+  {
+    _overflow = true;
+    return 0;
+  }
+  memcpy(_buffer + _length, aBuffer, aSize);
+  _length += aSize;
+  return aSize;
+}
+
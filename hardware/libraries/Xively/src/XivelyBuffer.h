@@ -0,0 +1,36 @@
+
+#ifndef XIVELY_BUFFER_H
+#define XIVELY_BUFFER_H
+
+#include <Print.h>
+
+// A Print that renders into a heap buffer which is kept between uploads,
+// so a feed can be formatted once and sent to the socket in a single write.
+class XivelyBuffer : public Print
+{
+public:
+  XivelyBuffer(size_t aMaxSize = kDefaultMaxSize);
+  ~XivelyBuffer();
+
+  virtual size_t write(uint8_t aByte);
+  virtual size_t write(const uint8_t *aBuffer, size_t aSize);
+
+  // Discard the contents, but keep the allocation for the next render
+  void reset() { _length = 0; _overflow = false; };
+  const uint8_t* data() const { return _buffer; };
+  size_t length() const { return _length; };
+  // True if a write didn't fit under the size limit, so data() is incomplete
+  bool overflow() const { return _overflow; };
+
+  static const size_t kDefaultMaxSize = 4096;
+protected:
+  bool reserve(size_t aSize);
+
+  uint8_t* _buffer;
+  size_t _capacity;
+  size_t _length;
+  size_t _maxSize;
+  bool _overflow;
+};
+
+#endif
@@ -2,8 +2,8 @@
 #include <HttpClient.h>
 #include <CountingStream.h>
 
-XivelyClient::XivelyClient(Client& aClient)
-  : _client(aClient)
+XivelyClient::XivelyClient(Client& aClient, size_t aMaxBodySize)
+  : _client(aClient), _body(aMaxBodySize)
 {
 }
 
@@ -20,25 +20,22 @@ int XivelyClient::put(XivelyFeed& aFeed, const char* aApiKey)
     http.sendHeader("X-ApiKey", aApiKey);
     http.sendHeader("User-Agent", "Xively-Arduino-Lib/1.0");    
 
-    CountingStream countingStream; // Used to work out how long that data will be
-    for (int i =kCalculateDataLength; i <= kSendData; i++)
+    // Render the feed once, so we know the Content-Length and can hand the
+    // whole body to the socket in one write
+    _body.reset();
+    int len = _body.print(aFeed);
+    if (!_body.overflow())
     {
-      Print* s;
-      int len =0;
-      if (i == kCalculateDataLength)
-      {
-        s = &countingStream;
-      }
-      else
-      {
-        s = &http;
-      }
-      len = s->print(aFeed);
-      if (i == kCalculateDataLength)
-      {
-        // We now know how long the data will be...
-        http.sendHeader("Content-Length", len);
-      }
+      http.sendHeader("Content-Length", len);
+      http.write(_body.data(), _body.length());
+    }
+    else
+    {
+      // Too big to buffer, so fall back to working out the length first
+      CountingStream countingStream;
+      len = countingStream.print(aFeed);
+      http.sendHeader("Content-Length", len);
+      http.print(aFeed);
     }
     // Now we're done sending the request
     http.endRequest();
@@ -165,6 +162,11 @@ int XivelyClient::get(XivelyFeed& aFeed, const char* aApiKey)
             break;
           };
         }
+        else if (http.waitFor(SOCKET_READABLE, 1000) & SOCKET_CLOSED)
+        {
+          // Everything the server sent has been read
+          break;
+        }
       }
       delay(10);
     }
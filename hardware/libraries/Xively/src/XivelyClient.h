@@ -4,21 +4,25 @@
 
 #include <Client.h>
 #include <XivelyFeed.h>
+#include <XivelyBuffer.h>
 
 class XivelyClient
 {
 public:
-	XivelyClient(Client& aClient);
+  // aMaxBodySize caps the buffer put() renders the feed into. A feed
+  // that does not fit is printed twice instead, once to work out its
+  // Content-Length and once to the socket; 0 always does that.
+	XivelyClient(Client& aClient, size_t aMaxBodySize = XivelyBuffer::kDefaultMaxSize);
 
   int get(XivelyFeed& aFeed, const char* aApiKey);
   int put(XivelyFeed& aFeed, const char* aApiKey);
 
 protected:
-  static const int kCalculateDataLength =0;
-  static const int kSendData =1;
   void buildPath(char* aDest, unsigned long aFeedId, const char* aFormat);
 
   Client& _client;
+  // Rendered request body, kept between calls to put() to avoid reallocating
+  XivelyBuffer _body;
 };
 
 #endif
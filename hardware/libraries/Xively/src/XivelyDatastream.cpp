@@ -3,19 +3,19 @@
 #include <Arduino.h>
 
 XivelyDatastream::XivelyDatastream(String& aId, int aType)
-  : _idType(DATASTREAM_STRING), _valueType(aType), _idString(aId)
+  : _idType(DATASTREAM_STRING), _valueType(aType), _idString(aId), _valueTextLength(-1)
 {
 }
 
 XivelyDatastream::XivelyDatastream(char* aIdBuffer, int aIdBufferSize, int aType)
-  : _idType(DATASTREAM_BUFFER), _valueType(aType), _idString(), _valueString()
+  : _idType(DATASTREAM_BUFFER), _valueType(aType), _idString(), _valueString(), _valueTextLength(-1)
 {
   _idBuffer._buffer = aIdBuffer;
   _idBuffer._bufferSize = aIdBufferSize;
 }
 
 XivelyDatastream::XivelyDatastream(char* aIdBuffer, int aIdBufferSize, int aType, char* aValueBuffer, int aValueBufferSize)
-  : _idType(DATASTREAM_BUFFER), _valueType(aType)
+  : _idType(DATASTREAM_BUFFER), _valueType(aType), _valueTextLength(-1)
 {
   _idBuffer._buffer = aIdBuffer;
   _idBuffer._bufferSize = aIdBufferSize;
@@ -25,6 +25,7 @@ XivelyDatastream::XivelyDatastream(char* aIdBuffer, int aIdBufferSize, int aType
 
 int XivelyDatastream::updateValue(Stream& aStream)
 {
+  invalidateValueText();
   switch (_valueType)
   {
   case DATASTREAM_INT:
@@ -67,17 +68,19 @@ int XivelyDatastream::timedRead(Stream& aStream)
 
 void XivelyDatastream::setInt(int aValue)
 {
-  if (_valueType == DATASTREAM_INT)
+  if ((_valueType == DATASTREAM_INT) && (_value._valueInt != aValue))
   {
     _value._valueInt = aValue;
+    invalidateValueText();
   }
 }
 
 void XivelyDatastream::setFloat(float aValue)
 {
-  if (_valueType == DATASTREAM_FLOAT)
+  if ((_valueType == DATASTREAM_FLOAT) && (_value._valueFloat != aValue))
   {
     _value._valueFloat = aValue;
+    invalidateValueText();
   }
 }
 
@@ -160,16 +163,53 @@ size_t XivelyDatastream::printTo(Print& aPrint) const
     count += aPrint.print(_value._valueBuffer._buffer);
     break;
   case DATASTREAM_INT:
-    count += aPrint.print(_value._valueInt);
-    break;
   case DATASTREAM_FLOAT:
-    count += aPrint.print(_value._valueFloat);
+    count += printValueTo(aPrint);
     break;
   };
   count += aPrint.print("\" }");
   return count;
 }
 
+// Collects the output of Print's number formatting into _valueText
+class ValueTextPrint : public Print
+{
+public:
+  ValueTextPrint(char* aBuffer, size_t aSize) : _buffer(aBuffer), _size(aSize), _length(0) {};
+  virtual size_t write(uint8_t aByte)
+  {
+    if (_length >= _size)
+    {
+      return 0;
+    }
+    _buffer[_length++] = aByte;
+    return 1;
+  };
+  size_t length() { return _length; };
+protected:
+  char* _buffer;
+  size_t _size;
+  size_t _length;
+};
+
+size_t XivelyDatastream::printValueTo(Print& aPrint) const
+{
+  if (_valueTextLength < 0)
+  {
+    ValueTextPrint text(_valueText, sizeof(_valueText));
+    if (_valueType == DATASTREAM_INT)
+    {
+      text.print(_value._valueInt);
+    }
+    else
+    {
+      text.print(_value._valueFloat);
+    }
+    _valueTextLength = text.length();
+  }
+  return aPrint.write((const uint8_t*)_valueText, _valueTextLength);
+}
+
 #if 0
 DatastreamBufferInt::DatastreamBufferInt(char* aId, int aIdLength, int aValue)
   : _id(aId), _idLength(aIdLength), _value(aValue)
@@ -36,6 +36,9 @@ protected:
   char idChar(int idx) { return (_idType == DATASTREAM_STRING ? _idString[idx] : (idx > strlen(_idBuffer._buffer) ? '\0' : _idBuffer._buffer[idx])); };
   // FIXME Only needed until readStringUntil is available in core
   int timedRead(Stream& aStream);
+  // Formatted text of an int or float value, reused until the value changes
+  size_t printValueTo(Print& aPrint) const;
+  void invalidateValueText() { _valueTextLength = -1; };
 
   int _idType;
   String _idString;
@@ -47,6 +50,8 @@ protected:
     int _valueInt;
     float _valueFloat;
   } _value;
+  mutable char _valueText[16];
+  mutable int _valueTextLength;
 };
 
 #endif
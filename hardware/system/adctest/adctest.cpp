@@ -0,0 +1,327 @@
+/*
+ * Runs cores/arduino/ADCSampler.cpp against a model of the ADC and its
+ * DMA: the model fills the block the sampler gave it with known values,
+ * moves the clock on by the conversion time and raises the DMA
+ * interrupt. Checks what the callbacks get against the same values
+ * decimated here. See README.md.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "ADCSampler.h"
+#include "us_ticker_api.h"
+
+/******************************************************************************
+ * ADC model
+ ******************************************************************************/
+
+struct AdcModel {
+	uint32_t native;	// conversion frames per second
+	uint64_t frame;		// next frame the ADC converts
+	uint64_t clockNs;
+	uint32_t *armed;	// block of the pending DMA transfer
+	uint32_t words;
+	uint32_t *filled;	// block of the interrupt being handled
+	bool running;
+	bool failBegin;
+	int errors;		// DMA restarted wrongly
+};
+
+static AdcModel adc;
+
+uint32_t us_ticker_read(void)
+{
+	return (uint32_t)(adc.clockNs / 1000);
+}
+
+int adc_sampler_hw_begin(uint8_t channel)
+{
+	if (adc.failBegin) return -1;
+	adc.running = true;
+	return 0;
+}
+
+void adc_sampler_hw_receive(uint32_t *buf, uint32_t words)
+{
+	// one transfer at a time, never into the block being read
+	if (adc.armed != NULL || buf == adc.filled) adc.errors++;
+	adc.armed = buf;
+	adc.words = words;
+}
+
+void adc_sampler_hw_end(void)
+{
+	adc.running = false;
+	adc.armed = NULL;
+}
+
+static uint16_t adc_value(uint64_t frame, int channel)
+{
+	return (uint16_t)(frame * 37 + channel * 10007 + (frame >> 5) * 3);
+}
+
+static void adc_reset(uint32_t native)
+{
+	memset(&adc, 0, sizeof(adc));
+	adc.native = native;
+	adc.frame = 1000;
+	adc.clockNs = 5000000;
+}
+
+/*
+ * Fill the pending block and raise the DMA interrupt. lostFrames are
+ * converted while nobody drains the FIFO: they are lost and the
+ * interrupt comes that much later.
+ */
+static bool adc_complete(uint32_t lostFrames = 0)
+{
+	uint32_t *buf = adc.armed;
+	uint32_t frames;
+
+	if (buf == NULL) return false;
+
+	adc.frame += lostFrames;
+	adc.clockNs += (uint64_t)lostFrames * 1000000000 / adc.native;
+
+	frames = adc.words / 2;
+	for (uint32_t f = 0; f < frames; f++) {
+		for (int ch = 0; ch < 4; ch++) {
+			uint16_t *half = (uint16_t *)&buf[f * 2 + ch / 2];
+			half[ch & 1] = adc_value(adc.frame + f, ch);
+		}
+	}
+	adc.frame += frames;
+	adc.clockNs += (uint64_t)frames * 1000000000 / adc.native;
+
+	adc.armed = NULL;
+	adc.filled = buf;
+	ADCSampler.dmaDone();
+	adc.filled = NULL;
+	return true;
+}
+
+/******************************************************************************
+ * Callback record
+ ******************************************************************************/
+
+struct Half {
+	const uint16_t *ptr;
+	uint32_t frames;
+	std::vector<uint16_t> data;
+};
+
+static std::vector<Half> halves;
+static uint8_t cbCount;		// pins of the current run
+static bool rearmedFirst;	// DMA was pending in every callback
+static bool heldIntact;		// each half unchanged until the next callback
+
+static void on_buffer(const uint16_t *samples, uint32_t frames, void *arg)
+{
+	if (adc.armed == NULL) rearmedFirst = false;
+
+	if (!halves.empty()) {
+		const Half &last = halves.back();
+		if (memcmp(last.ptr, last.data.data(), last.data.size() * 2) != 0) heldIntact = false;
+	}
+
+	Half h;
+	h.ptr = samples;
+	h.frames = frames;
+	h.data.assign(samples, samples + frames * cbCount);
+	halves.push_back(h);
+	*(int *)arg += 1;
+}
+
+/******************************************************************************
+ * Checks
+ ******************************************************************************/
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+	printf("  %-52s %s\n", what, ok ? "ok" : "FAILED");
+	if (!ok) {
+		failures++;
+	}
+}
+
+static const uint8_t pin_channel[] = { 2, 2, 3 };
+
+/* First frame the sampler keeps: the calibration blocks are dropped */
+static uint64_t first_frame(uint64_t begin)
+{
+	return begin + (uint64_t)(ADC_SAMPLER_CAL_BLOCKS + 1) * ADC_SAMPLER_DMA_FRAMES;
+}
+
+/* Compare every half received with the model decimated here */
+static bool data_matches(const uint8_t *pins, uint8_t count, uint64_t start, uint32_t decimation, bool averaging)
+{
+	uint64_t frame = start;
+
+	for (size_t n = 0; n < halves.size(); n++) {
+		const Half &h = halves[n];
+		for (uint32_t s = 0; s < h.frames; s++, frame += decimation) {
+			for (int i = 0; i < count; i++) {
+				int ch = pin_channel[pins[i]];
+				uint32_t want = 0;
+
+				if (averaging) {
+					for (uint32_t d = 0; d < decimation; d++) want += adc_value(frame + d, ch);
+					want /= decimation;
+				} else {
+					want = adc_value(frame, ch);
+				}
+				if (h.data[s * count + i] != want) {
+					printf("    half %zu sample %u pin %d: %u, want %u\n", n, s, pins[i], h.data[s * count + i], want);
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+/* Both halves used in turn, each frames * count long */
+static bool halves_alternate(uint32_t frames, uint8_t count)
+{
+	if (halves.size() < 3) return false;
+
+	const uint16_t *a = halves[0].ptr, *b = halves[1].ptr;
+	if (b - a != (ptrdiff_t)(frames * count)) return false;
+
+	for (size_t n = 0; n < halves.size(); n++) {
+		if (halves[n].ptr != ((n & 1) ? b : a) || halves[n].frames != frames) return false;
+	}
+	return true;
+}
+
+struct Run {
+	const char *name;
+	uint32_t native;
+	const uint8_t *pins;
+	uint8_t count;
+	uint32_t rate;
+	uint32_t frames;
+	bool averaging;
+	uint32_t decimation;	// expected
+};
+
+static void run(const Run &r)
+{
+	int calls = 0;
+	uint64_t begin;
+	uint32_t blocks;
+	char what[80];
+
+	printf("\n%s\n", r.name);
+
+	adc_reset(r.native);
+	halves.clear();
+	cbCount = r.count;
+	rearmedFirst = true;
+	heldIntact = true;
+	begin = adc.frame;
+
+	ADCSampler.setAveraging(r.averaging);
+	check(ADCSampler.begin(r.pins, r.count, r.rate, r.frames, on_buffer, &calls) == 1, "begin()");
+
+	// enough blocks for six halves after calibration
+	blocks = ADC_SAMPLER_CAL_BLOCKS + 1 +
+		(6 * r.frames * r.decimation + ADC_SAMPLER_DMA_FRAMES - 1) / ADC_SAMPLER_DMA_FRAMES;
+	for (uint32_t b = 0; b < blocks; b++) adc_complete();
+
+	snprintf(what, sizeof(what), "decimation %u, %u samples/s", ADCSampler.decimation(), ADCSampler.sampleRate());
+	uint32_t want = (r.native + r.decimation / 2) / r.decimation;
+	check(ADCSampler.decimation() == r.decimation &&
+	      ADCSampler.sampleRate() >= want - want / 1000 && ADCSampler.sampleRate() <= want + want / 1000, what);
+
+	check(calls >= 6 && (uint32_t)calls == ADCSampler.buffersFilled(), "a callback per filled half");
+	check(halves_alternate(r.frames, r.count), "halves used in turn");
+	check(data_matches(r.pins, r.count, first_frame(begin), r.decimation, r.averaging), "samples match the ADC");
+	check(rearmedFirst && adc.errors == 0, "DMA restarted into the other block first");
+	check(heldIntact, "half untouched until the other one is full");
+	check(ADCSampler.overruns() == 0, "no overruns");
+
+	ADCSampler.end();
+	check(!adc.running && !ADCSampler.running(), "end() stops the DMA");
+}
+
+static void fault_tests(void)
+{
+	static const uint8_t one[] = { 2 };
+	static const uint8_t five[] = { 0, 1, 2, 0, 1 };
+	static const uint8_t bad[] = { 3 };
+	int calls = 0;
+
+	printf("\nfaults\n");
+
+	adc_reset(50000);
+	check(ADCSampler.begin(one, 0, 0, 64, on_buffer, &calls) == 0 &&
+	      ADCSampler.begin(five, 5, 0, 64, on_buffer, &calls) == 0 &&
+	      ADCSampler.begin(bad, 1, 0, 64, on_buffer, &calls) == 0 &&
+	      ADCSampler.begin(one, 1, 0, 0, on_buffer, &calls) == 0 &&
+	      ADCSampler.begin(one, 1, 0, 64, NULL, &calls) == 0 &&
+	      !adc.running, "bad arguments refused");
+
+	adc.failBegin = true;
+	check(ADCSampler.begin(one, 1, 0, 64, on_buffer, &calls) == 0 && !ADCSampler.running(),
+	      "ADC that does not start refused");
+	adc.failBegin = false;
+
+	// late interrupt
+	adc_reset(50000);
+	halves.clear();
+	cbCount = 1;
+	ADCSampler.setAveraging(true);
+	ADCSampler.begin(one, 1, 0, 64, on_buffer, &calls);
+	for (int b = 0; b < ADC_SAMPLER_CAL_BLOCKS + 4; b++) adc_complete();
+	adc_complete(ADC_SAMPLER_DMA_FRAMES / 4);
+	check(ADCSampler.overruns() == 0, "interrupt a quarter block late: no overrun");
+	adc_complete(ADC_SAMPLER_DMA_FRAMES * 3 / 2);
+	check(ADCSampler.overruns() == 1, "interrupt 1.5 blocks late: overrun");
+
+	// an interrupt that was already pending when end() ran
+	ADCSampler.end();
+	calls = 0;
+	adc.armed = NULL;
+	ADCSampler.dmaDone();
+	check(calls == 0 && adc.armed == NULL, "interrupt after end(): ignored");
+
+	// and again
+	adc_reset(50000);
+	halves.clear();
+	uint64_t begin = adc.frame;
+	check(ADCSampler.begin(one, 1, 0, 64, on_buffer, &calls) == 1, "begin() after end()");
+	for (int b = 0; b < ADC_SAMPLER_CAL_BLOCKS + 1 + 4; b++) adc_complete();
+	check(halves.size() == 4 && data_matches(one, 1, first_frame(begin), 1, true), "samples match after a restart");
+	ADCSampler.end();
+}
+
+int main(int argc, char **argv)
+{
+	static const uint8_t a2[] = { 2 };
+	static const uint8_t a0a2[] = { 0, 2 };
+	static const uint8_t three[] = { 2, 0, 1 };
+
+	static const Run runs[] = {
+		{ "one pin, every conversion, half of 100",   50000, a2,   1, 0,      100, true,  1 },
+		{ "two pins, 48000 averaged down to 6000",    48000, a0a2, 2, 6000,   32,  true,  8 },
+		{ "two pins, 48000 down to 6000, no average", 48000, a0a2, 2, 6000,   32,  false, 8 },
+		{ "three pins, 50000 down to about 7000",     50000, three, 3, 7000,  50,  true,  7 },
+		{ "rate above the ADC clock",                 20000, a2,   1, 100000, 64,  true,  1 },
+		{ "large decimation, half of one sample",     50000, a0a2, 2, 100,    1,   true,  500 },
+	};
+
+	for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); i++) {
+		run(runs[i]);
+	}
+	fault_tests();
+
+	printf("\n%s\n", failures ? "FAILED" : "all ok");
+	return failures ? 1 : 0;
+}
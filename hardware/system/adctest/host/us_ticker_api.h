@@ -0,0 +1,13 @@
+/*
+ * Host stand-in for the microsecond ticker of libameba, for
+ * system/adctest. The clock only moves when the ADC model says so.
+ */
+
+#ifndef ADCTEST_US_TICKER_API_H
+#define ADCTEST_US_TICKER_API_H
+
+#include <stdint.h>
+
+uint32_t us_ticker_read(void);
+
+#endif
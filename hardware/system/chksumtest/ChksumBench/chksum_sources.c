@@ -0,0 +1,11 @@
+/* The Thumb-2 routines of lwip-sys/arch, built into the sketch under names
+   of their own, so they cannot clash with whatever the libraries link. The
+   sketch include path has lwip-sys in it. */
+
+#define thumb2_memcpy       bench_memcpy
+#define thumb2_checksum     bench_checksum
+#define thumb2_chksum_copy  bench_chksum_copy
+
+#include "arch/memcpy.c"
+#include "arch/checksum.c"
+#include "arch/chksum_copy.c"
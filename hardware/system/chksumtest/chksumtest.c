@@ -0,0 +1,256 @@
+/*
+ * Tests thumb2_chksum_copy() (libameba/sw/lib/net/lwip-sys/arch/chksum_copy.c)
+ * on the host. The host builds its portable C version. A model of the
+ * Thumb-2 version's registers and carry flag runs next to it. Both must
+ * copy exactly and return the RFC 1071 sum of the data for every alignment
+ * and length, and their sums must add up the way tcp_write() adds them.
+ * See README.md.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+uint16_t thumb2_chksum_copy(void* pDest, const void* pSource, int length);
+
+#define MAX_LEN		1500	// an Ethernet MTU of payload
+#define ALIGNS		8	// source and destination offsets 0 to 7
+#define GUARD		16	// bytes checked on each side of the copy
+#define GUARD_BYTE	0xa5
+
+/******************************************************************************
+ * References
+ ******************************************************************************/
+
+// RFC 1071 over the bytes in network order, with an odd last byte as the
+// high half of a 16-bit unit. Swapped, it is the sum of the same data read
+// as little-endian units, which lwIP uses on both the host and the board.
+static uint16_t rfc1071_sum(const uint8_t *data, int length)
+{
+	uint64_t sum = 0;
+	int i;
+
+	for (i = 0; i + 1 < length; i += 2)
+		sum += (data[i] << 8) | data[i + 1];
+	if (length & 1)
+		sum += data[length - 1] << 8;
+	while (sum >> 16)
+		sum = (sum >> 16) + (sum & 0xffff);
+	return (uint16_t)((sum >> 8) | (sum << 8));
+}
+
+static uint32_t load32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// adds/adcs: rd = a + b + carry, and the carry out
+static uint32_t add_carry(uint32_t a, uint32_t b, int *carry)
+{
+	uint64_t r = (uint64_t)a + b + *carry;
+
+	*carry = (int)(r >> 32);
+	return (uint32_t)r;
+}
+
+// The Thumb-2 version step by step: r3 is the sum, r4-r7 the words loaded.
+// A carry the code drops, or folds twice, shows up against rfc1071_sum().
+static uint16_t model_chksum_copy(uint8_t *dst, const uint8_t *src, int length)
+{
+	uint32_t r3 = 0, r4;
+	int carry;
+
+	while (length >= 16) {
+		memcpy(dst, src, 16);
+		carry = 0;
+		r3 = add_carry(r3, load32(src), &carry);
+		r3 = add_carry(r3, load32(src + 4), &carry);
+		r3 = add_carry(r3, load32(src + 8), &carry);
+		r3 = add_carry(r3, load32(src + 12), &carry);
+		r3 = r3 + carry;			// adc r3, r3, #0
+		src += 16;
+		dst += 16;
+		length -= 16;
+	}
+	while (length >= 4) {
+		memcpy(dst, src, 4);
+		carry = 0;
+		r3 = add_carry(r3, load32(src), &carry);
+		r3 = r3 + carry;
+		src += 4;
+		dst += 4;
+		length -= 4;
+	}
+	if (length >= 2) {
+		memcpy(dst, src, 2);
+		carry = 0;
+		r3 = add_carry(r3, src[0] | (src[1] << 8), &carry);
+		r3 = r3 + carry;
+		src += 2;
+		dst += 2;
+		length -= 2;
+	}
+	if (length > 0) {
+		*dst = *src;
+		carry = 0;
+		r3 = add_carry(r3, *src, &carry);
+		r3 = r3 + carry;
+	}
+	r4 = r3 >> 16;
+	r3 = (r3 & 0xffff) + r4;
+	r4 = r3 >> 16;
+	r3 = (r3 & 0xffff) + r4;
+	return (uint16_t)r3;
+}
+
+// tcp_seg_add_chksum() of lwIP's core/tcp_out.c, which is static there:
+// how tcp_write() adds up the sums of the pieces it copies into a segment
+static void seg_add_chksum(uint16_t chksum, int len, uint16_t *seg_chksum, int *swapped)
+{
+	uint32_t helper = chksum + *seg_chksum;
+
+	helper = (helper >> 16) + (helper & 0xffff);
+	if (len & 1) {
+		*swapped = 1 - *swapped;
+		helper = ((helper & 0xff) << 8) | ((helper >> 8) & 0xff);
+	}
+	*seg_chksum = (uint16_t)helper;
+}
+
+/******************************************************************************
+ * Tests
+ ******************************************************************************/
+
+enum { RANDOM, ONES, ALTERNATE, ZEROS, PATTERNS };
+
+static const char *const pattern_name[PATTERNS] = {
+	"random bytes", "all 0xff", "0xff and 0x00 in turn", "all 0x00"
+};
+
+static uint8_t source[MAX_LEN + ALIGNS];
+static uint8_t dest[GUARD + MAX_LEN + ALIGNS + GUARD];
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+	printf("  %-52s %s\n", what, ok ? "ok" : "FAILED");
+	if (!ok) {
+		failures++;
+	}
+}
+
+static void fill(int pattern)
+{
+	int i;
+
+	for (i = 0; i < (int)sizeof(source); i++) {
+		switch (pattern) {
+		case RANDOM:	source[i] = (uint8_t)rand(); break;
+		case ONES:	source[i] = 0xff; break;
+		case ALTERNATE:	source[i] = (i & 1) ? 0x00 : 0xff; break;
+		default:	source[i] = 0x00; break;
+		}
+	}
+}
+
+// True if the copy of length bytes at dest + GUARD + offset is exact and
+// no byte around it was written
+static bool copied(int offset, const uint8_t *src, int length)
+{
+	int i;
+
+	if (memcmp(dest + GUARD + offset, src, length) != 0)
+		return false;
+	for (i = 0; i < GUARD + offset; i++) {
+		if (dest[i] != GUARD_BYTE)
+			return false;
+	}
+	for (i = GUARD + offset + length; i < (int)sizeof(dest); i++) {
+		if (dest[i] != GUARD_BYTE)
+			return false;
+	}
+	return true;
+}
+
+static void test_pattern(int pattern)
+{
+	int s, d, length;
+	bool sums = true, copies = true, model = true;
+
+	fill(pattern);
+	for (s = 0; s < ALIGNS; s++) {
+		for (d = 0; d < ALIGNS; d++) {
+			for (length = 0; length <= MAX_LEN; length++) {
+				uint16_t want = rfc1071_sum(source + s, length);
+				uint16_t sum;
+
+				memset(dest, GUARD_BYTE, sizeof(dest));
+				sum = thumb2_chksum_copy(dest + GUARD + d, source + s, length);
+				sums = sums && sum == want;
+				copies = copies && copied(d, source + s, length);
+
+				memset(dest, GUARD_BYTE, sizeof(dest));
+				sum = model_chksum_copy(dest + GUARD + d, source + s, length);
+				model = model && sum == want && copied(d, source + s, length);
+			}
+		}
+	}
+	printf("%s\n", pattern_name[pattern]);
+	check(copies, "copy exact, nothing written around it");
+	check(sums, "sum is RFC 1071's");
+	check(model, "Thumb-2 model copies and sums the same");
+}
+
+// Copies a random buffer in random pieces and adds up their sums as
+// tcp_write() does, for both versions
+static void test_pieces(void)
+{
+	int run;
+	bool c_ok = true, model_ok = true;
+
+	printf("pieces added up as tcp_write() does\n");
+	fill(RANDOM);
+	for (run = 0; run < 100000; run++) {
+		int length = 1 + rand() % MAX_LEN;
+		int s = rand() % ALIGNS, d = rand() % ALIGNS;
+		uint16_t c_sum = 0, model_sum = 0;
+		int c_swapped = 0, model_swapped = 0;
+		int pos = 0;
+
+		while (pos < length) {
+			int piece = 1 + rand() % (length - pos);
+
+			if (rand() % 2)
+				piece = 1 + rand() % (piece < 8 ? piece : 8);
+			seg_add_chksum(thumb2_chksum_copy(dest + GUARD + d + pos, source + s + pos, piece),
+				       piece, &c_sum, &c_swapped);
+			seg_add_chksum(model_chksum_copy(dest + GUARD + d + pos, source + s + pos, piece),
+				       piece, &model_sum, &model_swapped);
+			pos += piece;
+		}
+		// tcp_output_segment() swaps a swapped sum back
+		if (c_swapped)
+			c_sum = (uint16_t)((c_sum << 8) | (c_sum >> 8));
+		if (model_swapped)
+			model_sum = (uint16_t)((model_sum << 8) | (model_sum >> 8));
+		c_ok = c_ok && c_sum == rfc1071_sum(source + s, length);
+		model_ok = model_ok && model_sum == rfc1071_sum(source + s, length);
+	}
+	check(c_ok, "100000 buffers in pieces of 1 byte and up");
+	check(model_ok, "Thumb-2 model the same");
+}
+
+int main(int argc, char **argv)
+{
+	int pattern;
+
+	srand(1);
+	for (pattern = 0; pattern < PATTERNS; pattern++)
+		test_pattern(pattern);
+	test_pieces();
+
+	printf("\n%s\n", failures ? "FAILED" : "all ok");
+	return failures ? 1 : 0;
+}
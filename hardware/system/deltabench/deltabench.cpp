@@ -0,0 +1,490 @@
+/*
+ * Builds ram_all.bin images of a modelled sketch before and after some
+ * typical edits, makes the delta with the code of binfiletool and applies
+ * it with cores/arduino/FlashDelta.cpp to a simulated flash. Reports the
+ * bytes that have to be sent and the flash work, and checks that the
+ * flash ends up holding the new image. See README.md.
+ *
+ *   deltabench [seed]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#define BINFILETOOL_NO_MAIN
+#include "../../../ameba-tools-mac/src/binfiletool.cpp"
+
+#include "FlashDelta.h"
+#include "flash_api.h"
+
+/******************************************************************************
+ * Simulated flash
+ ******************************************************************************/
+
+#define SIM_FLASH_SIZE		0x200000
+
+// W25Q16-class part: 4KB erase and 256 byte page program, typical times
+#define SIM_ERASE_US		45000
+#define SIM_PAGE_US		700
+
+struct flash_s {
+	uint8_t data[SIM_FLASH_SIZE];
+	uint32_t erases;
+	uint32_t pages;
+	uint32_t programmed;
+	bool bad;		// programming silently drops the data
+};
+
+flash_t flash;
+
+void flash_erase_sector(flash_t *obj, uint32_t address)
+{
+	address &= ~(FLASH_DELTA_SECTOR_SIZE - 1);
+	memset(obj->data + address, 0xFF, FLASH_DELTA_SECTOR_SIZE);
+	obj->erases++;
+}
+
+int flash_stream_read(flash_t *obj, uint32_t address, uint32_t len, uint8_t *data)
+{
+	memcpy(data, obj->data + address, len);
+	return 1;
+}
+
+int flash_stream_write(flash_t *obj, uint32_t address, uint32_t len, uint8_t *data)
+{
+	obj->pages += (address + len + 255) / 256 - address / 256;
+	obj->programmed += len;
+	if (obj->bad) {
+		return 1;
+	}
+	for (uint32_t i = 0; i < len; i++) {
+		obj->data[address + i] &= data[i];
+	}
+	return 1;
+}
+
+static void sim_load(const std::vector<char> &image)
+{
+	memset(flash.data, 0xFF, sizeof(flash.data));
+	memcpy(flash.data, image.data(), image.size());
+	flash.erases = flash.pages = flash.programmed = 0;
+	flash.bad = false;
+}
+
+static bool sim_holds(const std::vector<char> &image)
+{
+	return memcmp(flash.data, image.data(), image.size()) == 0;
+}
+
+/******************************************************************************
+ * Sketch model
+ ******************************************************************************/
+
+/*
+ * image2 as rlx8195A.ld lays it out: the prebuilt .wifi/.img2 sections,
+ * then .text in link order (the sketch and library objects, then core.a
+ * and the prebuilt archives), .data, .ARM.exidx and .tcm. .bss follows
+ * in BD_RAM. Functions call each other with pc relative branches and load
+ * the addresses of variables and other functions from literal pools, so
+ * moving code changes bytes wherever it is referenced.
+ */
+
+enum Group { PREBUILT, SKETCH, LIBRARY, CORE, ARCHIVE, GROUPS };
+
+enum RefKind { CALL, FUNC_ADDR, DATA_ADDR, BSS_ADDR };
+
+struct Ref {
+	uint32_t at;		// offset in the function
+	RefKind kind;
+	int target;		// function, data or bss variable
+};
+
+struct Func {
+	Group group;
+	uint32_t size;
+	uint32_t seed;		// body bytes
+	std::vector<Ref> refs;
+};
+
+struct Var {
+	Group group;
+	uint32_t size;
+	uint32_t seed;
+};
+
+struct Program {
+	std::vector<Func> funcs;
+	std::vector<Var> data;
+	std::vector<Var> bss;
+	uint32_t tcm_size;
+};
+
+#define IMAGE2_ADDR		0x1000B000
+#define IMAGE1_SIZE		45056
+
+static std::mt19937 rng;
+
+static uint32_t rnd(uint32_t lo, uint32_t hi)
+{
+	return std::uniform_int_distribution<uint32_t>(lo, hi)(rng);
+}
+
+static void add_refs(Program &p, Func &f, int count)
+{
+	for (int i = 0; i < count; i++) {
+		Ref r;
+		r.at = rnd(0, f.size / 4 - 1) * 4;
+		uint32_t kind = rnd(0, 99);
+		if (kind < 60) {
+			r.kind = CALL;
+			r.target = rnd(0, p.funcs.size() - 1);
+		} else if (kind < 70) {
+			r.kind = FUNC_ADDR;
+			r.target = rnd(0, p.funcs.size() - 1);
+		} else if (kind < 85) {
+			r.kind = DATA_ADDR;
+			r.target = rnd(0, p.data.size() - 1);
+		} else {
+			r.kind = BSS_ADDR;
+			r.target = rnd(0, p.bss.size() - 1);
+		}
+		f.refs.push_back(r);
+	}
+}
+
+static void add_object(Program &p, Group group, int funcs, int data, int bss)
+{
+	for (int i = 0; i < funcs; i++) {
+		Func f;
+		f.group = group;
+		f.size = rnd(4, 80) * 4;
+		f.seed = rng();
+		p.funcs.push_back(f);
+	}
+	for (int i = 0; i < data; i++) {
+		Var v = { group, rnd(1, 16) * 4, (uint32_t)rng() };
+		p.data.push_back(v);
+	}
+	for (int i = 0; i < bss; i++) {
+		Var v = { group, rnd(1, 64) * 4, 0 };
+		p.bss.push_back(v);
+	}
+}
+
+// About 350KB of image2, like a WiFi sketch
+static Program make_program(void)
+{
+	Program p;
+
+	add_object(p, PREBUILT, 700, 0, 0);
+	add_object(p, SKETCH, 12, 6, 10);
+	add_object(p, LIBRARY, 160, 40, 60);
+	add_object(p, CORE, 220, 60, 80);
+	add_object(p, ARCHIVE, 1000, 200, 300);
+	p.tcm_size = 6 * 1024;
+
+	for (size_t i = 0; i < p.funcs.size(); i++) {
+		add_refs(p, p.funcs[i], rnd(1, 6));
+	}
+	return p;
+}
+
+static void put32(std::vector<char> &buf, uint32_t at, uint32_t value)
+{
+	for (int i = 0; i < 4; i++) {
+		buf[at + i] = (char)(value >> (8 * i));
+	}
+}
+
+static void fill(std::vector<char> &buf, uint32_t at, uint32_t size, uint32_t seed)
+{
+	std::mt19937 body(seed);
+	for (uint32_t i = 0; i < size; i++) {
+		buf[at + i] = (char)body();
+	}
+}
+
+static std::vector<char> link(const Program &p)
+{
+	std::vector<uint32_t> func_addr(p.funcs.size());
+	std::vector<uint32_t> data_addr(p.data.size());
+	std::vector<uint32_t> bss_addr(p.bss.size());
+	uint32_t addr = IMAGE2_ADDR;
+
+	// link order: objects are kept in group order
+	for (int g = 0; g < GROUPS; g++) {
+		for (size_t i = 0; i < p.funcs.size(); i++) {
+			if (p.funcs[i].group == g) {
+				func_addr[i] = addr;
+				addr += p.funcs[i].size;
+			}
+		}
+	}
+	for (int g = 0; g < GROUPS; g++) {
+		for (size_t i = 0; i < p.data.size(); i++) {
+			if (p.data[i].group == g) {
+				data_addr[i] = addr;
+				addr += p.data[i].size;
+			}
+		}
+	}
+	uint32_t exidx = addr;
+	addr += 8 * p.funcs.size();
+	uint32_t tcm = addr;
+	addr += p.tcm_size;
+	uint32_t end = addr;
+	for (int g = 0; g < GROUPS; g++) {
+		for (size_t i = 0; i < p.bss.size(); i++) {
+			if (p.bss[i].group == g) {
+				bss_addr[i] = addr;
+				addr += p.bss[i].size;
+			}
+		}
+	}
+
+	uint32_t image2_size = end - IMAGE2_ADDR;
+	std::vector<char> image(IMAGE1_SIZE + 16 + image2_size, (char)0xFF);
+	fill(image, 0, IMAGE1_SIZE, 1);
+	put32(image, IMAGE1_SIZE, image2_size);
+	put32(image, IMAGE1_SIZE + 4, IMAGE2_ADDR);
+
+	uint32_t body = IMAGE1_SIZE + 16 - IMAGE2_ADDR;
+	for (size_t i = 0; i < p.funcs.size(); i++) {
+		const Func &f = p.funcs[i];
+		fill(image, body + func_addr[i], f.size, f.seed);
+		for (size_t r = 0; r < f.refs.size(); r++) {
+			const Ref &ref = f.refs[r];
+			uint32_t site = func_addr[i] + ref.at;
+			uint32_t value = 0;
+			switch (ref.kind) {
+			case CALL:	value = func_addr[ref.target] - site; break;
+			case FUNC_ADDR:	value = func_addr[ref.target] | 1; break;
+			case DATA_ADDR:	value = data_addr[ref.target]; break;
+			case BSS_ADDR:	value = bss_addr[ref.target]; break;
+			}
+			put32(image, body + site, value);
+		}
+	}
+	for (size_t i = 0; i < p.data.size(); i++) {
+		fill(image, body + data_addr[i], p.data[i].size, p.data[i].seed);
+	}
+	// .ARM.exidx: prel31 offset to the function, then EXIDX_CANTUNWIND
+	for (size_t i = 0; i < p.funcs.size(); i++) {
+		uint32_t entry = exidx + 8 * i;
+		put32(image, body + entry, (func_addr[i] - entry) & 0x7FFFFFFF);
+		put32(image, body + entry + 4, 1);
+	}
+	fill(image, body + tcm, p.tcm_size, 2);
+
+	return image;
+}
+
+static int pick(const Program &p, Group group)
+{
+	std::vector<int> in_group;
+	for (size_t i = 0; i < p.funcs.size(); i++) {
+		if (p.funcs[i].group == group) {
+			in_group.push_back(i);
+		}
+	}
+	return in_group[rnd(0, in_group.size() - 1)];
+}
+
+/******************************************************************************
+ * Edits
+ ******************************************************************************/
+
+struct Edit {
+	const char *name;
+	const char *what;
+	void (*apply)(Program &p);
+};
+
+static void edit_none(Program &)
+{
+}
+
+// A new constant in a sketch function, same size
+static void edit_constant(Program &p)
+{
+	p.funcs[pick(p, SKETCH)].seed++;
+}
+
+// A core or library function fixed without changing its size
+static void edit_core_fix(Program &p)
+{
+	p.funcs[pick(p, CORE)].seed++;
+}
+
+// A few more lines in loop()
+static void edit_sketch_grows(Program &p)
+{
+	Func &f = p.funcs[pick(p, SKETCH)];
+	f.size += 96;
+	f.seed++;
+	add_refs(p, f, 2);
+}
+
+// A new global buffer in the sketch
+static void edit_new_global(Program &p)
+{
+	Var v = { SKETCH, 256, 0 };
+	p.bss.insert(p.bss.begin(), v);
+	for (size_t i = 0; i < p.funcs.size(); i++) {
+		for (size_t r = 0; r < p.funcs[i].refs.size(); r++) {
+			if (p.funcs[i].refs[r].kind == BSS_ADDR) {
+				p.funcs[i].refs[r].target++;
+			}
+		}
+	}
+	Func &f = p.funcs[pick(p, SKETCH)];
+	f.seed++;
+	f.refs.push_back((Ref){ 0, BSS_ADDR, 0 });
+}
+
+// #include of another library
+static void edit_new_library(Program &p)
+{
+	size_t first = p.funcs.size();
+	add_object(p, LIBRARY, 25, 4, 6);
+	for (size_t i = first; i < p.funcs.size(); i++) {
+		add_refs(p, p.funcs[i], rnd(1, 6));
+	}
+	Func &f = p.funcs[pick(p, SKETCH)];
+	f.size += 16;
+	f.seed++;
+	f.refs.push_back((Ref){ 0, CALL, (int)first });
+}
+
+static const Edit edits[] = {
+	{ "rebuild", "nothing changed", edit_none },
+	{ "constant", "sketch constant, same size", edit_constant },
+	{ "core-fix", "core function, same size", edit_core_fix },
+	{ "sketch+96", "sketch function grows 96 bytes", edit_sketch_grows },
+	{ "global", "new 256 byte global in the sketch", edit_new_global },
+	{ "library", "another library linked in", edit_new_library },
+};
+
+/******************************************************************************
+ * Apply
+ ******************************************************************************/
+
+// Feed the delta in pieces of random size, as they come off a socket
+static int apply(const std::vector<char> &delta, size_t max_chunk)
+{
+	if (!flashDelta.begin()) {
+		return 0;
+	}
+	size_t done = 0;
+	while (done < delta.size()) {
+		size_t n = std::min((size_t)rnd(1, max_chunk), delta.size() - done);
+		if (flashDelta.write((const uint8_t *)&delta[done], n) != n) {
+			return 0;
+		}
+		done += n;
+	}
+	return flashDelta.end();
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+	printf("  %-44s %s\n", what, ok ? "ok" : "FAILED");
+	if (!ok) {
+		failures++;
+	}
+}
+
+static void fault_tests(const std::vector<char> &base, const std::vector<char> &image)
+{
+	image_manifest manifest;
+	std::vector<char> delta;
+
+	make_manifest(base, manifest);
+	make_delta(image, manifest, delta);
+
+	printf("\nfault checks\n");
+
+	sim_load(base);
+	check(apply(delta, 1) && sim_holds(image), "applied one byte at a time");
+
+	flash.erases = 0;
+	check(apply(delta, 1500) && flash.erases == 0 && sim_holds(image), "applied twice, second time writes nothing");
+
+	std::vector<char> other = base;
+	other[100] ^= 1;
+	sim_load(other);
+	check(!apply(delta, 1500) && flashDelta.error() == FLASH_DELTA_ERR_BASE && flash.erases == 0,
+	      "other base image: refused, nothing written");
+
+	std::vector<char> corrupt = delta;
+	corrupt[corrupt.size() - 10] ^= 0x40;
+	sim_load(base);
+	check(!apply(corrupt, 1500) && flashDelta.error() == FLASH_DELTA_ERR_CRC, "corrupt record: refused");
+
+	std::vector<char> cut(delta.begin(), delta.end() - 100);
+	sim_load(base);
+	check(!apply(cut, 1500) && flashDelta.error() == FLASH_DELTA_ERR_FORMAT, "delta cut short: refused");
+
+	std::vector<char> longer = delta;
+	longer.push_back(0);
+	sim_load(base);
+	check(!apply(longer, 1500) && flashDelta.error() == FLASH_DELTA_ERR_FORMAT, "data after the last record: refused");
+
+	sim_load(base);
+	flash.bad = true;
+	check(!apply(delta, 1500) && flashDelta.error() == FLASH_DELTA_ERR_FLASH, "sector does not program: reported");
+}
+
+int main(int argc, char *argv[])
+{
+	rng.seed(argc > 1 ? atoi(argv[1]) : 1);
+
+	Program base_program = make_program();
+	std::vector<char> base = link(base_program);
+	image_manifest manifest;
+	make_manifest(base, manifest);
+
+	printf("ram_all.bin: %zu bytes, %zu sectors\n\n", base.size(), manifest.sectors.size());
+	printf("%-10s %-36s %8s %9s %7s %7s %9s %9s\n",
+	       "edit", "", "sectors", "delta", "of full", "erases", "flash ms", "full ms");
+
+	std::vector<char> last;
+	for (size_t e = 0; e < sizeof(edits) / sizeof(edits[0]); e++) {
+		Program p = base_program;
+		edits[e].apply(p);
+		std::vector<char> image = link(p);
+		std::vector<char> delta;
+		unsigned long records = make_delta(image, manifest, delta);
+
+		sim_load(base);
+		bool ok = apply(delta, 1500) && sim_holds(image);
+		if (!ok) {
+			failures++;
+		}
+
+		uint32_t full_sectors = (image.size() + FLASH_DELTA_SECTOR_SIZE - 1) / FLASH_DELTA_SECTOR_SIZE;
+		uint32_t full_us = full_sectors * SIM_ERASE_US + (image.size() + 255) / 256 * SIM_PAGE_US;
+		uint32_t delta_us = flash.erases * SIM_ERASE_US + flash.pages * SIM_PAGE_US;
+
+		printf("%-10s %-36s %3lu/%-4u %9zu %6.1f%% %7u %9u %9u%s\n",
+		       edits[e].name, edits[e].what, records, full_sectors, delta.size(),
+		       100.0 * delta.size() / image.size(), flash.erases, delta_us / 1000, full_us / 1000,
+		       ok ? "" : "  FAILED");
+
+		if (e == 3) {
+			last = image;
+		}
+	}
+
+	fault_tests(base, last);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,20 @@
+/*
+ * Host stand-in for the flash API of libameba, for system/deltabench.
+ * The flash is a RAM array with NOR semantics: erase sets a 4KB sector
+ * to 0xFF and programming can only clear bits.
+ */
+
+#ifndef DELTABENCH_FLASH_API_H
+#define DELTABENCH_FLASH_API_H
+
+#include <stdint.h>
+
+typedef struct flash_s flash_t;
+
+extern flash_t flash;
+
+void flash_erase_sector(flash_t *obj, uint32_t address);
+int  flash_stream_read(flash_t *obj, uint32_t address, uint32_t len, uint8_t *data);
+int  flash_stream_write(flash_t *obj, uint32_t address, uint32_t len, uint8_t *data);
+
+#endif
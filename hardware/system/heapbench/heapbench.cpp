@@ -0,0 +1,401 @@
+/*
+ * Replays allocation traces against cores/arduino/heap_caps.c, built
+ * for the host, and reports failures, fragmentation and speed for a few
+ * region layouts. See README.md for the trace format.
+ *
+ *   heapbench <trace>...                 replay every layout
+ *   heapbench gen <workload> <seed>      write a synthetic trace
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "heap_caps.h"
+
+extern "C" void heap_caps_reset(void);
+
+// Only the region that stands in for newlib's arena has it
+#define BENCH_CAP_LIBC		0x0100
+
+#define RUNS			15
+#define SAMPLE_EVERY		64
+
+struct Region {
+	const char *name;
+	size_t size;
+	uint32_t caps;
+};
+
+struct Layout {
+	const char *name;
+	bool split;		// keep the lwIP and libc requests apart
+	Region regions[HEAP_CAPS_MAX_REGIONS];
+};
+
+// Same 192KB of on-chip RAM in the first two; the last adds SDRAM
+static const Layout layouts[] = {
+	{ "split", true, {
+		{ "lwip", 128 * 1024, MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA },
+		{ "libc", 64 * 1024, MALLOC_CAP_INTERNAL | BENCH_CAP_LIBC },
+	} },
+	{ "shared", false, {
+		{ "BD_RAM", 144 * 1024, MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA },
+		{ "TCM", 48 * 1024, MALLOC_CAP_INTERNAL | MALLOC_CAP_TCM },
+	} },
+	{ "shared+sdram", false, {
+		{ "BD_RAM", 144 * 1024, MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA },
+		{ "TCM", 48 * 1024, MALLOC_CAP_INTERNAL | MALLOC_CAP_TCM },
+		{ "SDRAM", 2048 * 1024, MALLOC_CAP_SDRAM },
+	} },
+};
+
+struct Event {
+	char op;
+	uint32_t id;		// the block, or the new block for 'r'
+	uint32_t old;		// the block resized by 'r'
+	uint32_t size;
+	uint32_t caps;
+};
+
+struct Result {
+	uint32_t ops;
+	uint32_t failed_dma;
+	uint32_t failed_other;
+	uint32_t peak_used;
+	double worst_frag;
+	double ns_per_op;
+};
+
+/*
+ * Trace lines:  m <id> <size> <caps>
+ *               r <id> <old> <size> <caps>
+ *               f <id>
+ * Ids are any token (a pointer printed by the target works); id 0 is a
+ * request that failed when recorded and is skipped.
+ */
+static bool load_trace(const char *path, std::vector<Event> &events)
+{
+	std::ifstream in(path);
+	std::unordered_map<std::string, uint32_t> ids;
+	std::string line;
+
+	if (!in) {
+		return false;
+	}
+	ids["0"] = 0;
+	auto id_of = [&ids](const std::string &tok) {
+		auto it = ids.find(tok);
+		if (it != ids.end()) {
+			return it->second;
+		}
+		uint32_t id = ids.size();
+		ids[tok] = id;
+		return id;
+	};
+	while (std::getline(in, line)) {
+		std::istringstream ls(line);
+		std::string op, a, b;
+		Event e = {};
+
+		if (!(ls >> op) || op[0] == '#') {
+			continue;
+		}
+		e.op = op[0];
+		if (e.op == 'm') {
+			ls >> a >> e.size >> e.caps;
+			e.id = id_of(a);
+		} else if (e.op == 'r') {
+			ls >> a >> b >> e.size >> e.caps;
+			e.id = id_of(a);
+			e.old = id_of(b);
+		} else if (e.op == 'f') {
+			ls >> a;
+			e.id = id_of(a);
+		} else {
+			continue;
+		}
+		if (e.id != 0 || e.op == 'r') {
+			events.push_back(e);
+		}
+	}
+	return true;
+}
+
+static uint32_t request_caps(const Layout &layout, uint32_t caps)
+{
+	if (!layout.split) {
+		return caps;
+	}
+	return (caps & MALLOC_CAP_DMA) ? MALLOC_CAP_DMA : BENCH_CAP_LIBC;
+}
+
+static double fragmentation(void)
+{
+	size_t free_total = 0;
+	size_t largest = 0;
+	heap_caps_stats_t st;
+
+	for (int i = 0; i < heap_caps_region_count(); i++) {
+		heap_caps_get_stats(i, &st);
+		free_total += st.size - st.used;
+		largest = std::max<size_t>(largest, st.largest_free);
+	}
+	return free_total ? 1.0 - (double)largest / free_total : 0.0;
+}
+
+static uint32_t total_used(void)
+{
+	uint32_t used = 0;
+	heap_caps_stats_t st;
+
+	for (int i = 0; i < heap_caps_region_count(); i++) {
+		heap_caps_get_stats(i, &st);
+		used += st.used;
+	}
+	return used;
+}
+
+static void replay_once(const Layout &layout, const std::vector<Event> &events,
+			std::vector<uint8_t *> &memory, Result *res, bool measure)
+{
+	std::vector<void *> live;
+
+	heap_caps_reset();
+	for (int i = 0; i < HEAP_CAPS_MAX_REGIONS && layout.regions[i].name; i++) {
+		heap_caps_add_region(layout.regions[i].name, memory[i],
+				     layout.regions[i].size, layout.regions[i].caps);
+	}
+
+	for (size_t n = 0; n < events.size(); n++) {
+		const Event &e = events[n];
+		uint32_t caps = request_caps(layout, e.caps);
+		void *p;
+
+		if (std::max(e.id, e.old) >= live.size()) {
+			live.resize(std::max(e.id, e.old) + 1, NULL);
+		}
+		switch (e.op) {
+		case 'm':
+			p = malloc_caps(e.size, caps);
+			live[e.id] = p;
+			break;
+		case 'r':
+			// a block recorded before the trace started is a new one here
+			p = realloc_caps(live[e.old], e.size, caps);
+			// on failure the old block carries on under the new id
+			if (e.id != 0) {
+				live[e.id] = p ? p : live[e.old];
+			}
+			if (e.id != e.old) {
+				live[e.old] = NULL;
+			}
+			break;
+		default:
+			free_caps(live[e.id]);
+			live[e.id] = NULL;
+			continue;
+		}
+		if (!measure) {
+			continue;
+		}
+		if (!p) {
+			if (e.caps & MALLOC_CAP_DMA) {
+				res->failed_dma++;
+			} else {
+				res->failed_other++;
+			}
+		}
+		if ((n % SAMPLE_EVERY) == 0) {
+			res->peak_used = std::max(res->peak_used, total_used());
+			res->worst_frag = std::max(res->worst_frag, fragmentation());
+		}
+	}
+}
+
+static Result replay(const Layout &layout, const std::vector<Event> &events)
+{
+	std::vector<uint8_t *> memory;
+	Result res = {};
+	double best = 1e30;
+
+	for (int i = 0; i < HEAP_CAPS_MAX_REGIONS && layout.regions[i].name; i++) {
+		memory.push_back((uint8_t *)malloc(layout.regions[i].size));
+	}
+
+	res.ops = events.size();
+	replay_once(layout, events, memory, &res, true);
+
+	// best of several runs, the stats pass above is not timed
+	for (int run = 0; run < RUNS; run++) {
+		auto t0 = std::chrono::steady_clock::now();
+		replay_once(layout, events, memory, NULL, false);
+		auto t1 = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::nano>(t1 - t0).count());
+	}
+	res.ns_per_op = events.empty() ? 0 : best / events.size();
+
+	for (size_t i = 0; i < memory.size(); i++) {
+		free(memory[i]);
+	}
+	return res;
+}
+
+/*
+ * Synthetic workloads. Each step frees what has expired and starts one
+ * to three new blocks from the weighted classes; a growing class
+ * reallocs towards its final size the way String does.
+ */
+struct Class {
+	uint32_t weight;
+	uint32_t caps;
+	uint32_t min_size, max_size;
+	uint32_t grow_to;	// 0: fixed size
+	uint32_t min_life, max_life;
+};
+
+struct Workload {
+	const char *name;
+	uint32_t steps;
+	Class classes[6];
+};
+
+static const Workload workloads[] = {
+	{ "webserver", 1200, {
+		{ 30, MALLOC_CAP_DMA, 1600, 1664, 0, 1, 3 },		// rx skb
+		{ 25, MALLOC_CAP_DMA, 64, 1460, 0, 2, 40 },		// tx pbuf, held until acked
+		{ 25, MALLOC_CAP_DEFAULT, 16, 64, 1200, 3, 12 },	// request String
+		{ 8, MALLOC_CAP_DEFAULT, 1024, 4096, 0, 2, 8 },		// response buffer
+		{ 12, MALLOC_CAP_DEFAULT, 8, 96, 0, 50, 2000 },		// long-lived objects
+	} },
+	{ "mqtt", 1500, {
+		{ 30, MALLOC_CAP_DMA, 1600, 1600, 0, 1, 2 },		// rx skb
+		{ 30, MALLOC_CAP_DMA, 40, 300, 0, 1, 10 },		// publish pbuf
+		{ 30, MALLOC_CAP_DEFAULT, 16, 64, 256, 1, 50 },		// topic/payload String
+		{ 10, MALLOC_CAP_DEFAULT, 16, 128, 0, 500, 5000 },	// subscriptions, sessions
+	} },
+	{ "bulk", 1200, {
+		{ 10, MALLOC_CAP_DEFAULT, 8192, 32768, 0, 5, 30 },	// frame buffers
+		{ 40, MALLOC_CAP_DMA, 1600, 1600, 0, 1, 3 },		// rx skb
+		{ 40, MALLOC_CAP_DMA, 1460, 1460, 0, 2, 10 },		// tx pbuf
+		{ 10, MALLOC_CAP_DEFAULT, 16, 64, 0, 10, 1000 },	// small objects
+	} },
+};
+
+static uint32_t rng_state;
+
+static uint32_t rng(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+static uint32_t rng_range(uint32_t lo, uint32_t hi)
+{
+	return lo + rng() % (hi - lo + 1);
+}
+
+static int generate(const char *name, uint32_t seed)
+{
+	struct Live {
+		uint32_t id, size, grow_to, caps, dies;
+	};
+	const Workload *w = NULL;
+	std::vector<Live> live;
+	uint32_t next_id = 1;
+	uint32_t total = 0;
+
+	for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++) {
+		if (strcmp(workloads[i].name, name) == 0) {
+			w = &workloads[i];
+		}
+	}
+	if (!w) {
+		fprintf(stderr, "unknown workload %s\n", name);
+		return 1;
+	}
+	for (int c = 0; c < 6; c++) {
+		total += w->classes[c].weight;
+	}
+	rng_state = seed ? seed : 1;
+
+	printf("# heapbench gen %s %u\n", name, seed);
+	for (uint32_t step = 0; step < w->steps; step++) {
+		for (size_t i = 0; i < live.size(); ) {
+			Live &l = live[i];
+			if (l.dies <= step) {
+				printf("f %u\n", l.id);
+				live[i] = live.back();
+				live.pop_back();
+			} else if (l.grow_to && l.size < l.grow_to) {
+				uint32_t id = next_id++;
+				l.size = std::min(l.grow_to, l.size + l.size / 2 + 1);
+				printf("r %u %u %u %u\n", id, l.id, l.size, l.caps);
+				l.id = id;
+				i++;
+			} else {
+				i++;
+			}
+		}
+		for (uint32_t n = rng_range(1, 3); n > 0; n--) {
+			uint32_t pick = rng() % total;
+			const Class *c = w->classes;
+			while (pick >= c->weight) {
+				pick -= c->weight;
+				c++;
+			}
+			Live l;
+			l.id = next_id++;
+			l.size = rng_range(c->min_size, c->max_size);
+			l.grow_to = c->grow_to ? rng_range(l.size, c->grow_to) : 0;
+			l.caps = c->caps;
+			l.dies = step + rng_range(c->min_life, c->max_life);
+			printf("m %u %u %u\n", l.id, l.size, l.caps);
+			live.push_back(l);
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc >= 3 && strcmp(argv[1], "gen") == 0) {
+		return generate(argv[2], argc > 3 ? strtoul(argv[3], NULL, 0) : 1);
+	}
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <trace>...\n       %s gen <workload> [seed]\n", argv[0], argv[0]);
+		return 1;
+	}
+
+	printf("%-24s %-14s %7s %9s %9s %8s %7s %7s\n",
+	       "trace", "layout", "ops", "fail-dma", "fail-oth", "peak KB", "frag%", "ns/op");
+	for (int a = 1; a < argc; a++) {
+		std::vector<Event> events;
+		const char *base = strrchr(argv[a], '/');
+
+		if (!load_trace(argv[a], events)) {
+			fprintf(stderr, "cannot read %s\n", argv[a]);
+			return 1;
+		}
+		for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+			Result r = replay(layouts[l], events);
+			printf("%-24s %-14s %7u %9u %9u %8.1f %7.1f %7.1f\n",
+			       base ? base + 1 : argv[a], layouts[l].name, r.ops,
+			       r.failed_dma, r.failed_other, r.peak_used / 1024.0,
+			       r.worst_frag * 100, r.ns_per_op);
+		}
+	}
+	return 0;
+}
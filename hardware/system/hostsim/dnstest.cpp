@@ -0,0 +1,315 @@
+/*
+ * Tests of WiFiResolver (libraries/WiFi/src/wifi_resolver.cpp) against a
+ * mock DNS server, built for the host like hostsim. The server is a
+ * thread on lwIP's loopback interface at 127.0.0.1:53, and answers from
+ * the table below. See README.md.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "Arduino.h"
+#include "Thread.h"
+#include "heap_caps.h"
+#include "WiFi.h"
+#include "wifi_resolver.h"
+#include "wifi_intfs.h"
+#include "lwip/tcpip.h"
+#include "lwip/sockets.h"
+#include "lwip/dns.h"
+
+// lwIP's heap, BD_RAM on the board
+static uint8_t heap_bd_ram[128 * 1024] __attribute__((aligned(8)));
+
+/* The mock server ---------------------------------------------------------- */
+
+enum Reply {
+	REPLY_A,		// an A record
+	REPLY_CNAME,		// a CNAME with ttl, then an A record with a_ttl
+	REPLY_NXDOMAIN,		// no such name
+	REPLY_SILENT,		// no answer at all
+};
+
+struct Zone {
+	const char *name;
+	Reply reply;
+	IPAddress addr;
+	uint32_t ttl;
+	uint32_t a_ttl;		// of the A record after a CNAME
+	volatile uint32_t queries;
+};
+
+static Zone zones[] = {
+	{ "a.test", REPLY_A, IPAddress(10, 0, 0, 1), 300, 0, 0 },
+	{ "refresh.test", REPLY_A, IPAddress(10, 0, 0, 2), 2, 0, 0 },
+	{ "expire.test", REPLY_A, IPAddress(10, 0, 0, 3), 1, 0, 0 },
+	{ "cname.test", REPLY_CNAME, IPAddress(10, 0, 0, 4), 1, 300, 0 },
+	{ "nx.test", REPLY_NXDOMAIN, IPAddress(0, 0, 0, 0), 0, 0, 0 },
+	{ "silent.test", REPLY_SILENT, IPAddress(10, 0, 0, 5), 300, 0, 0 },
+	{ "full.test", REPLY_A, IPAddress(10, 0, 0, 6), 300, 0, 0 },
+	{ "host0.test", REPLY_A, IPAddress(10, 0, 1, 0), 300, 0, 0 },
+	{ "host1.test", REPLY_A, IPAddress(10, 0, 1, 1), 300, 0, 0 },
+	{ "host2.test", REPLY_A, IPAddress(10, 0, 1, 2), 300, 0, 0 },
+	{ "host3.test", REPLY_A, IPAddress(10, 0, 1, 3), 300, 0, 0 },
+	{ "host4.test", REPLY_A, IPAddress(10, 0, 1, 4), 300, 0, 0 },
+	{ "host5.test", REPLY_A, IPAddress(10, 0, 1, 5), 300, 0, 0 },
+	{ "host6.test", REPLY_A, IPAddress(10, 0, 1, 6), 300, 0, 0 },
+	{ "host7.test", REPLY_A, IPAddress(10, 0, 1, 7), 300, 0, 0 },
+};
+
+#define ZONE_COUNT	(sizeof(zones) / sizeof(zones[0]))
+#define HOSTS		8	// host0.test to host7.test, twice DNS_TABLE_SIZE
+
+static Zone *zone(const char *name)
+{
+	for (size_t i = 0; i < ZONE_COUNT; i++) {
+		if (strcasecmp(zones[i].name, name) == 0)
+			return &zones[i];
+	}
+	return NULL;
+}
+
+static uint8_t *put_rr(uint8_t *p, uint16_t type, uint32_t ttl, const uint8_t *data, uint16_t len)
+{
+	*p++ = 0xc0;		// the name is the question's
+	*p++ = 12;
+	*p++ = type >> 8;
+	*p++ = type;
+	*p++ = 0;
+	*p++ = 1;		// class IN
+	*p++ = ttl >> 24;
+	*p++ = ttl >> 16;
+	*p++ = ttl >> 8;
+	*p++ = ttl;
+	*p++ = len >> 8;
+	*p++ = len;
+	memcpy(p, data, len);
+	return p + len;
+}
+
+static void dns_server(void const *argument)
+{
+	struct sockaddr_in local, peer;
+	uint8_t buf[512];
+	int s = lwip_socket(AF_INET, SOCK_DGRAM, 0);
+
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_port = PP_HTONS(53);
+	local.sin_addr.s_addr = PP_HTONL(INADDR_LOOPBACK);
+	lwip_bind(s, (struct sockaddr *)&local, sizeof(local));
+
+	for (;;) {
+		socklen_t peer_len = sizeof(peer);
+		int n = lwip_recvfrom(s, buf, sizeof(buf), 0, (struct sockaddr *)&peer, &peer_len);
+		char name[256];
+		int off = 12, len = 0;
+
+		if (n < 12 + 5)
+			continue;
+		// The question's name, dotted
+		while (off < n && buf[off] != 0 && len + buf[off] + 1 < (int)sizeof(name)) {
+			if (len > 0)
+				name[len++] = '.';
+			memcpy(name + len, buf + off + 1, buf[off]);
+			len += buf[off];
+			off += buf[off] + 1;
+		}
+		name[len] = 0;
+		off += 1 + 4;		// the zero, type and class
+
+		Zone *z = zone(name);
+		if (z != NULL)
+			z->queries++;
+		if (z != NULL && z->reply == REPLY_SILENT)
+			continue;
+
+		uint8_t *p = buf + off;
+		uint32_t addr = z != NULL ? (uint32_t)z->addr : 0;
+		buf[2] = 0x81;		// response, recursion desired
+		buf[3] = 0x80;		// recursion available
+		buf[6] = buf[7] = 0;	// no answers yet
+		if (z == NULL || z->reply == REPLY_NXDOMAIN) {
+			buf[3] |= 3;
+		} else if (z->reply == REPLY_CNAME) {
+			// The CNAME points back at the question: enough to be skipped
+			static const uint8_t target[] = { 0xc0, 12 };
+
+			p = put_rr(p, 5, z->ttl, target, sizeof(target));
+			p = put_rr(p, 1, z->a_ttl, (const uint8_t *)&addr, 4);
+			buf[7] = 2;
+		} else {
+			p = put_rr(p, 1, z->ttl, (const uint8_t *)&addr, 4);
+			buf[7] = 1;
+		}
+		lwip_sendto(s, buf, p - buf, 0, (struct sockaddr *)&peer, peer_len);
+	}
+}
+
+/* Tests -------------------------------------------------------------------- */
+
+static int failures;
+
+static void check(bool ok, const char *what)
+{
+	printf("  %-56s %s\n", what, ok ? "ok" : "FAILED");
+	fflush(stdout);
+	if (!ok)
+		failures++;
+}
+
+static bool resolves_to(const char *name, IPAddress expected)
+{
+	IPAddress result;
+
+	return WiFi.hostByName(name, result) == 1 && result == expected;
+}
+
+static volatile int async_status;
+static volatile uint32_t async_addr;
+
+static void async_done(const char *aHostname, IPAddress aResult, int aStatus, void *aArg)
+{
+	async_addr = (uint32_t)aResult;
+	async_status = aStatus;
+}
+
+static void test_cache(void)
+{
+	Zone *z = zone("a.test");
+	uint32_t t0;
+
+	printf("cache\n");
+	check(resolves_to("a.test", z->addr) && z->queries == 1, "first lookup asks the server");
+	t0 = millis();
+	check(resolves_to("a.test", z->addr) && z->queries == 1, "second lookup is answered from the cache");
+	check(millis() - t0 < 5, "and does not wait");
+	async_status = 0;
+	check(WiFi.resolveAsync("a.test", async_done) == 1 && async_status == WL_SUCCESS &&
+	      async_addr == (uint32_t)z->addr && z->queries == 1,
+	      "resolveAsync() calls back at once on a hit");
+	check(resolves_to("10.1.2.3", IPAddress(10, 1, 2, 3)), "a dotted quad needs no server");
+
+	for (int i = 0; i < HOSTS; i++) {
+		char name[16];
+
+		sprintf(name, "host%d.test", i);
+		resolves_to(name, zone(name)->addr);
+	}
+	bool all = true;
+	for (int i = 0; i < HOSTS; i++) {
+		char name[16];
+
+		sprintf(name, "host%d.test", i);
+		all = all && resolves_to(name, zone(name)->addr) && zone(name)->queries == 1;
+	}
+	check(all, "more names than lwIP's dns_table stay cached");
+
+	wiFiResolver.flush();
+	check(resolves_to("a.test", z->addr) && z->queries == 2, "flush() forgets them");
+}
+
+static void test_ttl(void)
+{
+	Zone *refresh = zone("refresh.test");
+	Zone *expire = zone("expire.test");
+	Zone *cname = zone("cname.test");
+	IPAddress old = refresh->addr;
+
+	printf("ttl\n");
+	check(resolves_to("refresh.test", old), "refresh.test resolves, ttl 2s");
+	refresh->addr = IPAddress(10, 0, 0, 20);
+	// Within DNS_CACHE_PREFETCH_WINDOW of expiry: served, and refreshed
+	check(resolves_to("refresh.test", old), "a hit close to expiry gets the cached address");
+	delay(100);
+	check(refresh->queries == 2, "and asks the server again");
+	check(resolves_to("refresh.test", refresh->addr), "the refresh brings the server's new address");
+
+	check(resolves_to("expire.test", expire->addr), "expire.test resolves, ttl 1s");
+	check(resolves_to("cname.test", cname->addr), "cname.test resolves through a CNAME");
+	// Unused entries are not refreshed, the sweep drops them after the TTL
+	delay(DNS_CACHE_SWEEP_INTERVAL + 1500);
+	check(resolves_to("expire.test", expire->addr) && expire->queries == 2,
+	      "after the TTL the server is asked again");
+	check(resolves_to("cname.test", cname->addr) && cname->queries == 2,
+	      "a CNAME chain lasts its shortest TTL");
+}
+
+static void test_failures(void)
+{
+	Zone *nx = zone("nx.test");
+	Zone *silent = zone("silent.test");
+	IPAddress result;
+
+	printf("failures\n");
+	check(WiFi.hostByName("nx.test", result) == 0 && nx->queries == 1, "a name the server denies fails");
+	check(WiFi.hostByName("nx.test", result) == 0 && nx->queries == 1, "and the failure is cached");
+
+	check(WiFi.hostByName("silent.test", result) == 0 && silent->queries == DNS_CACHE_RETRIES,
+	      "a silent server is asked DNS_CACHE_RETRIES times");
+	silent->reply = REPLY_A;
+	check(resolves_to("silent.test", silent->addr), "a timeout is not cached");
+	check(WiFi.hostByName("bad..test", result) == 0, "a malformed name fails");
+}
+
+static sys_sem_t unblock;
+
+static void block_tcpip(void *arg)
+{
+	sys_arch_sem_wait(&unblock, 0);
+}
+
+static void nothing(void *arg)
+{
+}
+
+static void test_mailbox_full(void)
+{
+	Zone *z = zone("full.test");
+
+	printf("mailbox full\n");
+	sys_sem_new(&unblock, 0);
+	tcpip_callback_with_block(block_tcpip, NULL, 1);
+	delay(10);
+	// Fill the mailbox, or the message pool behind it
+	while (tcpip_callback_with_block(nothing, NULL, 0) == ERR_OK)
+		;
+	async_status = 0;
+	check(WiFi.resolveAsync("full.test", async_done) == -1 && async_status == WL_FAILURE,
+	      "a lookup that cannot be posted fails at once");
+	sys_sem_signal(&unblock);
+	delay(10);
+	check(resolves_to("full.test", z->addr) && z->queries == 1, "and is not cached as a failure");
+	sys_sem_free(&unblock);
+}
+
+int main(int argc, char **argv)
+{
+	ip_addr_t server;
+
+	heap_caps_add_region("BD_RAM", heap_bd_ram, sizeof(heap_bd_ram),
+			     MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+	WiFi.begin((char *)"hostsim");
+	IP4_ADDR(&server, 127, 0, 0, 1);
+	dns_setserver(0, &server);
+
+	Thread server_thread(dns_server);
+	server_thread.start();
+	delay(10);
+
+	test_cache();
+	test_ttl();
+	test_failures();
+	test_mailbox_full();
+
+	if (failures > 0)
+		printf("\n%d failed\n", failures);
+	else
+		printf("\nall passed\n");
+	// The tcpip thread is still running: no static destructors
+	fflush(stdout);
+	_exit(failures > 0);
+}
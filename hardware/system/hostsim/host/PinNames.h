@@ -0,0 +1,20 @@
+/*
+ * Host stand-in for PinNames.h of libameba, for system/hostsim: the names
+ * of the pins on the Arduino headers, with nothing behind them.
+ */
+
+#ifndef HOSTSIM_PINNAMES_H
+#define HOSTSIM_PINNAMES_H
+
+typedef int PinName;
+
+enum {
+    PA_2 = 0x02, PA_3 = 0x03, PA_4 = 0x04, PA_5 = 0x05, PA_6 = 0x06, PA_7 = 0x07,
+    PB_4 = 0x14, PB_5 = 0x15,
+    PC_0 = 0x20, PC_1 = 0x21, PC_2 = 0x22, PC_3 = 0x23,
+    PD_4 = 0x34, PD_5 = 0x35,
+};
+
+#define NC ((PinName)0xFFFFFFFF)
+
+#endif
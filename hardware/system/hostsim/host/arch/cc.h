@@ -0,0 +1,53 @@
+/*
+ * Host stand-in for lwip-sys/arch/cc.h, for system/hostsim: the same
+ * types and errno values, with the portable checksum and byte swaps of
+ * the host compiler instead of the Thumb-2 routines.
+ */
+
+#ifndef __CC_H__
+#define __CC_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef uint8_t            u8_t;
+typedef int8_t             s8_t;
+typedef uint16_t           u16_t;
+typedef int16_t            s16_t;
+typedef uint32_t           u32_t;
+typedef int32_t            s32_t;
+typedef uintptr_t          mem_ptr_t;
+
+#define U16_F "hu"
+#define S16_F "hd"
+#define X16_F "hx"
+#define U32_F "u"
+#define S32_F "d"
+#define X32_F "x"
+#define SZT_F "zu"
+
+/* endian.h of the host may have it already */
+#ifndef BYTE_ORDER
+#define BYTE_ORDER LITTLE_ENDIAN
+#endif
+
+/* Use LWIP error codes */
+#define LWIP_PROVIDE_ERRNO
+
+#define PACK_STRUCT_BEGIN
+#define PACK_STRUCT_STRUCT __attribute__ ((__packed__))
+#define PACK_STRUCT_END
+#define PACK_STRUCT_FIELD(fld) fld
+#define ALIGNED(n)  __attribute__((aligned (n)))
+
+#define LWIP_CHKSUM_ALGORITHM   3
+
+#define LWIP_PLATFORM_DIAG(x)      do { printf x; } while (0)
+#define LWIP_PLATFORM_ASSERT(x)    do { fprintf(stderr, "lwIP assert \"%s\" at %s:%d\n", \
+                                        x, __FILE__, __LINE__); abort(); } while (0)
+
+#define LWIP_PLATFORM_HTONS(x)      __builtin_bswap16(x)
+#define LWIP_PLATFORM_HTONL(x)      __builtin_bswap32(x)
+
+#endif /* __CC_H__ */
@@ -0,0 +1,54 @@
+/*
+ * Host stand-in for lwip-sys/arch/sys_arch.h, for system/hostsim: the
+ * lwIP sys types on pthreads, see host/sys_arch.c. The calls that are not
+ * part of the lwIP sys API are the same as on the board.
+ */
+
+#ifndef __ARCH_SYS_ARCH_H__
+#define __ARCH_SYS_ARCH_H__
+
+#include <pthread.h>
+
+#include "lwip/opt.h"
+
+typedef struct sys_sem *sys_sem_t;
+#define sys_sem_valid(x)            (*(x) != NULL)
+#define sys_sem_set_invalid(x)      (*(x) = NULL)
+
+typedef struct sys_mutex *sys_mutex_t;
+#define sys_mutex_valid(x)          (*(x) != NULL)
+#define sys_mutex_set_invalid(x)    (*(x) = NULL)
+
+/* Not part of the lwIP sys API, used by tcpip_core_lock() */
+int sys_mutex_trylock(sys_mutex_t *mutex);
+uint32_t sys_now_us(void);
+
+/* Not part of the lwIP sys API, used by lwip_waitfor(). As on the board,
+   the thread sleeps on a signal flag of its own, see host/cmsis_os.c. */
+#define SYS_WAKE_SIGNAL     0x8000
+
+void *sys_thread_self(void);
+void sys_thread_wake(void *thread);
+void sys_thread_sleep(uint32_t timeout);
+
+#define MB_SIZE      8
+
+typedef struct sys_mbox *sys_mbox_t;
+#define SYS_MBOX_NULL               NULL
+#define sys_mbox_valid(x)           (*(x) != NULL)
+#define sys_mbox_set_invalid(x)     (*(x) = NULL)
+
+/* The board's limit, so that a setting that does not fit there fails here */
+#if ((DEFAULT_RAW_RECVMBOX_SIZE) > (MB_SIZE)) || \
+    ((DEFAULT_UDP_RECVMBOX_SIZE) > (MB_SIZE)) || \
+    ((DEFAULT_TCP_RECVMBOX_SIZE) > (MB_SIZE)) || \
+    ((DEFAULT_ACCEPTMBOX_SIZE)   > (MB_SIZE)) || \
+    ((TCPIP_MBOX_SIZE)           > (MB_SIZE))
+#   error Mailbox size not supported
+#endif
+
+typedef pthread_t sys_thread_t;
+
+typedef int sys_prot_t;
+
+#endif /* __ARCH_SYS_ARCH_H__ */
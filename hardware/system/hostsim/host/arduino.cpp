@@ -0,0 +1,91 @@
+/*
+ * What the core and the WiFi library take from the board, for
+ * system/hostsim: time from CLOCK_MONOTONIC, Serial and DiagPrintf() on
+ * stdout and stderr, and the ROM's prvStrLen().
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "Arduino.h"
+
+uint32_t SystemCoreClock = 166000000;
+
+HostSerial Serial;
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+extern "C" {
+
+uint32_t millis(void)
+{
+	return (uint32_t)(now_us() / 1000);
+}
+
+uint32_t micros(void)
+{
+	return (uint32_t)now_us();
+}
+
+uint32_t us_ticker_read(void)
+{
+	return (uint32_t)now_us();
+}
+
+void delay(uint32_t ms)
+{
+	osDelay(ms);
+}
+
+void delayMicroseconds(uint32_t usec)
+{
+	struct timespec ts = { (time_t)(usec / 1000000), (long)(usec % 1000000) * 1000 };
+
+	nanosleep(&ts, NULL);
+}
+
+void yield(void)
+{
+	osThreadYield();
+}
+
+u32 DiagPrintf(const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	return n;
+}
+
+uint32_t prvStrLen(const uint8_t *pSRC)
+{
+	return strlen((const char *)pSRC);
+}
+
+}
+
+void HostSerial::flush()
+{
+	fflush(stdout);
+}
+
+size_t HostSerial::write(uint8_t c)
+{
+	return fwrite(&c, 1, 1, stdout);
+}
+
+size_t HostSerial::write(const uint8_t *buffer, size_t size)
+{
+	return fwrite(buffer, 1, size, stdout);
+}
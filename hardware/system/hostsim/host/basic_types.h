@@ -0,0 +1,20 @@
+/* Host stand-in for basic_types.h of libameba, for system/hostsim */
+
+#ifndef HOSTSIM_BASIC_TYPES_H
+#define HOSTSIM_BASIC_TYPES_H
+
+#include <stdint.h>
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t   s8;
+typedef int16_t  s16;
+typedef int32_t  s32;
+typedef int64_t  s64;
+
+#define _LONG_CALL_     __attribute__ ((long_call))
+#define SECTION(_name)
+
+#endif
@@ -0,0 +1,7 @@
+/* Host stand-in for cmsis.h of libameba, for system/hostsim. TimerEvent.cpp
+ * includes it but uses none of it. */
+
+#ifndef HOSTSIM_CMSIS_H
+#define HOSTSIM_CMSIS_H
+
+#endif
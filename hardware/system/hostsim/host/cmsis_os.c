@@ -0,0 +1,559 @@
+/*
+ * The CMSIS-RTOS calls of host/cmsis_os.h on pthreads, for system/hostsim.
+ *
+ * Every object is a pthread mutex and condition variable, and waits
+ * time out on CLOCK_MONOTONIC. The host schedules the threads: priorities
+ * are kept but have no effect. A thread that was not started by
+ * osThreadCreate(), such as main(), gets its control block on its first
+ * call.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cmsis_os.h"
+
+struct os_thread_cb {
+	pthread_t tid;
+	osThreadDef_t *def;
+	void *argument;
+	osPriority priority;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int32_t signals;
+};
+
+struct os_mutex_cb {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct os_thread_cb *owner;
+	uint32_t level;
+};
+
+struct os_semaphore_cb {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int32_t count;
+};
+
+struct os_messageQ_cb {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint32_t size;
+	uint32_t first;
+	uint32_t count;
+	uint32_t msg[];
+};
+
+/* Thread::get_state() values */
+#define STATE_INACTIVE	0
+#define STATE_READY	1
+
+static __thread struct os_thread_cb *self;
+
+static void cond_init(pthread_cond_t *cond)
+{
+	pthread_condattr_t attr;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+static void deadline(struct timespec *ts, uint32_t millisec)
+{
+	clock_gettime(CLOCK_MONOTONIC, ts);
+	ts->tv_sec += millisec / 1000;
+	ts->tv_nsec += (long)(millisec % 1000) * 1000000L;
+	if (ts->tv_nsec >= 1000000000L) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000L;
+	}
+}
+
+/* Waits on cond until woken or until the deadline. Returns 0 once the
+   deadline has passed. */
+static int cond_wait(pthread_cond_t *cond, pthread_mutex_t *lock,
+		     uint32_t millisec, const struct timespec *ts)
+{
+	if (millisec == 0) {
+		return 0;
+	}
+	if (millisec == osWaitForever) {
+		pthread_cond_wait(cond, lock);
+		return 1;
+	}
+	return pthread_cond_timedwait(cond, lock, ts) != ETIMEDOUT;
+}
+
+static struct os_thread_cb *thread_new(osThreadDef_t *def, void *argument)
+{
+	struct os_thread_cb *t = calloc(1, sizeof(*t));
+
+	if (t == NULL) {
+		return NULL;
+	}
+	t->def = def;
+	t->argument = argument;
+	t->priority = def ? def->tpriority : osPriorityNormal;
+	pthread_mutex_init(&t->lock, NULL);
+	cond_init(&t->cond);
+	return t;
+}
+
+static struct os_thread_cb *current(void)
+{
+	if (self == NULL) {
+		self = thread_new(NULL, NULL);
+		self->tid = pthread_self();
+	}
+	return self;
+}
+
+/******************************************************************************
+ * Kernel and threads
+ ******************************************************************************/
+
+osStatus osKernelInitialize(void)
+{
+	return osOK;
+}
+
+osStatus osKernelStart(void)
+{
+	return osOK;
+}
+
+int32_t osKernelRunning(void)
+{
+	return 1;
+}
+
+static void *thread_main(void *arg)
+{
+	struct os_thread_cb *t = arg;
+
+	self = t;
+	t->def->pthread(t->argument);
+	t->def->tcb.state = STATE_INACTIVE;
+	return NULL;
+}
+
+osThreadId osThreadCreate(osThreadDef_t *thread_def, void *argument)
+{
+	struct os_thread_cb *t;
+	pthread_attr_t attr;
+	int ret;
+
+	if (thread_def == NULL || thread_def->pthread == NULL) {
+		return NULL;
+	}
+	t = thread_new(thread_def, argument);
+	if (t == NULL) {
+		return NULL;
+	}
+	thread_def->tcb.state = STATE_READY;
+
+	// The stack size is for the Cortex-M3: host code needs more
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	pthread_attr_setstacksize(&attr, 256 * 1024);
+	ret = pthread_create(&t->tid, &attr, thread_main, t);
+	pthread_attr_destroy(&attr);
+	if (ret != 0) {
+		thread_def->tcb.state = STATE_INACTIVE;
+		free(t);
+		return NULL;
+	}
+	return t;
+}
+
+osThreadId osThreadGetId(void)
+{
+	return current();
+}
+
+/* The control block is never freed, so a stale id stays harmless */
+osStatus osThreadTerminate(osThreadId thread_id)
+{
+	if (thread_id == NULL) {
+		return osErrorParameter;
+	}
+	if (thread_id->def != NULL) {
+		if (thread_id->def->tcb.state == STATE_INACTIVE) {
+			return osErrorResource;
+		}
+		thread_id->def->tcb.state = STATE_INACTIVE;
+	}
+	if (thread_id == current()) {
+		pthread_exit(NULL);
+	}
+	pthread_cancel(thread_id->tid);
+	return osOK;
+}
+
+osStatus osThreadYield(void)
+{
+	sched_yield();
+	return osOK;
+}
+
+osStatus osThreadSetPriority(osThreadId thread_id, osPriority priority)
+{
+	if (thread_id == NULL) {
+		return osErrorParameter;
+	}
+	if (priority < osPriorityIdle || priority > osPriorityRealtime) {
+		return osErrorValue;
+	}
+	thread_id->priority = priority;
+	return osOK;
+}
+
+osPriority osThreadGetPriority(osThreadId thread_id)
+{
+	if (thread_id == NULL) {
+		return osPriorityError;
+	}
+	return thread_id->priority;
+}
+
+osStatus osDelay(uint32_t millisec)
+{
+	struct timespec ts;
+
+	deadline(&ts, millisec);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+	return osEventTimeout;
+}
+
+/******************************************************************************
+ * Signals
+ ******************************************************************************/
+
+int32_t osSignalSet(osThreadId thread_id, int32_t signals)
+{
+	int32_t old;
+
+	if (thread_id == NULL) {
+		return 0x80000000;
+	}
+	pthread_mutex_lock(&thread_id->lock);
+	old = thread_id->signals;
+	thread_id->signals |= signals;
+	pthread_cond_broadcast(&thread_id->cond);
+	pthread_mutex_unlock(&thread_id->lock);
+	return old;
+}
+
+int32_t osSignalClear(osThreadId thread_id, int32_t signals)
+{
+	int32_t old;
+
+	if (thread_id == NULL) {
+		return 0x80000000;
+	}
+	pthread_mutex_lock(&thread_id->lock);
+	old = thread_id->signals;
+	thread_id->signals &= ~signals;
+	pthread_mutex_unlock(&thread_id->lock);
+	return old;
+}
+
+int32_t osSignalGet(osThreadId thread_id)
+{
+	int32_t signals;
+
+	if (thread_id == NULL) {
+		return 0x80000000;
+	}
+	pthread_mutex_lock(&thread_id->lock);
+	signals = thread_id->signals;
+	pthread_mutex_unlock(&thread_id->lock);
+	return signals;
+}
+
+/* As in RTX: signals == 0 waits for any flag and clears them all,
+   otherwise it waits for all of the given flags and clears those. */
+osEvent osSignalWait(int32_t signals, uint32_t millisec)
+{
+	struct os_thread_cb *t = current();
+	struct timespec ts;
+	osEvent event;
+
+	deadline(&ts, millisec);
+	pthread_mutex_lock(&t->lock);
+	for (;;) {
+		int32_t ready = (signals == 0) ? t->signals : (t->signals & signals);
+
+		if ((signals == 0 && ready != 0) || (signals != 0 && ready == signals)) {
+			t->signals &= ~ready;
+			event.status = osEventSignal;
+			event.value.signals = ready;
+			break;
+		}
+		if (!cond_wait(&t->cond, &t->lock, millisec, &ts)) {
+			event.status = (millisec == 0) ? osOK : osEventTimeout;
+			event.value.signals = 0;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&t->lock);
+	return event;
+}
+
+/******************************************************************************
+ * Mutexes: recursive, as in RTX
+ ******************************************************************************/
+
+osMutexId osMutexCreate(osMutexDef_t *mutex_def)
+{
+	struct os_mutex_cb *m = calloc(1, sizeof(*m));
+
+	if (m == NULL) {
+		return NULL;
+	}
+	pthread_mutex_init(&m->lock, NULL);
+	cond_init(&m->cond);
+	return m;
+}
+
+osStatus osMutexWait(osMutexId mutex_id, uint32_t millisec)
+{
+	struct os_thread_cb *t = current();
+	struct timespec ts;
+	osStatus status = osOK;
+
+	if (mutex_id == NULL) {
+		return osErrorParameter;
+	}
+	deadline(&ts, millisec);
+	pthread_mutex_lock(&mutex_id->lock);
+	while (mutex_id->owner != NULL && mutex_id->owner != t) {
+		if (!cond_wait(&mutex_id->cond, &mutex_id->lock, millisec, &ts)) {
+			status = (millisec == 0) ? osErrorResource : osErrorTimeoutResource;
+			break;
+		}
+	}
+	if (status == osOK) {
+		mutex_id->owner = t;
+		mutex_id->level++;
+	}
+	pthread_mutex_unlock(&mutex_id->lock);
+	return status;
+}
+
+osStatus osMutexRelease(osMutexId mutex_id)
+{
+	osStatus status = osOK;
+
+	if (mutex_id == NULL) {
+		return osErrorParameter;
+	}
+	pthread_mutex_lock(&mutex_id->lock);
+	if (mutex_id->owner != current()) {
+		status = osErrorResource;
+	} else if (--mutex_id->level == 0) {
+		mutex_id->owner = NULL;
+		pthread_cond_signal(&mutex_id->cond);
+	}
+	pthread_mutex_unlock(&mutex_id->lock);
+	return status;
+}
+
+osStatus osMutexDelete(osMutexId mutex_id)
+{
+	if (mutex_id == NULL) {
+		return osErrorParameter;
+	}
+	pthread_mutex_destroy(&mutex_id->lock);
+	pthread_cond_destroy(&mutex_id->cond);
+	free(mutex_id);
+	return osOK;
+}
+
+/******************************************************************************
+ * Semaphores
+ ******************************************************************************/
+
+osSemaphoreId osSemaphoreCreate(osSemaphoreDef_t *semaphore_def, int32_t count)
+{
+	struct os_semaphore_cb *s = calloc(1, sizeof(*s));
+
+	if (s == NULL) {
+		return NULL;
+	}
+	pthread_mutex_init(&s->lock, NULL);
+	cond_init(&s->cond);
+	s->count = count;
+	return s;
+}
+
+/* Returns the tokens left plus the one taken, or 0 on timeout */
+int32_t osSemaphoreWait(osSemaphoreId semaphore_id, uint32_t millisec)
+{
+	struct timespec ts;
+	int32_t ret = 0;
+
+	if (semaphore_id == NULL) {
+		return -1;
+	}
+	deadline(&ts, millisec);
+	pthread_mutex_lock(&semaphore_id->lock);
+	for (;;) {
+		if (semaphore_id->count > 0) {
+			ret = semaphore_id->count--;
+			break;
+		}
+		if (!cond_wait(&semaphore_id->cond, &semaphore_id->lock, millisec, &ts)) {
+			break;
+		}
+	}
+	pthread_mutex_unlock(&semaphore_id->lock);
+	return ret;
+}
+
+osStatus osSemaphoreRelease(osSemaphoreId semaphore_id)
+{
+	if (semaphore_id == NULL) {
+		return osErrorParameter;
+	}
+	pthread_mutex_lock(&semaphore_id->lock);
+	semaphore_id->count++;
+	pthread_cond_signal(&semaphore_id->cond);
+	pthread_mutex_unlock(&semaphore_id->lock);
+	return osOK;
+}
+
+osStatus osSemaphoreDelete(osSemaphoreId semaphore_id)
+{
+	if (semaphore_id == NULL) {
+		return osErrorParameter;
+	}
+	pthread_mutex_destroy(&semaphore_id->lock);
+	pthread_cond_destroy(&semaphore_id->cond);
+	free(semaphore_id);
+	return osOK;
+}
+
+/******************************************************************************
+ * Message queues: 32-bit messages, as in RTX
+ ******************************************************************************/
+
+osMessageQId osMessageCreate(osMessageQDef_t *queue_def, osThreadId thread_id)
+{
+	struct os_messageQ_cb *q;
+
+	if (queue_def == NULL || queue_def->queue_sz == 0) {
+		return NULL;
+	}
+	q = calloc(1, sizeof(*q) + queue_def->queue_sz * sizeof(uint32_t));
+	if (q == NULL) {
+		return NULL;
+	}
+	pthread_mutex_init(&q->lock, NULL);
+	cond_init(&q->cond);
+	q->size = queue_def->queue_sz;
+	return q;
+}
+
+osStatus osMessagePut(osMessageQId queue_id, uint32_t info, uint32_t millisec)
+{
+	struct timespec ts;
+	osStatus status = osOK;
+
+	if (queue_id == NULL) {
+		return osErrorParameter;
+	}
+	deadline(&ts, millisec);
+	pthread_mutex_lock(&queue_id->lock);
+	while (queue_id->count == queue_id->size) {
+		if (!cond_wait(&queue_id->cond, &queue_id->lock, millisec, &ts)) {
+			status = (millisec == 0) ? osErrorResource : osErrorTimeoutResource;
+			break;
+		}
+	}
+	if (status == osOK) {
+		queue_id->msg[(queue_id->first + queue_id->count) % queue_id->size] = info;
+		queue_id->count++;
+		pthread_cond_broadcast(&queue_id->cond);
+	}
+	pthread_mutex_unlock(&queue_id->lock);
+	return status;
+}
+
+osEvent osMessageGet(osMessageQId queue_id, uint32_t millisec)
+{
+	struct timespec ts;
+	osEvent event;
+
+	memset(&event, 0, sizeof(event));
+	if (queue_id == NULL) {
+		event.status = osErrorParameter;
+		return event;
+	}
+	event.def.message_id = queue_id;
+	deadline(&ts, millisec);
+	pthread_mutex_lock(&queue_id->lock);
+	for (;;) {
+		if (queue_id->count > 0) {
+			event.status = osEventMessage;
+			event.value.v = queue_id->msg[queue_id->first];
+			queue_id->first = (queue_id->first + 1) % queue_id->size;
+			queue_id->count--;
+			pthread_cond_broadcast(&queue_id->cond);
+			break;
+		}
+		if (!cond_wait(&queue_id->cond, &queue_id->lock, millisec, &ts)) {
+			event.status = (millisec == 0) ? osOK : osEventTimeout;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&queue_id->lock);
+	return event;
+}
+
+/******************************************************************************
+ * Interrupt masking
+ ******************************************************************************/
+
+static pthread_mutex_t irq_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread uint32_t irq_masked;
+
+void __disable_irq(void)
+{
+	if (!irq_masked) {
+		pthread_mutex_lock(&irq_lock);
+		irq_masked = 1;
+	}
+}
+
+void __enable_irq(void)
+{
+	if (irq_masked) {
+		irq_masked = 0;
+		pthread_mutex_unlock(&irq_lock);
+	}
+}
+
+uint32_t __get_PRIMASK(void)
+{
+	return irq_masked;
+}
+
+void __set_PRIMASK(uint32_t primask)
+{
+	if (primask) {
+		__disable_irq();
+	} else {
+		__enable_irq();
+	}
+}
@@ -0,0 +1,180 @@
+/*
+ * Host stand-in for the CMSIS-RTOS API of RTX (libos/include/cmsis_os.h),
+ * for system/hostsim. The types and calls are the same, host/cmsis_os.c
+ * runs them on pthreads. Only threads, signals, mutexes, semaphores and
+ * message queues are there; see ../README.md for what differs.
+ */
+
+#ifndef _CMSIS_OS_H
+#define _CMSIS_OS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define osCMSIS           0x10001
+#define osKernelSystemId "pthreads"
+
+#define WORDS_STACK_SIZE   512
+#define DEFAULT_STACK_SIZE (WORDS_STACK_SIZE*4)
+
+#define osFeature_MainThread   1
+#define osFeature_Signals      16
+#define osFeature_Semaphore    65535
+#define osFeature_Wait         0
+
+#ifdef  __cplusplus
+extern "C"
+{
+#endif
+
+typedef enum  {
+  osPriorityIdle          = -3,
+  osPriorityLow           = -2,
+  osPriorityBelowNormal   = -1,
+  osPriorityNormal        =  0,
+  osPriorityAboveNormal   = +1,
+  osPriorityHigh          = +2,
+  osPriorityRealtime      = +3,
+  osPriorityError         =  0x84
+} osPriority;
+
+#define osWaitForever     0xFFFFFFFF
+
+typedef enum  {
+  osOK                    =     0,
+  osEventSignal           =  0x08,
+  osEventMessage          =  0x10,
+  osEventMail             =  0x20,
+  osEventTimeout          =  0x40,
+  osErrorParameter        =  0x80,
+  osErrorResource         =  0x81,
+  osErrorTimeoutResource  =  0xC1,
+  osErrorISR              =  0x82,
+  osErrorISRRecursive     =  0x83,
+  osErrorPriority         =  0x84,
+  osErrorNoMemory         =  0x85,
+  osErrorValue            =  0x86,
+  osErrorOS               =  0xFF,
+  os_status_reserved      =  0x7FFFFFFF
+} osStatus;
+
+typedef void (*os_pthread) (void const *argument);
+
+typedef struct os_thread_cb *osThreadId;
+typedef struct os_mutex_cb *osMutexId;
+typedef struct os_semaphore_cb *osSemaphoreId;
+typedef struct os_messageQ_cb *osMessageQId;
+typedef struct os_mailQ_cb *osMailQId;
+
+/* Only the state is kept, for Thread::get_state() */
+struct OS_TCB {
+  uint8_t state;
+};
+
+typedef struct os_thread_def  {
+  os_pthread               pthread;
+  osPriority             tpriority;
+  uint32_t               stacksize;
+  unsigned char         *stack_pointer;  ///< not used: pthreads have their own
+  struct OS_TCB          tcb;
+} osThreadDef_t;
+
+typedef struct os_mutex_def  {
+  void                      *mutex;
+} osMutexDef_t;
+
+typedef struct os_semaphore_def  {
+  void                  *semaphore;
+} osSemaphoreDef_t;
+
+typedef struct os_messageQ_def  {
+  uint32_t                queue_sz;
+  void                       *pool;
+} osMessageQDef_t;
+
+typedef struct  {
+  osStatus                 status;
+  union  {
+    uint32_t                    v;
+    void                       *p;
+    int32_t               signals;
+  } value;
+  union  {
+    osMailQId             mail_id;
+    osMessageQId       message_id;
+  } def;
+} osEvent;
+
+osStatus osKernelInitialize (void);
+osStatus osKernelStart (void);
+int32_t osKernelRunning(void);
+
+#define osThreadDef(name, priority, stacksz)  \
+osThreadDef_t os_thread_def_##name = \
+{ (name), (priority), (stacksz), NULL }
+
+#define osThread(name)  \
+&os_thread_def_##name
+
+osThreadId osThreadCreate (osThreadDef_t *thread_def, void *argument);
+osThreadId osThreadGetId (void);
+osStatus osThreadTerminate (osThreadId thread_id);
+osStatus osThreadYield (void);
+osStatus osThreadSetPriority (osThreadId thread_id, osPriority priority);
+osPriority osThreadGetPriority (osThreadId thread_id);
+
+osStatus osDelay (uint32_t millisec);
+
+int32_t osSignalSet (osThreadId thread_id, int32_t signals);
+int32_t osSignalClear (osThreadId thread_id, int32_t signals);
+int32_t osSignalGet (osThreadId thread_id);
+osEvent osSignalWait (int32_t signals, uint32_t millisec);
+
+#define osMutexDef(name)  \
+osMutexDef_t os_mutex_def_##name = { NULL }
+
+#define osMutex(name)  \
+&os_mutex_def_##name
+
+osMutexId osMutexCreate (osMutexDef_t *mutex_def);
+osStatus osMutexWait (osMutexId mutex_id, uint32_t millisec);
+osStatus osMutexRelease (osMutexId mutex_id);
+osStatus osMutexDelete (osMutexId mutex_id);
+
+#define osSemaphoreDef(name)  \
+osSemaphoreDef_t os_semaphore_def_##name = { NULL }
+
+#define osSemaphore(name)  \
+&os_semaphore_def_##name
+
+osSemaphoreId osSemaphoreCreate (osSemaphoreDef_t *semaphore_def, int32_t count);
+int32_t osSemaphoreWait (osSemaphoreId semaphore_id, uint32_t millisec);
+osStatus osSemaphoreRelease (osSemaphoreId semaphore_id);
+osStatus osSemaphoreDelete (osSemaphoreId semaphore_id);
+
+#define osMessageQDef(name, queue_sz, type)   \
+osMessageQDef_t os_messageQ_def_##name = \
+{ (queue_sz), NULL }
+
+#define osMessageQ(name) \
+&os_messageQ_def_##name
+
+osMessageQId osMessageCreate (osMessageQDef_t *queue_def, osThreadId thread_id);
+osStatus osMessagePut (osMessageQId queue_id, uint32_t info, uint32_t millisec);
+osEvent osMessageGet (osMessageQId queue_id, uint32_t millisec);
+
+/*
+ * Interrupts are threads on the host. Masking them takes a lock, which a
+ * thread that stands in for an interrupt handler holds while it runs.
+ * PRIMASK is 1 while the calling thread holds the lock.
+ */
+void __disable_irq (void);
+void __enable_irq (void);
+uint32_t __get_PRIMASK (void);
+void __set_PRIMASK (uint32_t primask);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif  // _CMSIS_OS_H
@@ -0,0 +1,9 @@
+/* Host stand-in for diag.h of libameba, for system/hostsim: DiagPrintf()
+ * writes to stderr, see host/arduino.cpp. */
+
+#ifndef HOSTSIM_DIAG_H
+#define HOSTSIM_DIAG_H
+
+#include "basic_types.h"
+
+#endif
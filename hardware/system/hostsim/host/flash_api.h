@@ -0,0 +1,28 @@
+/*
+ * Host stand-in for flash_api.h of libameba, for system/hostsim. The
+ * functions and the flash object are up to the program that links
+ * FlashKV, see kvsim.cpp.
+ */
+
+#ifndef HOSTSIM_FLASH_API_H
+#define HOSTSIM_FLASH_API_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct flash_s flash_t;
+
+extern flash_t flash;
+
+void flash_erase_sector(flash_t *obj, uint32_t address);
+int  flash_stream_read (flash_t *obj, uint32_t address, uint32_t len, uint8_t *data);
+int  flash_stream_write(flash_t *obj, uint32_t address, uint32_t len, uint8_t *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,17 @@
+/* Host stand-in for hal_api.h of libameba, for system/hostsim: the types
+ * the HAL headers need, and no registers behind them. */
+
+#ifndef HOSTSIM_HAL_API_H
+#define HOSTSIM_HAL_API_H
+
+#include "basic_types.h"
+#include "section_config.h"
+
+#define VOID void
+
+typedef struct _IRQ_HANDLE_ {
+    void *IrqFun;
+    void *Data;
+} IRQ_HANDLE;
+
+#endif
@@ -0,0 +1,25 @@
+/* Host stand-in for hal_dac.h of libameba, for system/hostsim: the types
+ * DAC1.h declares its members with. There is no DAC. */
+
+#ifndef HOSTSIM_HAL_DAC_H
+#define HOSTSIM_HAL_DAC_H
+
+#include "basic_types.h"
+
+typedef void *PSAL_DAC_HND;
+typedef void *PSAL_DAC_HND_PRIV;
+typedef void *PSAL_DAC_MNGT_ADPT;
+typedef void *PHAL_GDMA_ADAPTER;
+typedef void *PHAL_GDMA_OP;
+typedef void *PIRQ_HANDLE;
+
+typedef struct {
+    u32 DataLen;
+    u32 *pDataBuf;
+    u32 RSVD;
+} SAL_DAC_TRANSFER_BUF;
+
+#define DAC_DATA_RATE_10K   0
+#define DAC_DATA_RATE_250K  1
+
+#endif
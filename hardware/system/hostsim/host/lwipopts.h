@@ -0,0 +1,38 @@
+/*
+ * lwipopts.h of the board, for system/hostsim, plus the loopback
+ * interface (127.0.0.1) that the benchmarks talk over instead of WiFi.
+ * HOSTSIM_TCPSIM builds lwIP for tcpsim.cpp instead.
+ */
+
+#ifndef HOSTSIM_LWIPOPTS_H
+#define HOSTSIM_LWIPOPTS_H
+
+/* lwIP is built here from the tree's sources, with every option */
+#ifndef LWIP_PREBUILT
+#define LWIP_PREBUILT               0
+#endif
+
+#include "../../libameba/sw/lib/net/lwip/lwipopts.h"
+
+#ifndef HOSTSIM_TCPSIM
+#define LWIP_NETIF_LOOPBACK         1
+#define LWIP_HAVE_LOOPIF            1
+#else
+/* tcpsim.cpp has its own interface, with loss and a receive path through
+   PBUF_POOL like the WiFi driver's. Both ends of its connections are
+   here, so it needs two pcbs and netconns per connection. */
+#define LWIP_NETIF_LOOPBACK         0
+#define LWIP_HAVE_LOOPIF            0
+#undef MEMP_NUM_TCP_PCB
+#define MEMP_NUM_TCP_PCB            16
+#define MEMP_NUM_NETCONN            17
+#endif
+
+/* Pointers are 8 bytes here, memp and pbuf headers must stay aligned */
+#undef MEM_ALIGNMENT
+#define MEM_ALIGNMENT               8
+
+/* stdlib.h of the host already brings struct timeval and fd_set */
+#define LWIP_TIMEVAL_PRIVATE        0
+
+#endif
@@ -0,0 +1,7 @@
+/* Host stand-in for objects.h of libameba, for system/hostsim: see
+ * serial_api.h for serial_t. */
+
+#ifndef HOSTSIM_OBJECTS_H
+#define HOSTSIM_OBJECTS_H
+
+#endif
@@ -0,0 +1,13 @@
+/* Host stand-in for rt_os_service.h of libameba, for system/hostsim: only
+ * the types the core headers need. */
+
+#ifndef HOSTSIM_RT_OS_SERVICE_H
+#define HOSTSIM_RT_OS_SERVICE_H
+
+#include "basic_types.h"
+#include "cmsis_os.h"
+
+typedef void* _sema;
+typedef void* _mutex;
+
+#endif
@@ -0,0 +1,17 @@
+/* Host stand-in for rtl8195a_gpio.h of libameba, for system/hostsim: the
+ * pin names and register offsets, with nothing behind them. */
+
+#ifndef HOSTSIM_RTL8195A_GPIO_H
+#define HOSTSIM_RTL8195A_GPIO_H
+
+#include "hal_api.h"
+#include "../../libameba/targets/hal/target_rtk/target_8195a/hal_gpio.h"
+
+#define GPIO_PORTA_DR           0x00
+#define GPIO_PORTB_DR           0x0c
+#define GPIO_PORTC_DR           0x18
+#define GPIO_EXT_PORTA          0x50
+#define GPIO_EXT_PORTB          0x54
+#define GPIO_EXT_PORTC          0x58
+
+#endif
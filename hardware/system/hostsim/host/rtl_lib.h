@@ -0,0 +1,10 @@
+/* Host stand-in for rtl_lib.h of libameba, for system/hostsim: the C
+ * library of the host takes its place. */
+
+#ifndef HOSTSIM_RTL_LIB_H
+#define HOSTSIM_RTL_LIB_H
+
+#include <stdio.h>
+#include <string.h>
+
+#endif
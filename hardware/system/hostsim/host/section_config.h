@@ -0,0 +1,12 @@
+/* Host stand-in for section_config.h of libameba, for system/hostsim:
+ * there is no TCM, everything stays where the host linker puts it. */
+
+#ifndef HOSTSIM_SECTION_CONFIG_H
+#define HOSTSIM_SECTION_CONFIG_H
+
+#define TCM_TEXT_SECTION
+#define TCM_DATA_SECTION
+#define TCM_BSS_SECTION
+#define IMAGE2_TEXT_SECTION
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ * Host stand-in for serial_api.h of libameba, for system/hostsim. The
+ * functions are up to the test that links a UART driver, see
+ * onewiretest.cpp.
+ */
+
+#ifndef HOSTSIM_SERIAL_API_H
+#define HOSTSIM_SERIAL_API_H
+
+#include <stdint.h>
+#include "PinNames.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    ParityNone = 0,
+    ParityOdd = 1,
+    ParityEven = 2,
+    ParityForced1 = 3,
+    ParityForced0 = 4
+} SerialParity;
+
+typedef enum {
+    RxIrq,
+    TxIrq
+} SerialIrq;
+
+typedef void (*uart_irq_handler)(uint32_t id, SerialIrq event);
+
+typedef struct serial_s {
+    PinName tx;
+    PinName rx;
+} serial_t;
+
+void serial_init       (serial_t *obj, PinName tx, PinName rx);
+void serial_baud       (serial_t *obj, int baudrate);
+void serial_format     (serial_t *obj, int data_bits, SerialParity parity, int stop_bits);
+void serial_irq_handler(serial_t *obj, uart_irq_handler handler, uint32_t id);
+void serial_irq_set    (serial_t *obj, SerialIrq irq, uint32_t enable);
+int  serial_getc       (serial_t *obj);
+void serial_putc       (serial_t *obj, uint8_t c);
+int  serial_readable   (serial_t *obj);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
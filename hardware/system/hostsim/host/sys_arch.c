@@ -0,0 +1,327 @@
+/*
+ * The lwIP sys API on pthreads, for system/hostsim. Takes the place of
+ * lwip-sys/arch/sys_arch.c, whose mailboxes carry 32-bit messages: on a
+ * 64-bit host they could not hold a pointer. Time is CLOCK_MONOTONIC.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+
+#include "cmsis_os.h"
+
+struct sys_sem {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    unsigned int count;
+};
+
+struct sys_mutex {
+    pthread_mutex_t lock;
+};
+
+struct sys_mbox {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int size;
+    int first;
+    int count;
+    void *msg[];
+};
+
+static pthread_mutex_t lwip_sys_mutex;
+
+static void sys_fatal(const char *msg)
+{
+    fprintf(stderr, "%s\n", msg);
+    abort();
+}
+
+static void cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static void recursive_init(pthread_mutex_t *lock)
+{
+    pthread_mutexattr_t attr;
+
+    // RTX mutexes are recursive
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Waits on cond for at most timeout ms, 0 for ever. Returns 0 on timeout. */
+static int cond_wait(pthread_cond_t *cond, pthread_mutex_t *lock,
+                     u32_t timeout, const struct timespec *ts)
+{
+    if (timeout == 0) {
+        pthread_cond_wait(cond, lock);
+        return 1;
+    }
+    return pthread_cond_timedwait(cond, lock, ts) != ETIMEDOUT;
+}
+
+static void deadline(struct timespec *ts, u32_t timeout)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += timeout / 1000;
+    ts->tv_nsec += (long)(timeout % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+err_t sys_mbox_new(sys_mbox_t *mbox, int queue_sz) {
+    struct sys_mbox *m;
+
+    if (queue_sz <= 0)
+        queue_sz = MB_SIZE;
+    m = calloc(1, sizeof(*m) + queue_sz * sizeof(void *));
+    if (m == NULL)
+        return ERR_MEM;
+    pthread_mutex_init(&m->lock, NULL);
+    cond_init(&m->cond);
+    m->size = queue_sz;
+    *mbox = m;
+    return ERR_OK;
+}
+
+void sys_mbox_free(sys_mbox_t *mbox) {
+    struct sys_mbox *m = *mbox;
+
+    if (m->count != 0)
+        sys_fatal("sys_mbox_free error");
+    pthread_mutex_destroy(&m->lock);
+    pthread_cond_destroy(&m->cond);
+    free(m);
+}
+
+static err_t mbox_put(struct sys_mbox *m, void *msg, int block) {
+    pthread_mutex_lock(&m->lock);
+    while (m->count == m->size) {
+        if (!block) {
+            pthread_mutex_unlock(&m->lock);
+            return ERR_MEM;
+        }
+        pthread_cond_wait(&m->cond, &m->lock);
+    }
+    m->msg[(m->first + m->count) % m->size] = msg;
+    m->count++;
+    pthread_cond_broadcast(&m->cond);
+    pthread_mutex_unlock(&m->lock);
+    return ERR_OK;
+}
+
+void sys_mbox_post(sys_mbox_t *mbox, void *msg) {
+    mbox_put(*mbox, msg, 1);
+}
+
+err_t sys_mbox_trypost(sys_mbox_t *mbox, void *msg) {
+    return mbox_put(*mbox, msg, 0);
+}
+
+u32_t sys_arch_mbox_fetch(sys_mbox_t *mbox, void **msg, u32_t timeout) {
+    struct sys_mbox *m = *mbox;
+    uint64_t start = now_us();
+    struct timespec ts;
+
+    deadline(&ts, timeout);
+    pthread_mutex_lock(&m->lock);
+    while (m->count == 0) {
+        if (!cond_wait(&m->cond, &m->lock, timeout, &ts)) {
+            pthread_mutex_unlock(&m->lock);
+            return SYS_ARCH_TIMEOUT;
+        }
+    }
+    if (msg != NULL)
+        *msg = m->msg[m->first];
+    m->first = (m->first + 1) % m->size;
+    m->count--;
+    pthread_cond_broadcast(&m->cond);
+    pthread_mutex_unlock(&m->lock);
+
+    return (u32_t)((now_us() - start) / 1000);
+}
+
+u32_t sys_arch_mbox_tryfetch(sys_mbox_t *mbox, void **msg) {
+    struct sys_mbox *m = *mbox;
+
+    pthread_mutex_lock(&m->lock);
+    if (m->count == 0) {
+        pthread_mutex_unlock(&m->lock);
+        return SYS_MBOX_EMPTY;
+    }
+    if (msg != NULL)
+        *msg = m->msg[m->first];
+    m->first = (m->first + 1) % m->size;
+    m->count--;
+    pthread_cond_broadcast(&m->cond);
+    pthread_mutex_unlock(&m->lock);
+
+    return 0;
+}
+
+err_t sys_sem_new(sys_sem_t *sem, u8_t count) {
+    struct sys_sem *s = calloc(1, sizeof(*s));
+
+    if (s == NULL)
+        sys_fatal("sys_sem_new create error");
+    pthread_mutex_init(&s->lock, NULL);
+    cond_init(&s->cond);
+    s->count = count;
+    *sem = s;
+    return ERR_OK;
+}
+
+u32_t sys_arch_sem_wait(sys_sem_t *sem, u32_t timeout) {
+    struct sys_sem *s = *sem;
+    uint64_t start = now_us();
+    struct timespec ts;
+
+    deadline(&ts, timeout);
+    pthread_mutex_lock(&s->lock);
+    while (s->count == 0) {
+        if (!cond_wait(&s->cond, &s->lock, timeout, &ts)) {
+            pthread_mutex_unlock(&s->lock);
+            return SYS_ARCH_TIMEOUT;
+        }
+    }
+    s->count--;
+    pthread_mutex_unlock(&s->lock);
+
+    return (u32_t)((now_us() - start) / 1000);
+}
+
+void sys_sem_signal(sys_sem_t *sem) {
+    struct sys_sem *s = *sem;
+
+    pthread_mutex_lock(&s->lock);
+    s->count++;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+}
+
+void sys_sem_free(sys_sem_t *sem) {
+    struct sys_sem *s = *sem;
+
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->cond);
+    free(s);
+}
+
+err_t sys_mutex_new(sys_mutex_t *mutex) {
+    struct sys_mutex *m = calloc(1, sizeof(*m));
+
+    if (m == NULL)
+        return ERR_MEM;
+    recursive_init(&m->lock);
+    *mutex = m;
+    return ERR_OK;
+}
+
+void sys_mutex_lock(sys_mutex_t *mutex) {
+    pthread_mutex_lock(&(*mutex)->lock);
+}
+
+int sys_mutex_trylock(sys_mutex_t *mutex) {
+    return pthread_mutex_trylock(&(*mutex)->lock) == 0;
+}
+
+void sys_mutex_unlock(sys_mutex_t *mutex) {
+    pthread_mutex_unlock(&(*mutex)->lock);
+}
+
+void sys_mutex_free(sys_mutex_t *mutex) {
+    pthread_mutex_destroy(&(*mutex)->lock);
+    free(*mutex);
+}
+
+void *sys_thread_self(void) {
+    return (void *)osThreadGetId();
+}
+
+void sys_thread_wake(void *thread) {
+    osSignalSet((osThreadId)thread, SYS_WAKE_SIGNAL);
+}
+
+void sys_thread_sleep(uint32_t timeout) {
+    osSignalWait(SYS_WAKE_SIGNAL, timeout);
+}
+
+void sys_init(void) {
+    recursive_init(&lwip_sys_mutex);
+}
+
+u32_t sys_jiffies(void) {
+    return (u32_t)(now_us() / 10000);
+}
+
+sys_prot_t sys_arch_protect(void) {
+    pthread_mutex_lock(&lwip_sys_mutex);
+    return (sys_prot_t) 1;
+}
+
+void sys_arch_unprotect(sys_prot_t p) {
+    pthread_mutex_unlock(&lwip_sys_mutex);
+}
+
+u32_t sys_now(void) {
+    return (u32_t)(now_us() / 1000);
+}
+
+uint32_t sys_now_us(void) {
+    return (uint32_t)now_us();
+}
+
+void sys_msleep(u32_t ms) {
+    osDelay(ms);
+}
+
+struct thread_start {
+    lwip_thread_fn thread;
+    void *arg;
+};
+
+static void *thread_main(void *p) {
+    struct thread_start start = *(struct thread_start *)p;
+
+    free(p);
+    start.thread(start.arg);
+    return NULL;
+}
+
+sys_thread_t sys_thread_new(const char *name, lwip_thread_fn thread,
+                            void *arg, int stacksize, int prio) {
+    struct thread_start *start = malloc(sizeof(*start));
+    pthread_t tid;
+
+    if (start == NULL)
+        sys_fatal("sys_thread_new create error");
+    start->thread = thread;
+    start->arg = arg;
+    if (pthread_create(&tid, NULL, thread_main, start) != 0)
+        sys_fatal("sys_thread_new create error");
+    pthread_detach(tid);
+    return tid;
+}
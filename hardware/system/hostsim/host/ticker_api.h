@@ -0,0 +1,35 @@
+/* Host stand-in for ticker_api.h of libameba, for system/hostsim: the
+ * types TimerEvent.h needs, and the ticker queue TimerEvent.cpp calls.
+ * Ticker is not built. servotest.cpp, the only program that links
+ * TimerEvent, provides the queue on a simulated clock. */
+
+#ifndef HOSTSIM_TICKER_API_H
+#define HOSTSIM_TICKER_API_H
+
+#include <stdint.h>
+
+typedef uint32_t timestamp_t;
+
+typedef void (*ticker_event_handler)(uint32_t id);
+
+typedef struct ticker_event_s {
+    timestamp_t            timestamp;
+    uint32_t               id;
+    struct ticker_event_s *next;
+} ticker_event_t;
+
+typedef struct ticker_data_s ticker_data_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void ticker_set_handler(const ticker_data_t *const data, ticker_event_handler handler);
+void ticker_remove_event(const ticker_data_t *const data, ticker_event_t *obj);
+void ticker_insert_event(const ticker_data_t *const data, ticker_event_t *obj, timestamp_t timestamp, uint32_t id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
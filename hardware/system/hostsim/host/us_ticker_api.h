@@ -0,0 +1,23 @@
+/* Host stand-in for us_ticker_api.h of libameba, for system/hostsim: the
+ * microsecond ticker is CLOCK_MONOTONIC, see host/arduino.cpp, except in
+ * servotest.cpp, which runs it on a simulated clock. */
+
+#ifndef HOSTSIM_US_TICKER_API_H
+#define HOSTSIM_US_TICKER_API_H
+
+#include <stdint.h>
+
+#include "ticker_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t us_ticker_read(void);
+const ticker_data_t *get_us_ticker_data(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
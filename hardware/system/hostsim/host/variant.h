@@ -0,0 +1,32 @@
+/*
+ * Host stand-in for variants/arduino_ameba/variant.h, for system/hostsim:
+ * no pins, and Serial writes to stdout and never has input.
+ */
+
+#ifndef HOSTSIM_VARIANT_H
+#define HOSTSIM_VARIANT_H
+
+#include "Arduino.h"
+
+#ifdef __cplusplus
+#include "Stream.h"
+
+class HostSerial : public Stream
+{
+public:
+    void begin(uint32_t baud) {}
+    void end() {}
+    virtual int available() { return 0; }
+    virtual int read() { return -1; }
+    virtual int peek() { return -1; }
+    virtual void flush();
+    virtual size_t write(uint8_t c);
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+    operator bool() { return true; }
+};
+
+extern HostSerial Serial;
+#endif
+
+#endif
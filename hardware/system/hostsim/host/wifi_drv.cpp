@@ -0,0 +1,149 @@
+/*
+ * WiFiDrv on the loopback interface of lwIP, for system/hostsim. Takes
+ * the place of libraries/WiFi/src/wifi_drv.cpp, whose driver is in the
+ * prebuilt library: wifiDriverInit() starts the tcpip thread, and
+ * begin() connects at once to a network that has only 127.0.0.1.
+ */
+
+#include <string.h>
+
+#include "Arduino.h"
+
+#include "lwip/tcpip.h"
+#include "lwip/netif.h"
+
+#include "wifi_drv.h"
+
+static char _ssid[WL_SSID_MAX_LENGTH + 1];
+static uint8_t _mac[WL_MAC_ADDR_LENGTH];
+static uint8_t _status = WL_IDLE_STATUS;
+static wl_connect_stats_t _connectStats;
+
+static void tcpip_ready(void *arg)
+{
+	sys_sem_signal((sys_sem_t *)arg);
+}
+
+void WiFiDrv::wifiDriverInit()
+{
+	sys_sem_t ready;
+
+	sys_sem_new(&ready, 0);
+	tcpip_init(tcpip_ready, &ready);
+	sys_sem_wait(&ready);
+	sys_sem_free(&ready);
+
+	// lwip_init() added the loopback interface, and no other
+	pnetif = netif_list;
+	padapter = NULL;
+	netif_set_default(netif_list);
+	_status = WL_DISCONNECTED;
+}
+
+int8_t WiFiDrv::wifiSetPassphrase(char* ssid, uint8_t ssid_len, const char *passphrase, const uint8_t len)
+{
+	if (ssid_len > WL_SSID_MAX_LENGTH)
+		return WL_FAILURE;
+	memcpy(_ssid, ssid, ssid_len);
+	_ssid[ssid_len] = '\0';
+	memset(&_connectStats, 0, sizeof(_connectStats));
+	_status = WL_CONNECTED;
+	return WL_SUCCESS;
+}
+
+void WiFiDrv::forgetNetwork()
+{
+}
+
+const wl_connect_stats_t& WiFiDrv::getConnectStats()
+{
+	return _connectStats;
+}
+
+int8_t WiFiDrv::disconnect()
+{
+	_status = WL_DISCONNECTED;
+	return WL_SUCCESS;
+}
+
+int8_t WiFiDrv::startScanNetworks()
+{
+	return WL_SUCCESS;
+}
+
+uint8_t WiFiDrv::getScanNetworks()
+{
+	return 0;
+}
+
+char* WiFiDrv::getSSIDNetoworks(uint8_t networkItem)
+{
+	return NULL;
+}
+
+int32_t WiFiDrv::getRSSINetoworks(uint8_t networkItem)
+{
+	return 0;
+}
+
+uint8_t WiFiDrv::getEncTypeNetowrks(uint8_t networkItem)
+{
+	return ENC_TYPE_NONE;
+}
+
+uint8_t* WiFiDrv::getMacAddress()
+{
+	return _mac;
+}
+
+void WiFiDrv::getIpAddress(IPAddress& ip)
+{
+	ip = IPAddress(127, 0, 0, 1);
+}
+
+void WiFiDrv::getSubnetMask(IPAddress& mask)
+{
+	mask = IPAddress(255, 0, 0, 0);
+}
+
+void WiFiDrv::getGatewayIP(IPAddress& ip)
+{
+	ip = IPAddress(127, 0, 0, 1);
+}
+
+char* WiFiDrv::getCurrentSSID()
+{
+	return _ssid;
+}
+
+uint8_t* WiFiDrv::getCurrentBSSID()
+{
+	return _mac;
+}
+
+int32_t WiFiDrv::getCurrentRSSI()
+{
+	return 0;
+}
+
+uint8_t WiFiDrv::getCurrentEncryptionType()
+{
+	return ENC_TYPE_NONE;
+}
+
+uint8_t WiFiDrv::getConnectionStatus()
+{
+	return _status;
+}
+
+uint8_t WiFiDrv::status()
+{
+	return _status;
+}
+
+int WiFiDrv::getHostByName(const char* aHostname, IPAddress& aResult)
+{
+	return WL_FAILURE;
+}
+
+WiFiDrv wiFiDrv;
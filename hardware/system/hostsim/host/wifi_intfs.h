@@ -0,0 +1,31 @@
+/* Host stand-in for wifi_intfs.h of libameba, for system/hostsim: the
+ * codes and security types of the WiFi library. There is no driver, see
+ * host/wifi_drv.cpp. */
+
+#ifndef HOSTSIM_WIFI_INTFS_H
+#define HOSTSIM_WIFI_INTFS_H
+
+#include "basic_types.h"
+
+typedef enum {
+    WL_FAILURE = -1,
+    WL_SUCCESS = 1,
+    WL_INVALID_LENGTH,
+    WL_NOT_SUPPORTED,
+    WL_RESOURCES,
+    WL_BUSY,
+    WL_RETRY,
+    WL_INVALID_ARGS,
+    WL_CARD_FAILURE,
+    WL_NO_AP,
+    WL_WRONG_SECURITY
+} wl_err_t;
+
+typedef enum {
+    RTW_SECURITY_OPEN           = 0,
+    RTW_SECURITY_WPA2_AES_PSK   = 0x00400004,
+    RTW_SECURITY_UNKNOWN        = -1,
+    RTW_SECURITY_FORCE_32_BIT   = 0x7fffffff
+} rtw_security_t;
+
+#endif
@@ -0,0 +1,734 @@
+/*
+ * Benchmarks of the core, the WiFi library and lwIP, built for the host
+ * and talking over lwIP's loopback interface. Each one runs a fixed
+ * workload once to warm up, then RUNS times, and reports the median and
+ * the spread of the runs. See README.md.
+ *
+ *   hostsim              run every benchmark
+ *   hostsim <name>...    run only these: loop string print http xively
+ *                        xively2 mqtt udp
+ */
+
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+
+#include "Arduino.h"
+#include "Thread.h"
+#include "heap_caps.h"
+#include "WiFi.h"
+#include "WiFiClient.h"
+#include "WiFiServer.h"
+#include "WiFiUdp.h"
+#include "HttpClient.h"
+#include "PubSubClient.h"
+#include "Xively.h"
+#include "lwip/sockets.h"
+#include "lwip/err.h"
+#include "lwip/dns.h"
+#include "lwip/stats.h"
+
+#define RUNS			21
+
+#define LOOP_ITERATIONS		50000000
+
+#define STRING_LINES		100000
+#define PRINT_LINES		500000
+#define HTTP_REQUESTS		200
+#define XIVELY_PUTS		200
+// Most of a put without a buffer is the wait for a delayed ACK, see
+// bench_xively2()
+#define XIVELY2_PUTS		10
+#define XIVELY_DATASTREAMS	32
+#define MQTT_MESSAGES		1000000
+#define MQTT_PAYLOAD		32
+#define UDP_PACKETS		20000
+#define UDP_PAYLOAD		64
+// Packets in flight: each one queued at the socket holds a netbuf
+#define UDP_WINDOW		MEMP_NUM_NETBUF
+
+#define HTTP_PORT		8080
+#define XIVELY_PORT		80	// XivelyClient always uses it
+#define DNS_PORT		53
+#define MQTT_PORT		1883
+#define UDP_PORT		5005
+
+// Signals to the thread running the benchmarks
+#define SIG_MQTT_DONE		0x01
+#define SIG_UDP_WINDOW		0x02
+
+// lwIP's heap, BD_RAM on the board
+static uint8_t heap_bd_ram[128 * 1024] __attribute__((aligned(8)));
+
+static const IPAddress localhost(127, 0, 0, 1);
+static osThreadId bench_thread;
+// Tells the peer thread of a benchmark to close its sockets and return
+static volatile bool peer_stop;
+// What a benchmark has to add to its line of results
+static char bench_note[80];
+
+static double now(void)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// CPU time of every thread: the benchmark, its peer and lwIP's
+static double cpu_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// CPU time of the calling thread only, for the benchmarks without a peer:
+// the time the host gives other threads and processes does not count
+static double thread_cpu_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Reads a client through a buffer of TCP_MSS: one socket call for each
+// segment, not one for each field of a small message
+class ClientReader {
+public:
+	ClientReader(WiFiClient &aClient) : client(aClient), pos(0), length(0) {}
+
+	// Reads exactly size bytes, false if the connection closes first
+	bool read(uint8_t *data, size_t size)
+	{
+		while (size > 0) {
+			if (pos == length) {
+				int n = client.read(buf, sizeof(buf));
+				if (n <= 0)
+					return false;
+				pos = 0;
+				length = n;
+			}
+			size_t n = min(size, length - pos);
+			memcpy(data, buf + pos, n);
+			pos += n;
+			data += n;
+			size -= n;
+		}
+		return true;
+	}
+
+private:
+	WiFiClient &client;
+	uint8_t buf[TCP_MSS];
+	size_t pos, length;
+};
+
+/* Loop, String and Print ------------------------------------------------ */
+
+// A fixed loop of integer arithmetic and none of the tree's code: its
+// spread is that of the host itself, which no benchmark can beat
+static double bench_loop(void)
+{
+	volatile uint32_t x = 1;
+	double t0 = thread_cpu_now();
+
+	for (int i = 0; i < LOOP_ITERATIONS; i++)
+		x = x * 1664525 + 1013904223;
+	return LOOP_ITERATIONS / (thread_cpu_now() - t0);
+}
+
+class NullPrint : public Print {
+public:
+	size_t bytes;
+
+	NullPrint() : bytes(0) {}
+	virtual size_t write(uint8_t c) { bytes++; return 1; }
+	virtual size_t write(const uint8_t *buffer, size_t size) { bytes += size; return size; }
+};
+
+// Heap allocations of Strings, see main()
+static uint32_t string_allocs;
+
+static void *count_realloc(void *ptr, size_t size)
+{
+	string_allocs++;
+	return realloc(ptr, size);
+}
+
+// Builds the line of JSON a sensor sketch sends
+static double bench_string(void)
+{
+	NullPrint out;
+	uint32_t allocs = string_allocs;
+	double t0 = thread_cpu_now();
+
+	for (int i = 0; i < STRING_LINES; i++) {
+		String s("{\"id\":");
+		s += i;
+		s += ",\"name\":\"sensor-";
+		s += String(i % 16, HEX);
+		s += "\",\"temp\":";
+		s += 20.0f + (i % 100) / 10.0f;
+		s += '}';
+		out.print(s);
+	}
+	t0 = thread_cpu_now() - t0;
+	snprintf(bench_note, sizeof(bench_note), "   %.2f allocations/line",
+		 (double)(string_allocs - allocs) / STRING_LINES);
+	return STRING_LINES / t0;
+}
+
+static double bench_print(void)
+{
+	NullPrint out;
+	double t0 = thread_cpu_now();
+
+	for (int i = 0; i < PRINT_LINES; i++) {
+		out.print("id=");
+		out.print(i);
+		out.print(" hex=");
+		out.print(i, HEX);
+		out.print(" temp=");
+		out.println(20.0 + (i % 100) / 10.0, 2);
+	}
+	return PRINT_LINES / (thread_cpu_now() - t0);
+}
+
+/* HTTP ------------------------------------------------------------------- */
+
+static const char http_response[] =
+	"HTTP/1.1 200 OK\r\n"
+	"Content-Type: text/plain\r\n"
+	"Content-Length: 64\r\n"
+	"Connection: close\r\n"
+	"\r\n"
+	"0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef";
+
+// Answers each request with http_response and closes
+static void http_server(void const *argument)
+{
+	WiFiServer server(HTTP_PORT);
+	uint8_t buf[256];
+
+	server.begin();
+	while (!peer_stop) {
+		if (server.waitFor(SOCKET_READABLE, 10) <= 0)
+			continue;
+
+		WiFiClient client = server.available();
+		uint32_t last = 0;
+		bool done = false;
+
+		// Read up to the empty line that ends the headers
+		while (!done) {
+			int n = client.read(buf, sizeof(buf));
+			if (n <= 0)
+				break;
+			for (int i = 0; i < n && !done; i++) {
+				last = (last << 8) | buf[i];
+				done = (last == 0x0d0a0d0a);
+			}
+		}
+		if (done)
+			client.write((const uint8_t *)http_response, sizeof(http_response) - 1);
+		client.stop();
+	}
+}
+
+static double bench_http(void)
+{
+	WiFiClient client;
+	HttpClient http(client);
+	uint8_t buf[64];
+	double t0 = now();
+
+	for (int i = 0; i < HTTP_REQUESTS; i++) {
+		if (http.get(localhost, "localhost", HTTP_PORT, "/") != 0 ||
+		    http.responseStatusCode() != 200 ||
+		    http.skipResponseHeaders() != HTTP_SUCCESS) {
+			fprintf(stderr, "http: request %d failed\n", i);
+			http.stop();
+			return 0;
+		}
+		while (!http.endOfBodyReached()) {
+			if (http.read(buf, sizeof(buf)) <= 0) {
+				fprintf(stderr, "http: body %d cut short\n", i);
+				break;
+			}
+		}
+		http.stop();
+	}
+	return HTTP_REQUESTS / (now() - t0);
+}
+
+/* Xively ----------------------------------------------------------------- */
+
+static const char xively_response[] =
+	"HTTP/1.1 200 OK\r\n"
+	"Content-Length: 0\r\n"
+	"Connection: close\r\n"
+	"\r\n";
+
+// Answers a DNS query for any name with 127.0.0.1, so api.xively.com is
+// xively_server(). The buffer holds the query and gets the answer.
+static int dns_answer(uint8_t *buf, int n, int size)
+{
+	static const uint8_t answer[] = {
+		0xc0, 12,		// the name of the question
+		0, 1, 0, 1,		// A, IN
+		0, 0, 0x0e, 0x10,	// one hour
+		0, 4, 127, 0, 0, 1,
+	};
+	int off = 12;
+
+	while (off < n && buf[off] != 0)
+		off += buf[off] + 1;
+	off += 1 + 4;		// the zero, type and class
+	if (off > n || off + (int)sizeof(answer) > size)
+		return 0;
+	buf[2] = 0x81;		// response, recursion desired
+	buf[3] = 0x80;		// recursion available
+	buf[6] = 0;
+	buf[7] = 1;		// one answer
+	memcpy(buf + off, answer, sizeof(answer));
+	return off + sizeof(answer);
+}
+
+// Reads each PUT, headers and body, and answers it with an empty 200.
+// Also answers DNS queries, see dns_answer(), until the first: WiFiResolver
+// caches the answer for an hour, and the socket would hold one of the
+// MEMP_NUM_NETCONN netconns that the server needs to accept the puts.
+static void xively_server(void const *argument)
+{
+	WiFiServer server(XIVELY_PORT);
+	struct sockaddr_in local, peer;
+	uint8_t buf[512];
+	int dns = lwip_socket(AF_INET, SOCK_DGRAM, 0);
+
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_port = PP_HTONS(DNS_PORT);
+	local.sin_addr.s_addr = PP_HTONL(INADDR_LOOPBACK);
+	lwip_bind(dns, (struct sockaddr *)&local, sizeof(local));
+
+	server.begin();
+	while (!peer_stop) {
+		socklen_t peer_len = sizeof(peer);
+		int n = dns < 0 ? 0 : lwip_recvfrom(dns, buf, sizeof(buf), MSG_DONTWAIT,
+						    (struct sockaddr *)&peer, &peer_len);
+		if (n > 12 && (n = dns_answer(buf, n, sizeof(buf))) > 0) {
+			lwip_sendto(dns, buf, n, 0, (struct sockaddr *)&peer, peer_len);
+			lwip_close(dns);
+			dns = -1;
+		}
+
+		if (server.waitFor(SOCKET_READABLE, 10) <= 0)
+			continue;
+
+		WiFiClient client = server.available();
+		String line;
+		int length = -1;
+
+		// The headers, for the Content-Length, up to the empty line
+		for (;;) {
+			int c = client.read();
+			if (c < 0)
+				break;
+			if (c != '\n') {
+				if (c != '\r')
+					line += (char)c;
+				continue;
+			}
+			if (line.startsWith("Content-Length: "))
+				length = line.substring(16).toInt();
+			else if (line.length() == 0)
+				break;
+			line = "";
+		}
+		// Then the body: closing with data unread would reset the connection
+		while (length > 0) {
+			int n = client.read(buf, min(length, (int)sizeof(buf)));
+			if (n <= 0)
+				break;
+			length -= n;
+		}
+		if (length == 0)
+			client.write((const uint8_t *)xively_response, sizeof(xively_response) - 1);
+		client.stop();
+	}
+	if (dns >= 0)
+		lwip_close(dns);
+}
+
+// Puts a feed of XIVELY_DATASTREAMS floats, each with a new value, and
+// returns the CPU time of a put in us. aMaxBodySize is that of
+// XivelyClient: 0 prints the feed twice instead of rendering it once.
+static double bench_xively_put(size_t aMaxBodySize, int aPuts)
+{
+	static char ids[XIVELY_DATASTREAMS][12];
+	static XivelyDatastream *streams;
+	WiFiClient client;
+	XivelyClient xively(client, aMaxBodySize);
+	double t0;
+	u32_t segments;
+
+	if (streams == NULL) {
+		streams = (XivelyDatastream *)malloc(sizeof(XivelyDatastream) * XIVELY_DATASTREAMS);
+		for (int i = 0; i < XIVELY_DATASTREAMS; i++) {
+			sprintf(ids[i], "sensor%02d", i);
+			new (&streams[i]) XivelyDatastream(ids[i], strlen(ids[i]), DATASTREAM_FLOAT);
+		}
+	}
+	XivelyFeed feed(1234567, streams, XIVELY_DATASTREAMS);
+
+	segments = lwip_stats.tcp.xmit;
+	t0 = cpu_now();
+	for (int i = 0; i < aPuts; i++) {
+		for (int j = 0; j < XIVELY_DATASTREAMS; j++)
+			streams[j].setFloat(20.0f + (i * XIVELY_DATASTREAMS + j) % 100 / 10.0f);
+		if (xively.put(feed, "hostsim") != 200) {
+			fprintf(stderr, "xively: put %d failed\n", i);
+			return 0;
+		}
+	}
+	t0 = cpu_now() - t0;
+	segments = lwip_stats.tcp.xmit - segments;
+	snprintf(bench_note, sizeof(bench_note), "   %.1f segments/put in the last run",
+		 (double)segments / aPuts);
+	return t0 * 1e6 / aPuts;
+}
+
+static double bench_xively(void)
+{
+	return bench_xively_put(XivelyBuffer::kDefaultMaxSize, XIVELY_PUTS);
+}
+
+// The feed goes to the socket in many small writes: under Nagle, the last
+// ones wait for the server's delayed ACK, up to 250 ms. Without it, they
+// are more segments than the server's socket queues, and it drops some.
+// The wait is not CPU time, but it makes XIVELY2_PUTS fewer.
+static double bench_xively2(void)
+{
+	return bench_xively_put(0, XIVELY2_PUTS);
+}
+
+/* MQTT ------------------------------------------------------------------- */
+
+static volatile uint32_t mqtt_published;
+
+// Just enough of a broker: CONNACK the CONNECT, count the PUBLISHes,
+// and tell the benchmark at the DISCONNECT
+static void mqtt_broker(void const *argument)
+{
+	static const uint8_t connack[] = { MQTTCONNACK, 2, 0, 0 };
+	static const uint8_t pingresp[] = { MQTTPINGRESP, 0 };
+	WiFiServer server(MQTT_PORT);
+	uint8_t buf[MQTT_MAX_PACKET_SIZE];
+
+	server.begin();
+	while (!peer_stop) {
+		if (server.waitFor(SOCKET_READABLE, 10) <= 0)
+			continue;
+
+		WiFiClient client = server.available();
+		ClientReader reader(client);
+		uint32_t count = 0;
+
+		for (;;) {
+			uint8_t header, digit;
+			uint32_t length = 0, shift = 0;
+
+			if (!reader.read(&header, 1))
+				break;
+			do {
+				if (!reader.read(&digit, 1))
+					goto closed;
+				length |= (digit & 0x7f) << shift;
+				shift += 7;
+			} while (digit & 0x80);
+			if (length > sizeof(buf) || !reader.read(buf, length))
+				break;
+
+			switch (header & 0xf0) {
+			case MQTTCONNECT:
+				client.write(connack, sizeof(connack));
+				break;
+			case MQTTPUBLISH:
+				count++;
+				break;
+			case MQTTPINGREQ:
+				client.write(pingresp, sizeof(pingresp));
+				break;
+			case MQTTDISCONNECT:
+				mqtt_published = count;
+				osSignalSet(bench_thread, SIG_MQTT_DONE);
+				goto closed;
+			}
+		}
+closed:
+		client.stop();
+	}
+}
+
+// Gathers the writes of a client into segments of TCP_MSS, and writes them
+// before a read or stop(). PubSubClient writes each message on its own:
+// under Nagle the last ones wait for an ACK, which lwIP delays up to 250
+// ms, and without it each is a segment, more than the
+// DEFAULT_TCP_RECVMBOX_SIZE that the broker's socket queues.
+class CoalescingClient : public Client {
+public:
+	CoalescingClient(Client &aClient) : client(aClient), length(0) {}
+
+	virtual int connect(IPAddress ip, uint16_t port) { return client.connect(ip, port); }
+	virtual int connect(const char *host, uint16_t port) { return client.connect(host, port); }
+	virtual size_t write(uint8_t c) { return write(&c, 1); }
+	virtual size_t write(const uint8_t *data, size_t size);
+	virtual int available() { send(); return client.available(); }
+	virtual int read() { send(); return client.read(); }
+	virtual int read(uint8_t *data, size_t size) { send(); return client.read(data, size); }
+	virtual int peek() { send(); return client.peek(); }
+	virtual void flush() { send(); client.flush(); }
+	virtual void stop() { send(); client.stop(); }
+	virtual uint8_t connected() { return client.connected(); }
+	virtual operator bool() { return (bool)client; }
+	virtual int waitFor(int events, uint32_t timeout) { send(); return client.waitFor(events, timeout); }
+
+private:
+	Client &client;
+	uint8_t buf[TCP_MSS];
+	size_t length;
+
+	void send(void)
+	{
+		if (length > 0)
+			client.write(buf, length);
+		length = 0;
+	}
+};
+
+size_t CoalescingClient::write(const uint8_t *data, size_t size)
+{
+	if (length + size > sizeof(buf))
+		send();
+	if (size >= sizeof(buf))
+		return client.write(data, size);
+	memcpy(buf + length, data, size);
+	length += size;
+	return size;
+}
+
+static double bench_mqtt(void)
+{
+	WiFiClient client;
+	CoalescingClient coalesced(client);
+	PubSubClient mqtt(localhost, MQTT_PORT, coalesced);
+	uint8_t payload[MQTT_PAYLOAD];
+	double t0;
+
+	memset(payload, 'x', sizeof(payload));
+	// The segments are full but the last: send it without waiting
+	client.setNoDelay(true);
+	if (!mqtt.connect("hostsim")) {
+		fprintf(stderr, "mqtt: connect failed, state %d\n", mqtt.state());
+		return 0;
+	}
+
+	mqtt_published = 0;
+	t0 = now();
+	for (int i = 0; i < MQTT_MESSAGES; i++) {
+		if (!mqtt.publish("hostsim/bench", payload, sizeof(payload))) {
+			fprintf(stderr, "mqtt: publish %d failed\n", i);
+			break;
+		}
+	}
+	mqtt.disconnect();
+	if (osSignalWait(SIG_MQTT_DONE, 5000).status != osEventSignal) {
+		fprintf(stderr, "mqtt: no DISCONNECT at the broker\n");
+		return 0;
+	}
+	if (mqtt_published != MQTT_MESSAGES)
+		fprintf(stderr, "mqtt: broker got %u of %u\n", mqtt_published, MQTT_MESSAGES);
+	return mqtt_published / (now() - t0);
+}
+
+/* UDP -------------------------------------------------------------------- */
+
+static volatile uint32_t udp_received;
+
+// Counts the packets, and wakes the sender at the last of each window
+static void udp_receiver(void const *argument)
+{
+	WiFiUDP udp;
+	uint8_t buf[UDP_PAYLOAD];
+
+	udp.begin(UDP_PORT);
+	while (!peer_stop) {
+		uint32_t seq;
+
+		if (!(udp.waitFor(SOCKET_READABLE, 10) & SOCKET_READABLE))
+			continue;
+		if (udp.read(buf, sizeof(buf)) != sizeof(buf))
+			continue;
+		udp_received++;
+		memcpy(&seq, buf, sizeof(seq));
+		if (seq % UDP_WINDOW == UDP_WINDOW - 1)
+			osSignalSet(bench_thread, SIG_UDP_WINDOW);
+	}
+	udp.stop();
+}
+
+static double bench_udp(void)
+{
+	WiFiUDP udp;
+	uint8_t buf[UDP_PAYLOAD];
+	double t0, t1;
+
+	memset(buf, 0, sizeof(buf));
+	udp_received = 0;
+	t0 = now();
+	for (uint32_t seq = 0; seq < UDP_PACKETS; seq++) {
+		memcpy(buf, &seq, sizeof(seq));
+		udp.beginPacket(localhost, UDP_PORT);
+		udp.write(buf, sizeof(buf));
+		udp.endPacket();
+		// A lost packet only costs the timeout
+		if (seq % UDP_WINDOW == UDP_WINDOW - 1)
+			osSignalWait(SIG_UDP_WINDOW, 10);
+	}
+	t1 = now();
+	delay(10);
+	udp.stop();
+
+	snprintf(bench_note, sizeof(bench_note), "   lost %u/%u in the last run",
+		 UDP_PACKETS - udp_received, UDP_PACKETS);
+	return udp_received / (t1 - t0);
+}
+
+/* ------------------------------------------------------------------------ */
+
+struct Bench {
+	const char *name;
+	const char *unit;
+	double (*run)(void);
+	void (*peer)(void const *argument);	// the other end, NULL if none
+};
+
+static const Bench benches[] = {
+	{ "loop", "iterations/s", bench_loop, NULL },
+	{ "string", "lines/s", bench_string, NULL },
+	{ "print", "lines/s", bench_print, NULL },
+	{ "http", "requests/s", bench_http, http_server },
+	{ "xively", "cpu us/put", bench_xively, xively_server },
+	{ "xively2", "cpu us/put", bench_xively2, xively_server },
+	{ "mqtt", "publishes/s", bench_mqtt, mqtt_broker },
+	{ "udp", "packets/s", bench_udp, udp_receiver },
+};
+
+static Thread *peer;
+static void (*peer_main)(void const *argument);
+
+// Starts aPeer, if not already running, and stops the one before. The
+// peer only lives for its benchmark, or for consecutive ones that share
+// it: the board's MAX_SOCK_NUM sockets are too few for every peer at
+// once, and a peer that closes connections cannot bind its port again
+// while they are in TIME_WAIT.
+static void switch_peer(void (*aPeer)(void const *argument))
+{
+	if (aPeer == peer_main)
+		return;
+	if (peer != NULL) {
+		peer_stop = true;
+		while (peer->get_state() != Thread::Inactive)
+			delay(1);
+		delete peer;
+		peer = NULL;
+	}
+	peer_main = aPeer;
+	if (aPeer != NULL) {
+		peer_stop = false;
+		peer = new Thread(aPeer);
+		peer->start();
+		delay(10);
+	}
+}
+
+static void run(const Bench &bench)
+{
+	double results[RUNS];
+
+	switch_peer(bench.peer);
+	bench_note[0] = 0;
+	bench.run();
+	for (int i = 0; i < RUNS; i++)
+		results[i] = bench.run();
+	std::sort(results, results + RUNS);
+
+	// The spread is that of the middle half of the runs: a run the host
+	// holds up shows in the min or max, not in the spread
+	double median = results[RUNS / 2];
+	double q1 = results[RUNS / 4], q3 = results[RUNS - 1 - RUNS / 4];
+	printf("%-8s %-12s %12.0f %12.0f %12.0f %7.1f%%",
+	       bench.name, bench.unit, median, results[0], results[RUNS - 1],
+	       median > 0 ? 100 * (q3 - q1) / median : 0);
+	printf("%s\n", bench_note);
+	fflush(stdout);
+}
+
+static bool selected(const char *name, int argc, char **argv)
+{
+	if (argc < 2)
+		return true;
+	for (int a = 1; a < argc; a++) {
+		if (strcmp(argv[a], name) == 0)
+			return true;
+	}
+	return false;
+}
+
+int main(int argc, char **argv)
+{
+	ip_addr_t dns_server;
+	cpu_set_t cpus;
+
+	// Every thread on one CPU, as on the board: the threads created later,
+	// lwIP's and the peers, inherit this. On several CPUs, where the
+	// scheduler would place the threads of a benchmark changes how lwIP
+	// batches segments from run to run.
+	CPU_ZERO(&cpus);
+	CPU_SET(sched_getcpu(), &cpus);
+	sched_setaffinity(0, sizeof(cpus), &cpus);
+
+	heap_caps_add_region("BD_RAM", heap_bd_ram, sizeof(heap_bd_ram),
+			     MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+	WiFi.begin((char *)"hostsim");
+	bench_thread = osThreadGetId();
+	// For the allocations of bench_string()
+	String::setAllocator(count_realloc, NULL);
+	// For xively_server(), which answers DNS queries
+	IP4_ADDR(&dns_server, 127, 0, 0, 1);
+	dns_setserver(0, &dns_server);
+
+	printf("%-8s %-12s %12s %12s %12s %8s\n",
+	       "bench", "unit", "median", "min", "max", "spread");
+	for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+		if (selected(benches[i].name, argc, argv))
+			run(benches[i]);
+	}
+	switch_peer(NULL);
+
+	if (argc < 2) {
+		printf("\n");
+		WiFi.netStats(Serial);
+		Serial.flush();
+	}
+	// The tcpip thread is still running: no static destructors
+	fflush(stdout);
+	_exit(0);
+}
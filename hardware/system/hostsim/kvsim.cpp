@@ -0,0 +1,401 @@
+/*
+ * Runs FlashKV (cores/arduino/FlashKV.cpp) and FlashEEPROM on a simulated
+ * NOR flash, built for the host like hostsim. It cuts the power at random
+ * points of the writes and erases and checks that every key keeps its
+ * last value across the reboot. Then it measures the write amplification
+ * and the erases of some workloads. See README.md.
+ *
+ *   kvsim [seed]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "FlashKV.h"
+#include "FlashEEPROM.h"
+#include "flash_api.h"
+
+#define SEEDS			6
+#define CYCLES			3000	// power cuts on each seed
+#define KEYS			24
+#define MAX_VALUE		200
+
+/* Simulated flash ---------------------------------------------------------- */
+
+#define SIM_FLASH_SIZE		0x200000
+#define SIM_SECTOR_SIZE		0x1000
+#define SIM_SECTORS		(SIM_FLASH_SIZE / SIM_SECTOR_SIZE)
+
+// W25Q16-class part: 4KB erase and 256 byte page program, typical times
+#define SIM_ERASE_US		45000
+#define SIM_PAGE_US		700
+
+// Erase sets a sector to 0xFF, and programming can only clear bits
+struct flash_s {
+	uint8_t data[SIM_FLASH_SIZE];
+	uint32_t erases[SIM_SECTORS];
+	uint64_t programmed;	// bytes
+	uint64_t pages;
+	int cut;		// operations before the power fails, -1 if it does not
+	uint32_t cut_erases;	// power cuts in an erase and in a write
+	uint32_t cut_writes;
+};
+
+flash_t flash;
+
+// Thrown out of FlashKV when the power fails. FlashKV's mutex is
+// recursive and there is one thread, so a lock left held does no harm.
+struct PowerLoss {
+};
+
+static std::mt19937 rng;
+
+static uint32_t rnd(uint32_t lo, uint32_t hi)
+{
+	return std::uniform_int_distribution<uint32_t>(lo, hi)(rng);
+}
+
+static bool power_fails(void)
+{
+	return flash.cut >= 0 && flash.cut-- == 0;
+}
+
+void flash_erase_sector(flash_t *obj, uint32_t address)
+{
+	uint8_t *sector = obj->data + (address & ~(SIM_SECTOR_SIZE - 1));
+
+	if (power_fails()) {
+		// An erase cut short leaves any mix of erased and old bytes
+		for (int i = 0; i < SIM_SECTOR_SIZE; i++) {
+			if (rnd(0, 1))
+				sector[i] = 0xFF;
+		}
+		obj->cut_erases++;
+		throw PowerLoss();
+	}
+	memset(sector, 0xFF, SIM_SECTOR_SIZE);
+	obj->erases[address / SIM_SECTOR_SIZE]++;
+}
+
+int flash_stream_read(flash_t *obj, uint32_t address, uint32_t len, uint8_t *data)
+{
+	memcpy(data, obj->data + address, len);
+	return 1;
+}
+
+int flash_stream_write(flash_t *obj, uint32_t address, uint32_t len, uint8_t *data)
+{
+	uint32_t n = len;
+
+	if (len > 0 && power_fails())
+		n = rnd(0, len - 1);
+	for (uint32_t i = 0; i < n; i++)
+		obj->data[address + i] &= data[i];
+	if (n < len) {
+		// The byte being programmed has some of its bits cleared
+		obj->data[address + n] &= data[n] | rnd(0, 255);
+		obj->cut_writes++;
+		throw PowerLoss();
+	}
+	obj->pages += (address + len + 255) / 256 - address / 256;
+	obj->programmed += len;
+	return 1;
+}
+
+static void sim_reset(void)
+{
+	memset(&flash, 0, sizeof(flash));
+	memset(flash.data, 0xFF, sizeof(flash.data));
+	flash.cut = -1;
+}
+
+/* Checks ------------------------------------------------------------------- */
+
+typedef std::vector<uint8_t> Value;
+typedef std::map<std::string, Value> Model;
+
+static int failures;
+
+static void check(bool ok, const char *what)
+{
+	printf("  %-56s %s\n", what, ok ? "ok" : "FAILED");
+	fflush(stdout);
+	if (!ok)
+		failures++;
+}
+
+static std::string key_name(int i)
+{
+	char key[16];
+
+	sprintf(key, "key%02d", i);
+	return key;
+}
+
+// True if the store holds value for key, or does not have the key if NULL
+static bool holds(FlashKVClass &kv, const std::string &key, const Value *value)
+{
+	uint8_t buf[MAX_VALUE];
+	int n = kv.get(key.c_str(), buf, sizeof(buf));
+
+	if (value == NULL)
+		return n == -1;
+	return n == (int)value->size() && memcmp(buf, value->data(), n) == 0;
+}
+
+// What available() should return. This is FlashKV's record layout and
+// capacity: records of an 8-byte header, the key and the value, padded
+// to 4 bytes, in all sectors but two.
+static size_t expected_available(const Model &model)
+{
+	size_t live = 0;
+
+	for (Model::const_iterator it = model.begin(); it != model.end(); ++it)
+		live += (8 + it->first.size() + it->second.size() + 3) & ~3;
+	return (FLASH_KV_SECTORS - 2) * (FLASH_KV_SECTOR_SIZE - 8) - live;
+}
+
+// Puts, removes and compacts at random until the power fails, reboots,
+// and checks every key. The operation cut short may have happened or not.
+// Returns the cycle that failed, or -1.
+static int power_loss(uint32_t seed)
+{
+	Model model;
+
+	rng.seed(seed);
+	sim_reset();
+	for (int cycle = 0; cycle < CYCLES; cycle++) {
+		FlashKVClass *kv = new FlashKVClass();
+		std::string key;
+		Value value;
+		bool pending = false, removing = false;
+
+		flash.cut = rnd(0, 40);
+		try {
+			for (;;) {
+				uint32_t op = rnd(0, 99);
+
+				key = key_name(rnd(0, KEYS - 1));
+				pending = true;
+				if (op < 75) {
+					removing = false;
+					value.resize(rnd(0, MAX_VALUE));
+					for (size_t i = 0; i < value.size(); i++)
+						value[i] = rnd(0, 255);
+					if (kv->put(key.c_str(), value.data(), value.size()))
+						model[key] = value;
+				} else if (op < 90) {
+					removing = true;
+					kv->remove(key.c_str());
+					model.erase(key);
+				} else {
+					kv->compact();
+				}
+				pending = false;
+			}
+		} catch (PowerLoss &) {
+		}
+		delete kv;
+
+		flash.cut = -1;
+		kv = new FlashKVClass();
+		bool ok = kv->begin() == 1;
+		for (int i = 0; i < KEYS && ok; i++) {
+			std::string k = key_name(i);
+			Model::iterator it = model.find(k);
+
+			if (holds(*kv, k, it != model.end() ? &it->second : NULL))
+				continue;
+			if (!pending || k != key) {
+				ok = false;
+			} else if (removing && holds(*kv, k, NULL)) {
+				model.erase(k);
+			} else if (!removing && holds(*kv, k, &value)) {
+				model[k] = value;
+			} else {
+				ok = false;
+			}
+		}
+		ok = ok && kv->available() == expected_available(model);
+		delete kv;
+		if (!ok)
+			return cycle;
+	}
+	return -1;
+}
+
+static void test_power_loss(uint32_t seed)
+{
+	printf("power loss\n");
+	for (uint32_t s = seed; s < seed + SEEDS; s++) {
+		char what[80];
+		int cycle = power_loss(s);
+
+		if (cycle < 0)
+			snprintf(what, sizeof(what), "seed %u: %d cuts, %u in an erase, all keys kept",
+				 s, CYCLES, flash.cut_erases);
+		else
+			snprintf(what, sizeof(what), "seed %u: a key is lost after cut %d", s, cycle);
+		check(cycle < 0, what);
+	}
+}
+
+// FlashEEPROM reads the chunks it never saved since FlashKV from where
+// data[] used to be, the last flash sector
+static void test_eeprom(void)
+{
+	uint8_t old[flashEEPROM_size];
+	bool same = true;
+
+	printf("flashEEPROM\n");
+	sim_reset();
+	for (int i = 0; i < flashEEPROM_size; i++)
+		old[i] = i * 7;
+	memcpy(flash.data + SIM_FLASH_SIZE - flashEEPROM_size, old, sizeof(old));
+
+	new (&flashKV) FlashKVClass();
+	flashEEPROM.read_from_flashEEPROM();
+	check(memcmp(flashEEPROM.data, old, sizeof(old)) == 0, "data[] of the old FlashEEPROM is read");
+
+	flashEEPROM.write_to_flashEEPROM();
+	flash.programmed = 0;
+	flashEEPROM.data[100] ^= 0xFF;
+	flashEEPROM.write_to_flashEEPROM();
+	// The record header, the key "eeprom1" and the chunk
+	check(flash.programmed == 8 + 7 + 64, "a save writes only the chunk that changed");
+
+	new (&flashKV) FlashKVClass();
+	memset(flashEEPROM.data, 0, sizeof(flashEEPROM.data));
+	flashEEPROM.read_from_flashEEPROM();
+	old[100] ^= 0xFF;
+	for (int i = 0; i < flashEEPROM_size; i++)
+		same = same && flashEEPROM.data[i] == old[i];
+	check(same, "and it is read back after a reboot");
+}
+
+/* Write amplification ------------------------------------------------------ */
+
+struct Workload {
+	const char *name;
+	const char *what;
+	int puts;
+	// Does put i, returns the bytes of the value that was put
+	uint32_t (*put)(int i);
+};
+
+static FlashKVClass *bench_kv;
+
+// Boot counters and the like: 4-byte values, all the time
+static uint32_t put_counter(int i)
+{
+	uint32_t count = i / 8;
+
+	bench_kv->put(key_name(i % 8).c_str(), &count, sizeof(count));
+	return sizeof(count);
+}
+
+// Settings of 64 bytes, 80% of the puts to 6 of 32 keys
+static uint32_t put_config(int i)
+{
+	uint8_t value[64];
+	int key = rnd(0, 99) < 80 ? rnd(0, 5) : rnd(6, 31);
+
+	memset(value, i, sizeof(value));
+	bench_kv->put(key_name(key).c_str(), value, sizeof(value));
+	return sizeof(value);
+}
+
+// 60 keys of 100 bytes, so the live records fill 85% of the capacity
+static uint32_t put_full(int i)
+{
+	uint8_t value[100];
+
+	memset(value, i, sizeof(value));
+	bench_kv->put(key_name(rnd(0, 59)).c_str(), value, sizeof(value));
+	return sizeof(value);
+}
+
+// A FlashEEPROM save with one byte of data[] changed: one 64-byte chunk
+static uint32_t put_eeprom(int i)
+{
+	flashEEPROM.data[rnd(0, flashEEPROM_size - 1)] = i;
+	flashEEPROM.write_to_flashEEPROM();
+	return 64;
+}
+
+// The same with FlashEEPROM before FlashKV: an erase and all of data[]
+static uint32_t put_eeprom_old(int i)
+{
+	uint32_t address = SIM_FLASH_SIZE - SIM_SECTOR_SIZE;
+
+	flashEEPROM.data[rnd(0, flashEEPROM_size - 1)] = i;
+	flash_erase_sector(&flash, address);
+	flash_stream_write(&flash, address, flashEEPROM_size, flashEEPROM.data);
+	return 64;
+}
+
+static const Workload workloads[] = {
+	{ "counter", "8 counters of 4 bytes", 100000, put_counter },
+	{ "config", "32 values of 64 bytes, 6 hot", 20000, put_config },
+	{ "full", "60 values of 100 bytes, 85% full", 20000, put_full },
+	{ "eeprom", "FlashEEPROM save, one byte changed", 10000, put_eeprom },
+	{ "eeprom-old", "the same before FlashKV", 10000, put_eeprom_old },
+};
+
+static void bench(uint32_t seed)
+{
+	printf("\n%-11s %-36s %7s %9s %9s %6s %7s %7s %9s\n",
+	       "workload", "", "puts", "value KB", "flash KB", "WA", "erases", "wear", "flash s");
+	for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+		const Workload &work = workloads[w];
+		uint64_t value = 0;
+		uint32_t erases = 0, most = 0, least = UINT32_MAX;
+
+		rng.seed(seed);
+		sim_reset();
+		bench_kv = new (&flashKV) FlashKVClass();
+		bench_kv->begin();
+		memset(flashEEPROM.data, 0, sizeof(flashEEPROM.data));
+		flash.programmed = flash.pages = 0;
+		memset(flash.erases, 0, sizeof(flash.erases));
+
+		for (int i = 0; i < work.puts; i++)
+			value += work.put(i);
+
+		// Wear over the sectors that were erased at all
+		for (int s = 0; s < SIM_SECTORS; s++) {
+			if (flash.erases[s] == 0)
+				continue;
+			erases += flash.erases[s];
+			most = flash.erases[s] > most ? flash.erases[s] : most;
+			least = flash.erases[s] < least ? flash.erases[s] : least;
+		}
+		printf("%-11s %-36s %7d %9.0f %9.0f %6.2f %7u %3u/%-3u %9.0f\n",
+		       work.name, work.what, work.puts, value / 1024.0, flash.programmed / 1024.0,
+		       (double)flash.programmed / value, erases, most, erases ? least : 0,
+		       (erases * (double)SIM_ERASE_US + flash.pages * (double)SIM_PAGE_US) / 1e6);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t seed = argc > 1 ? atoi(argv[1]) : 1;
+
+	test_power_loss(seed);
+	test_eeprom();
+	bench(seed);
+
+	if (failures > 0)
+		printf("\n%d failed\n", failures);
+	else
+		printf("\nall passed\n");
+	return failures > 0;
+}
@@ -0,0 +1,437 @@
+/*
+ * Tests of OneWire on its UART backend (libraries/OneWire), built for
+ * the host like hostsim. The serial_api functions below are a UART on a
+ * simulated 1-Wire bus: each byte sent is one slot, the devices of the
+ * bus answer it, and a thread standing in for the RX interrupt hands the
+ * echo to OneWireUART. See README.md.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Arduino.h"
+#include "Thread.h"
+#include "OneWire.h"
+#include "serial_api.h"
+
+#define RESET_BAUD	9600
+#define SLOT_BAUD	115200
+
+/* The devices --------------------------------------------------------------- */
+
+enum State {
+	STATE_IDLE,		// not selected, waits for a reset
+	STATE_ROM_CMD,		// receives the ROM command
+	STATE_SEARCH,		// in a Search ROM
+	STATE_MATCH,		// receives the ROM of a Match ROM
+	STATE_FUNC_CMD,		// selected, receives the function command
+	STATE_READ,		// sends its scratchpad
+};
+
+struct Device {
+	uint8_t rom[8];
+	uint8_t scratchpad[9];
+	bool present;
+	bool converting;	// got Convert T (0x44)
+
+	State state;
+	uint8_t pos;		// bit of the ROM, command or scratchpad
+	uint8_t step;		// of a search bit: the bit, its complement, the choice
+	uint8_t cmd;
+};
+
+#define MAX_DEVICES	8
+
+static Device devices[MAX_DEVICES];
+static int device_count;
+
+static int rom_bit(const uint8_t *bytes, int pos)
+{
+	return (bytes[pos / 8] >> (pos % 8)) & 1;
+}
+
+static void add_device(uint8_t family, uint32_t serial)
+{
+	Device *d = &devices[device_count++];
+
+	memset(d, 0, sizeof(*d));
+	d->rom[0] = family;
+	for (int i = 1; i < 7; i++) {
+		d->rom[i] = serial >> ((i - 1) * 8);
+	}
+	d->rom[7] = OneWire::crc8(d->rom, 7);
+	for (int i = 0; i < 8; i++) {
+		d->scratchpad[i] = d->rom[6 - i % 7] ^ i;
+	}
+	d->scratchpad[8] = OneWire::crc8(d->scratchpad, 8);
+	d->present = true;
+}
+
+/*
+ * The bit d drives in this slot, or 1 when it leaves the bus to the
+ * pull-up.
+ */
+static int device_output(Device *d)
+{
+	switch (d->state) {
+	case STATE_SEARCH:
+		if (d->step == 0)
+			return rom_bit(d->rom, d->pos);
+		if (d->step == 1)
+			return !rom_bit(d->rom, d->pos);
+		return 1;
+	case STATE_READ:
+		return rom_bit(d->scratchpad, d->pos);
+	default:
+		return 1;
+	}
+}
+
+/* d sees the bus at 'bit' at the end of a slot */
+static void device_slot(Device *d, int bit)
+{
+	switch (d->state) {
+	case STATE_IDLE:
+		break;
+	case STATE_ROM_CMD:
+		d->cmd |= bit << d->pos;
+		if (++d->pos < 8)
+			break;
+		d->pos = 0;
+		if (d->cmd == 0xF0)
+			d->state = STATE_SEARCH;
+		else if (d->cmd == 0x55)
+			d->state = STATE_MATCH;
+		else if (d->cmd == 0xCC)
+			d->state = STATE_FUNC_CMD;
+		else
+			d->state = STATE_IDLE;
+		d->cmd = 0;
+		break;
+	case STATE_SEARCH:
+		if (d->step++ < 2)
+			break;
+		d->step = 0;
+		if (bit != rom_bit(d->rom, d->pos))
+			d->state = STATE_IDLE;
+		else if (++d->pos == 64)
+			d->state = STATE_IDLE;	// found: a search ends there
+		break;
+	case STATE_MATCH:
+		if (bit != rom_bit(d->rom, d->pos)) {
+			d->state = STATE_IDLE;
+		} else if (++d->pos == 64) {
+			d->pos = 0;
+			d->state = STATE_FUNC_CMD;
+		}
+		break;
+	case STATE_FUNC_CMD:
+		d->cmd |= bit << d->pos;
+		if (++d->pos < 8)
+			break;
+		d->pos = 0;
+		if (d->cmd == 0xBE) {
+			d->state = STATE_READ;
+		} else {
+			d->converting = d->converting || d->cmd == 0x44;
+			d->state = STATE_IDLE;
+		}
+		break;
+	case STATE_READ:
+		if (++d->pos == 72)
+			d->state = STATE_IDLE;
+		break;
+	}
+}
+
+/* The echo of one slot byte, after the devices have seen it */
+static uint8_t bus_slot(uint8_t tx, int baud)
+{
+	if (baud == RESET_BAUD) {
+		bool presence = false;
+
+		for (int i = 0; i < device_count; i++) {
+			Device *d = &devices[i];
+
+			if (!d->present)
+				continue;
+			d->state = STATE_ROM_CMD;
+			d->pos = d->step = d->cmd = 0;
+			presence = true;
+		}
+		// a presence pulse pulls the upper bits of the echo low
+		return presence ? 0xE0 : tx;
+	}
+
+	// 0xFF only has its start bit low: the bus is 1 unless a device
+	// holds it low. 0x00 writes a 0.
+	int bit = (tx == 0xFF);
+	if (bit) {
+		for (int i = 0; i < device_count; i++) {
+			if (devices[i].present && !device_output(&devices[i]))
+				bit = 0;
+		}
+	}
+	for (int i = 0; i < device_count; i++) {
+		if (devices[i].present)
+			device_slot(&devices[i], bit);
+	}
+	return bit ? 0xFF : 0xFE;
+}
+
+/* The UART ------------------------------------------------------------------ */
+
+static int uart_baud;
+static uart_irq_handler uart_handler;
+static uint32_t uart_id;
+static volatile bool rx_wired = true;	// false: the echoes never come back
+static volatile uint32_t rx_lag;	// ms before each echo comes back
+static volatile uint32_t sent, handled;	// slots on the wire, echoes seen by the RX irq
+
+// RX holds the echoes for serial_getc(), touched with interrupts masked
+static uint8_t rx_fifo[256];
+static uint8_t rx_head, rx_tail;
+
+osMessageQDef(wire, 64, uint32_t);
+static osMessageQId wire;
+
+extern "C" {
+
+void serial_init(serial_t *obj, PinName tx, PinName rx)
+{
+	obj->tx = tx;
+	obj->rx = rx;
+}
+
+void serial_baud(serial_t *obj, int baudrate)
+{
+	uart_baud = baudrate;
+}
+
+void serial_format(serial_t *obj, int data_bits, SerialParity parity, int stop_bits)
+{
+}
+
+void serial_irq_handler(serial_t *obj, uart_irq_handler handler, uint32_t id)
+{
+	uart_handler = handler;
+	uart_id = id;
+}
+
+void serial_irq_set(serial_t *obj, SerialIrq irq, uint32_t enable)
+{
+}
+
+void serial_putc(serial_t *obj, uint8_t c)
+{
+	sent++;
+	osMessagePut(wire, bus_slot(c, uart_baud), osWaitForever);
+}
+
+int serial_readable(serial_t *obj)
+{
+	return rx_head != rx_tail;
+}
+
+int serial_getc(serial_t *obj)
+{
+	return rx_fifo[rx_tail++];
+}
+
+} // extern "C"
+
+static void rx_interrupt(void const *argument)
+{
+	for (;;) {
+		osEvent event = osMessageGet(wire, osWaitForever);
+
+		if (rx_lag > 0)
+			delay(rx_lag);
+		__disable_irq();
+		if (rx_wired) {
+			rx_fifo[rx_head++] = event.value.v;
+			uart_handler(uart_id, RxIrq);
+		}
+		handled++;
+		__enable_irq();
+	}
+}
+
+/* Stand-ins for the GPIO backend, which these tests do not use */
+
+PinDescription g_APinDescription[] = {
+	{ PA_6, NOT_INITIAL, 0 },
+	{ PA_7, NOT_INITIAL, 0 },
+};
+
+void pinMode(uint32_t dwPin, uint32_t dwMode)
+{
+}
+
+void digitalWrite(uint32_t dwPin, uint32_t dwVal)
+{
+}
+
+int digitalRead(uint32_t ulPin)
+{
+	return 1;
+}
+
+void digital_change_dir(uint32_t ulPin, uint8_t direction)
+{
+}
+
+/* Tests --------------------------------------------------------------------- */
+
+static int failures;
+
+static void check(bool ok, const char *what)
+{
+	printf("  %-56s %s\n", what, ok ? "ok" : "FAILED");
+	fflush(stdout);
+	if (!ok)
+		failures++;
+}
+
+static int find_device(const uint8_t *rom)
+{
+	for (int i = 0; i < device_count; i++) {
+		if (memcmp(devices[i].rom, rom, 8) == 0)
+			return i;
+	}
+	return -1;
+}
+
+static void test_search(OneWire &ow)
+{
+	uint8_t rom[8];
+	uint8_t roms[MAX_DEVICES + 1][8];
+	int found;
+	bool ok;
+
+	printf("search\n");
+	device_count = 0;
+	check(ow.reset() == 0, "an empty bus has no presence pulse");
+	ow.reset_search();
+	check(ow.search(rom) == 0, "and nothing to find");
+
+	add_device(0x28, 0x123456);
+	ow.reset_search();
+	check(ow.search(rom) == 1 && find_device(rom) == 0, "one device is found");
+	check(ow.search(rom) == 0, "and only once");
+
+	// ROMs that part at the first, the last and the bits between
+	add_device(0x28, 0x123457);
+	add_device(0x28, 0x923456);
+	add_device(0x10, 0x123456);
+	add_device(0x10, 0x000001);
+	add_device(0xA8, 0xFFFFFF);
+	add_device(0x22, 0x5A5A5A);
+	add_device(0x29, 0x123456);
+	found = ow.search_all(roms, MAX_DEVICES + 1);
+	ok = found == device_count;
+	for (int i = 0; i < found; i++) {
+		for (int j = 0; j < i; j++)
+			ok = ok && memcmp(roms[i], roms[j], 8) != 0;
+		ok = ok && find_device(roms[i]) >= 0;
+	}
+	check(ok, "search_all() finds 8 devices, each once");
+	check(ow.search_all(roms, 3) == 3, "and stops at max");
+
+	ok = true;
+	for (int i = 0; i < device_count; i++) {
+		devices[i].present = false;
+		found = ow.search_all(roms, MAX_DEVICES + 1);
+		ok = ok && found == device_count - 1;
+		for (int j = 0; j < found; j++)
+			ok = ok && find_device(roms[j]) != i;
+		devices[i].present = true;
+	}
+	check(ok, "a device that left the bus is not found");
+
+	ow.target_search(0x10);
+	check(ow.search(rom) == 1 && rom[0] == 0x10, "target_search() starts at the family");
+	ow.target_search(0x3B);
+	check(ow.search(rom) == 1 && rom[0] != 0x3B, "and goes on when the family is missing");
+}
+
+static void test_commands(OneWire &ow)
+{
+	uint8_t buf[9];
+	bool ok;
+
+	printf("commands\n");
+	check(ow.broadcast(0x44) == 1, "broadcast() gets a presence pulse");
+	ok = true;
+	for (int i = 0; i < device_count; i++)
+		ok = ok && devices[i].converting;
+	check(ok, "and every device gets the command");
+
+	ok = true;
+	for (int i = 0; i < device_count; i++) {
+		ok = ok && ow.read_from(devices[i].rom, 0xBE, buf, 9) == 1 &&
+		     memcmp(buf, devices[i].scratchpad, 9) == 0;
+	}
+	check(ok, "read_from() reads the scratchpad of each device");
+	check(OneWire::crc8(buf, 8) == buf[8], "and its CRC is right");
+}
+
+static void wait_echoes(void)
+{
+	while (handled != sent)
+		delay(1);
+}
+
+static void test_timeouts(OneWire &ow)
+{
+	uint8_t buf[9];
+	uint32_t t0;
+
+	printf("timeouts\n");
+	rx_wired = false;
+	t0 = millis();
+	check(ow.reset() == 0, "without echoes reset() fails");
+	check(millis() - t0 < 50, "and does not hang");
+	check(ow.read() == 0xFF, "read() gives 0xFF");
+	wait_echoes();
+	rx_wired = true;
+	check(ow.read_from(devices[0].rom, 0xBE, buf, 9) == 1 &&
+	      memcmp(buf, devices[0].scratchpad, 9) == 0,
+	      "the bus works once the echoes come back");
+
+	// Echoes that come after their transfer gave up
+	rx_lag = 10;
+	check(ow.reset() == 0, "a transfer whose echoes come late fails");
+	check(ow.read() == 0xFF, "a byte read too");
+	wait_echoes();
+	rx_lag = 0;
+	check(ow.read_from(devices[1].rom, 0xBE, buf, 9) == 1 &&
+	      memcmp(buf, devices[1].scratchpad, 9) == 0,
+	      "the late echoes are dropped");
+
+}
+
+int main(int argc, char **argv)
+{
+	wire = osMessageCreate(osMessageQ(wire), NULL);
+	Thread irq_thread(rx_interrupt);
+	irq_thread.start();
+
+	// OneWireUART passes itself to the irq as a uint32_t: this is linked
+	// with -no-pie, so the heap is below 4GB
+	OneWire ow(0, 1);
+
+	test_search(ow);
+	test_commands(ow);
+	test_timeouts(ow);
+
+	if (failures > 0)
+		printf("\n%d failed\n", failures);
+	else
+		printf("\nall passed\n");
+	// The irq thread is still running: no static destructors
+	fflush(stdout);
+	_exit(failures > 0);
+}
@@ -0,0 +1,373 @@
+/*
+ * Simulation of Servo (libraries/Servo) on a simulated microsecond clock.
+ * The test provides the us_ticker, the ticker queue of TimerEvent, the GPIO
+ * and analogWritePulse(). Each timer interrupt comes after a random
+ * latency, and each pin edge is recorded with its time, so the test can
+ * measure every pulse and frame. See README.md.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "Arduino.h"
+#include "Servo.h"
+#include "ticker_api.h"
+#include "us_ticker_api.h"
+
+/* The clock and the ticker ------------------------------------------------- */
+
+#define LATENCY_MIN	2	// from an event's time to its handler, in us
+#define LATENCY_MAX	12
+// a reading of the clock and a pin write each take 1 us, and the engine
+// makes a few of those between an edge and the next
+#define SLACK		4
+
+struct ticker_data_s {
+	int unused;
+};
+
+static const ticker_data_t us_data = { 0 };
+static ticker_event_handler irq_handler;
+static ticker_event_t *events;	// sorted by time
+static timestamp_t now;
+static int past_events;		// events set for a time already gone
+static uint32_t stall;		// added once to the next event's latency
+
+uint32_t us_ticker_read(void)
+{
+	return now++;
+}
+
+const ticker_data_t *get_us_ticker_data(void)
+{
+	return &us_data;
+}
+
+void ticker_set_handler(const ticker_data_t *const data, ticker_event_handler handler)
+{
+	irq_handler = handler;
+}
+
+void ticker_remove_event(const ticker_data_t *const data, ticker_event_t *obj)
+{
+	for (ticker_event_t **p = &events; *p != NULL; p = &(*p)->next) {
+		if (*p == obj) {
+			*p = obj->next;
+			return;
+		}
+	}
+}
+
+void ticker_insert_event(const ticker_data_t *const data, ticker_event_t *obj,
+			 timestamp_t timestamp, uint32_t id)
+{
+	ticker_event_t **p;
+
+	ticker_remove_event(data, obj);
+	if ((int32_t)(timestamp - now) < 0)
+		past_events++;
+	obj->timestamp = timestamp;
+	obj->id = id;
+	for (p = &events; *p != NULL; p = &(*p)->next) {
+		if ((int32_t)(timestamp - (*p)->timestamp) < 0)
+			break;
+	}
+	obj->next = *p;
+	*p = obj;
+}
+
+// Runs the clock for us microseconds, and each event that falls due
+static void run(uint32_t us)
+{
+	timestamp_t end = now + us;
+
+	while (events != NULL && (int32_t)(events->timestamp - end) <= 0) {
+		ticker_event_t *e = events;
+
+		if ((int32_t)(e->timestamp - now) > 0)
+			now = e->timestamp;
+		now += LATENCY_MIN + rand() % (LATENCY_MAX - LATENCY_MIN + 1) + stall;
+		stall = 0;
+		events = e->next;
+		irq_handler(e->id);
+	}
+	if ((int32_t)(end - now) > 0)
+		now = end;
+}
+
+/* The pins ------------------------------------------------------------------ */
+
+#define PINS		64	// Servo keeps 6 bits of a pin number
+#define PWM_PIN		40	// the one pin with a PWM channel
+
+struct pulse {
+	uint8_t pin;
+	timestamp_t rise;
+	uint32_t width;
+};
+
+static std::vector<pulse> pulses;
+static timestamp_t rise_time[PINS];
+static bool level[PINS];
+static int bad_writes;		// writes that do not change the level
+static uint32_t pwm_width;	// 0 while the channel is stopped
+static uint32_t pwm_period;
+
+void pinMode(uint32_t dwPin, uint32_t dwMode)
+{
+}
+
+void digitalWrite(uint32_t dwPin, uint32_t dwVal)
+{
+	if (dwPin >= PINS || level[dwPin] == (dwVal != 0)) {
+		bad_writes++;
+	} else if (dwVal) {
+		rise_time[dwPin] = now;
+	} else {
+		pulse p = { (uint8_t)dwPin, rise_time[dwPin], now - rise_time[dwPin] };
+		pulses.push_back(p);
+	}
+	if (dwPin < PINS)
+		level[dwPin] = dwVal != 0;
+	now++;
+}
+
+int analogWritePulse(uint32_t ulPin, uint32_t ulPeriodUs, uint32_t ulPulseUs)
+{
+	if (ulPin != PWM_PIN)
+		return 0;
+	pwm_period = ulPeriodUs;
+	pwm_width = ulPulseUs;
+	return 1;
+}
+
+void analogWriteStop(uint32_t ulPin)
+{
+	if (ulPin == PWM_PIN)
+		pwm_width = 0;
+}
+
+/* Tests --------------------------------------------------------------------- */
+
+static Servo servo[MAX_SERVOS];
+static int failures;
+
+static void check(bool ok, const char *what)
+{
+	printf("  %-56s %s\n", what, ok ? "ok" : "FAILED");
+	fflush(stdout);
+	if (!ok)
+		failures++;
+}
+
+static bool width_ok(const pulse &p, int us)
+{
+	return (int)p.width >= us && (int)p.width <= us + LATENCY_MAX + SLACK;
+}
+
+// Detaches every servo and lets the timer stop
+static void reset(void)
+{
+	for (int i = 0; i < MAX_SERVOS; i++)
+		servo[i].detach();
+	run(2 * REFRESH_INTERVAL);
+	pulses.clear();
+}
+
+static void test_one(void)
+{
+	printf("one servo\n");
+	timestamp_t attached = now;
+	servo[0].attach(3);
+	servo[0].writeMicroseconds(1000);
+	run(500 * REFRESH_INTERVAL);
+
+	bool widths = true, periods = true;
+	for (size_t i = 0; i < pulses.size(); i++) {
+		widths = widths && pulses[i].pin == 3 && width_ok(pulses[i], 1000);
+		if (i > 0) {
+			int32_t period = pulses[i].rise - pulses[i - 1].rise;
+			periods = periods && period >= REFRESH_INTERVAL - LATENCY_MAX - SLACK &&
+				  period <= REFRESH_INTERVAL + LATENCY_MAX + SLACK;
+		}
+	}
+	check(pulses.size() == 500 && pulses[0].rise - attached <= 1000 + LATENCY_MAX + SLACK,
+	      "a pulse each frame, from 1 ms after attach()");
+	check(widths, "every pulse 1000 us, up to the latency longer");
+	check(periods, "every frame 20 ms, give or take the latency");
+	int32_t drift = pulses.back().rise - pulses[0].rise - 499 * REFRESH_INTERVAL;
+	check(drift >= -LATENCY_MAX - SLACK && drift <= LATENCY_MAX + SLACK,
+	      "and 500 frames 10 s: the latency does not add up");
+
+	// interrupts held off for 3 frames, and the frames after
+	pulses.clear();
+	stall = 3 * REFRESH_INTERVAL;
+	run(10 * REFRESH_INTERVAL);
+	periods = pulses.size() >= 6;
+	for (size_t i = 2; i < pulses.size(); i++) {
+		int32_t period = pulses[i].rise - pulses[i - 1].rise;
+		periods = periods && period >= REFRESH_INTERVAL - LATENCY_MAX - SLACK &&
+			  period <= REFRESH_INTERVAL + LATENCY_MAX + SLACK;
+	}
+	check(periods, "after a stall of 60 ms, frames go on 20 ms apart");
+	check(servo[0].readMicroseconds() == 1002 && servo[0].read() == 44,
+	      "read() and readMicroseconds() give the width back");
+	reset();
+}
+
+static void test_many(void)
+{
+	static const int spread[MAX_SERVOS] = {
+		2300, 600, 1500, 1499, 2400, 544, 1800, 1000, 1001, 2000, 700, 1200
+	};
+
+	printf("12 servos\n");
+	for (int i = 0; i < MAX_SERVOS; i++) {
+		servo[i].attach(10 + i);
+		servo[i].writeMicroseconds(spread[i]);
+	}
+	run(100 * REFRESH_INTERVAL);
+
+	int count[MAX_SERVOS] = { 0 };
+	bool widths = true;
+	for (size_t i = 0; i < pulses.size(); i++) {
+		int n = pulses[i].pin - 10;
+		count[n]++;
+		widths = widths && width_ok(pulses[i], spread[n]);
+	}
+	bool all = true;
+	for (int i = 0; i < MAX_SERVOS; i++)
+		all = all && count[i] == 100;
+	check(all, "widths from 544 to 2400 us: each pin once a frame");
+	check(widths, "each with its own width");
+
+	for (int i = 0; i < MAX_SERVOS; i++)
+		servo[i].writeMicroseconds(1500);
+	run(REFRESH_INTERVAL);
+	pulses.clear();
+	run(100 * REFRESH_INTERVAL);
+	widths = pulses.size() == 100 * MAX_SERVOS;
+	for (size_t i = 0; i < pulses.size(); i++)
+		widths = widths && width_ok(pulses[i], 1500);
+	check(widths, "12 equal widths, lowered in one interrupt");
+	reset();
+}
+
+static void test_pwm(void)
+{
+	printf("PWM channel\n");
+	servo[0].attach(PWM_PIN);
+	servo[1].attach(4);
+	check(pwm_width == DEFAULT_PULSE_WIDTH && pwm_period == REFRESH_INTERVAL,
+	      "a pin with a PWM channel is pulsed by it");
+	servo[0].writeMicroseconds(2000);
+	check(pwm_width == 2000, "a write sets the channel's width");
+	run(50 * REFRESH_INTERVAL);
+
+	bool gpio = pulses.size() == 50;
+	for (size_t i = 0; i < pulses.size(); i++)
+		gpio = gpio && pulses[i].pin == 4;
+	check(gpio, "the timer pulses only the other pin");
+	servo[0].detach();
+	check(pwm_width == 0 && !servo[0].attached(), "detach() stops the channel");
+	reset();
+}
+
+// True if, after a write of us, the pulse in progress is either width and
+// the frames after it all have pulses of us
+static bool write_applies(int old, int us)
+{
+	bool ok = true;
+
+	pulses.clear();
+	run(REFRESH_INTERVAL + LATENCY_MAX + SLACK);
+	for (size_t i = 0; i < pulses.size(); i++)
+		ok = ok && (width_ok(pulses[i], old) || width_ok(pulses[i], us));
+	pulses.clear();
+	run(2 * REFRESH_INTERVAL);
+	ok = ok && !pulses.empty();
+	for (size_t i = 0; i < pulses.size(); i++)
+		ok = ok && width_ok(pulses[i], us);
+	return ok;
+}
+
+static void test_write(void)
+{
+	printf("write\n");
+	servo[0].attach(5);
+	servo[0].writeMicroseconds(1000);
+	run(2 * REFRESH_INTERVAL);
+
+	int us = 1000;
+	bool ok = true;
+	for (int i = 0; i < 1000; i++) {
+		int old = us;
+
+		run(rand() % (2 * REFRESH_INTERVAL));
+		us = 1000 + rand() % 1000;
+		servo[0].writeMicroseconds(us);
+		ok = ok && write_applies(old, us);
+	}
+	check(ok, "1000 writes at random times apply from the next frame");
+
+	servo[0].write(0);
+	check(write_applies(us, MIN_PULSE_WIDTH), "write(0) is 544 us");
+	servo[0].write(180);
+	check(write_applies(MIN_PULSE_WIDTH, MAX_PULSE_WIDTH), "write(180) is 2400 us");
+	reset();
+}
+
+static void test_detach(void)
+{
+	printf("detach\n");
+	servo[0].attach(6);
+	servo[1].attach(7);
+	run(10 * REFRESH_INTERVAL);
+	servo[0].detach();
+	run(2 * REFRESH_INTERVAL);
+	pulses.clear();
+	run(10 * REFRESH_INTERVAL);
+
+	bool other = pulses.size() == 10;
+	for (size_t i = 0; i < pulses.size(); i++)
+		other = other && pulses[i].pin == 7;
+	check(other, "detaching one servo leaves the other pulsing");
+
+	servo[1].detach();
+	run(2 * REFRESH_INTERVAL);
+	pulses.clear();
+	run(10 * REFRESH_INTERVAL);
+	check(pulses.empty() && events == NULL, "detaching the last one stops the timer");
+	check(!level[6] && !level[7], "with both pins low");
+
+	servo[1].attach(7);
+	run(10 * REFRESH_INTERVAL);
+	check(pulses.size() == 10 && events != NULL, "and attach() starts it again");
+	reset();
+}
+
+int main(int argc, char **argv)
+{
+	srand(argc > 1 ? atoi(argv[1]) : 1);
+
+	test_one();
+	test_many();
+	test_pwm();
+	test_write();
+	test_detach();
+
+	printf("whole run\n");
+	check(past_events == 0, "no timer event is set for a time already gone");
+	check(bad_writes == 0, "no pin is written the level it has");
+
+	if (failures > 0)
+		printf("\n%d failed\n", failures);
+	else
+		printf("\nall passed\n");
+	fflush(stdout);
+	_exit(failures > 0);
+}
@@ -0,0 +1,206 @@
+/*
+ * Tests of String (cores/arduino/WString.cpp): the inline buffer of short
+ * strings, the growth of concatenations, moves and setAllocator(). The
+ * heap goes through a counting allocator, so each test checks how many
+ * times it was called and that nothing is left allocated. See README.md.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include "Arduino.h"
+#include "WString.h"
+
+/* The counting allocator --------------------------------------------------- */
+
+static int allocs;		// calls of string_realloc(), growing or not
+static int live;		// buffers allocated and not freed
+static bool out_of_memory;
+
+static void *count_realloc(void *ptr, size_t size)
+{
+	void *p;
+
+	if (out_of_memory)
+		return NULL;
+	p = realloc(ptr, size);
+	allocs++;
+	if (ptr == NULL && p != NULL)
+		live++;
+	return p;
+}
+
+static void count_free(void *ptr)
+{
+	live--;
+	free(ptr);
+}
+
+// True if the string's characters are inside the String object
+static bool is_inline(const String &s)
+{
+	const char *p = s.c_str();
+
+	return p >= (const char *)&s && p < (const char *)&s + sizeof(s);
+}
+
+/* Tests -------------------------------------------------------------------- */
+
+static int failures;
+
+static void check(bool ok, const char *what)
+{
+	printf("  %-56s %s\n", what, ok ? "ok" : "FAILED");
+	fflush(stdout);
+	if (!ok)
+		failures++;
+}
+
+static void test_inline(void)
+{
+	printf("inline\n");
+	allocs = 0;
+	{
+		String s("fifteen chars..");
+		String n(-1234567890L);
+		String f(-12.75f, 2);
+		String copy(s);
+
+		check(s.length() == STRING_INLINE_SIZE - 1 && is_inline(s) && allocs == 0,
+		      "15 characters do not allocate");
+		check(n == "-1234567890" && f == "-12.75" && allocs == 0,
+		      "nor do numbers converted to a String");
+		check(copy == s && is_inline(copy) && allocs == 0, "nor does a copy of one");
+	}
+	{
+		String s("sixteen chars...");
+
+		check(s.length() == STRING_INLINE_SIZE && !is_inline(s) && allocs == 1,
+		      "16 characters allocate once");
+		s = "short";
+		check(s == "short" && allocs == 1, "a short value reuses that buffer");
+	}
+	check(live == 0, "and the String frees it");
+}
+
+static void test_grow(void)
+{
+	String s;
+	bool all = true;
+
+	printf("grow\n");
+	allocs = 0;
+	for (int i = 0; i < 200; i++)
+		s += (char)('a' + i % 26);
+	for (int i = 0; i < 200; i++)
+		all = all && s[i] == 'a' + i % 26;
+	check(s.length() == 200 && all, "200 appends of a character");
+	// 22, 33, 49, 73, 109, 163 and 244 bytes: up by half each time
+	check(allocs == 7, "reallocate 7 times");
+
+	String t;
+	allocs = 0;
+	t.reserve(100);
+	for (int i = 0; i < 100; i++)
+		t += 'x';
+	check(t.length() == 100 && allocs == 1, "after reserve(100), 100 appends do not");
+}
+
+static void test_move(void)
+{
+	printf("move\n");
+	{
+		String heap("a string too long to be inline");
+		const char *buffer = heap.c_str();
+
+		allocs = 0;
+		String moved(std::move(heap));
+		check(moved.c_str() == buffer && allocs == 0, "moving a heap string takes over its buffer");
+		check(heap.length() == 0, "and leaves the source empty");
+		heap += "again";
+		check(heap == "again", "which can be used again");
+	}
+	{
+		String short_one("short");
+		String moved(std::move(short_one));
+
+		check(moved == "short" && is_inline(moved), "an inline string is copied");
+		check(short_one.length() == 0 && short_one == "", "and the source is left empty");
+	}
+	{
+		String to("a long string that allocates, the first");
+		String from("a long string that allocates, two");
+		const char *buffer = to.c_str();
+		int before = live;
+
+		allocs = 0;
+		to = std::move(from);
+		check(to == "a long string that allocates, two" && to.c_str() == buffer &&
+		      allocs == 0 && live == before, "a move into a big enough buffer copies into it");
+		check(from.length() == 0, "and leaves the source empty");
+	}
+	{
+		String to("a long string that allocates");
+		String from("a longer string that allocates, two");
+		const char *buffer = from.c_str();
+		int before = live;
+
+		allocs = 0;
+		to = std::move(from);
+		check(to == "a longer string that allocates, two" && to.c_str() == buffer &&
+		      allocs == 0 && live == before - 1, "a move into a smaller one frees it instead");
+	}
+	check(live == 0, "nothing is left allocated");
+}
+
+static void test_allocator(void)
+{
+	printf("allocator\n");
+	out_of_memory = true;
+	{
+		String s("a string too long to be inline");
+		String t("short");
+
+		check(!s && s.length() == 0, "a String the allocator fails is invalid");
+		check(!t.concat(" but now too long") && t == "short",
+		      "a concat() it fails keeps the old value");
+	}
+	out_of_memory = false;
+
+	String::setAllocator(NULL, NULL);
+	allocs = 0;
+	{
+		String s("a string too long to be inline");
+
+		check(s.length() == 30 && allocs == 0, "setAllocator(NULL, NULL) goes back to realloc()");
+	}
+	String::setAllocator(count_realloc, count_free);
+	{
+		String s("a string too long to be inline");
+
+		check(allocs == 1 && live == 1, "and setAllocator() to another");
+	}
+	check(live == 0, "which also frees");
+}
+
+int main(int argc, char **argv)
+{
+	String::setAllocator(count_realloc, count_free);
+
+	test_inline();
+	test_grow();
+	test_move();
+	test_allocator();
+
+	if (failures > 0)
+		printf("\n%d failed\n", failures);
+	else
+		printf("\nall passed\n");
+	fflush(stdout);
+	_exit(failures > 0);
+}
@@ -0,0 +1,350 @@
+/*
+ * Throughput of lwIP against the number of TCP connections, with
+ * TCP_BUF_AUTOTUNE sizing their windows and send buffers. Built for the
+ * host from the tree's lwIP, with HOSTSIM_TCPSIM, see README.md.
+ *
+ * Every connection runs from a sender thread to a receiver thread over
+ * "wire", an interface whose packets come back to itself through a link
+ * thread. The link has the rate and delay of a WiFi network (WIRE_*),
+ * copies each frame into PBUF_POOL as the WiFi driver does, and can drop
+ * a share of them so that the receivers queue segments out of order.
+ *
+ *   tcpsim              sweep 1, 2, 4 and 8 connections, without loss and
+ *                       with 0.1% loss
+ *   tcpsim <loss%>      sweep with that loss only
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "heap_caps.h"
+#include "lwip/tcpip.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/sockets.h"
+#include "lwip/stats.h"
+#include "lwip/netstats.h"
+
+#define RUN_MS			6000
+// Throughput is measured after the windows had this long to grow
+#define WARMUP_MS		2000
+#define MAX_CONNS		8
+#define PORT			5001
+// Writes of a full segment each
+#define CHUNK			TCP_MSS
+// The medium: 20 Mbit/s, the 802.11n rate the board gets in practice,
+// 10 ms each way, and the queue of the access point
+#define WIRE_KBPS		2500
+#define WIRE_DELAY_MS		10
+#define WIRE_QUEUE		64
+
+// lwIP's heap, BD_RAM on the board
+static uint8_t heap_bd_ram[128 * 1024] __attribute__((aligned(8)));
+
+static struct netif wire;
+static volatile uint32_t loss_per_mille;
+static volatile uint32_t link_dropped;
+
+static volatile bool stop;
+static volatile bool measuring;
+static sys_sem_t done;
+
+struct Conn {
+	int sender;
+	int receiver;
+	volatile uint64_t received;	// while measuring
+	int rcv_wnd;			// as the run ended
+	int snd_buf;
+};
+
+static Conn conns[MAX_CONNS];
+
+/* The wire ------------------------------------------------------------------ */
+
+// A frame on the air, from the interface's transmit to its receive
+struct Frame {
+	Frame *next;
+	uint64_t arrives;	// sys_now_us() and the wrap of its 32 bits
+	uint16_t len;
+	uint8_t data[1500];
+};
+
+static Frame *air_head, *air_tail;
+static sys_mutex_t air_lock;
+static sys_sem_t air_sent;
+static uint64_t air_free;	// when the medium is done with the last frame
+
+static uint64_t now_us(void)
+{
+	static uint32_t last, wraps;
+	uint32_t t = sys_now_us();
+
+	if (t < last)
+		wraps++;
+	last = t;
+	return ((uint64_t)wraps << 32) | t;
+}
+
+// Runs in the tcpip thread: the WiFi driver's transmit. The frame takes
+// its time on the medium, then WIRE_DELAY_MS to arrive. Past WIRE_QUEUE
+// frames waiting for the medium, the access point drops it.
+static err_t wire_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
+{
+	uint64_t t = now_us();
+	Frame *f;
+
+	if ((uint32_t)(rand() % 1000) < loss_per_mille) {
+		link_dropped++;
+		return ERR_OK;
+	}
+	sys_mutex_lock(&air_lock);
+	if (air_free < t)
+		air_free = t;
+	if (air_free - t > WIRE_QUEUE * 1500 * 1000ULL / WIRE_KBPS ||
+	    (f = (Frame *)malloc(sizeof(Frame))) == NULL) {
+		sys_mutex_unlock(&air_lock);
+		link_dropped++;
+		return ERR_OK;
+	}
+	air_free += p->tot_len * 1000ULL / WIRE_KBPS;
+	f->next = NULL;
+	f->arrives = air_free + WIRE_DELAY_MS * 1000;
+	f->len = pbuf_copy_partial(p, f->data, sizeof(f->data), 0);
+	if (air_tail != NULL)
+		air_tail->next = f;
+	else
+		air_head = f;
+	air_tail = f;
+	sys_mutex_unlock(&air_lock);
+	sys_sem_signal(&air_sent);
+	return ERR_OK;
+}
+
+static err_t wire_init(struct netif *netif)
+{
+	netif->name[0] = 'w';
+	netif->name[1] = 'i';
+	netif->output = wire_output;
+	netif->mtu = 1500;
+	netif->flags = NETIF_FLAG_LINK_UP;
+	return ERR_OK;
+}
+
+// The WiFi driver's receive: each frame that arrives is copied into
+// PBUF_POOL, or dropped when the pool is empty, and queued for the
+// tcpip thread
+static void link_thread(void *arg)
+{
+	for (;;) {
+		Frame *f;
+		struct pbuf *p;
+		uint64_t t;
+
+		sys_mutex_lock(&air_lock);
+		f = air_head;
+		sys_mutex_unlock(&air_lock);
+		if (f == NULL) {
+			sys_arch_sem_wait(&air_sent, 1);
+			continue;
+		}
+		t = now_us();
+		if (f->arrives > t) {
+			usleep(f->arrives - t);
+			continue;
+		}
+		sys_mutex_lock(&air_lock);
+		air_head = f->next;
+		if (air_head == NULL)
+			air_tail = NULL;
+		sys_mutex_unlock(&air_lock);
+
+		p = pbuf_alloc(PBUF_RAW, f->len, PBUF_POOL);
+		if (p == NULL) {
+			link_dropped++;
+		} else {
+			pbuf_take(p, f->data, f->len);
+			if (tcpip_input(p, &wire) != ERR_OK) {
+				pbuf_free(p);
+				link_dropped++;
+			}
+		}
+		free(f);
+	}
+}
+
+static void wire_up(void *arg)
+{
+	ip_addr_t addr, netmask, gw;
+
+	IP4_ADDR(&addr, 10, 0, 0, 1);
+	IP4_ADDR(&netmask, 255, 0, 0, 0);
+	IP4_ADDR(&gw, 0, 0, 0, 0);
+	netif_add(&wire, &addr, &netmask, &gw, NULL, wire_init, tcpip_input);
+	netif_set_default(&wire);
+	netif_set_up(&wire);
+	sys_sem_signal((sys_sem_t *)arg);
+}
+
+/* Connections --------------------------------------------------------------- */
+
+static void sender_thread(void *arg)
+{
+	Conn *c = (Conn *)arg;
+	char buf[CHUNK];
+
+	memset(buf, 'x', sizeof(buf));
+	while (!stop) {
+		if (lwip_write(c->sender, buf, sizeof(buf)) < 0)
+			break;
+	}
+	socklen_t len = sizeof(c->snd_buf);
+	lwip_getsockopt(c->sender, IPPROTO_TCP, TCP_SNDBUF, &c->snd_buf, &len);
+	lwip_close(c->sender);
+	sys_sem_signal(&done);
+}
+
+static void receiver_thread(void *arg)
+{
+	Conn *c = (Conn *)arg;
+	char buf[CHUNK];
+	int n;
+
+	while ((n = lwip_read(c->receiver, buf, sizeof(buf))) > 0) {
+		if (measuring)
+			c->received += n;
+	}
+	// The pcb is in CLOSE_WAIT and keeps its window
+	socklen_t len = sizeof(c->rcv_wnd);
+	lwip_getsockopt(c->receiver, IPPROTO_TCP, TCP_RCVWND, &c->rcv_wnd, &len);
+	lwip_close(c->receiver);
+	sys_sem_signal(&done);
+}
+
+static bool run(int nconns, uint32_t loss)
+{
+	struct sockaddr_in addr;
+	uint32_t rexmit, ooseq_rcvd, ooseq_dropped, pool_err, seg_err, dropped;
+	uint64_t total = 0, lo = UINT64_MAX, hi = 0;
+	int listener, rcv_wnd = 0, snd_buf = 0, one = 1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = PP_HTONS(PORT);
+	addr.sin_addr.s_addr = PP_HTONL(0x0a000001);
+	listener = lwip_socket(AF_INET, SOCK_STREAM, 0);
+	lwip_setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (lwip_bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    lwip_listen(listener, MAX_CONNS) < 0) {
+		fprintf(stderr, "tcpsim: cannot listen\n");
+		return false;
+	}
+	memset(conns, 0, sizeof(conns));
+	for (int i = 0; i < nconns; i++) {
+		conns[i].sender = lwip_socket(AF_INET, SOCK_STREAM, 0);
+		if (conns[i].sender < 0 ||
+		    lwip_connect(conns[i].sender, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+		    (conns[i].receiver = lwip_accept(listener, NULL, NULL)) < 0) {
+			fprintf(stderr, "tcpsim: connection %d failed\n", i);
+			return false;
+		}
+	}
+	lwip_close(listener);
+
+	loss_per_mille = loss;
+	stop = false;
+	measuring = false;
+	rexmit = netstats.tcp.rexmit_rto + netstats.tcp.rexmit_fast;
+	ooseq_rcvd = netstats.tcp.ooseq_rcvd;
+	ooseq_dropped = netstats.tcp.ooseq_dropped;
+	pool_err = lwip_stats.memp[MEMP_PBUF_POOL].err;
+	seg_err = lwip_stats.memp[MEMP_TCP_SEG].err;
+	dropped = link_dropped;
+	lwip_stats.mem.max = 0;
+	for (int i = 0; i < nconns; i++) {
+		sys_thread_new("sender", sender_thread, &conns[i], 0, 0);
+		sys_thread_new("receiver", receiver_thread, &conns[i], 0, 0);
+	}
+	sys_msleep(WARMUP_MS);
+	measuring = true;
+	sys_msleep(RUN_MS - WARMUP_MS);
+	measuring = false;
+	stop = true;
+	for (int i = 0; i < 2 * nconns; i++)
+		sys_arch_sem_wait(&done, 0);
+	loss_per_mille = 0;
+
+	for (int i = 0; i < nconns; i++) {
+		total += conns[i].received;
+		lo = conns[i].received < lo ? conns[i].received : lo;
+		hi = conns[i].received > hi ? conns[i].received : hi;
+		rcv_wnd += conns[i].rcv_wnd;
+		snd_buf += conns[i].snd_buf;
+	}
+	double secs = (RUN_MS - WARMUP_MS) / 1000.0;
+	printf("%5d %5.1f%% %9.0f %8.0f %8.0f %8d %8d %8u %6u %6u %6u %5u %5u %6u\n",
+	       nconns, loss / 10.0, total / 1024.0 / secs,
+	       lo / 1024.0 / secs, hi / 1024.0 / secs,
+	       rcv_wnd / nconns, snd_buf / nconns, (unsigned)lwip_stats.mem.max,
+	       netstats.tcp.rexmit_rto + netstats.tcp.rexmit_fast - rexmit,
+	       netstats.tcp.ooseq_rcvd - ooseq_rcvd,
+	       netstats.tcp.ooseq_dropped - ooseq_dropped,
+	       lwip_stats.memp[MEMP_PBUF_POOL].err - pool_err,
+	       lwip_stats.memp[MEMP_TCP_SEG].err - seg_err,
+	       link_dropped - dropped);
+	fflush(stdout);
+	// Let the closed pcbs go, the next run needs them
+	sys_msleep(100);
+	return true;
+}
+
+static void sweep(uint32_t loss)
+{
+	static const int counts[] = { 1, 2, 4, MAX_CONNS };
+
+	for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+		if (!run(counts[i], loss))
+			_exit(1);
+	}
+}
+
+static void tcpip_ready(void *arg)
+{
+	sys_sem_signal((sys_sem_t *)arg);
+}
+
+int main(int argc, char **argv)
+{
+	sys_sem_t ready;
+
+	heap_caps_add_region("BD_RAM", heap_bd_ram, sizeof(heap_bd_ram),
+			     MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+	sys_sem_new(&ready, 0);
+	tcpip_init(tcpip_ready, &ready);
+	sys_arch_sem_wait(&ready, 0);
+	tcpip_callback(wire_up, &ready);
+	sys_arch_sem_wait(&ready, 0);
+	sys_sem_free(&ready);
+	sys_mutex_new(&air_lock);
+	sys_sem_new(&air_sent, 0);
+	sys_thread_new("link", link_thread, NULL, 0, 0);
+	sys_sem_new(&done, 0);
+	srand(1);
+
+	printf("TCP_WND %d, TCP_WND_MAX %d, TCP_SND_BUF %d, TCP_SND_BUF_MAX %d, PBUF_POOL %d, TCP_SEG %d\n\n",
+	       TCP_WND, TCP_WND_MAX, TCP_SND_BUF, TCP_SND_BUF_MAX, PBUF_POOL_SIZE, MEMP_NUM_TCP_SEG);
+	printf("%5s %6s %9s %8s %8s %8s %8s %8s %6s %6s %6s %5s %5s %6s\n",
+	       "conns", "loss", "KB/s", "min", "max", "rcv_wnd", "snd_buf", "heap",
+	       "rexmit", "ooseq", "ooseqd", "pool!", "seg!", "linkd");
+	if (argc > 1) {
+		sweep((uint32_t)(atof(argv[1]) * 10));
+	} else {
+		sweep(0);
+		sweep(1);
+	}
+	// The tcpip thread is still running: no static destructors
+	fflush(stdout);
+	_exit(0);
+}
@@ -0,0 +1,406 @@
+/*
+ * Runs cores/arduino/I2S.cpp against a model of the I2S page DMA: the
+ * model keeps an own bit per page and steps through the pages in ring
+ * order, sending or filling a page only while it owns it, then clears
+ * the bit and raises the page interrupt. Checks what the sketch side
+ * gets and what goes out on the wire. See README.md.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "I2S.h"
+#include "heap_caps.h"
+
+/******************************************************************************
+ * Heap
+ ******************************************************************************/
+
+static int allocs;
+static uint32_t lastCaps;
+
+void *malloc_caps(size_t size, uint32_t caps)
+{
+	lastCaps = caps;
+	allocs++;
+	return malloc(size);
+}
+
+void free_caps(void *ptr)
+{
+	if (ptr != NULL) allocs--;
+	free(ptr);
+}
+
+/******************************************************************************
+ * I2S model
+ ******************************************************************************/
+
+struct Dir {
+	uint8_t *base;
+	bool own[I2S_MAX_PAGES];
+	std::vector<uint32_t> snap[I2S_MAX_PAGES];	// TX page as given
+	uint32_t page;		// page the hardware works on
+	uint32_t stalls;	// steps the page was not owned
+};
+
+struct I2SModel {
+	bool configured;
+	bool started;
+	uint32_t rateCode;
+	uint8_t bits, channels;
+	int mode;
+	uint16_t words;
+	uint8_t pages;
+	bool failBegin;
+	Dir tx, rx;
+	uint32_t nextWord;		// RX data: a running count
+	std::vector<uint32_t> wire;	// TX data sent
+	int errors;			// given twice, or changed while owned
+};
+
+static I2SModel hw;
+
+int i2s_hw_begin(uint32_t rateCode, uint8_t bits, uint8_t channels, int mode,
+	uint8_t *tx, uint8_t *rx, uint16_t pageWords, uint8_t pages)
+{
+	if (hw.failBegin) return -1;
+	hw.configured = true;
+	hw.rateCode = rateCode;
+	hw.bits = bits;
+	hw.channels = channels;
+	hw.mode = mode;
+	hw.words = pageWords;
+	hw.pages = pages;
+	memset(hw.tx.own, 0, sizeof(hw.tx.own));
+	memset(hw.rx.own, 0, sizeof(hw.rx.own));
+	hw.tx.base = tx;
+	hw.rx.base = rx;
+	hw.tx.page = hw.rx.page = 0;
+	hw.tx.stalls = hw.rx.stalls = 0;
+	return 0;
+}
+
+void i2s_hw_give(int mode, uint32_t page)
+{
+	Dir &d = (mode == I2S_MODE_TX) ? hw.tx : hw.rx;
+
+	if (page >= hw.pages || d.own[page]) hw.errors++;
+	d.own[page] = true;
+	if (mode == I2S_MODE_TX) {
+		uint32_t *p = (uint32_t *)(d.base + page * hw.words * 4);
+		d.snap[page].assign(p, p + hw.words);
+	}
+}
+
+void i2s_hw_start(void)
+{
+	hw.started = true;
+}
+
+void i2s_hw_end(void)
+{
+	hw.started = false;
+	hw.configured = false;
+}
+
+/* One page time: each direction finishes its page if it owns it */
+static void hw_step(void)
+{
+	if (!hw.started) return;
+
+	if (hw.tx.base != NULL) {
+		Dir &d = hw.tx;
+		if (d.own[d.page]) {
+			uint32_t *p = (uint32_t *)(d.base + d.page * hw.words * 4);
+			if (memcmp(p, d.snap[d.page].data(), hw.words * 4) != 0) hw.errors++;
+			hw.wire.insert(hw.wire.end(), p, p + hw.words);
+			d.own[d.page] = false;
+			d.page = (d.page + 1) % hw.pages;
+			I2S.txPageDone();
+		} else {
+			d.stalls++;
+		}
+	}
+
+	if (hw.rx.base != NULL) {
+		Dir &d = hw.rx;
+		if (d.own[d.page]) {
+			uint32_t *p = (uint32_t *)(d.base + d.page * hw.words * 4);
+			for (uint32_t i = 0; i < hw.words; i++) p[i] = hw.nextWord++;
+			d.own[d.page] = false;
+			d.page = (d.page + 1) % hw.pages;
+			I2S.rxPageDone();
+		} else {
+			// the FIFO runs over, those words are lost
+			hw.nextWord += hw.words;
+			d.stalls++;
+		}
+	}
+}
+
+static bool owned_by_hw(const Dir &d, const void *p)
+{
+	uint32_t page = ((const uint8_t *)p - d.base) / (hw.words * 4);
+
+	return page >= hw.pages || d.own[page];
+}
+
+static void hw_reset(void)
+{
+	hw.configured = false;
+	hw.started = false;
+	hw.failBegin = false;
+	hw.nextWord = 0;
+	hw.wire.clear();
+	hw.errors = 0;
+}
+
+/******************************************************************************
+ * Checks
+ ******************************************************************************/
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+	printf("  %-52s %s\n", what, ok ? "ok" : "FAILED");
+	if (!ok) {
+		failures++;
+	}
+}
+
+static int callbacks[3];
+
+static void on_page(int mode, void *arg)
+{
+	callbacks[mode]++;
+	*(int *)arg += 1;
+}
+
+/* Read every RX page as it comes: the words arrive as the model counted them */
+static void rx_tests(uint8_t pages, uint16_t words)
+{
+	char what[80];
+	int calls = 0;
+	uint32_t expect = 0;
+	bool inOrder = true, notOwned = true, inRing = true;
+	int got = 0;
+
+	printf("\nreceive, %u pages of %u words\n", pages, words);
+
+	hw_reset();
+	memset(callbacks, 0, sizeof(callbacks));
+	I2S.onPage(on_page, &calls);
+	check(I2S.begin(16000, 16, 1, I2S_MODE_RX, words, pages) == 1, "begin()");
+	check(hw.started && hw.rateCode == 0x01 && hw.mode == I2S_MODE_RX && lastCaps == MALLOC_CAP_DMA,
+	      "16 kHz, RX only, pages from DMA memory");
+	check(I2S.pageBytes() == words * 4u && I2S.pageFrames() == words * 2u, "page size, 16-bit mono frames");
+	check(I2S.rxAcquire() == NULL && I2S.txAcquire() == NULL, "nothing to lend before the first page");
+
+	// keep up: one page read per page time
+	for (int step = 0; step < 40; step++) {
+		hw_step();
+		uint32_t *p = (uint32_t *)I2S.rxAcquire();
+		if (p == NULL) continue;
+		got++;
+		if (owned_by_hw(hw.rx, p)) notOwned = false;
+		if ((uint8_t *)p < hw.rx.base || (uint8_t *)p >= hw.rx.base + pages * words * 4) inRing = false;
+		if (I2S.rxAcquire() != NULL) inOrder = false;	// one at a time
+		for (uint32_t i = 0; i < words; i++) {
+			if (p[i] != expect++) inOrder = false;
+		}
+		I2S.rxRelease();
+	}
+	snprintf(what, sizeof(what), "%d pages in order, no copies", got);
+	check(got == 40 && inOrder && inRing, what);
+	check(notOwned && hw.errors == 0, "never a page the hardware owns");
+	check(I2S.overruns() == 0 && hw.rx.stalls == 0, "no overruns");
+	check(calls == 40 && callbacks[I2S_MODE_RX] == 40, "a callback per page");
+
+	// stop reading: the oldest pages are dropped, the newest kept
+	for (int step = 0; step < 10; step++) hw_step();
+	snprintf(what, sizeof(what), "10 pages unread: %u overruns", I2S.overruns());
+	check(I2S.overruns() == (uint32_t)(10 - (pages - 1)) && hw.rx.stalls == 0, what);
+	check(I2S.rxAvailable() == (uint32_t)pages - 1, "the rest of the ring full");
+
+	// the ring holds the newest pages - 1 pages, oldest first
+	expect = hw.nextWord - (pages - 1) * words;
+	inOrder = true;
+	for (int n = 0; n < pages - 1; n++) {
+		uint32_t *p = (uint32_t *)I2S.rxAcquire();
+		if (p == NULL || p[0] != expect || p[words - 1] != expect + words - 1) inOrder = false;
+		expect += words;
+		I2S.rxRelease();
+	}
+	check(inOrder && I2S.rxAcquire() == NULL, "newest pages kept, in order");
+	I2S.rxRelease();	// nothing lent: does nothing
+	check(hw.errors == 0, "release without a page lent: ignored");
+
+	// a lent page is not taken back: the hardware waits for it
+	for (int step = 0; step < 4; step++) hw_step();
+	uint32_t before = I2S.overruns();
+	uint32_t *held = (uint32_t *)I2S.rxAcquire();
+	uint32_t heldWord = held ? held[0] : 0;
+	for (int step = 0; step < 6; step++) hw_step();
+	check(held != NULL && held[0] == heldWord && hw.errors == 0, "lent page left alone");
+	check(hw.rx.stalls > 0 && I2S.overruns() == before + 1, "hardware stalls on it, one overrun");
+	I2S.rxRelease();
+	uint32_t stalls = hw.rx.stalls;
+	hw_step();
+	check(hw.rx.stalls == stalls && hw.errors == 0, "running again after the release");
+
+	I2S.end();
+	check(!hw.started && !I2S.running() && allocs == 0, "end() stops the I2S and frees the pages");
+	I2S.onPage(NULL);
+}
+
+/* Commit numbered pages: the wire carries them after the initial silence */
+static void tx_tests(uint8_t pages, uint16_t words)
+{
+	char what[80];
+	uint32_t next = 1;
+	bool notOwned = true;
+
+	printf("\nsend, %u pages of %u words\n", pages, words);
+
+	hw_reset();
+	check(I2S.begin(48000, 24, 2, I2S_MODE_TX, words, pages) == 1, "begin()");
+	check(hw.rateCode == 0x05 && hw.bits == 24 && hw.channels == 2 && hw.rx.base == NULL,
+	      "48 kHz, 24 bits stereo, TX only");
+	check(I2S.pageFrames() == words / 2u && I2S.rxAcquire() == NULL, "page size, 24-bit stereo frames");
+	check(I2S.txAcquire() == NULL, "every page queued with silence at first");
+
+	// keep up: fill every page that comes free
+	for (int step = 0; step < 30; step++) {
+		hw_step();
+		uint32_t *p = (uint32_t *)I2S.txAcquire();
+		if (p == NULL) continue;
+		if (owned_by_hw(hw.tx, p)) notOwned = false;
+		for (uint32_t i = 0; i < words; i++) p[i] = next++;
+		I2S.txCommit();
+	}
+	bool wire = hw.wire.size() == 30u * words;
+	for (size_t i = 0; wire && i < hw.wire.size(); i++) {
+		uint32_t want = (i < (size_t)pages * words) ? 0 : i - pages * words + 1;
+		if (hw.wire[i] != want) wire = false;
+	}
+	check(wire, "pages sent in commit order after the silence");
+	check(notOwned && hw.errors == 0, "never a page the hardware owns");
+	check(I2S.underruns() == 0 && hw.tx.stalls == 0, "no underruns");
+
+	// stop committing: silence instead, the hardware never waits
+	size_t mark = hw.wire.size();
+	for (int step = 0; step < 10; step++) hw_step();
+	bool silent = true;
+	for (size_t i = mark + pages * words; i < hw.wire.size(); i++) {
+		if (hw.wire[i] != 0) silent = false;
+	}
+	snprintf(what, sizeof(what), "10 pages not committed: %u underruns", I2S.underruns());
+	check(I2S.underruns() == (uint32_t)(10 - (pages - 1)) && silent && hw.tx.stalls == 0, what);
+
+	// a lent page is not taken back either
+	while (I2S.txAcquire() != NULL) I2S.txCommit();
+	uint32_t before = I2S.underruns();
+	uint32_t *held = (uint32_t *)I2S.txAcquire();
+	check(held == NULL, "ring full after committing every free page");
+	for (int step = 0; step < pages && held == NULL; step++) {
+		hw_step();
+		held = (uint32_t *)I2S.txAcquire();
+	}
+	for (int step = 0; step < pages + 2; step++) hw_step();
+	check(held != NULL && hw.tx.stalls > 0 && I2S.underruns() == before + 1 && hw.errors == 0,
+	      "hardware stalls on a lent page, one underrun");
+	for (uint32_t i = 0; held && i < words; i++) held[i] = 0xABCD;
+	I2S.txCommit();
+	mark = hw.wire.size();
+	hw_step();
+	check(hw.wire.size() == mark + words && hw.wire[mark] == 0xABCD, "the late page goes out next");
+
+	I2S.end();
+	check(!hw.started && allocs == 0, "end() stops the I2S and frees the pages");
+}
+
+static void duplex_tests(void)
+{
+	int ok = 1;
+
+	printf("\nfull duplex\n");
+
+	hw_reset();
+	check(I2S.begin(44100, 16, 2, I2S_MODE_DUPLEX, 64, 2) == 1, "begin()");
+	check(hw.rateCode == 0x15 && hw.tx.base != NULL && hw.rx.base != NULL &&
+	      (hw.rx.base >= hw.tx.base + 2 * 64 * 4 || hw.tx.base >= hw.rx.base + 2 * 64 * 4),
+	      "44.1 kHz, two rings apart");
+
+	// loop back: every page received goes out again
+	for (int step = 0; step < 20; step++) {
+		hw_step();
+		uint32_t *in = (uint32_t *)I2S.rxAcquire();
+		uint32_t *out = (uint32_t *)I2S.txAcquire();
+		if (in == NULL || out == NULL) {
+			if (step > 0) ok = 0;
+			if (in) I2S.rxRelease();
+			if (out) I2S.txCommit();
+			continue;
+		}
+		memcpy(out, in, 64 * 4);
+		I2S.rxRelease();
+		I2S.txCommit();
+	}
+	check(ok && hw.errors == 0, "a page each way every page time");
+	check(hw.wire.size() == 20 * 64 && hw.wire[2 * 64] == 0 && hw.wire[3 * 64] == 64 &&
+	      hw.wire.back() == 18 * 64 - 1, "received pages sent back, two pages later");
+	check(I2S.underruns() == 0 && I2S.overruns() == 0, "no underruns or overruns");
+	I2S.end();
+}
+
+static void fault_tests(void)
+{
+	printf("\nfaults\n");
+
+	hw_reset();
+	check(I2S.begin(11025) == 0 &&
+	      I2S.begin(16000, 8) == 0 &&
+	      I2S.begin(16000, 16, 3) == 0 &&
+	      I2S.begin(16000, 16, 2, 3) == 0 &&
+	      I2S.begin(16000, 16, 2, I2S_MODE_RX, 0) == 0 &&
+	      I2S.begin(16000, 16, 2, I2S_MODE_RX, I2S_MAX_PAGE_WORDS + 1) == 0 &&
+	      I2S.begin(16000, 16, 2, I2S_MODE_RX, 64, 1) == 0 &&
+	      I2S.begin(16000, 16, 2, I2S_MODE_RX, 64, I2S_MAX_PAGES + 1) == 0 &&
+	      !hw.configured && allocs == 0, "bad arguments refused");
+
+	hw.failBegin = true;
+	check(I2S.begin(16000) == 0 && !I2S.running() && allocs == 0, "I2S that does not start refused");
+	hw.failBegin = false;
+
+	// interrupts that were pending when end() ran
+	I2S.begin(16000, 16, 2, I2S_MODE_DUPLEX, 32, 2);
+	I2S.end();
+	I2S.txPageDone();
+	I2S.rxPageDone();
+	check(I2S.rxAcquire() == NULL && I2S.txAcquire() == NULL && hw.errors == 0,
+	      "interrupts after end(): ignored");
+
+	check(I2S.begin(32000, 16, 2, I2S_MODE_DUPLEX, I2S_MAX_PAGE_WORDS, I2S_MAX_PAGES) == 1 &&
+	      hw.rateCode == 0x03 && hw.words == I2S_MAX_PAGE_WORDS, "begin() after end(), largest ring");
+	I2S.end();
+	check(allocs == 0, "no leaks");
+}
+
+int main(int argc, char **argv)
+{
+	rx_tests(2, 16);
+	rx_tests(4, 100);
+	tx_tests(2, 16);
+	tx_tests(3, 100);
+	duplex_tests();
+	fault_tests();
+
+	printf("\n%s\n", failures ? "FAILED" : "all ok");
+	return failures ? 1 : 0;
+}
@@ -298,4 +298,18 @@
 #define IMAGE2_DATA_SECTION					\
 		SECTION(".img2.ram.data")
 
+//3 TCM Section
+// 64KB of zero wait state RAM at 0x1FFF0000, copied/zeroed by _AppStart().
+// The DMA engines can not reach it, so keep DMA buffers out of it. Calls
+// between TCM and BD_RAM code are out of branch range and go through
+// linker veneers, which costs a few cycles per call.
+#define TCM_TEXT_SECTION					\
+		SECTION(".tcm.code")
+
+#define TCM_DATA_SECTION					\
+		SECTION(".tcm.vars")
+
+#define TCM_BSS_SECTION						\
+		SECTION(".tcm.bss")
+
 #endif //_SECTION_CONFIG_H_
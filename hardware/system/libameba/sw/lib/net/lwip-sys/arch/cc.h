@@ -100,12 +100,15 @@ typedef uintptr_t          mem_ptr_t;
 #if defined(TOOLCHAIN_GCC) && defined(__thumb2__)
     #define MEMCPY(dst,src,len)     thumb2_memcpy(dst,src,len)
     #define LWIP_CHKSUM             thumb2_checksum
+    /* Copy and checksum in one pass, used with LWIP_CHECKSUM_ON_COPY */
+    #define LWIP_CHKSUM_COPY(dst,src,len) thumb2_chksum_copy(dst,src,len)
     /* Set algorithm to 0 so that unused lwip_standard_chksum function
        doesn't generate compiler warning */
     #define LWIP_CHKSUM_ALGORITHM   0
 
     void* thumb2_memcpy(void* pDest, const void* pSource, size_t length);
     u16_t thumb2_checksum(void* pData, int length);
+    u16_t thumb2_chksum_copy(void* pDest, const void* pSource, int length);
 #else
     /* Used with IP headers only */
     #define LWIP_CHKSUM_ALGORITHM   1
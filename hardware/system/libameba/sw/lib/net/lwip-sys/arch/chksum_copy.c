@@ -0,0 +1,130 @@
+#include <stdint.h>
+
+
+#if defined(__thumb2__)
+
+/* This is a hand written Thumb-2 assembly language routine for lwIP's
+   LWIP_CHKSUM_COPY.  It copies like thumb2_memcpy and sums the same
+   words while they are still in registers, so every payload byte is
+   loaded once instead of once for the copy and again for the checksum.
+
+   The sum is taken over 16-bit units counted from the start of the
+   data, which is what thumb2_checksum returns after its odd address
+   swap.  The Cortex-M3 handles unaligned ldr/str, so neither pointer
+   needs to be aligned.
+
+   Returns:
+        16-bit 1's complement summation (not inversed).
+
+   NOTE: This function does return a uint16_t from the assembly language code
+         but is marked as void so that GCC doesn't issue warning because it
+         doesn't know about this low level return.
+*/
+__attribute__((naked)) void /*uint16_t*/ thumb2_chksum_copy(void* pDest, const void* pSource, int length)
+{
+    __asm (
+        ".syntax unified\n"
+        ".thumb\n"
+
+        // Push the non-volatile registers we use, 16 bytes keeps the stack
+        // 8-byte aligned.
+        "    push    {r4-r7}\n"
+        // Initialize sum, r3, to 0.
+        "    movs    r3, #0\n"
+
+        // Main loop, copies and sums 16 bytes at a time.  The carry out of
+        // one add goes into the next, and the final carry is folded back
+        // in.  When an add carries, the low word is at most 0xfffffffe, so
+        // that last fold can not carry again.
+        "1$: cmp     r2, #16\n"
+        "    blt     2$\n"
+        "    ldr     r4, [r1], #4\n"
+        "    ldr     r5, [r1], #4\n"
+        "    ldr     r6, [r1], #4\n"
+        "    ldr     r7, [r1], #4\n"
+        "    str     r4, [r0], #4\n"
+        "    str     r5, [r0], #4\n"
+        "    str     r6, [r0], #4\n"
+        "    str     r7, [r0], #4\n"
+        "    adds    r3, r3, r4\n"
+        "    adcs    r3, r3, r5\n"
+        "    adcs    r3, r3, r6\n"
+        "    adcs    r3, r3, r7\n"
+        "    adc     r3, r3, #0\n"
+        "    subs    r2, r2, #16\n"
+        "    b       1$\n"
+
+        // Remaining words.
+        "2$: cmp     r2, #4\n"
+        "    blt     3$\n"
+        "    ldr     r4, [r1], #4\n"
+        "    str     r4, [r0], #4\n"
+        "    adds    r3, r3, r4\n"
+        "    adc     r3, r3, #0\n"
+        "    subs    r2, r2, #4\n"
+        "    b       2$\n"
+
+        // Remaining half-word.
+        "3$: cmp     r2, #2\n"
+        "    blt     4$\n"
+        "    ldrh    r4, [r1], #2\n"
+        "    strh    r4, [r0], #2\n"
+        "    adds    r3, r3, r4\n"
+        "    adc     r3, r3, #0\n"
+        "    subs    r2, r2, #2\n"
+
+        // Trailing byte, it sums as the low byte of a half-word.
+        "4$: cbz     r2, 5$\n"
+        "    ldrb    r4, [r1]\n"
+        "    strb    r4, [r0]\n"
+        "    adds    r3, r3, r4\n"
+        "    adc     r3, r3, #0\n"
+
+        // Fold 32-bit checksum into 16-bit checksum.
+        "5$: ubfx    r4, r3, #16, #16\n"
+        "    ubfx    r3, r3, #0, #16\n"
+        "    adds    r3, r4\n"
+        "    ubfx    r4, r3, #16, #16\n"
+        "    ubfx    r3, r3, #0, #16\n"
+        "    adds    r3, r4\n"
+
+        // Return final sum.
+        "    mov     r0, r3\n"
+        "    pop     {r4-r7}\n"
+        "    bx      lr\n"
+    );
+}
+
+#else
+
+/* Reference version of the routine above, for builds that are not
+   Thumb-2.  It sums the same little-endian 16-bit units, so both must
+   return the same value for any data, length and alignment.
+   system/chksumtest tests it, and a model of the routine above, on the
+   host; its ChksumBench sketch tests and times the routine on the board.
+*/
+uint16_t thumb2_chksum_copy(void* pDest, const void* pSource, int length)
+{
+    uint8_t* pDst = (uint8_t*)pDest;
+    const uint8_t* pSrc = (const uint8_t*)pSource;
+    uint32_t sum = 0;
+
+    while (length >= 2) {
+        pDst[0] = pSrc[0];
+        pDst[1] = pSrc[1];
+        sum += pSrc[0] | (pSrc[1] << 8);
+        pDst += 2;
+        pSrc += 2;
+        length -= 2;
+    }
+    if (length > 0) {
+        pDst[0] = pSrc[0];
+        sum += pSrc[0];
+    }
+
+    sum = (sum >> 16) + (sum & 0xffff);
+    sum = (sum >> 16) + (sum & 0xffff);
+    return (uint16_t)sum;
+}
+
+#endif
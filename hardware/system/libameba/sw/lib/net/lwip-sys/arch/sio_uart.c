@@ -0,0 +1,184 @@
+/* lwIP sio layer on the Ameba UARTs, see sio_uart.h */
+
+#include <string.h>
+
+#include "serial_api.h"
+
+#include "lwip/opt.h"
+
+#if LWIP_HAVE_SLIPIF || PPPOS_SUPPORT
+
+#include "lwip/sio.h"
+#include "lwip/sys.h"
+#include "lwip/stats.h"
+#include "arch/sio_uart.h"
+
+#ifndef SIO_UART_NUM
+#define SIO_UART_NUM            2
+#endif
+
+/* Must be a power of two. At 921600 baud, 512 bytes is 5.5ms of data. */
+#ifndef SIO_UART_RX_BUFSIZE
+#define SIO_UART_RX_BUFSIZE     512
+#endif
+
+#if (SIO_UART_RX_BUFSIZE & (SIO_UART_RX_BUFSIZE - 1)) != 0
+#error "SIO_UART_RX_BUFSIZE must be a power of two"
+#endif
+
+struct sio_uart {
+  serial_t sobj;
+  PinName tx, rx;
+  u32_t baud;
+  u8_t opened;
+  volatile u8_t aborted;
+  sys_sem_t rx_sem;
+  /* head is only moved by the RX interrupt, tail only by the reader */
+  volatile u32_t head, tail;
+  u8_t ring[SIO_UART_RX_BUFSIZE];
+};
+
+static struct sio_uart sio_uarts[SIO_UART_NUM];
+
+void
+sio_uart_config(u8_t devnum, PinName tx, PinName rx, u32_t baud)
+{
+  LWIP_ASSERT("sio_uart_config: devnum < SIO_UART_NUM", devnum < SIO_UART_NUM);
+
+  sio_uarts[devnum].tx = tx;
+  sio_uarts[devnum].rx = rx;
+  sio_uarts[devnum].baud = baud;
+}
+
+static void
+sio_uart_irq(uint32_t id, SerialIrq event)
+{
+  struct sio_uart *sio = (struct sio_uart *)id;
+  u32_t head = sio->head;
+  u8_t was_empty = (head == sio->tail);
+
+  if (event != RxIrq) {
+    return;
+  }
+  while (serial_readable(&sio->sobj)) {
+    u8_t c = (u8_t)serial_getc(&sio->sobj);
+    if ((head - sio->tail) < SIO_UART_RX_BUFSIZE) {
+      sio->ring[head & (SIO_UART_RX_BUFSIZE - 1)] = c;
+      head++;
+    } else {
+      LINK_STATS_INC(link.drop);
+    }
+  }
+  sio->head = head;
+
+  /* the reader only sleeps on an empty ring */
+  if (was_empty && (head != sio->tail)) {
+    sys_sem_signal(&sio->rx_sem);
+  }
+}
+
+sio_fd_t
+sio_open(u8_t devnum)
+{
+  struct sio_uart *sio;
+
+  if ((devnum >= SIO_UART_NUM) || (sio_uarts[devnum].baud == 0)) {
+    return NULL;
+  }
+  sio = &sio_uarts[devnum];
+  if (sio->opened) {
+    return sio;
+  }
+  if (sys_sem_new(&sio->rx_sem, 0) != ERR_OK) {
+    return NULL;
+  }
+  sio->head = sio->tail = 0;
+
+  serial_init(&sio->sobj, sio->tx, sio->rx);
+  serial_baud(&sio->sobj, sio->baud);
+  serial_format(&sio->sobj, 8, ParityNone, 1);
+  serial_irq_handler(&sio->sobj, sio_uart_irq, (uint32_t)sio);
+  serial_irq_set(&sio->sobj, RxIrq, 1);
+
+  sio->opened = 1;
+  return sio;
+}
+
+void
+sio_send(u8_t c, sio_fd_t fd)
+{
+  struct sio_uart *sio = (struct sio_uart *)fd;
+
+  serial_putc(&sio->sobj, c);
+}
+
+u32_t
+sio_write(sio_fd_t fd, u8_t *data, u32_t len)
+{
+  struct sio_uart *sio = (struct sio_uart *)fd;
+  u32_t i;
+
+  for (i = 0; i < len; i++) {
+    serial_putc(&sio->sobj, data[i]);
+  }
+  return len;
+}
+
+/**
+ * Copy out what the ring holds, in at most two pieces (before and after
+ * the wrap).
+ */
+static u32_t
+sio_uart_take(struct sio_uart *sio, u8_t *data, u32_t len)
+{
+  u32_t tail = sio->tail;
+  u32_t n = LWIP_MIN(sio->head - tail, len);
+  u32_t pos = tail & (SIO_UART_RX_BUFSIZE - 1);
+  u32_t first = LWIP_MIN(n, SIO_UART_RX_BUFSIZE - pos);
+
+  MEMCPY(data, &sio->ring[pos], first);
+  MEMCPY(data + first, &sio->ring[0], n - first);
+  sio->tail = tail + n;
+  return n;
+}
+
+u32_t
+sio_tryread(sio_fd_t fd, u8_t *data, u32_t len)
+{
+  return sio_uart_take((struct sio_uart *)fd, data, len);
+}
+
+u32_t
+sio_read(sio_fd_t fd, u8_t *data, u32_t len)
+{
+  struct sio_uart *sio = (struct sio_uart *)fd;
+
+  while (sio->head == sio->tail) {
+    if (sio->aborted) {
+      sio->aborted = 0;
+      return 0;
+    }
+    sys_arch_sem_wait(&sio->rx_sem, 0);
+  }
+  return sio_uart_take(sio, data, len);
+}
+
+u8_t
+sio_recv(sio_fd_t fd)
+{
+  u8_t c;
+
+  sio_read(fd, &c, 1);
+  return c;
+}
+
+void
+sio_read_abort(sio_fd_t fd)
+{
+  struct sio_uart *sio = (struct sio_uart *)fd;
+
+  sio->aborted = 1;
+  sys_sem_signal(&sio->rx_sem);
+}
+
+#endif /* LWIP_HAVE_SLIPIF || PPPOS_SUPPORT */
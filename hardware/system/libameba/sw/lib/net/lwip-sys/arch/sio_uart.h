@@ -0,0 +1,31 @@
+#ifndef __ARCH_SIO_UART_H__
+#define __ARCH_SIO_UART_H__
+
+#include "lwip/opt.h"
+#include "PinNames.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* lwIP sio layer (lwip/sio.h) on the UARTs, for slipif and PPP over serial.
+ *
+ * Received bytes are moved by the RX interrupt into a ring of
+ * SIO_UART_RX_BUFSIZE bytes. sio_read() sleeps until the ring is not empty
+ * and then returns everything in it (up to len) at once, so the link layer
+ * decodes whole bursts instead of single bytes. Bytes that arrive while
+ * the ring is full are dropped and counted in LINK_STATS link.drop.
+ *
+ * sio_open(devnum) opens the UART set with sio_uart_config() for devnum,
+ * which must be called first, e.g. before slipif_init():
+ *
+ *   sio_uart_config(0, PA_4, PA_0, 921600);
+ *   netif_add(&slipnetif, &ip, &mask, &gw, NULL, slipif_init, tcpip_input);
+ */
+void sio_uart_config(u8_t devnum, PinName tx, PinName rx, u32_t baud);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ARCH_SIO_UART_H__ */
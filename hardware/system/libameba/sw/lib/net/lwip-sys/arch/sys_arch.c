@@ -302,6 +302,13 @@ void sys_mutex_lock(sys_mutex_t *mutex) {
         error("sys_mutex_lock error\n");
 }
 
+/** Lock a mutex if it is free, without blocking
+ * @param mutex the mutex to lock
+ * @return 1 if the mutex was locked, 0 if another thread holds it */
+int sys_mutex_trylock(sys_mutex_t *mutex) {
+    return (osMutexWait(mutex->id, 0) == osOK);
+}
+
 /** Unlock a mutex
  * @param mutex the mutex to unlock */
 void sys_mutex_unlock(sys_mutex_t *mutex) {
@@ -313,6 +320,24 @@ void sys_mutex_unlock(sys_mutex_t *mutex) {
  * @param mutex the mutex to delete */
 void sys_mutex_free(sys_mutex_t *mutex) {}
 
+/** The calling thread, for sys_thread_wake() */
+void *sys_thread_self(void) {
+    return (void *)osThreadGetId();
+}
+
+/** Wake a thread in sys_thread_sleep(), or make its next sleep return
+ * at once
+ * @param thread the thread, from sys_thread_self() */
+void sys_thread_wake(void *thread) {
+    osSignalSet((osThreadId)thread, SYS_WAKE_SIGNAL);
+}
+
+/** Sleep until sys_thread_wake() or the timeout
+ * @param timeout milliseconds, osWaitForever for no timeout */
+void sys_thread_sleep(uint32_t timeout) {
+    osSignalWait(SYS_WAKE_SIGNAL, timeout);
+}
+
 /*---------------------------------------------------------------------------*
  * Routine:  sys_init
  *---------------------------------------------------------------------------*
@@ -386,6 +411,10 @@ u32_t sys_now(void) {
     return us_ticker_read() / 1000;
 }
 
+uint32_t sys_now_us(void) {
+    return us_ticker_read();
+}
+
 void sys_msleep(u32_t ms) {
     osDelay(ms);
 }
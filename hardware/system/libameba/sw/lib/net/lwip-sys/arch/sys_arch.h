@@ -44,6 +44,18 @@ typedef struct {
 #endif
 } sys_mutex_t;
 
+/* Not part of the lwIP sys API, used by tcpip_core_lock() */
+int sys_mutex_trylock(sys_mutex_t *mutex);
+uint32_t sys_now_us(void);
+
+/* Not part of the lwIP sys API, used by lwip_waitfor(): the waiting thread
+   sleeps on this signal flag of its own, and event_callback() sets it. */
+#define SYS_WAKE_SIGNAL     0x8000
+
+void *sys_thread_self(void);
+void sys_thread_wake(void *thread);
+void sys_thread_sleep(uint32_t timeout);
+
 // === MAIL BOX ===
 #define MB_SIZE      8
 
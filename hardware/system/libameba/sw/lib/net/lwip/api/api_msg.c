@@ -292,8 +292,8 @@ poll_tcp(void *arg, struct tcp_pcb *pcb)
   if (conn->flags & NETCONN_FLAG_CHECK_WRITESPACE) {
     /* If the queued byte- or pbuf-count drops below the configured low-water limit,
        let select mark this pcb as writable again. */
-    if ((conn->pcb.tcp != NULL) && (tcp_sndbuf(conn->pcb.tcp) > TCP_SNDLOWAT) &&
-      (tcp_sndqueuelen(conn->pcb.tcp) < TCP_SNDQUEUELOWAT)) {
+    if ((conn->pcb.tcp != NULL) && (tcp_sndbuf(conn->pcb.tcp) > tcp_sndlowat(conn->pcb.tcp)) &&
+      (tcp_sndqueuelen(conn->pcb.tcp) < tcp_sndqueuelowat(conn->pcb.tcp))) {
       conn->flags &= ~NETCONN_FLAG_CHECK_WRITESPACE;
       API_EVENT(conn, NETCONN_EVT_SENDPLUS, 0);
     }
@@ -326,8 +326,8 @@ sent_tcp(void *arg, struct tcp_pcb *pcb, u16_t len)
   if (conn) {
     /* If the queued byte- or pbuf-count drops below the configured low-water limit,
        let select mark this pcb as writable again. */
-    if ((conn->pcb.tcp != NULL) && (tcp_sndbuf(conn->pcb.tcp) > TCP_SNDLOWAT) &&
-      (tcp_sndqueuelen(conn->pcb.tcp) < TCP_SNDQUEUELOWAT)) {
+    if ((conn->pcb.tcp != NULL) && (tcp_sndbuf(conn->pcb.tcp) > tcp_sndlowat(conn->pcb.tcp)) &&
+      (tcp_sndqueuelen(conn->pcb.tcp) < tcp_sndqueuelowat(conn->pcb.tcp))) {
       conn->flags &= ~NETCONN_FLAG_CHECK_WRITESPACE;
       API_EVENT(conn, NETCONN_EVT_SENDPLUS, len);
     }
@@ -1249,8 +1249,8 @@ do_writemore(struct netconn *conn)
   } else {
     /* if OK or memory error, check available space */
     if (((err == ERR_OK) || (err == ERR_MEM)) &&
-        ((tcp_sndbuf(conn->pcb.tcp) <= TCP_SNDLOWAT) ||
-         (tcp_sndqueuelen(conn->pcb.tcp) >= TCP_SNDQUEUELOWAT))) {
+        ((tcp_sndbuf(conn->pcb.tcp) <= tcp_sndlowat(conn->pcb.tcp)) ||
+         (tcp_sndqueuelen(conn->pcb.tcp) >= tcp_sndqueuelowat(conn->pcb.tcp)))) {
       /* The queued byte- or pbuf-count exceeds the configured low-water limit,
          let select mark this pcb as non-writable. */
       API_EVENT(conn, NETCONN_EVT_SENDMINUS, len);
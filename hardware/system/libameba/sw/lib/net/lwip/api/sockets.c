@@ -48,10 +48,12 @@
 #include "lwip/igmp.h"
 #include "lwip/inet.h"
 #include "lwip/tcp.h"
+#include "lwip/tcp_impl.h"
 #include "lwip/raw.h"
 #include "lwip/udp.h"
 #include "lwip/tcpip.h"
 #include "lwip/pbuf.h"
+#include "lwip/netstats.h"
 #if LWIP_CHECKSUM_ON_COPY
 #include "lwip/inet_chksum.h"
 #endif
@@ -80,6 +82,14 @@ struct lwip_sock {
   int err;
   /** counter of how many threads are waiting for this socket using select */
   int select_waiting;
+#if LWIP_SOCKET_WAITFOR
+  /** the peer closed the connection, set by event_callback() */
+  u8_t eofevent;
+  /** events the thread in lwip_waitfor() waits for */
+  u8_t wait_events;
+  /** thread waiting for this socket in lwip_waitfor(), NULL if none */
+  void *waiter;
+#endif /* LWIP_SOCKET_WAITFOR */
 };
 
 /** Description for a task waiting in select */
@@ -263,6 +273,11 @@ alloc_socket(struct netconn *newconn, int accepted)
       sockets[i].errevent   = 0;
       sockets[i].err        = 0;
       sockets[i].select_waiting = 0;
+#if LWIP_SOCKET_WAITFOR
+      sockets[i].eofevent   = 0;
+      sockets[i].wait_events = 0;
+      sockets[i].waiter     = NULL;
+#endif /* LWIP_SOCKET_WAITFOR */
       return i;
     }
     SYS_ARCH_UNPROTECT(lev);
@@ -290,6 +305,13 @@ free_socket(struct lwip_sock *sock, int is_tcp)
   /* Protect socket array */
   SYS_ARCH_PROTECT(lev);
   sock->conn       = NULL;
+#if LWIP_SOCKET_WAITFOR
+  if (sock->waiter != NULL) {
+    /* it finds the socket gone */
+    sys_thread_wake(sock->waiter);
+    sock->waiter = NULL;
+  }
+#endif /* LWIP_SOCKET_WAITFOR */
   SYS_ARCH_UNPROTECT(lev);
   /* don't use 'sock' after this line, as another task might have allocated it */
 
@@ -767,7 +789,11 @@ lwip_send(int s, const void *data, size_t size, int flags)
   }
 
   if ((flags & MSG_DONTWAIT) || netconn_is_nonblocking(sock->conn)) {
+#if TCP_BUF_AUTOTUNE
+    if ((size > TCP_SND_BUF_MAX) || ((size / TCP_MSS) > (TCP_SND_QUEUELEN * TCP_SND_BUF_MAX / TCP_SND_BUF))) {
+#else /* TCP_BUF_AUTOTUNE */
     if ((size > TCP_SND_BUF) || ((size / TCP_MSS) > TCP_SND_QUEUELEN)) {
+#endif /* TCP_BUF_AUTOTUNE */
       /* too much data to ever send nonblocking! */
       sock_set_errno(sock, EMSGSIZE);
       return -1;
@@ -822,7 +848,9 @@ lwip_sendto(int s, const void *data, size_t size, int flags,
   to_in = (const struct sockaddr_in *)(void*)to;
 
 #if LWIP_TCPIP_CORE_LOCKING
-  /* Should only be consider like a sample or a simple way to experiment this option (no check of "to" field...) */
+  /* Send straight from this thread under the core lock. Without
+     LWIP_NETIF_TX_SINGLE_PBUF the pbuf references the caller's data;
+     etharp copies it if the packet has to wait for an ARP reply. */
   {
     struct pbuf* p;
     ip_addr_t *remote_addr;
@@ -843,22 +871,29 @@ lwip_sendto(int s, const void *data, size_t size, int flags,
       p->payload = (void*)data;
 #endif /* LWIP_NETIF_TX_SINGLE_PBUF */
 
+      LOCK_TCPIP_CORE();
       if (to_in != NULL) {
         inet_addr_to_ipaddr_p(remote_addr, &to_in->sin_addr);
         remote_port = ntohs(to_in->sin_port);
       } else {
-        remote_addr = &sock->conn->pcb.raw->remote_ip;
+#if LWIP_RAW
         if (sock->conn->type == NETCONN_RAW) {
+          remote_addr = &sock->conn->pcb.raw->remote_ip;
           remote_port = 0;
-        } else {
+        } else
+#endif /* LWIP_RAW */
+        {
+          remote_addr = &sock->conn->pcb.udp->remote_ip;
           remote_port = sock->conn->pcb.udp->remote_port;
         }
       }
 
-      LOCK_TCPIP_CORE();
+#if LWIP_RAW
       if (sock->conn->type == NETCONN_RAW) {
         err = sock->conn->last_err = raw_sendto(sock->conn->pcb.raw, p, remote_addr);
-      } else {
+      } else
+#endif /* LWIP_RAW */
+      {
 #if LWIP_UDP
 #if LWIP_CHECKSUM_ON_COPY && LWIP_NETIF_TX_SINGLE_PBUF
         err = sock->conn->last_err = udp_sendto_chksum(sock->conn->pcb.udp, p,
@@ -1226,6 +1261,83 @@ return_copy_fdsets:
   return nready;
 }
 
+#if LWIP_SOCKET_WAITFOR
+/** LWIP_WAIT_* events that are ready on a socket; call it protected */
+static int
+waitfor_ready(struct lwip_sock *sock)
+{
+  int ready = 0;
+
+  if ((sock->lastdata != NULL) || (sock->rcvevent > 0)) {
+    ready |= LWIP_WAIT_READ;
+  }
+  if (sock->sendevent != 0) {
+    ready |= LWIP_WAIT_WRITE;
+  }
+  if ((sock->errevent != 0) || (sock->eofevent != 0)) {
+    ready |= LWIP_WAIT_CLOSED;
+  }
+  return ready;
+}
+
+/**
+ * Block until a socket has one of the events, or the timeout passes.
+ * Unlike lwip_select(), the thread sleeps on its own signal flag and only
+ * event_callback() for this socket wakes it. One thread at a time can wait
+ * on a socket.
+ *
+ * @param s the socket
+ * @param events LWIP_WAIT_* events to wait for, LWIP_WAIT_CLOSED always counts
+ * @param timeout milliseconds, 0 to poll, LWIP_WAIT_FOREVER for no timeout
+ * @return the events that are ready, 0 on timeout, -1 if the socket is not
+ *         open or closes meanwhile (EBADF) or another thread waits on it (EBUSY)
+ */
+int
+lwip_waitfor(int s, int events, u32_t timeout)
+{
+  struct lwip_sock *sock;
+  void *self = sys_thread_self();
+  u32_t start = sys_now(), waited;
+  int ready;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  sock = get_socket(s);
+  if (!sock) {
+    return -1;
+  }
+  events = (events & (LWIP_WAIT_READ | LWIP_WAIT_WRITE)) | LWIP_WAIT_CLOSED;
+
+  for (;;) {
+    SYS_ARCH_PROTECT(lev);
+    if (sock->waiter == self) {
+      sock->waiter = NULL;
+    }
+    if (sock->conn == NULL) {
+      SYS_ARCH_UNPROTECT(lev);
+      set_errno(EBADF);
+      return -1;
+    }
+    ready = waitfor_ready(sock) & events;
+    waited = sys_now() - start;
+    if ((ready != 0) || (waited >= timeout)) {
+      SYS_ARCH_UNPROTECT(lev);
+      return ready;
+    }
+    if (sock->waiter != NULL) {
+      SYS_ARCH_UNPROTECT(lev);
+      sock_set_errno(sock, EBUSY);
+      return -1;
+    }
+    sock->waiter = self;
+    sock->wait_events = (u8_t)events;
+    SYS_ARCH_UNPROTECT(lev);
+
+    /* A wake left over from an earlier wait only costs one more turn */
+    sys_thread_sleep(timeout == LWIP_WAIT_FOREVER ? LWIP_WAIT_FOREVER : timeout - waited);
+  }
+}
+#endif /* LWIP_SOCKET_WAITFOR */
+
 /**
  * Callback registered in the netconn layer for each socket-netconn.
  * Processes recvevent (data available) and wakes up tasks waiting for select.
@@ -1293,6 +1405,21 @@ event_callback(struct netconn *conn, enum netconn_evt evt, u16_t len)
       break;
   }
 
+#if LWIP_SOCKET_WAITFOR
+#if LWIP_TCP
+  /* A TCP connection signals its end of stream with an empty receive,
+     a listening one each new connection */
+  if ((evt == NETCONN_EVT_RCVPLUS) && (len == 0) &&
+      (NETCONNTYPE_GROUP(conn->type) == NETCONN_TCP) && !sys_mbox_valid(&conn->acceptmbox)) {
+    sock->eofevent = 1;
+  }
+#endif /* LWIP_TCP */
+  if ((sock->waiter != NULL) && (waitfor_ready(sock) & sock->wait_events)) {
+    sys_thread_wake(sock->waiter);
+    sock->waiter = NULL;
+  }
+#endif /* LWIP_SOCKET_WAITFOR */
+
   if (sock->select_waiting == 0) {
     /* noone is waiting for this socket, no need to check select_cb_list */
     SYS_ARCH_UNPROTECT(lev);
@@ -1570,6 +1697,10 @@ lwip_getsockopt(int s, int level, int optname, void *optval, socklen_t *optlen)
     case TCP_KEEPINTVL:
     case TCP_KEEPCNT:
 #endif /* LWIP_TCP_KEEPALIVE */
+#if TCP_BUF_AUTOTUNE
+    case TCP_SNDBUF:
+    case TCP_RCVWND:
+#endif /* TCP_BUF_AUTOTUNE */
       break;
        
     default:
@@ -1806,6 +1937,19 @@ lwip_getsockopt_internal(void *arg)
                   s, *(int *)optval));
       break;
 #endif /* LWIP_TCP_KEEPALIVE */
+#if TCP_BUF_AUTOTUNE
+    case TCP_SNDBUF:
+    case TCP_RCVWND:
+      if (sock->conn->pcb.tcp->state == LISTEN) {
+        data->err = EINVAL;
+        break;
+      }
+      *(int*)optval = (optname == TCP_SNDBUF) ? tcp_sndbuf_max(sock->conn->pcb.tcp) :
+                                                tcp_rcv_wnd_max(sock->conn->pcb.tcp);
+      LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_getsockopt(%d, IPPROTO_TCP, optname=0x%x) = %d\n",
+                  s, optname, *(int *)optval));
+      break;
+#endif /* TCP_BUF_AUTOTUNE */
     default:
       LWIP_ASSERT("unhandled optname", 0);
       break;
@@ -1980,6 +2124,10 @@ lwip_setsockopt(int s, int level, int optname, const void *optval, socklen_t opt
     case TCP_KEEPINTVL:
     case TCP_KEEPCNT:
 #endif /* LWIP_TCP_KEEPALIVE */
+#if TCP_BUF_AUTOTUNE
+    case TCP_SNDBUF:
+    case TCP_RCVWND:
+#endif /* TCP_BUF_AUTOTUNE */
       break;
 
     default:
@@ -2207,6 +2355,23 @@ lwip_setsockopt_internal(void *arg)
                   s, sock->conn->pcb.tcp->keep_cnt));
       break;
 #endif /* LWIP_TCP_KEEPALIVE */
+#if TCP_BUF_AUTOTUNE
+    case TCP_SNDBUF:
+    case TCP_RCVWND:
+      if ((sock->conn->pcb.tcp->state == LISTEN) ||
+          (*(int*)optval < 0) || (*(int*)optval > 0xffff)) {
+        data->err = EINVAL;
+        break;
+      }
+      if (optname == TCP_SNDBUF) {
+        tcp_set_snd_buf(sock->conn->pcb.tcp, (u16_t)(*(int*)optval));
+      } else {
+        tcp_set_rcv_wnd(sock->conn->pcb.tcp, (u16_t)(*(int*)optval));
+      }
+      LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_setsockopt(%d, IPPROTO_TCP, optname=0x%x) -> %d\n",
+                  s, optname, *(int*)optval));
+      break;
+#endif /* TCP_BUF_AUTOTUNE */
     default:
       LWIP_ASSERT("unhandled optname", 0);
       break;
@@ -2344,4 +2509,42 @@ lwip_fcntl(int s, int cmd, int val)
   return ret;
 }
 
+#if NETSTATS
+/**
+ * Snapshot the RTT estimate and retransmission counters of a TCP socket.
+ * The fields are read without stopping the tcpip thread, so values that
+ * change together (e.g. cwnd and snd_wnd) may be from different segments.
+ */
+int
+netstats_socket_get(int s, struct netstats_socket *stats)
+{
+  struct lwip_sock *sock = tryget_socket(s);
+  struct tcp_pcb *pcb;
+
+  if (!sock || !sock->conn || (NETCONNTYPE_GROUP(sock->conn->type) != NETCONN_TCP)) {
+    return -1;
+  }
+
+  pcb = sock->conn->pcb.tcp;
+  if (pcb == NULL) {
+    return -1;
+  }
+  stats->state = (u8_t)pcb->state;
+  stats->mss = pcb->mss;
+  /* sa holds 8 * srtt and sv 4 * rttvar, both in TCP_SLOW_INTERVAL ticks */
+  stats->srtt = (u32_t)(pcb->sa >> 3) * TCP_SLOW_INTERVAL;
+  stats->rttvar = (u32_t)(pcb->sv >> 2) * TCP_SLOW_INTERVAL;
+  stats->rto = (u32_t)pcb->rto * TCP_SLOW_INTERVAL;
+  stats->rexmit = pcb->rexmit_cnt;
+  stats->cwnd = pcb->cwnd;
+  stats->snd_wnd = pcb->snd_wnd;
+  stats->rcv_wnd = pcb->rcv_wnd;
+  stats->snd_buf = pcb->snd_buf;
+  stats->rcv_wnd_max = tcp_rcv_wnd_max(pcb);
+  stats->snd_buf_max = tcp_sndbuf_max(pcb);
+  stats->snd_queuelen = pcb->snd_queuelen;
+  return 0;
+}
+#endif /* NETSTATS */
+
 #endif /* LWIP_SOCKET */
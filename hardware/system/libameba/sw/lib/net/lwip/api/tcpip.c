@@ -45,6 +45,7 @@
 #include "lwip/mem.h"
 #include "lwip/pbuf.h"
 #include "lwip/tcpip.h"
+#include "lwip/netstats.h"
 #include "lwip/init.h"
 #include "netif/etharp.h"
 #include "netif/ppp_oe.h"
@@ -57,6 +58,38 @@ static sys_mbox_t mbox;
 #if LWIP_TCPIP_CORE_LOCKING
 /** The global semaphore to lock the stack. */
 sys_mutex_t lock_tcpip_core;
+
+/**
+ * Lock the lwIP core. Application threads take it to run an api_msg
+ * function themselves instead of posting it to tcpip_thread, and
+ * tcpip_thread takes it for everything it runs.
+ *
+ * The free case is one non-blocking try; only a thread that finds the
+ * lock taken is counted and timed, in netstats.core.
+ */
+void
+tcpip_core_lock(void)
+{
+#if NETSTATS
+  u32_t start;
+
+  if (!sys_mutex_trylock(&lock_tcpip_core)) {
+    start = sys_now_us();
+    sys_mutex_lock(&lock_tcpip_core);
+    NETSTATS_CORE_WAIT(sys_now_us() - start);
+  }
+  NETSTATS_INC(core.locks);
+#else /* NETSTATS */
+  sys_mutex_lock(&lock_tcpip_core);
+#endif /* NETSTATS */
+}
+
+/** Unlock the lwIP core, see tcpip_core_lock() */
+void
+tcpip_core_unlock(void)
+{
+  sys_mutex_unlock(&lock_tcpip_core);
+}
 #endif /* LWIP_TCPIP_CORE_LOCKING */
 
 
@@ -86,6 +119,7 @@ tcpip_thread(void *arg)
     LWIP_TCPIP_THREAD_ALIVE();
     /* wait for a message, timeouts are processed while waiting */
     sys_timeouts_mbox_fetch(&mbox, (void **)&msg);
+    NETSTATS_TCPIP_FETCH();
     LOCK_TCPIP_CORE();
     switch (msg->type) {
 #if LWIP_NETCONN
@@ -181,7 +215,9 @@ tcpip_input(struct pbuf *p, struct netif *inp)
     msg->type = TCPIP_MSG_INPKT;
     msg->msg.inp.p = p;
     msg->msg.inp.netif = inp;
+    NETSTATS_TCPIP_POST();
     if (sys_mbox_trypost(&mbox, msg) != ERR_OK) {
+      NETSTATS_TCPIP_FULL(msg->type);
       memp_free(MEMP_TCPIP_MSG_INPKT, msg);
       return ERR_MEM;
     }
@@ -217,9 +253,12 @@ tcpip_callback_with_block(tcpip_callback_fn function, void *ctx, u8_t block)
     msg->msg.cb.function = function;
     msg->msg.cb.ctx = ctx;
     if (block) {
+      NETSTATS_TCPIP_POST();
       sys_mbox_post(&mbox, msg);
     } else {
+      NETSTATS_TCPIP_POST();
       if (sys_mbox_trypost(&mbox, msg) != ERR_OK) {
+        NETSTATS_TCPIP_FULL(msg->type);
         memp_free(MEMP_TCPIP_MSG_API, msg);
         return ERR_MEM;
       }
@@ -253,6 +292,7 @@ tcpip_timeout(u32_t msecs, sys_timeout_handler h, void *arg)
     msg->msg.tmo.msecs = msecs;
     msg->msg.tmo.h = h;
     msg->msg.tmo.arg = arg;
+    NETSTATS_TCPIP_POST();
     sys_mbox_post(&mbox, msg);
     return ERR_OK;
   }
@@ -281,6 +321,7 @@ tcpip_untimeout(sys_timeout_handler h, void *arg)
     msg->type = TCPIP_MSG_UNTIMEOUT;
     msg->msg.tmo.h = h;
     msg->msg.tmo.arg = arg;
+    NETSTATS_TCPIP_POST();
     sys_mbox_post(&mbox, msg);
     return ERR_OK;
   }
@@ -309,6 +350,7 @@ tcpip_apimsg(struct api_msg *apimsg)
   if (sys_mbox_valid(&mbox)) {
     msg.type = TCPIP_MSG_API;
     msg.msg.apimsg = apimsg;
+    NETSTATS_TCPIP_POST();
     sys_mbox_post(&mbox, &msg);
     sys_arch_sem_wait(&apimsg->msg.conn->op_completed, 0);
     return apimsg->msg.err;
@@ -365,6 +407,7 @@ tcpip_netifapi(struct netifapi_msg* netifapimsg)
     
     msg.type = TCPIP_MSG_NETIFAPI;
     msg.msg.netifapimsg = netifapimsg;
+    NETSTATS_TCPIP_POST();
     sys_mbox_post(&mbox, &msg);
     sys_sem_wait(&netifapimsg->msg.sem);
     sys_sem_free(&netifapimsg->msg.sem);
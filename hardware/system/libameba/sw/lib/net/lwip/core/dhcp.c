@@ -80,6 +80,7 @@
 #include "lwip/dhcp.h"
 #include "lwip/autoip.h"
 #include "lwip/dns.h"
+#include "lwip/netstats.h"
 #include "netif/etharp.h"
 
 #include <string.h>
@@ -167,6 +168,11 @@ static void dhcp_option_long(struct dhcp *dhcp, u32_t value);
 /* always add the DHCP options trailer to end and pad */
 static void dhcp_option_trailer(struct dhcp *dhcp);
 
+#if LWIP_DHCP_REBOOT_HINT
+/** address to ask for on the next dhcp_start(), zero if none */
+static ip_addr_t dhcp_reboot_hint;
+#endif /* LWIP_DHCP_REBOOT_HINT */
+
 /**
  * Back-off the DHCP client (because of a received NAK response).
  *
@@ -541,6 +547,12 @@ dhcp_handle_ack(struct netif *netif)
   /* (y)our internet address */
   ip_addr_copy(dhcp->offered_ip_addr, dhcp->msg_in->yiaddr);
 
+  /* server identifier, renewals are sent to it; after INIT-REBOOT there
+     was no offer to take it from */
+  if (dhcp_option_given(dhcp, DHCP_OPTION_IDX_SERVER_ID)) {
+    ip4_addr_set_u32(&dhcp->server_ip_addr, htonl(dhcp_get_option_value(dhcp, DHCP_OPTION_IDX_SERVER_ID)));
+  }
+
 #if LWIP_DHCP_BOOTP_FILE
   /* copy boot server address,
      boot file name copied in dhcp_parse_reply if not overloaded */
@@ -683,6 +695,15 @@ dhcp_start(struct netif *netif)
   /* set up the recv callback and argument */
   udp_recv(dhcp->pcb, dhcp_recv, netif);
   LWIP_DEBUGF(DHCP_DEBUG | LWIP_DBG_TRACE, ("dhcp_start(): starting DHCP configuration\n"));
+#if LWIP_DHCP_REBOOT_HINT
+  if (!ip_addr_isany(&dhcp_reboot_hint)) {
+    /* try to keep the remembered lease, dhcp_timeout() and
+       dhcp_handle_nak() fall back to discovery */
+    ip_addr_copy(dhcp->offered_ip_addr, dhcp_reboot_hint);
+    ip_addr_set_zero(&dhcp_reboot_hint);
+    result = dhcp_reboot(netif);
+  } else
+#endif /* LWIP_DHCP_REBOOT_HINT */
   /* (re)start the DHCP negotiation */
   result = dhcp_discover(netif);
   if (result != ERR_OK) {
@@ -695,6 +716,26 @@ dhcp_start(struct netif *netif)
   return result;
 }
 
+#if LWIP_DHCP_REBOOT_HINT
+/**
+ * Remember an address leased before a reset. The next dhcp_start() asks
+ * the server to confirm it (INIT-REBOOT, RFC 2131 3.2) instead of sending
+ * DISCOVER, which saves the offer round trip and the ARP check. The hint
+ * is used once; a NAK or no answer falls back to discovery.
+ *
+ * @param ipaddr the address to ask for, NULL to forget a previous hint
+ */
+void
+dhcp_set_reboot_hint(ip_addr_t *ipaddr)
+{
+  if (ipaddr != NULL) {
+    ip_addr_set(&dhcp_reboot_hint, ipaddr);
+  } else {
+    ip_addr_set_zero(&dhcp_reboot_hint);
+  }
+}
+#endif /* LWIP_DHCP_REBOOT_HINT */
+
 /**
  * Inform a DHCP server of our manual configuration.
  *
@@ -893,6 +934,7 @@ dhcp_discover(struct netif *netif)
     pbuf_realloc(dhcp->p_out, sizeof(struct dhcp_msg) - DHCP_OPTIONS_LEN + dhcp->options_out_len);
 
     LWIP_DEBUGF(DHCP_DEBUG | LWIP_DBG_TRACE, ("dhcp_discover: sendto(DISCOVER, IP_ADDR_BROADCAST, DHCP_SERVER_PORT)\n"));
+    NETSTATS_INC(dhcp.discover);
     udp_sendto_if(dhcp->pcb, dhcp->p_out, IP_ADDR_BROADCAST, DHCP_SERVER_PORT, netif);
     LWIP_DEBUGF(DHCP_DEBUG | LWIP_DBG_TRACE, ("dhcp_discover: deleting()ing\n"));
     dhcp_delete_msg(dhcp);
@@ -1150,10 +1192,17 @@ dhcp_reboot(struct netif *netif)
     dhcp_option(dhcp, DHCP_OPTION_REQUESTED_IP, 4);
     dhcp_option_long(dhcp, ntohl(ip4_addr_get_u32(&dhcp->offered_ip_addr)));
 
+    dhcp_option(dhcp, DHCP_OPTION_PARAMETER_REQUEST_LIST, 4/*num options*/);
+    dhcp_option_byte(dhcp, DHCP_OPTION_SUBNET_MASK);
+    dhcp_option_byte(dhcp, DHCP_OPTION_ROUTER);
+    dhcp_option_byte(dhcp, DHCP_OPTION_BROADCAST);
+    dhcp_option_byte(dhcp, DHCP_OPTION_DNS_SERVER);
+
     dhcp_option_trailer(dhcp);
 
     pbuf_realloc(dhcp->p_out, sizeof(struct dhcp_msg) - DHCP_OPTIONS_LEN + dhcp->options_out_len);
 
+    NETSTATS_INC(dhcp.reboot);
     /* broadcast to server */
     udp_sendto_if(dhcp->pcb, dhcp->p_out, IP_ADDR_BROADCAST, DHCP_SERVER_PORT, netif);
     dhcp_delete_msg(dhcp);
@@ -1588,6 +1637,12 @@ dhcp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t
     }
     /* already bound to the given lease address? */
     else if ((dhcp->state == DHCP_REBOOTING) || (dhcp->state == DHCP_REBINDING) || (dhcp->state == DHCP_RENEWING)) {
+      if (dhcp->state == DHCP_REBOOTING) {
+        NETSTATS_INC(dhcp.reboot_acked);
+      }
+      /* after a reset, mask, gateway and lease times are only known
+         from this ack */
+      dhcp_handle_ack(netif);
       dhcp_bind(netif);
     }
   }
@@ -1596,6 +1651,7 @@ dhcp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t
     ((dhcp->state == DHCP_REBOOTING) || (dhcp->state == DHCP_REQUESTING) ||
      (dhcp->state == DHCP_REBINDING) || (dhcp->state == DHCP_RENEWING  ))) {
     LWIP_DEBUGF(DHCP_DEBUG | LWIP_DBG_TRACE, ("DHCP_NAK received\n"));
+    NETSTATS_INC(dhcp.nak);
     dhcp_handle_nak(netif);
   }
   /* received a DHCP_OFFER in DHCP_SELECTING state? */
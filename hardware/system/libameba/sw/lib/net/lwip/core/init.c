@@ -102,6 +102,15 @@
 #if (LWIP_TCP && (TCP_WND > 0xffff))
   #error "If you want to use TCP, TCP_WND must fit in an u16_t, so, you have to reduce it in your lwipopts.h"
 #endif
+#if (LWIP_TCP && TCP_BUF_AUTOTUNE && ((TCP_WND_MAX >= 0xffff) || (TCP_SND_BUF_MAX >= 0xffff)))
+  #error "TCP_WND_MAX and TCP_SND_BUF_MAX must fit in an u16_t, so, you have to reduce them in your lwipopts.h"
+#endif
+#if (LWIP_TCP && TCP_BUF_AUTOTUNE && ((TCP_WND_MAX < TCP_WND) || (TCP_SND_BUF_MAX < TCP_SND_BUF)))
+  #error "TCP_WND_MAX and TCP_SND_BUF_MAX must not be smaller than TCP_WND and TCP_SND_BUF"
+#endif
+#if (LWIP_TCP && TCP_BUF_AUTOTUNE && (!MEM_STATS || !MEMP_STATS))
+  #error "TCP_BUF_AUTOTUNE sizes buffers from the heap and pool usage, so it needs MEM_STATS and MEMP_STATS"
+#endif
 #if (LWIP_TCP && (TCP_SND_QUEUELEN > 0xffff))
   #error "If you want to use TCP, TCP_SND_QUEUELEN must fit in an u16_t, so, you have to reduce it in your lwipopts.h"
 #endif
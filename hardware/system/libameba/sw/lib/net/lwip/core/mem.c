@@ -61,11 +61,89 @@
 #include "lwip/mem.h"
 #include "lwip/sys.h"
 #include "lwip/stats.h"
+#include "lwip/netstats.h"
 #include "lwip/err.h"
 
 #include <string.h>
 
-#if MEM_USE_POOLS
+#if MEM_HEAP_CAPS
+/* lwIP heap on the region heap, see heap_caps.h */
+
+#include "heap_caps.h"
+
+#if MEM_STATS
+/* The region heap does the counting: lwip_stats.mem shows the regions
+   mem_malloc() draws on, which the rest of the system shares, so that
+   tcp_buf_tune() sizes the buffers by what is really left. */
+static void
+mem_caps_stats(void)
+{
+  static int regions;
+  static mem_size_t avail;
+  heap_caps_stats_t stats;
+  mem_size_t used;
+  int i;
+
+  if (heap_caps_region_count() != regions) {
+    regions = heap_caps_region_count();
+    avail = 0;
+    for (i = 0; i < regions; i++) {
+      if (heap_caps_get_stats(i, &stats) == 0 &&
+          (stats.caps & MEM_HEAP_CAPS_FLAGS) == MEM_HEAP_CAPS_FLAGS) {
+        avail += stats.size;
+      }
+    }
+    MEM_STATS_AVAIL(avail, avail);
+  }
+  used = avail - heap_caps_get_free_size(MEM_HEAP_CAPS_FLAGS);
+  MEM_STATS_AVAIL(used, used);
+  if (used > lwip_stats.mem.max) {
+    MEM_STATS_AVAIL(max, used);
+  }
+}
+#else /* MEM_STATS */
+#define mem_caps_stats()
+#endif /* MEM_STATS */
+
+void
+mem_init(void)
+{
+  heap_caps_init();
+  mem_caps_stats();
+}
+
+void *
+mem_malloc(mem_size_t size)
+{
+  void *p = malloc_caps(size, MEM_HEAP_CAPS_FLAGS);
+
+  if (p == NULL) {
+    LWIP_DEBUGF(MEM_DEBUG | LWIP_DBG_LEVEL_SERIOUS, ("mem_malloc: could not allocate %"S16_F" bytes\n", (s16_t)size));
+    MEM_STATS_INC(err);
+    NETSTATS_TRACE_EVENT(NETSTATS_EV_MEM_ERR, (size > 0xffff) ? 0xffff : (u16_t)size);
+  }
+  mem_caps_stats();
+  return p;
+}
+
+void
+mem_free(void *rmem)
+{
+  free_caps(rmem);
+  mem_caps_stats();
+}
+
+/* realloc_caps() never moves a block it shrinks */
+void *
+mem_trim(void *rmem, mem_size_t newsize)
+{
+  void *p = realloc_caps(rmem, newsize, MEM_HEAP_CAPS_FLAGS);
+
+  mem_caps_stats();
+  return p;
+}
+
+#elif MEM_USE_POOLS
 /* lwIP head implemented with different sized pools */
 
 /**
@@ -614,6 +692,7 @@ mem_malloc(mem_size_t size)
 #endif /* LWIP_ALLOW_MEM_FREE_FROM_OTHER_CONTEXT */
   LWIP_DEBUGF(MEM_DEBUG | LWIP_DBG_LEVEL_SERIOUS, ("mem_malloc: could not allocate %"S16_F" bytes\n", (s16_t)size));
   MEM_STATS_INC(err);
+  NETSTATS_TRACE_EVENT(NETSTATS_EV_MEM_ERR, (size > 0xffff) ? 0xffff : (u16_t)size);
   LWIP_MEM_ALLOC_UNPROTECT();
   sys_mutex_unlock(&mem_mutex);
   return NULL;
@@ -52,6 +52,7 @@
 #include "lwip/sys.h"
 #include "lwip/timers.h"
 #include "lwip/stats.h"
+#include "lwip/netstats.h"
 #include "netif/etharp.h"
 #include "lwip/ip_frag.h"
 #include "lwip/snmp_structs.h"
@@ -423,6 +424,7 @@ memp_malloc_fn(memp_t type, const char* file, const int line)
   } else {
     LWIP_DEBUGF(MEMP_DEBUG | LWIP_DBG_LEVEL_SERIOUS, ("memp_malloc: out of memory in pool %s\n", memp_desc[type]));
     MEMP_STATS_INC(err, type);
+    NETSTATS_TRACE_EVENT(NETSTATS_EV_MEMP_ERR, type);
   }
 
   SYS_ARCH_UNPROTECT(old_level);
@@ -166,6 +166,9 @@ netif_add(struct netif *netif, ip_addr_t *ipaddr, ip_addr_t *netmask,
 #if ENABLE_LOOPBACK
   netif->loop_first = NULL;
   netif->loop_last = NULL;
+#if LWIP_NETIF_LOOPBACK_MULTITHREADING
+  netif->loop_poll_pending = 0;
+#endif /* LWIP_NETIF_LOOPBACK_MULTITHREADING */
 #endif /* ENABLE_LOOPBACK */
 
   /* remember netif specific state information data */
@@ -600,6 +603,9 @@ netif_loop_output(struct netif *netif, struct pbuf *p,
 #if LWIP_LOOPBACK_MAX_PBUFS
   u8_t clen = 0;
 #endif /* LWIP_LOOPBACK_MAX_PBUFS */
+#if LWIP_NETIF_LOOPBACK_MULTITHREADING
+  u8_t schedule_poll = 0;
+#endif /* LWIP_NETIF_LOOPBACK_MULTITHREADING */
   /* If we have a loopif, SNMP counters are adjusted for it,
    * if not they are adjusted for 'netif'. */
 #if LWIP_SNMP
@@ -658,6 +664,11 @@ netif_loop_output(struct netif *netif, struct pbuf *p,
     netif->loop_first = r;
     netif->loop_last = last;
   }
+#if LWIP_NETIF_LOOPBACK_MULTITHREADING
+  /* netif_poll() empties the list before it clears loop_poll_pending */
+  schedule_poll = !netif->loop_poll_pending;
+  netif->loop_poll_pending = 1;
+#endif /* LWIP_NETIF_LOOPBACK_MULTITHREADING */
   SYS_ARCH_UNPROTECT(lev);
 
   LINK_STATS_INC(link.xmit);
@@ -665,8 +676,17 @@ netif_loop_output(struct netif *netif, struct pbuf *p,
   snmp_inc_ifoutucastpkts(stats_if);
 
 #if LWIP_NETIF_LOOPBACK_MULTITHREADING
-  /* For multithreading environment, schedule a call to netif_poll */
-  tcpip_callback((tcpip_callback_fn)netif_poll, netif);
+  /* For multithreading environment, schedule a call to netif_poll, unless
+     one is already scheduled or running. One call per packet could empty
+     MEMP_TCPIP_MSG_API under a burst, and a packet whose call failed stayed
+     on the list with no call to come. If this call fails, the next packet
+     tries again. */
+  if (schedule_poll &&
+      tcpip_callback((tcpip_callback_fn)netif_poll, netif) != ERR_OK) {
+    SYS_ARCH_PROTECT(lev);
+    netif->loop_poll_pending = 0;
+    SYS_ARCH_UNPROTECT(lev);
+  }
 #endif /* LWIP_NETIF_LOOPBACK_MULTITHREADING */
 
   return ERR_OK;
@@ -682,6 +702,7 @@ void
 netif_poll(struct netif *netif)
 {
   struct pbuf *in;
+  u8_t more;
   /* If we have a loopif, SNMP counters are adjusted for it,
    * if not they are adjusted for 'netif'. */
 #if LWIP_SNMP
@@ -722,6 +743,13 @@ netif_poll(struct netif *netif)
       /* De-queue the pbuf from its successors on the 'loop_' list. */
       in_end->next = NULL;
     }
+#if LWIP_NETIF_LOOPBACK_MULTITHREADING
+    else {
+      /* The list is empty: the next packet schedules a new call */
+      netif->loop_poll_pending = 0;
+    }
+#endif /* LWIP_NETIF_LOOPBACK_MULTITHREADING */
+    more = (in != NULL);
     SYS_ARCH_UNPROTECT(lev);
 
     if (in != NULL) {
@@ -735,8 +763,8 @@ netif_poll(struct netif *netif)
       /* Don't reference the packet any more! */
       in = NULL;
     }
-  /* go on while there is a packet on the list */
-  } while (netif->loop_first != NULL);
+  /* go on until the list was found empty */
+  } while (more);
 }
 
 #if !LWIP_NETIF_LOOPBACK_MULTITHREADING
@@ -0,0 +1,60 @@
+/**
+ * @file
+ * Runtime network counters and event trace, see lwip/netstats.h
+ *
+ */
+
+#include "lwip/opt.h"
+#include "lwip/netstats.h"
+
+#if NETSTATS /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/sys.h"
+
+struct netstats_ netstats;
+
+#if NETSTATS_TRACE
+
+#if (NETSTATS_TRACE_SIZE & (NETSTATS_TRACE_SIZE - 1)) != 0
+#error "NETSTATS_TRACE_SIZE must be a power of two"
+#endif
+
+static struct netstats_event netstats_ring[NETSTATS_TRACE_SIZE];
+/* Total number of events ever recorded; the slot is head % size */
+static volatile u32_t netstats_head;
+
+/**
+ * Record an event. Safe from any thread or interrupt: each writer claims
+ * its own slot with an atomic increment, so no lock is taken.
+ */
+void
+netstats_trace(u16_t type, u16_t arg)
+{
+  u32_t i = __sync_fetch_and_add(&netstats_head, 1);
+  struct netstats_event *ev = &netstats_ring[i & (NETSTATS_TRACE_SIZE - 1)];
+
+  ev->time = sys_now();
+  ev->type = type;
+  ev->arg  = arg;
+}
+
+int
+netstats_trace_read(u32_t *cursor, struct netstats_event *ev)
+{
+  u32_t head = netstats_head;
+
+  if (*cursor == head) {
+    return 0;
+  }
+  /* the writers lapped this reader, skip what was overwritten */
+  if ((head - *cursor) > NETSTATS_TRACE_SIZE) {
+    *cursor = head - NETSTATS_TRACE_SIZE;
+  }
+  *ev = netstats_ring[*cursor & (NETSTATS_TRACE_SIZE - 1)];
+  (*cursor)++;
+  return 1;
+}
+
+#endif /* NETSTATS_TRACE */
+
+#endif /* NETSTATS */
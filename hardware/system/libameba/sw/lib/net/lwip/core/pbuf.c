@@ -69,6 +69,7 @@
 #include "lwip/memp.h"
 #include "lwip/pbuf.h"
 #include "lwip/sys.h"
+#include "lwip/netstats.h"
 #include "arch/perf.h"
 #if TCP_QUEUE_OOSEQ
 #include "lwip/tcp_impl.h"
@@ -108,6 +109,9 @@ static void
 pbuf_free_ooseq(void* arg)
 {
   struct tcp_pcb* pcb;
+  struct tcp_pcb* victim = NULL;
+  struct tcp_seg* seg;
+  u16_t clen, victim_clen = 0;
   SYS_ARCH_DECL_PROTECT(old_level);
   LWIP_UNUSED_ARG(arg);
 
@@ -115,15 +119,40 @@ pbuf_free_ooseq(void* arg)
   pbuf_free_ooseq_queued = 0;
   SYS_ARCH_UNPROTECT(old_level);
 
+  /* Reclaim from the PCB holding the most pbufs */
   for (pcb = tcp_active_pcbs; NULL != pcb; pcb = pcb->next) {
-    if (NULL != pcb->ooseq) {
-      /** Free the ooseq pbufs of one PCB only */
-      LWIP_DEBUGF(PBUF_DEBUG | LWIP_DBG_TRACE, ("pbuf_free_ooseq: freeing out-of-sequence pbufs\n"));
-      tcp_segs_free(pcb->ooseq);
-      pcb->ooseq = NULL;
-      return;
+    clen = 0;
+    for (seg = pcb->ooseq; seg != NULL; seg = seg->next) {
+      clen += pbuf_clen(seg->p);
+    }
+    if (clen > victim_clen) {
+      victim = pcb;
+      victim_clen = clen;
+    }
+  }
+  if (victim == NULL) {
+    return;
+  }
+
+  LWIP_DEBUGF(PBUF_DEBUG | LWIP_DBG_TRACE, ("pbuf_free_ooseq: freeing out-of-sequence pbufs\n"));
+  /** Keep the segment next to rcv_nxt if there is more than one, it is the
+      first one delivered once the missing data comes in */
+  if (victim->ooseq->next != NULL) {
+    seg = victim->ooseq->next;
+    victim->ooseq->next = NULL;
+  } else {
+    seg = victim->ooseq;
+    victim->ooseq = NULL;
+  }
+#if NETSTATS
+  {
+    struct tcp_seg* s;
+    for (s = seg; s != NULL; s = s->next) {
+      NETSTATS_INC(tcp.ooseq_evicted);
     }
   }
+#endif /* NETSTATS */
+  tcp_segs_free(seg);
 }
 
 /** Queue a call to pbuf_free_ooseq if not already queued. */
@@ -100,6 +100,9 @@ struct tcp_pcb *tcp_tmp_pcb;
 /** Timer counter to handle calling slow-timer from tcp_tmr() */ 
 static u8_t tcp_timer;
 static u16_t tcp_new_port(void);
+#if TCP_BUF_AUTOTUNE
+static void tcp_buf_tune(void);
+#endif /* TCP_BUF_AUTOTUNE */
 
 /**
  * Called periodically to dispatch TCP timers.
@@ -115,6 +118,9 @@ tcp_tmr(void)
     /* Call tcp_tmr() every 500 ms, i.e., every other timer
        tcp_tmr() is called. */
     tcp_slowtmr();
+#if TCP_BUF_AUTOTUNE
+    tcp_buf_tune();
+#endif /* TCP_BUF_AUTOTUNE */
   }
 }
 
@@ -140,7 +146,7 @@ tcp_close_shutdown(struct tcp_pcb *pcb, u8_t rst_on_unacked_data)
   err_t err;
 
   if (rst_on_unacked_data && (pcb->state != LISTEN)) {
-    if ((pcb->refused_data != NULL) || (pcb->rcv_wnd != TCP_WND)) {
+    if ((pcb->refused_data != NULL) || (pcb->rcv_wnd != tcp_rcv_wnd_max(pcb))) {
       /* Not all data received by application, send RST to tell the remote
          side about this. */
       LWIP_ASSERT("pcb->flags & TF_RXCLOSED", pcb->flags & TF_RXCLOSED);
@@ -544,7 +550,7 @@ u32_t tcp_update_rcv_ann_wnd(struct tcp_pcb *pcb)
 {
   u32_t new_right_edge = pcb->rcv_nxt + pcb->rcv_wnd;
 
-  if (TCP_SEQ_GEQ(new_right_edge, pcb->rcv_ann_right_edge + LWIP_MIN((TCP_WND / 2), pcb->mss))) {
+  if (TCP_SEQ_GEQ(new_right_edge, pcb->rcv_ann_right_edge + LWIP_MIN((tcp_rcv_wnd_max(pcb) / 2), pcb->mss))) {
     /* we can advertise more window */
     pcb->rcv_ann_wnd = pcb->rcv_wnd;
     return new_right_edge - pcb->rcv_ann_right_edge;
@@ -580,8 +586,8 @@ tcp_recved(struct tcp_pcb *pcb, u16_t len)
               len <= 0xffff - pcb->rcv_wnd );
 
   pcb->rcv_wnd += len;
-  if (pcb->rcv_wnd > TCP_WND) {
-    pcb->rcv_wnd = TCP_WND;
+  if (pcb->rcv_wnd > tcp_rcv_wnd_max(pcb)) {
+    pcb->rcv_wnd = tcp_rcv_wnd_max(pcb);
   }
 
   wnd_inflation = tcp_update_rcv_ann_wnd(pcb);
@@ -596,8 +602,196 @@ tcp_recved(struct tcp_pcb *pcb, u16_t len)
   }
 
   LWIP_DEBUGF(TCP_DEBUG, ("tcp_recved: recveived %"U16_F" bytes, wnd %"U16_F" (%"U16_F").\n",
-         len, pcb->rcv_wnd, TCP_WND - pcb->rcv_wnd));
+         len, pcb->rcv_wnd, tcp_rcv_wnd_max(pcb) - pcb->rcv_wnd));
+}
+
+#if TCP_BUF_AUTOTUNE
+/**
+ * Resize the receive window of a pcb, rcv_wnd staying the part not in use.
+ * The right edge already announced to the remote side must not move back,
+ * so a shrink only takes what is free beyond it; the rest is left for a
+ * later call.
+ */
+static void
+tcp_resize_rcv_wnd(struct tcp_pcb *pcb, u16_t size)
+{
+  u32_t announced = 0;
+  u16_t cut;
+
+  if (size >= pcb->rcv_wnd_max) {
+    pcb->rcv_wnd += size - pcb->rcv_wnd_max;
+  } else {
+    if (TCP_SEQ_GT(pcb->rcv_ann_right_edge, pcb->rcv_nxt)) {
+      announced = pcb->rcv_ann_right_edge - pcb->rcv_nxt;
+    }
+    cut = pcb->rcv_wnd_max - size;
+    if ((u32_t)pcb->rcv_wnd < announced + cut) {
+      cut = (pcb->rcv_wnd > announced) ? (u16_t)(pcb->rcv_wnd - announced) : 0;
+    }
+    pcb->rcv_wnd -= cut;
+    size = pcb->rcv_wnd_max - cut;
+  }
+  pcb->rcv_wnd_max = size;
+
+  if ((pcb->state >= ESTABLISHED) &&
+      (tcp_update_rcv_ann_wnd(pcb) >= TCP_WND_UPDATE_THRESHOLD)) {
+    tcp_ack_now(pcb);
+    tcp_output(pcb);
+  }
+}
+
+/**
+ * Resize the send buffer of a pcb, snd_buf staying the part not in use.
+ * A shrink only takes what is free now; the rest is left for a later call,
+ * once queued data has been acked.
+ */
+static void
+tcp_resize_snd_buf(struct tcp_pcb *pcb, u16_t size)
+{
+  u16_t cut;
+
+  if (size >= pcb->snd_buf_max) {
+    pcb->snd_buf += size - pcb->snd_buf_max;
+  } else {
+    cut = LWIP_MIN(pcb->snd_buf_max - size, pcb->snd_buf);
+    pcb->snd_buf -= cut;
+    size = pcb->snd_buf_max - cut;
+  }
+  pcb->snd_buf_max = size;
+}
+
+/**
+ * Fix the receive window of a pcb, which tcp_buf_tune() then leaves alone.
+ *
+ * @param pcb the tcp_pcb to change (not a listening one)
+ * @param size window in bytes, clamped to [TCP_MSS, TCP_WND_MAX];
+ *        0 hands the window back to tcp_buf_tune()
+ */
+void
+tcp_set_rcv_wnd(struct tcp_pcb *pcb, u16_t size)
+{
+  LWIP_ASSERT("tcp_set_rcv_wnd: not for listen-pcbs", pcb->state != LISTEN);
+
+  if (size == 0) {
+    pcb->tune_flags &= ~TCP_BUF_LOCK_RCV;
+    return;
+  }
+  pcb->tune_flags |= TCP_BUF_LOCK_RCV;
+  tcp_resize_rcv_wnd(pcb, LWIP_MIN(LWIP_MAX(size, TCP_MSS), TCP_WND_MAX));
+}
+
+/**
+ * Fix the send buffer of a pcb, which tcp_buf_tune() then leaves alone.
+ *
+ * @param pcb the tcp_pcb to change (not a listening one)
+ * @param size buffer in bytes, clamped to [TCP_MSS, TCP_SND_BUF_MAX];
+ *        0 hands the buffer back to tcp_buf_tune()
+ */
+void
+tcp_set_snd_buf(struct tcp_pcb *pcb, u16_t size)
+{
+  LWIP_ASSERT("tcp_set_snd_buf: not for listen-pcbs", pcb->state != LISTEN);
+
+  if (size == 0) {
+    pcb->tune_flags &= ~TCP_BUF_LOCK_SND;
+    return;
+  }
+  pcb->tune_flags |= TCP_BUF_LOCK_SND;
+  tcp_resize_snd_buf(pcb, LWIP_MIN(LWIP_MAX(size, TCP_MSS), TCP_SND_BUF_MAX));
+}
+
+/**
+ * Called every TCP_SLOW_INTERVAL to size the windows and send buffers of
+ * the established pcbs.
+ *
+ * A window grows when the remote side filled it over the last round trip
+ * while the application kept reading; a send buffer grows when the
+ * application keeps it full and the network takes more than it holds
+ * (twice the usable congestion window). Each step at most doubles the
+ * size, and takes at most an equal share of the heap above
+ * TCP_BUF_MEM_RESERVE and of the free pool pbufs or segments. Once the
+ * heap or PBUF_POOL runs low, every size not fixed by the application is
+ * halved back towards TCP_WND and TCP_SND_BUF.
+ */
+static void
+tcp_buf_tune(void)
+{
+  struct tcp_pcb *pcb;
+  u32_t heap, pool, segs, rtt, rcvd, acked, want, size;
+  u32_t rcv_share, snd_share, rcv_cap, snd_cap;
+  u16_t n = 0;
+  u8_t low;
+
+  for (pcb = tcp_active_pcbs; pcb != NULL; pcb = pcb->next) {
+    if ((pcb->state == ESTABLISHED) || (pcb->state == CLOSE_WAIT)) {
+      n++;
+    }
+  }
+  if (n == 0) {
+    return;
+  }
+
+  heap = lwip_stats.mem.avail - lwip_stats.mem.used;
+  pool = lwip_stats.memp[MEMP_PBUF_POOL].avail - lwip_stats.memp[MEMP_PBUF_POOL].used;
+  segs = lwip_stats.memp[MEMP_TCP_SEG].avail - lwip_stats.memp[MEMP_TCP_SEG].used;
+  low = (heap < TCP_BUF_MEM_RESERVE) || (pool < PBUF_POOL_SIZE / 4);
+  heap = (heap > TCP_BUF_MEM_RESERVE) ? heap - TCP_BUF_MEM_RESERVE : 0;
+
+  rcv_share = LWIP_MIN(heap, pool * PBUF_POOL_BUFSIZE) / n;
+  snd_share = LWIP_MIN(heap, segs * TCP_MSS) / n;
+  /* what the pools can hold when every connection is full */
+  rcv_cap = LWIP_MIN(TCP_WND_MAX, (PBUF_POOL_SIZE * PBUF_POOL_BUFSIZE) / n);
+  snd_cap = LWIP_MIN(TCP_SND_BUF_MAX, (MEMP_NUM_TCP_SEG * TCP_MSS) / n);
+
+  for (pcb = tcp_active_pcbs; pcb != NULL; pcb = pcb->next) {
+    if ((pcb->state != ESTABLISHED) && (pcb->state != CLOSE_WAIT)) {
+      continue;
+    }
+    rcvd = pcb->rcv_nxt - pcb->tune_rcv_nxt;
+    acked = pcb->lastack - pcb->tune_lastack;
+    pcb->tune_rcv_nxt = pcb->rcv_nxt;
+    pcb->tune_lastack = pcb->lastack;
+    if (!(pcb->tune_flags & TCP_BUF_STARTED)) {
+      /* nothing to compare with yet */
+      pcb->tune_flags |= TCP_BUF_STARTED;
+      continue;
+    }
+    /* sa holds 8 * srtt in ticks; a LAN round trip rounds to 0 */
+    rtt = (u32_t)LWIP_MAX(pcb->sa >> 3, 1);
+
+    if (!(pcb->tune_flags & TCP_BUF_LOCK_RCV)) {
+      size = pcb->rcv_wnd_max;
+      if (low) {
+        size = LWIP_MAX(size / 2, TCP_WND);
+      } else if ((rcvd * rtt >= pcb->rcv_wnd_max) &&
+                 (pcb->rcv_wnd >= pcb->rcv_wnd_max / 2)) {
+        size = LWIP_MIN(size + LWIP_MIN(size, rcv_share), LWIP_MAX(rcv_cap, TCP_WND));
+      }
+      if (size != pcb->rcv_wnd_max) {
+        LWIP_DEBUGF(TCP_WND_DEBUG, ("tcp_buf_tune: rcv_wnd_max %"U16_F" -> %"U32_F"\n",
+                                    pcb->rcv_wnd_max, size));
+        tcp_resize_rcv_wnd(pcb, (u16_t)size);
+      }
+    }
+
+    if (!(pcb->tune_flags & TCP_BUF_LOCK_SND)) {
+      size = pcb->snd_buf_max;
+      want = 2 * (u32_t)LWIP_MIN(pcb->cwnd, pcb->snd_wnd);
+      if (low) {
+        size = LWIP_MAX(size / 2, TCP_SND_BUF);
+      } else if ((acked > 0) && (pcb->snd_buf < tcp_sndlowat(pcb)) && (want > size)) {
+        size = LWIP_MIN(size + LWIP_MIN(LWIP_MIN(size, want - size), snd_share),
+                        LWIP_MAX(snd_cap, TCP_SND_BUF));
+      }
+      if (size != pcb->snd_buf_max) {
+        LWIP_DEBUGF(TCP_WND_DEBUG, ("tcp_buf_tune: snd_buf_max %"U16_F" -> %"U32_F"\n",
+                                    pcb->snd_buf_max, size));
+        tcp_resize_snd_buf(pcb, (u16_t)size);
+      }
+    }
+  }
 }
+#endif /* TCP_BUF_AUTOTUNE */
 
 /**
  * A nastly hack featuring 'goto' statements that allocates a
@@ -705,8 +899,8 @@ tcp_connect(struct tcp_pcb *pcb, ip_addr_t *ipaddr, u16_t port,
   pcb->snd_nxt = iss;
   pcb->lastack = iss - 1;
   pcb->snd_lbb = iss - 1;
-  pcb->rcv_wnd = TCP_WND;
-  pcb->rcv_ann_wnd = TCP_WND;
+  pcb->rcv_wnd = tcp_rcv_wnd_max(pcb);
+  pcb->rcv_ann_wnd = tcp_rcv_wnd_max(pcb);
   pcb->rcv_ann_right_edge = pcb->rcv_nxt;
   pcb->snd_wnd = TCP_WND;
   /* As initial send MSS, we use TCP_MSS but limit it to 536.
@@ -1208,6 +1402,10 @@ tcp_alloc(u8_t prio)
   if (pcb != NULL) {
     memset(pcb, 0, sizeof(struct tcp_pcb));
     pcb->prio = prio;
+#if TCP_BUF_AUTOTUNE
+    pcb->snd_buf_max = TCP_SND_BUF;
+    pcb->rcv_wnd_max = TCP_WND;
+#endif /* TCP_BUF_AUTOTUNE */
     pcb->snd_buf = TCP_SND_BUF;
     pcb->snd_queuelen = 0;
     pcb->rcv_wnd = TCP_WND;
@@ -54,6 +54,7 @@
 #include "lwip/inet_chksum.h"
 #include "lwip/stats.h"
 #include "lwip/snmp.h"
+#include "lwip/netstats.h"
 #include "arch/perf.h"
 
 /* These variables are global to all functions involved in the input
@@ -376,7 +377,7 @@ tcp_input(struct pbuf *p, struct netif *inp)
         if (recv_flags & TF_GOT_FIN) {
           /* correct rcv_wnd as the application won't call tcp_recved()
              for the FIN's seqno */
-          if (pcb->rcv_wnd != TCP_WND) {
+          if (pcb->rcv_wnd != tcp_rcv_wnd_max(pcb)) {
             pcb->rcv_wnd++;
           }
           TCP_EVENT_CLOSED(pcb, err);
@@ -826,6 +827,83 @@ tcp_oos_insert_segment(struct tcp_seg *cseg, struct tcp_seg *next)
   }
   cseg->next = next;
 }
+
+#define TCP_OOSEQ_LIMIT(max) ((max) > 0 ? (u32_t)(max) : 0xffffffffUL)
+
+/**
+ * Trim pcb->ooseq to TCP_OOSEQ_MAX_BYTES/TCP_OOSEQ_MAX_PBUFS, scaled with
+ * the window under TCP_BUF_AUTOTUNE, and to what the other pcbs leave of TCP_OOSEQ_TOTAL_BYTES/TCP_OOSEQ_TOTAL_PBUFS. Segments
+ * are dropped from the tail: those next to rcv_nxt are the ones that are
+ * delivered as soon as the hole is filled.
+ *
+ * Called from tcp_receive()
+ */
+static void
+tcp_ooseq_limit(struct tcp_pcb *pcb)
+{
+  struct tcp_pcb *other;
+  struct tcp_seg *seg, *prev;
+  u32_t max_bytes = TCP_OOSEQ_LIMIT(TCP_OOSEQ_MAX_BYTES);
+  u32_t max_pbufs = TCP_OOSEQ_LIMIT(TCP_OOSEQ_MAX_PBUFS);
+  u32_t bytes = 0, pbufs = 0;
+
+#if TCP_BUF_AUTOTUNE
+  /* the per-pcb budgets are for a window of TCP_WND: scale them with the
+     window tcp_buf_tune() gave this pcb */
+#if TCP_OOSEQ_MAX_BYTES
+  max_bytes = (u32_t)TCP_OOSEQ_MAX_BYTES * tcp_rcv_wnd_max(pcb) / TCP_WND;
+#endif
+#if TCP_OOSEQ_MAX_PBUFS
+  max_pbufs = (u32_t)TCP_OOSEQ_MAX_PBUFS * tcp_rcv_wnd_max(pcb) / TCP_WND;
+#endif
+#endif /* TCP_BUF_AUTOTUNE */
+
+#if TCP_OOSEQ_TOTAL_BYTES || TCP_OOSEQ_TOTAL_PBUFS
+  u32_t used_bytes = 0, used_pbufs = 0;
+
+  for (other = tcp_active_pcbs; other != NULL; other = other->next) {
+    if (other != pcb) {
+      for (seg = other->ooseq; seg != NULL; seg = seg->next) {
+        used_bytes += seg->p->tot_len;
+        used_pbufs += pbuf_clen(seg->p);
+      }
+    }
+  }
+  if (used_bytes >= TCP_OOSEQ_LIMIT(TCP_OOSEQ_TOTAL_BYTES)) {
+    max_bytes = 0;
+  } else {
+    max_bytes = LWIP_MIN(max_bytes, TCP_OOSEQ_LIMIT(TCP_OOSEQ_TOTAL_BYTES) - used_bytes);
+  }
+  if (used_pbufs >= TCP_OOSEQ_LIMIT(TCP_OOSEQ_TOTAL_PBUFS)) {
+    max_pbufs = 0;
+  } else {
+    max_pbufs = LWIP_MIN(max_pbufs, TCP_OOSEQ_LIMIT(TCP_OOSEQ_TOTAL_PBUFS) - used_pbufs);
+  }
+#else
+  LWIP_UNUSED_ARG(other);
+#endif /* TCP_OOSEQ_TOTAL_BYTES || TCP_OOSEQ_TOTAL_PBUFS */
+
+  prev = NULL;
+  for (seg = pcb->ooseq; seg != NULL; seg = seg->next) {
+    bytes += seg->p->tot_len;
+    pbufs += pbuf_clen(seg->p);
+    if (bytes > max_bytes || pbufs > max_pbufs) {
+      LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_receive: ooseq over budget, dropping from seqno %"U32_F"\n",
+                                    seg->tcphdr->seqno));
+      if (prev != NULL) {
+        prev->next = NULL;
+      } else {
+        pcb->ooseq = NULL;
+      }
+      for (prev = seg; prev != NULL; prev = prev->next) {
+        NETSTATS_INC(tcp.ooseq_dropped);
+      }
+      tcp_segs_free(seg);
+      return;
+    }
+    prev = seg;
+  }
+}
 #endif /* TCP_QUEUE_OOSEQ */
 
 /**
@@ -1340,6 +1418,7 @@ tcp_receive(struct tcp_pcb *pcb)
         /* We get here if the incoming segment is out-of-sequence. */
         tcp_send_empty_ack(pcb);
 #if TCP_QUEUE_OOSEQ
+        NETSTATS_INC(tcp.ooseq_rcvd);
         /* We queue the segment on the ->ooseq queue. */
         if (pcb->ooseq == NULL) {
           pcb->ooseq = tcp_seg_copy(&inseg);
@@ -1460,6 +1539,7 @@ tcp_receive(struct tcp_pcb *pcb)
             prev = next;
           }
         }
+        tcp_ooseq_limit(pcb);
 #endif /* TCP_QUEUE_OOSEQ */
 
       }
@@ -51,6 +51,7 @@
 #include "lwip/netif.h"
 #include "lwip/inet_chksum.h"
 #include "lwip/stats.h"
+#include "lwip/netstats.h"
 #include "lwip/snmp.h"
 
 #include <string.h>
@@ -314,9 +315,9 @@ tcp_write_checks(struct tcp_pcb *pcb, u16_t len)
   /* If total number of pbufs on the unsent/unacked queues exceeds the
    * configured maximum, return an error */
   /* check for configured max queuelen and possible overflow */
-  if ((pcb->snd_queuelen >= TCP_SND_QUEUELEN) || (pcb->snd_queuelen > TCP_SNDQUEUELEN_OVERFLOW)) {
+  if ((pcb->snd_queuelen >= tcp_sndqueuelen_max(pcb)) || (pcb->snd_queuelen > TCP_SNDQUEUELEN_OVERFLOW)) {
     LWIP_DEBUGF(TCP_OUTPUT_DEBUG | 3, ("tcp_write: too long queue %"U16_F" (max %"U16_F")\n",
-      pcb->snd_queuelen, TCP_SND_QUEUELEN));
+      pcb->snd_queuelen, tcp_sndqueuelen_max(pcb)));
     TCP_STATS_INC(tcp.memerr);
     pcb->flags |= TF_NAGLEMEMERR;
     return ERR_MEM;
@@ -572,8 +573,8 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
     /* Now that there are more segments queued, we check again if the
      * length of the queue exceeds the configured maximum or
      * overflows. */
-    if ((queuelen > TCP_SND_QUEUELEN) || (queuelen > TCP_SNDQUEUELEN_OVERFLOW)) {
-      LWIP_DEBUGF(TCP_OUTPUT_DEBUG | 2, ("tcp_write: queue too long %"U16_F" (%"U16_F")\n", queuelen, TCP_SND_QUEUELEN));
+    if ((queuelen > tcp_sndqueuelen_max(pcb)) || (queuelen > TCP_SNDQUEUELEN_OVERFLOW)) {
+      LWIP_DEBUGF(TCP_OUTPUT_DEBUG | 2, ("tcp_write: queue too long %"U16_F" (%"U16_F")\n", queuelen, tcp_sndqueuelen_max(pcb)));
       pbuf_free(p);
       goto memerr;
     }
@@ -728,9 +729,9 @@ tcp_enqueue_flags(struct tcp_pcb *pcb, u8_t flags)
               (flags & (TCP_SYN | TCP_FIN)) != 0);
 
   /* check for configured max queuelen and possible overflow */
-  if ((pcb->snd_queuelen >= TCP_SND_QUEUELEN) || (pcb->snd_queuelen > TCP_SNDQUEUELEN_OVERFLOW)) {
+  if ((pcb->snd_queuelen >= tcp_sndqueuelen_max(pcb)) || (pcb->snd_queuelen > TCP_SNDQUEUELEN_OVERFLOW)) {
     LWIP_DEBUGF(TCP_OUTPUT_DEBUG | 3, ("tcp_enqueue_flags: too long queue %"U16_F" (max %"U16_F")\n",
-                                       pcb->snd_queuelen, TCP_SND_QUEUELEN));
+                                       pcb->snd_queuelen, tcp_sndqueuelen_max(pcb)));
     TCP_STATS_INC(tcp.memerr);
     pcb->flags |= TF_NAGLEMEMERR;
     return ERR_MEM;
@@ -1250,6 +1251,9 @@ tcp_rexmit_rto(struct tcp_pcb *pcb)
 
   /* increment number of retransmissions */
   ++pcb->nrtx;
+  NETSTATS_PCB_REXMIT(pcb);
+  NETSTATS_INC(tcp.rexmit_rto);
+  NETSTATS_TRACE_EVENT(NETSTATS_EV_TCP_REXMIT, 0);
 
   /* Don't take any RTT measurements after retransmitting. */
   pcb->rttest = 0;
@@ -1289,6 +1293,9 @@ tcp_rexmit(struct tcp_pcb *pcb)
   *cur_seg = seg;
 
   ++pcb->nrtx;
+  NETSTATS_PCB_REXMIT(pcb);
+  NETSTATS_INC(tcp.rexmit_fast);
+  NETSTATS_TRACE_EVENT(NETSTATS_EV_TCP_REXMIT, 1);
 
   /* Don't take any rtt measurements after retransmitting. */
   pcb->rttest = 0;
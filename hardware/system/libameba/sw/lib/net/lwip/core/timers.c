@@ -68,6 +68,14 @@ static u32_t timeouts_last_time;
 /** global variable that shows if the tcp timer is currently scheduled or not */
 static int tcpip_tcp_timer_active;
 
+/* With LWIP_TCPIP_CORE_LOCKING, TCP_REG also runs in the threads that make
+   socket calls. tcpip_thread walks the timeout list outside the core lock,
+   and sleeps until the first timeout it saw: a timer started from another
+   thread could corrupt the list, or not run until a message wakes
+   tcpip_thread, and delayed ACKs and retransmissions would wait with it.
+   So the TCP timer starts in sys_timeouts_init() and never stops. */
+#define TCP_TIMER_ALWAYS            LWIP_TCPIP_CORE_LOCKING
+
 /**
  * Timer callback function that calls tcp_tmr() and reschedules itself.
  *
@@ -81,7 +89,7 @@ tcpip_tcp_timer(void *arg)
   /* call TCP timer handler */
   tcp_tmr();
   /* timer still needed? */
-  if (tcp_active_pcbs || tcp_tw_pcbs) {
+  if (tcp_active_pcbs || tcp_tw_pcbs || TCP_TIMER_ALWAYS) {
     /* restart timer */
     sys_timeout(TCP_TMR_INTERVAL, tcpip_tcp_timer, NULL);
   } else {
@@ -99,7 +107,7 @@ void
 tcp_timer_needed(void)
 {
   /* timer is off but needed again? */
-  if (!tcpip_tcp_timer_active && (tcp_active_pcbs || tcp_tw_pcbs)) {
+  if (!TCP_TIMER_ALWAYS && !tcpip_tcp_timer_active && (tcp_active_pcbs || tcp_tw_pcbs)) {
     /* enable and start timer */
     tcpip_tcp_timer_active = 1;
     sys_timeout(TCP_TMR_INTERVAL, tcpip_tcp_timer, NULL);
@@ -220,6 +228,10 @@ dns_timer(void *arg)
 /** Initialize this module */
 void sys_timeouts_init(void)
 {
+#if LWIP_TCP && TCP_TIMER_ALWAYS
+  tcpip_tcp_timer_active = 1;
+  sys_timeout(TCP_TMR_INTERVAL, tcpip_tcp_timer, NULL);
+#endif /* LWIP_TCP && TCP_TIMER_ALWAYS */
 #if IP_REASSEMBLY
   sys_timeout(IP_TMR_INTERVAL, ip_reass_timer, NULL);
 #endif /* IP_REASSEMBLY */
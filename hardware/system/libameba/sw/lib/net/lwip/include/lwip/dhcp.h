@@ -121,6 +121,11 @@ void dhcp_stop(struct netif *netif);
 void dhcp_inform(struct netif *netif);
 /** Handle a possible change in the network configuration */
 void dhcp_network_changed(struct netif *netif);
+#if LWIP_DHCP_REBOOT_HINT
+/** ask the next dhcp_start() to verify ipaddr (INIT-REBOOT) before
+    discovering, NULL to forget it */
+void dhcp_set_reboot_hint(ip_addr_t *ipaddr);
+#endif /* LWIP_DHCP_REBOOT_HINT */
 
 /** if enabled, check whether the offered IP address is not in use, using ARP */
 #if DHCP_DOES_ARP_CHECK
@@ -0,0 +1,169 @@
+/**
+ * @file
+ * Runtime network counters that lwip_stats does not cover:
+ * tcpip mailbox depth, TCP retransmissions, core lock contention,
+ * DHCP exchanges, per-socket RTT, and an optional event trace ring.
+ *
+ * Every counter update is a single increment, so this stays enabled in
+ * release builds along with LWIP_STATS.
+ */
+
+#ifndef __LWIP_NETSTATS_H__
+#define __LWIP_NETSTATS_H__
+
+#include "lwip/opt.h"
+#include "lwip/stats.h"
+
+/**
+ * NETSTATS==1: Keep the counters in this file. Default is on whenever
+ * LWIP_STATS is.
+ */
+#ifndef NETSTATS
+#define NETSTATS                        LWIP_STATS
+#endif
+
+/**
+ * NETSTATS_TRACE==1: Record exceptional events (pool exhaustion,
+ * retransmissions, full mailbox) with a timestamp in a ring buffer.
+ */
+#ifndef NETSTATS_TRACE
+#define NETSTATS_TRACE                  0
+#endif
+
+/** Number of events kept by the trace ring, must be a power of two. */
+#ifndef NETSTATS_TRACE_SIZE
+#define NETSTATS_TRACE_SIZE             64
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if NETSTATS
+
+struct netstats_tcpip {
+  u32_t posted;      /* Messages posted to the tcpip thread. */
+  u32_t fetched;     /* Messages taken by the tcpip thread. */
+  u32_t max_depth;   /* Most messages seen waiting at once. */
+  u32_t full;        /* Non-blocking posts refused, mailbox full. */
+};
+
+struct netstats_tcp {
+  u32_t rexmit_rto;    /* Retransmissions after a timeout. */
+  u32_t rexmit_fast;   /* Fast retransmissions after three dupacks. */
+  u32_t ooseq_rcvd;    /* Segments received out of order. */
+  u32_t ooseq_dropped; /* Out of order segments over the ooseq budget. */
+  u32_t ooseq_evicted; /* Freed from ooseq because PBUF_POOL ran out. */
+};
+
+struct netstats_dhcp {
+  u32_t discover;     /* DISCOVER messages sent. */
+  u32_t reboot;       /* INIT-REBOOT requests sent for a remembered lease. */
+  u32_t reboot_acked; /* Remembered leases the server confirmed. */
+  u32_t nak;          /* NAKs received, in any state. */
+};
+
+/* Only updated while the core lock is held, see tcpip_core_lock(). */
+struct netstats_core {
+  u32_t locks;       /* Times the core lock was taken. */
+  u32_t contended;   /* Times it was taken by another thread. */
+  u32_t wait_us;     /* Total time spent waiting for it. */
+  u32_t max_wait_us; /* Longest single wait. */
+};
+
+struct netstats_ {
+  struct netstats_tcpip tcpip;
+  struct netstats_tcp tcp;
+  struct netstats_core core;
+  struct netstats_dhcp dhcp;
+};
+
+/** Snapshot of one TCP socket, see netstats_socket_get() */
+struct netstats_socket {
+  u8_t  state;       /* enum tcp_state */
+  u16_t mss;
+  u32_t srtt;        /* Smoothed round trip time, in ms. */
+  u32_t rttvar;      /* Round trip time variation, in ms. */
+  u32_t rto;         /* Current retransmission timeout, in ms. */
+  u32_t rexmit;      /* Retransmissions over the connection's life. */
+  u16_t cwnd;
+  u16_t snd_wnd;
+  u16_t rcv_wnd;
+  u16_t rcv_wnd_max; /* Window size, rcv_wnd is the part not in use. */
+  u16_t snd_buf;
+  u16_t snd_buf_max; /* Send buffer size, snd_buf is the part not in use. */
+  u16_t snd_queuelen;
+};
+
+extern struct netstats_ netstats;
+
+#define NETSTATS_INC(x) ++netstats.x
+/* Count before posting, so the tcpip thread never sees more fetches than
+   posts. Any thread posts, so posted and full are updated atomically, as
+   in the trace ring. fetched and max_depth are only written by the tcpip
+   thread. */
+#define NETSTATS_TCPIP_POST() __sync_fetch_and_add(&netstats.tcpip.posted, 1)
+#define NETSTATS_TCPIP_FULL(type) do { __sync_fetch_and_sub(&netstats.tcpip.posted, 1); \
+                                       __sync_fetch_and_add(&netstats.tcpip.full, 1); \
+                                       NETSTATS_TRACE_EVENT(NETSTATS_EV_TCPIP_FULL, type); \
+                                     } while(0)
+/* A post counted after its message was fetched would read as a negative
+   depth, don't let it wrap into max_depth */
+#define NETSTATS_TCPIP_FETCH() do { s32_t depth_ = (s32_t)(netstats.tcpip.posted - netstats.tcpip.fetched++); \
+                                    if (depth_ > 0 && netstats.tcpip.max_depth < (u32_t)depth_) { \
+                                      netstats.tcpip.max_depth = (u32_t)depth_; \
+                                    } \
+                                  } while(0)
+#define NETSTATS_PCB_REXMIT(pcb) ++(pcb)->rexmit_cnt
+#define NETSTATS_CORE_WAIT(us) do { u32_t wait_ = (us); \
+                                    ++netstats.core.contended; \
+                                    netstats.core.wait_us += wait_; \
+                                    if (netstats.core.max_wait_us < wait_) { \
+                                      netstats.core.max_wait_us = wait_; \
+                                    } \
+                                  } while(0)
+
+/** Fill in *stats for socket s. Returns 0, or -1 if s is not a TCP socket. */
+int netstats_socket_get(int s, struct netstats_socket *stats);
+
+#else /* NETSTATS */
+#define NETSTATS_INC(x)
+#define NETSTATS_TCPIP_POST()
+#define NETSTATS_TCPIP_FULL(type)
+#define NETSTATS_TCPIP_FETCH()
+#define NETSTATS_PCB_REXMIT(pcb)
+#define NETSTATS_CORE_WAIT(us)
+#endif /* NETSTATS */
+
+#if NETSTATS_TRACE
+
+enum netstats_event_type {
+  NETSTATS_EV_MEMP_ERR,      /* arg: memp pool index */
+  NETSTATS_EV_MEM_ERR,       /* arg: requested size, saturated */
+  NETSTATS_EV_TCP_REXMIT,    /* arg: 0 timeout, 1 fast */
+  NETSTATS_EV_TCPIP_FULL,    /* arg: tcpip_msg_type */
+  NETSTATS_EV_LINK_DROP      /* arg: unused */
+};
+
+struct netstats_event {
+  u32_t time;                /* sys_now() when the event was recorded */
+  u16_t type;                /* enum netstats_event_type */
+  u16_t arg;
+};
+
+void netstats_trace(u16_t type, u16_t arg);
+/** Copy the next event after *cursor into *ev and advance *cursor.
+ *  Returns 1 if an event was copied, 0 if the reader has caught up.
+ *  Events overwritten before they were read are skipped. */
+int netstats_trace_read(u32_t *cursor, struct netstats_event *ev);
+
+#define NETSTATS_TRACE_EVENT(type, arg) netstats_trace(type, arg)
+#else /* NETSTATS_TRACE */
+#define NETSTATS_TRACE_EVENT(type, arg)
+#endif /* NETSTATS_TRACE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LWIP_NETSTATS_H__ */
@@ -106,6 +106,24 @@
 #define MEM_LIBC_MALLOC                 0
 #endif
 
+/**
+ * MEM_HEAP_CAPS==1: Serve mem_malloc() and friends from the region heap
+ * in heap_caps.h instead of the ram_heap array, so lwIP, the WiFi driver
+ * and the application share one heap. Unlike with MEM_LIBC_MALLOC, the
+ * mem_*() functions stay real functions. MEM_SIZE is then unused.
+ */
+#ifndef MEM_HEAP_CAPS
+#define MEM_HEAP_CAPS                   0
+#endif
+
+/**
+ * MEM_HEAP_CAPS_FLAGS: MALLOC_CAP_* flags of the blocks mem_malloc()
+ * asks the region heap for.
+ */
+#ifndef MEM_HEAP_CAPS_FLAGS
+#define MEM_HEAP_CAPS_FLAGS             MALLOC_CAP_DEFAULT
+#endif
+
 /**
 * MEMP_MEM_MALLOC==1: Use mem_malloc/mem_free instead of the lwip pool allocator.
 * Especially useful with MEM_LIBC_MALLOC but handle with care regarding execution
@@ -665,6 +683,15 @@
 #define DHCP_DOES_ARP_CHECK             ((LWIP_DHCP) && (LWIP_ARP))
 #endif
 
+/**
+ * LWIP_DHCP_REBOOT_HINT==1: Provide dhcp_set_reboot_hint(), so that the
+ * next dhcp_start() asks to keep an address remembered from an earlier
+ * lease (INIT-REBOOT) instead of discovering a new one.
+ */
+#ifndef LWIP_DHCP_REBOOT_HINT
+#define LWIP_DHCP_REBOOT_HINT           0
+#endif
+
 /*
    ------------------------------------
    ---------- AUTOIP options ----------
@@ -921,6 +948,42 @@
 #define TCP_QUEUE_OOSEQ                 (LWIP_TCP)
 #endif
 
+/**
+ * TCP_OOSEQ_MAX_BYTES: The maximum number of bytes queued on ooseq per pcb.
+ * Segments furthest from rcv_nxt are dropped first. Default is 0 (no limit).
+ * Only valid for TCP_QUEUE_OOSEQ==1. With TCP_BUF_AUTOTUNE==1 this is the
+ * budget of a window of TCP_WND, and it scales with the window of the pcb.
+ */
+#ifndef TCP_OOSEQ_MAX_BYTES
+#define TCP_OOSEQ_MAX_BYTES             0
+#endif
+
+/**
+ * TCP_OOSEQ_MAX_PBUFS: The maximum number of pbufs queued on ooseq per pcb.
+ * Default is 0 (no limit). Only valid for TCP_QUEUE_OOSEQ==1. Scales with
+ * the window like TCP_OOSEQ_MAX_BYTES.
+ */
+#ifndef TCP_OOSEQ_MAX_PBUFS
+#define TCP_OOSEQ_MAX_PBUFS             0
+#endif
+
+/**
+ * TCP_OOSEQ_TOTAL_BYTES: The maximum number of bytes queued on ooseq by all
+ * pcbs together. Default is 0 (no limit). Only valid for TCP_QUEUE_OOSEQ==1.
+ */
+#ifndef TCP_OOSEQ_TOTAL_BYTES
+#define TCP_OOSEQ_TOTAL_BYTES           0
+#endif
+
+/**
+ * TCP_OOSEQ_TOTAL_PBUFS: The maximum number of pbufs queued on ooseq by all
+ * pcbs together, to keep some of PBUF_POOL free for in-order data. Default
+ * is 0 (no limit). Only valid for TCP_QUEUE_OOSEQ==1.
+ */
+#ifndef TCP_OOSEQ_TOTAL_PBUFS
+#define TCP_OOSEQ_TOTAL_PBUFS           0
+#endif
+
 /**
  * TCP_MSS: TCP Maximum segment size. (default is 536, a conservative default,
  * you might want to increase this.)
@@ -978,6 +1041,43 @@
 #define TCP_SNDQUEUELOWAT               ((TCP_SND_QUEUELEN)/2)
 #endif
 
+/**
+ * TCP_BUF_AUTOTUNE==1: Size the receive window and send buffer of each pcb
+ * at run time. TCP_WND and TCP_SND_BUF become the starting (and smallest)
+ * sizes; a connection that fills them grows up to TCP_WND_MAX and
+ * TCP_SND_BUF_MAX, as long as the heap and pools have room to spare.
+ * Sizes can also be fixed per socket with the TCP_RCVWND and TCP_SNDBUF
+ * socket options.
+ */
+#ifndef TCP_BUF_AUTOTUNE
+#define TCP_BUF_AUTOTUNE                0
+#endif
+
+/**
+ * TCP_WND_MAX: The largest receive window TCP_BUF_AUTOTUNE gives a pcb.
+ * Without window scaling this must stay below 0xffff.
+ */
+#ifndef TCP_WND_MAX
+#define TCP_WND_MAX                     (TCP_WND)
+#endif
+
+/**
+ * TCP_SND_BUF_MAX: The largest send buffer TCP_BUF_AUTOTUNE gives a pcb.
+ * Must stay below 0xffff.
+ */
+#ifndef TCP_SND_BUF_MAX
+#define TCP_SND_BUF_MAX                 (TCP_SND_BUF)
+#endif
+
+/**
+ * TCP_BUF_MEM_RESERVE: Heap bytes TCP_BUF_AUTOTUNE leaves to everything
+ * else. Windows and send buffers stop growing below this, and shrink back
+ * towards TCP_WND and TCP_SND_BUF.
+ */
+#ifndef TCP_BUF_MEM_RESERVE
+#define TCP_BUF_MEM_RESERVE             ((MEM_SIZE)/4)
+#endif
+
 /**
  * TCP_LISTEN_BACKLOG: Enable the backlog option for tcp listen pcb.
  */
@@ -1183,6 +1283,16 @@
 #define LWIP_HAVE_SLIPIF                0
 #endif
 
+/**
+ * SLIPIF_RX_BUFSIZE: The number of bytes slipif asks sio_read() for at once,
+ * decoded as one chunk. sio_read() must return what has arrived rather than
+ * wait for the whole buffer, as the DMA sio in lwip-sys does; leave this at
+ * 1 for a serial layer that blocks until len bytes are in.
+ */
+#ifndef SLIPIF_RX_BUFSIZE
+#define SLIPIF_RX_BUFSIZE               1
+#endif
+
 /*
    ------------------------------------
    ---------- Thread options ----------
@@ -1443,6 +1553,16 @@
 #define SO_REUSE_RXTOALL                0
 #endif
 
+/**
+ * LWIP_SOCKET_WAITFOR==1: Enable lwip_waitfor(), which blocks a thread until
+ * one socket is readable, writable or closed. event_callback() wakes the
+ * thread through sys_thread_wake(), which the port must provide along with
+ * sys_thread_self() and sys_thread_sleep().
+ */
+#ifndef LWIP_SOCKET_WAITFOR
+#define LWIP_SOCKET_WAITFOR             0
+#endif
+
 /*
    ----------------------------------------
    ---------- Statistics options ----------
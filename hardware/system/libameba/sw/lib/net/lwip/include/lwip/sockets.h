@@ -149,6 +149,10 @@ struct linger {
 #define TCP_KEEPIDLE   0x03    /* set pcb->keep_idle  - Same as TCP_KEEPALIVE, but use seconds for get/setsockopt */
 #define TCP_KEEPINTVL  0x04    /* set pcb->keep_intvl - Use seconds for get/setsockopt */
 #define TCP_KEEPCNT    0x05    /* set pcb->keep_cnt   - Use number of probes sent for get/setsockopt */
+#if TCP_BUF_AUTOTUNE
+#define TCP_SNDBUF     0x06    /* fix the send buffer size in bytes, 0 to size it automatically */
+#define TCP_RCVWND     0x07    /* fix the receive window size in bytes, 0 to size it automatically */
+#endif /* TCP_BUF_AUTOTUNE */
 #endif /* LWIP_TCP */
 
 #if LWIP_UDP && LWIP_UDPLITE
@@ -340,6 +344,17 @@ int lwip_select(int maxfdp1, fd_set *readset, fd_set *writeset, fd_set *exceptse
 int lwip_ioctl(int s, long cmd, void *argp);
 int lwip_fcntl(int s, int cmd, int val);
 
+#if LWIP_SOCKET_WAITFOR
+/* Events for lwip_waitfor(). LWIP_WAIT_CLOSED is reported whether it is
+   asked for or not. */
+#define LWIP_WAIT_READ        0x01  /* data, a connection to accept, or the end of the stream */
+#define LWIP_WAIT_WRITE       0x02  /* room in the send buffer */
+#define LWIP_WAIT_CLOSED      0x04  /* closed by the peer, reset, or failed */
+#define LWIP_WAIT_FOREVER     0xffffffffUL
+
+int lwip_waitfor(int s, int events, u32_t timeout);
+#endif /* LWIP_SOCKET_WAITFOR */
+
 #if LWIP_COMPAT_SOCKETS
 #define accept(a,b,c)         lwip_accept(a,b,c)
 #define bind(a,b,c)           lwip_bind(a,b,c)
@@ -42,6 +42,7 @@
 #include "lwip/ip.h"
 #include "lwip/icmp.h"
 #include "lwip/err.h"
+#include "lwip/netstats.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -209,6 +210,9 @@ struct tcp_pcb {
 
   s16_t rto;    /* retransmission time-out */
   u8_t nrtx;    /* number of retransmissions */
+#if NETSTATS
+  u32_t rexmit_cnt; /* retransmissions over the connection's life */
+#endif /* NETSTATS */
 
   /* fast retransmit/recovery */
   u32_t lastack; /* Highest acknowledged seqno. */
@@ -231,6 +235,17 @@ struct tcp_pcb {
 #define TCP_SNDQUEUELEN_OVERFLOW (0xffffU-3)
   u16_t snd_queuelen; /* Available buffer space for sending (in tcp_segs). */
 
+#if TCP_BUF_AUTOTUNE
+  u16_t rcv_wnd_max; /* Receive window size, rcv_wnd is the part not in use. */
+  u16_t snd_buf_max; /* Send buffer size, snd_buf is the part not in use. */
+  u32_t tune_rcv_nxt; /* rcv_nxt at the last tcp_buf_tune() */
+  u32_t tune_lastack; /* lastack at the last tcp_buf_tune() */
+  u8_t tune_flags;
+#define TCP_BUF_LOCK_RCV 0x01U /* rcv_wnd_max set with tcp_set_rcv_wnd() */
+#define TCP_BUF_LOCK_SND 0x02U /* snd_buf_max set with tcp_set_snd_buf() */
+#define TCP_BUF_STARTED  0x04U /* tune_rcv_nxt and tune_lastack are valid */
+#endif /* TCP_BUF_AUTOTUNE */
+
 #if TCP_OVERSIZE
   /* Extra bytes available at the end of the last pbuf in unsent. */
   u16_t unsent_oversize;
@@ -327,6 +342,18 @@ void             tcp_err     (struct tcp_pcb *pcb, tcp_err_fn err);
 #define          tcp_nagle_enable(pcb)    ((pcb)->flags &= ~TF_NODELAY)
 #define          tcp_nagle_disabled(pcb)  (((pcb)->flags & TF_NODELAY) != 0)
 
+#if TCP_BUF_AUTOTUNE
+#define          tcp_rcv_wnd_max(pcb)     ((pcb)->rcv_wnd_max)
+#define          tcp_sndbuf_max(pcb)      ((pcb)->snd_buf_max)
+#else /* TCP_BUF_AUTOTUNE */
+#define          tcp_rcv_wnd_max(pcb)     (TCP_WND)
+#define          tcp_sndbuf_max(pcb)      (TCP_SND_BUF)
+#endif /* TCP_BUF_AUTOTUNE */
+/* The queue length and low-water marks scale with the send buffer */
+#define          tcp_sndqueuelen_max(pcb) ((u16_t)(((u32_t)(TCP_SND_QUEUELEN) * tcp_sndbuf_max(pcb)) / (TCP_SND_BUF)))
+#define          tcp_sndlowat(pcb)        ((u16_t)(((u32_t)(TCP_SNDLOWAT) * tcp_sndbuf_max(pcb)) / (TCP_SND_BUF)))
+#define          tcp_sndqueuelowat(pcb)   ((u16_t)(((u32_t)(TCP_SNDQUEUELOWAT) * tcp_sndbuf_max(pcb)) / (TCP_SND_BUF)))
+
 #if TCP_LISTEN_BACKLOG
 #define          tcp_accepted(pcb) do { \
   LWIP_ASSERT("pcb->state == LISTEN (called for wrong pcb?)", pcb->state == LISTEN); \
@@ -358,6 +385,11 @@ err_t            tcp_write   (struct tcp_pcb *pcb, const void *dataptr, u16_t le
 
 void             tcp_setprio (struct tcp_pcb *pcb, u8_t prio);
 
+#if TCP_BUF_AUTOTUNE
+void             tcp_set_rcv_wnd(struct tcp_pcb *pcb, u16_t size);
+void             tcp_set_snd_buf(struct tcp_pcb *pcb, u16_t size);
+#endif /* TCP_BUF_AUTOTUNE */
+
 #define TCP_PRIO_MIN    1
 #define TCP_PRIO_NORMAL 64
 #define TCP_PRIO_MAX    127
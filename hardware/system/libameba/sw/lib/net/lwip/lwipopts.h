@@ -24,6 +24,15 @@
 // Operating System 
 #define NO_SYS                      0
 
+/* Sketches link the lwIP prebuilt in librt_ameba_gcc_rel.a, not the
+   sources in this tree. With LWIP_PREBUILT (the default) the options
+   stay those of the archive. The ones under !LWIP_PREBUILT change
+   struct layouts or need functions the archive lacks: they only apply
+   to an lwIP built from these sources, as system/hostsim does. */
+#ifndef LWIP_PREBUILT
+#define LWIP_PREBUILT               1
+#endif
+
 
 #if NO_SYS == 0
 #include "cmsis_os.h"
@@ -38,12 +47,21 @@
 #define DEFAULT_RAW_RECVMBOX_SIZE   8
 #define DEFAULT_ACCEPTMBOX_SIZE     8
 
+#if !LWIP_PREBUILT
+/* Socket calls run their api_msg function in the calling thread under the
+   core lock, instead of posting it to tcpip_thread and waiting for the
+   reply. Received packets and timers still go through tcpip_thread. */
+#define LWIP_TCPIP_CORE_LOCKING     1
+
+/* lwip_waitfor(): a thread sleeps on one socket until event_callback()
+   signals it, instead of polling or going through lwip_select(). */
+#define LWIP_SOCKET_WAITFOR         1
+#endif
+
 #define TCPIP_THREAD_STACKSIZE      1024
 #define TCPIP_THREAD_PRIO           (osPriorityNormal)
 
 #define DEFAULT_THREAD_STACKSIZE    512
-
-#define MEMP_NUM_SYS_TIMEOUT        16
 #endif
 
 // 32-bit alignment
@@ -65,10 +83,38 @@
 //#define MEMP_NUM_PBUF               8
 #define MEMP_NUM_PBUF               10 // esp8266:10, wifi_soc:100
 
+#if LWIP_PREBUILT
 #define TCP_QUEUE_OOSEQ             0
+#else
+/* Keep out-of-order segments so one lost frame does not cost a
+   retransmission of everything after it, but only up to a budget that
+   leaves half of PBUF_POOL for in-order data. The per-pcb budget is one
+   window: TCP_BUF_AUTOTUNE scales it from TCP_WND. The total is what that
+   half of the pool holds, so that it does not cap a grown window. */
+#define TCP_QUEUE_OOSEQ             1
+#define TCP_OOSEQ_MAX_BYTES         TCP_WND
+#define TCP_OOSEQ_MAX_PBUFS         4
+#define TCP_OOSEQ_TOTAL_PBUFS       (PBUF_POOL_SIZE / 2)
+#define TCP_OOSEQ_TOTAL_BYTES       (TCP_OOSEQ_TOTAL_PBUFS * TCP_MSS)
+#endif
 #define TCP_OVERSIZE                0
 
+#if !LWIP_PREBUILT
+/* Checksum TCP and UDP payload while copying it into pbufs, instead of
+   reading it a second time when the segment is sent. */
+#define LWIP_CHECKSUM_ON_COPY       1
+
+/* Serial IP links read through lwip-sys/arch/sio_uart.c, whose sio_read()
+   returns all bytes received so far: let slipif decode them in chunks. */
+#define SLIPIF_RX_BUFSIZE           128
+#endif
+
 #define LWIP_DHCP                   1
+#if !LWIP_PREBUILT
+/* WiFi.begin() offers the lease saved in flash before falling back to
+   DISCOVER, see WiFiDrv::wifiSetPassphrase(). */
+#define LWIP_DHCP_REBOOT_HINT       1
+#endif
 #define LWIP_DNS                    1
 
 // Support Multicast
@@ -112,7 +158,6 @@
 #define MEMP_SANITY_CHECK           1
 #else
 #define LWIP_NOASSERT               1
-#define LWIP_STATS                  0
 #endif
 
 #define LWIP_PLATFORM_BYTESWAP      1
@@ -123,6 +168,14 @@
 a lot of data that needs to be copied, this should be set high. */
 #define MEM_SIZE                (128*1024)
 
+#if !LWIP_PREBUILT
+/* The heap is the shared region heap instead, its BD_RAM region has
+   the same size (HEAP_BDRAM_SIZE). The WiFi driver gets its DMA
+   buffers from mem_malloc(), so keep them in BD_RAM. */
+#define MEM_HEAP_CAPS           1
+#define MEM_HEAP_CAPS_FLAGS     MALLOC_CAP_DMA
+#endif
+
 /* MEMP_NUM_SYS_TIMEOUT: the number of simulateously active
    timeouts. */
 #define MEMP_NUM_SYS_TIMEOUT    10
@@ -134,7 +187,24 @@ a lot of data that needs to be copied, this should be set high. */
 #define TCP_WND                     (2 * TCP_MSS)
 #define TCP_SND_QUEUELEN            (4 * TCP_SND_BUF/TCP_MSS)
 
-#define LWIP_STATS				0
+#if LWIP_PREBUILT
+#define LWIP_STATS                  0
+#else
+/* Grow the window and send buffer of busy connections while the heap and
+   pools have room, instead of sizing every connection for the worst case.
+   A window of TCP_WND_MAX still fits in PBUF_POOL. */
+#define TCP_BUF_AUTOTUNE            1
+#define TCP_WND_MAX                 (12 * TCP_MSS)
+#define TCP_SND_BUF_MAX             (12 * TCP_MSS)
+#define MEMP_NUM_TCP_SEG            48
+
+/* Statistics: counter updates are single increments, so they stay on in
+   release builds. Read them with WiFi.netStats() or lwip/netstats.h. */
+#define LWIP_STATS                  1
+#define LWIP_STATS_LARGE            1
+#define LWIP_STATS_DISPLAY          0
+#define NETSTATS_TRACE              0
+#endif
 
 #define LWIP_ALLOW_MEM_FREE_FROM_OTHER_CONTEXT 1
 #define LWIP_NETIF_STATUS_CALLBACK  1
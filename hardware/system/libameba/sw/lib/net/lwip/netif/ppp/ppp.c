@@ -1761,6 +1761,9 @@ pppos_input(int pd, u_char* data, int len)
 
 /**
  * Process a received octet string.
+ *
+ * Data bytes that need no unescaping are copied and added to the FCS in
+ * runs, up to the end of the current pbuf.
  */
 static void
 pppInProc(PPPControlRx *pcrx, u_char *s, int l)
@@ -1768,15 +1771,24 @@ pppInProc(PPPControlRx *pcrx, u_char *s, int l)
   struct pbuf *nextNBuf;
   u_char curChar;
   u_char escaped;
+  ext_accm accm;
+  u_char *payload;
+  u16_t len, room;
+  u16_t fcs;
   SYS_ARCH_DECL_PROTECT(lev);
 
   PPPDEBUG(LOG_DEBUG, ("pppInProc[%d]: got %d bytes\n", pcrx->pd, l));
+
+  /* The map only changes during negotiation: take one copy for the whole
+   * chunk instead of locking for every byte. */
+  SYS_ARCH_PROTECT(lev);
+  MEMCPY(accm, pcrx->inACCM, sizeof(accm));
+  SYS_ARCH_UNPROTECT(lev);
+
   while (l-- > 0) {
     curChar = *s++;
 
-    SYS_ARCH_PROTECT(lev);
-    escaped = ESCAPE_P(pcrx->inACCM, curChar);
-    SYS_ARCH_UNPROTECT(lev);
+    escaped = ESCAPE_P(accm, curChar);
     /* Handle special characters. */
     if (escaped) {
       /* Check for escape sequences. */
@@ -1946,9 +1958,22 @@ pppInProc(PPPControlRx *pcrx, u_char *s, int l)
             }
             pcrx->inTail = nextNBuf;
           }
-          /* Load character into buffer. */
-          ((u_char*)pcrx->inTail->payload)[pcrx->inTail->len++] = curChar;
-          break;
+          /* Load character into buffer, along with the plain ones after it. */
+          payload = (u_char*)pcrx->inTail->payload;
+          len = pcrx->inTail->len;
+          fcs = PPP_FCS(pcrx->inFCS, curChar);
+          payload[len++] = curChar;
+          room = PBUF_POOL_BUFSIZE - len;
+          while ((room > 0) && (l > 0) && !ESCAPE_P(accm, *s)) {
+            curChar = *s++;
+            l--;
+            room--;
+            fcs = PPP_FCS(fcs, curChar);
+            payload[len++] = curChar;
+          }
+          pcrx->inTail->len = len;
+          pcrx->inFCS = fcs;
+          continue;
       }
 
       /* update the frame check sequence number. */
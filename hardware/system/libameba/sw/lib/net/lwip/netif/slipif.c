@@ -39,7 +39,7 @@
 
 /* 
  * This is an arch independent SLIP netif. The specific serial hooks must be
- * provided by another file. They are sio_open, sio_read/sio_tryread and sio_send
+ * provided by another file. They are sio_open, sio_read/sio_tryread and sio_write
  */
 
 #include "netif/slipif.h"
@@ -71,16 +71,26 @@ enum slipif_recv_state {
 
 struct slipif_priv {
   sio_fd_t sd;
+  /* the last chunk read from the line, decoded from rxpos up to rxlen */
+  u8_t rxbuf[SLIPIF_RX_BUFSIZE];
+  u16_t rxpos, rxlen;
   /* q is the whole pbuf chain for a packet, p is the current pbuf in the chain */
   struct pbuf *p, *q;
   enum slipif_recv_state state;
   u16_t i, recved;
 };
 
+/* What SLIP_END and SLIP_ESC inside a packet are sent as */
+static const u8_t slip_end[1] = { SLIP_END };
+static const u8_t slip_esc_end[2] = { SLIP_ESC, SLIP_ESC_END };
+static const u8_t slip_esc_esc[2] = { SLIP_ESC, SLIP_ESC_ESC };
+
 /**
  * Send a pbuf doing the necessary SLIP encapsulation
  *
- * Uses the serial layer's sio_send()
+ * Uses the serial layer's sio_write(): runs of bytes that need no escaping
+ * go out straight from the pbufs, so the serial layer is called once per
+ * run instead of once per byte.
  *
  * @param netif the lwip network interface structure for this slipif
  * @param p the pbuf chaing packet to send
@@ -92,8 +102,8 @@ slipif_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
 {
   struct slipif_priv *priv;
   struct pbuf *q;
-  u16_t i;
-  u8_t c;
+  u8_t *data;
+  u16_t i, start;
 
   LWIP_ASSERT("netif != NULL", (netif != NULL));
   LWIP_ASSERT("netif->state != NULL", (netif->state != NULL));
@@ -104,27 +114,29 @@ slipif_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
   priv = netif->state;
 
   /* Send pbuf out on the serial I/O device. */
-  sio_send(SLIP_END, priv->sd);
+  sio_write(priv->sd, (u8_t *)slip_end, sizeof(slip_end));
 
   for (q = p; q != NULL; q = q->next) {
+    data = (u8_t *)q->payload;
+    start = 0;
     for (i = 0; i < q->len; i++) {
-      c = ((u8_t *)q->payload)[i];
-      switch (c) {
-      case SLIP_END:
-        sio_send(SLIP_ESC, priv->sd);
-        sio_send(SLIP_ESC_END, priv->sd);
-        break;
-      case SLIP_ESC:
-        sio_send(SLIP_ESC, priv->sd);
-        sio_send(SLIP_ESC_ESC, priv->sd);
-        break;
-      default:
-        sio_send(c, priv->sd);
-        break;
+      if ((data[i] == SLIP_END) || (data[i] == SLIP_ESC)) {
+        if (i > start) {
+          sio_write(priv->sd, data + start, i - start);
+        }
+        if (data[i] == SLIP_END) {
+          sio_write(priv->sd, (u8_t *)slip_esc_end, sizeof(slip_esc_end));
+        } else {
+          sio_write(priv->sd, (u8_t *)slip_esc_esc, sizeof(slip_esc_esc));
+        }
+        start = i + 1;
       }
     }
+    if (q->len > start) {
+      sio_write(priv->sd, data + start, q->len - start);
+    }
   }
-  sio_send(SLIP_END, priv->sd);
+  sio_write(priv->sd, (u8_t *)slip_end, sizeof(slip_end));
   return ERR_OK;
 }
 
@@ -149,9 +161,68 @@ slip_sio_read(sio_fd_t fd, u8_t* data, u32_t len, u8_t block)
 }
 
 /**
- * Handle the incoming SLIP stream character by character
+ * Append decoded bytes to the packet being received, allocating pbufs as
+ * needed. This automatically drops bytes if > SLIP_MAX_SIZE.
+ *
+ * @param priv the slipif private data
+ * @param data the decoded bytes
+ * @param len number of bytes
+ */
+static void
+slipif_rxcopy(struct slipif_priv *priv, const u8_t *data, u16_t len)
+{
+  u16_t n;
+
+  while ((len > 0) && (priv->recved <= SLIP_MAX_SIZE)) {
+    if (priv->p == NULL) {
+      /* allocate a new pbuf */
+      LWIP_DEBUGF(SLIP_DEBUG, ("slipif_input: alloc\n"));
+      priv->p = pbuf_alloc(PBUF_LINK, (PBUF_POOL_BUFSIZE - PBUF_LINK_HLEN), PBUF_POOL);
+
+      if (priv->p == NULL) {
+        LINK_STATS_INC(link.drop);
+        LWIP_DEBUGF(SLIP_DEBUG, ("slipif_input: no new pbuf! (DROP)\n"));
+        /* don't process any further since we got no pbuf to receive to */
+        return;
+      }
+
+      if (priv->q != NULL) {
+        /* 'chain' the pbuf to the existing chain */
+        pbuf_cat(priv->q, priv->p);
+      } else {
+        /* p is the first pbuf in the chain */
+        priv->q = priv->p;
+      }
+    }
+
+    n = LWIP_MIN(len, priv->p->len - priv->i);
+    n = LWIP_MIN(n, SLIP_MAX_SIZE + 1 - priv->recved);
+    MEMCPY((u8_t *)priv->p->payload + priv->i, data, n);
+    data += n;
+    len -= n;
+    priv->recved += n;
+    priv->i += n;
+    if (priv->i >= priv->p->len) {
+      /* on to the next pbuf */
+      priv->i = 0;
+      if (priv->p->next != NULL && priv->p->next->len > 0) {
+        /* p is a chain, on to the next in the chain */
+          priv->p = priv->p->next;
+      } else {
+        /* p is a single pbuf, set it to NULL so next time a new
+         * pbuf is allocated */
+          priv->p = NULL;
+      }
+    }
+  }
+}
+
+/**
+ * Handle the incoming SLIP stream a chunk at a time
  *
- * Poll the serial layer by calling sio_read() or sio_tryread().
+ * Poll the serial layer by calling sio_read() or sio_tryread() for up to
+ * SLIPIF_RX_BUFSIZE bytes. Runs of bytes that are not escaped are copied
+ * into the packet in one go.
  *
  * @param netif the lwip network interface structure for this slipif
  * @param block if 1, block until data is received; if 0, return when all data
@@ -164,6 +235,8 @@ slipif_input(struct netif *netif, u8_t block)
 {
   struct slipif_priv *priv;
   u8_t c;
+  u16_t start;
+  u32_t len;
   struct pbuf *t;
 
   LWIP_ASSERT("netif != NULL", (netif != NULL));
@@ -171,9 +244,33 @@ slipif_input(struct netif *netif, u8_t block)
 
   priv = netif->state;
 
-  while (slip_sio_read(priv->sd, &c, 1, block) > 0) {
-    switch (priv->state) {
-    case SLIP_RECV_NORMAL:
+  for (;;) {
+    if (priv->rxpos >= priv->rxlen) {
+      len = slip_sio_read(priv->sd, priv->rxbuf, SLIPIF_RX_BUFSIZE, block);
+      if (len == 0) {
+        return NULL;
+      }
+      priv->rxpos = 0;
+      priv->rxlen = (u16_t)len;
+    }
+
+    while (priv->rxpos < priv->rxlen) {
+      c = priv->rxbuf[priv->rxpos++];
+
+      if (priv->state == SLIP_RECV_ESCAPE) {
+        switch (c) {
+        case SLIP_ESC_END:
+          c = SLIP_END;
+          break;
+        case SLIP_ESC_ESC:
+          c = SLIP_ESC;
+          break;
+        }
+        priv->state = SLIP_RECV_NORMAL;
+        slipif_rxcopy(priv, &c, 1);
+        continue;
+      }
+
       switch (c) {
       case SLIP_END:
         if (priv->recved > 0) {
@@ -189,68 +286,23 @@ slipif_input(struct netif *netif, u8_t block)
           priv->i = priv->recved = 0;
           return t;
         }
-        continue;
+        break;
       case SLIP_ESC:
         priv->state = SLIP_RECV_ESCAPE;
-        continue;
-      }
-      break;
-    case SLIP_RECV_ESCAPE:
-      switch (c) {
-      case SLIP_ESC_END:
-        c = SLIP_END;
         break;
-      case SLIP_ESC_ESC:
-        c = SLIP_ESC;
-        break;
-      }
-      priv->state = SLIP_RECV_NORMAL;
-      /* FALLTHROUGH */
-    }
-
-    /* byte received, packet not yet completely received */
-    if (priv->p == NULL) {
-      /* allocate a new pbuf */
-      LWIP_DEBUGF(SLIP_DEBUG, ("slipif_input: alloc\n"));
-      priv->p = pbuf_alloc(PBUF_LINK, (PBUF_POOL_BUFSIZE - PBUF_LINK_HLEN), PBUF_POOL);
-
-      if (priv->p == NULL) {
-        LINK_STATS_INC(link.drop);
-        LWIP_DEBUGF(SLIP_DEBUG, ("slipif_input: no new pbuf! (DROP)\n"));
-        /* don't process any further since we got no pbuf to receive to */
-        break;
-      }
-
-      if (priv->q != NULL) {
-        /* 'chain' the pbuf to the existing chain */
-        pbuf_cat(priv->q, priv->p);
-      } else {
-        /* p is the first pbuf in the chain */
-        priv->q = priv->p;
-      }
-    }
-
-    /* this automatically drops bytes if > SLIP_MAX_SIZE */
-    if ((priv->p != NULL) && (priv->recved <= SLIP_MAX_SIZE)) {
-      ((u8_t *)priv->p->payload)[priv->i] = c;
-      priv->recved++;
-      priv->i++;
-      if (priv->i >= priv->p->len) {
-        /* on to the next pbuf */
-        priv->i = 0;
-        if (priv->p->next != NULL && priv->p->next->len > 0) {
-          /* p is a chain, on to the next in the chain */
-            priv->p = priv->p->next;
-        } else {
-          /* p is a single pbuf, set it to NULL so next time a new
-           * pbuf is allocated */
-            priv->p = NULL;
+      default:
+        /* take this byte and the plain ones after it together */
+        start = priv->rxpos - 1;
+        while ((priv->rxpos < priv->rxlen) &&
+               (priv->rxbuf[priv->rxpos] != SLIP_END) &&
+               (priv->rxbuf[priv->rxpos] != SLIP_ESC)) {
+          priv->rxpos++;
         }
+        slipif_rxcopy(priv, &priv->rxbuf[start], priv->rxpos - start);
+        break;
       }
     }
   }
-
-  return NULL;
 }
 
 #if !NO_SYS
@@ -326,6 +378,8 @@ slipif_init(struct netif *netif)
   priv->state = SLIP_RECV_NORMAL;
   priv->i = 0;
   priv->recved = 0;
+  priv->rxpos = 0;
+  priv->rxlen = 0;
 
   netif->state = priv;
 
@@ -0,0 +1,102 @@
+#ifndef _HEAP_CAPS_H_
+#define _HEAP_CAPS_H_
+
+/*
+ * One heap over several RAM regions, each tagged with what it can do:
+ *
+ *   BD_RAM  main RAM, the only region the DMA engines can use
+ *   TCM     what user code leaves of the 64KB TCM, zero wait state
+ *   SDRAM   external SDRAM, only added when the boot code enabled it
+ *
+ * malloc_caps() takes the first region that has every requested
+ * capability and room for the block. Without MALLOC_CAP_* flags, small
+ * blocks go to BD_RAM and then TCM, and blocks of HEAP_CAPS_BULK_SIZE or
+ * more go to SDRAM first, so a full region spills into another.
+ *
+ * lwIP's mem_malloc() lives here (MEM_HEAP_CAPS in lwipopts.h), so the
+ * WiFi driver, lwIP, and String or operator new once routed here, all
+ * draw on the same memory. free_caps() also takes blocks from malloc(),
+ * which makes it safe to switch routing on at any time.
+ *
+ * The code is in cores/arduino/heap_caps.c. It runs with interrupts
+ * disabled and can be called from an ISR.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MALLOC_CAP_DEFAULT      0x0000  /* any region */
+#define MALLOC_CAP_INTERNAL     0x0001  /* on-chip: BD_RAM or TCM */
+#define MALLOC_CAP_DMA          0x0002  /* reachable by DMA: BD_RAM */
+#define MALLOC_CAP_TCM          0x0004  /* small hot objects */
+#define MALLOC_CAP_SDRAM        0x0008  /* large bulk buffers */
+
+/* Default requests of this size and above prefer SDRAM */
+#ifndef HEAP_CAPS_BULK_SIZE
+#define HEAP_CAPS_BULK_SIZE     4096
+#endif
+
+#define HEAP_CAPS_MAX_REGIONS   4
+
+typedef struct {
+	const char *name;
+	uint32_t caps;
+	uint32_t size;          /* bytes under management */
+	uint32_t used;          /* bytes in allocated blocks, headers included */
+	uint32_t peak;          /* highest used */
+	uint32_t free_blocks;
+	uint32_t largest_free;  /* largest block malloc_caps() can return */
+	uint32_t allocs;
+	uint32_t frees;
+	uint32_t misses;        /* requests that had to look elsewhere */
+} heap_caps_stats_t;
+
+/* Called by the first allocation; only needed to add regions early */
+void heap_caps_init(void);
+
+/* Hand [start, start + size) over to the heap. Returns the region index
+ * or -1. */
+int heap_caps_add_region(const char *name, void *start, size_t size, uint32_t caps);
+
+void *malloc_caps(size_t size, uint32_t caps);
+void *calloc_caps(size_t count, size_t size, uint32_t caps);
+
+/* Shrinking never moves the block. Growing tries in place, then moves
+ * it to a region with the given caps. Blocks from malloc() are passed
+ * to realloc(). */
+void *realloc_caps(void *ptr, size_t size, uint32_t caps);
+
+void free_caps(void *ptr);
+
+/* realloc_caps(ptr, size, MALLOC_CAP_DEFAULT), for
+ * String::setAllocator(heap_caps_realloc, free_caps) */
+void *heap_caps_realloc(void *ptr, size_t size);
+
+/* Make operator new and delete use malloc_caps(size, caps) and
+ * free_caps(). new stays on malloc() until this is called. */
+void heap_caps_route_new(uint32_t caps);
+void heap_caps_unroute_new(void);
+
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+
+int heap_caps_region_count(void);
+int heap_caps_get_stats(int region, heap_caps_stats_t *stats);
+
+/* Allocation trace hook, e.g. to record a trace for the host benchmark
+ * in system/heapbench. op is 'm' (ptr = new block), 'r' (ptr = new
+ * block, old = previous one) or 'f' (old = freed block); ptr is NULL
+ * when the request failed. It can run in an interrupt handler, so it
+ * should only buffer the event. */
+typedef void (*heap_caps_trace_fn)(char op, void *ptr, void *old, size_t size, uint32_t caps);
+void heap_caps_set_trace(heap_caps_trace_fn fn);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _HEAP_CAPS_H_ */
@@ -115,6 +115,9 @@ uint8_t  const os_fifo_size = OS_FIFOSZ;
 /* An array of Active task pointers. */
 void *os_active_TCB[OS_TASK_CNT];
 
+/* Time slice, background and slice statistics of each active task. */
+struct OS_SCHED os_tsk_sched[OS_TASK_CNT];
+
 /* User Timers Resources */
 #if (OS_TIMERS != 0)
 extern void osTimerThread (void const *argument);
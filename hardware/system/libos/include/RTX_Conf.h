@@ -48,6 +48,7 @@
 extern U32 idle_task_stack[];
 extern U32 os_fifo[];
 extern void *os_active_TCB[];
+extern struct OS_SCHED os_tsk_sched[];
 
 /* Constants */
 extern U16 const os_maxtaskrun;
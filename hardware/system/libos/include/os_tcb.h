@@ -47,4 +47,13 @@ typedef struct OS_TCB {
   FUNCP  ptask;                   /* Task entry address                      */
 } *P_TCB;
 
+/* Scheduling state kept beside the TCB, in os_tsk_sched[task_id-1]: the    */
+/* TCB is part of osThreadDef_t, which prebuilt libraries allocate.         */
+typedef struct OS_SCHED {
+  U16    slice;                   /* Round Robin timeout, 0 = os_rrobin      */
+  U8     bg_prio;                 /* Priority outside background, 0 = none   */
+  U8     reserved;
+  U32    slice_exp;               /* Timeouts that passed the CPU on         */
+} *P_SCHED;
+
 #endif
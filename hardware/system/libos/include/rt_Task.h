@@ -57,6 +57,9 @@
 #define OS_R_OK         0x00
 #define OS_R_NOK        0xff
 
+/* Priority of background tasks: above the idle demon (0), at osPriorityIdle */
+#define OS_BG_PRIO      1
+
 /* Variables */
 extern struct OS_TSK os_tsk;
 extern struct OS_TCB os_idle_TCB;
@@ -68,6 +71,8 @@ extern void      rt_block      (U16 timeout, U8 block_state);
 extern void      rt_tsk_pass   (void);
 extern OS_TID    rt_tsk_self   (void);
 extern OS_RESULT rt_tsk_prio   (OS_TID task_id, U8 new_prio);
+extern OS_RESULT rt_tsk_slice  (OS_TID task_id, U16 ticks);
+extern OS_RESULT rt_tsk_bg     (OS_TID task_id, U32 on);
 extern OS_RESULT rt_tsk_delete (OS_TID task_id);
 extern void      rt_sys_init   (void);
 extern void      rt_sys_start  (void);
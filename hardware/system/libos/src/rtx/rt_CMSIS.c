@@ -438,6 +438,14 @@ static P_TCB rt_tid2ptcb (osThreadId thread_id) {
   return ptcb;
 }
 
+/// Scheduling state of a task, NULL for the idle demon
+static P_SCHED rt_ptcb2sched (P_TCB ptcb) {
+
+  if ((ptcb->task_id == 0) || (ptcb->task_id > os_maxtaskrun)) return NULL;
+
+  return &os_tsk_sched[ptcb->task_id - 1];
+}
+
 /// Convert ID pointer to Object pointer
 static void *rt_id2obj (void *id) {
 
@@ -666,6 +674,7 @@ IMAGE2_TEXT_SECTION
 osStatus svcThreadSetPriority (osThreadId thread_id, osPriority priority) {
   OS_RESULT res;
   P_TCB     ptcb;
+  P_SCHED   psched;
 
   ptcb = rt_tid2ptcb(thread_id);                // Get TCB pointer
   if (ptcb == NULL) return osErrorParameter;
@@ -674,6 +683,13 @@ osStatus svcThreadSetPriority (osThreadId thread_id, osPriority priority) {
     return osErrorValue;
   }
 
+  psched = rt_ptcb2sched(ptcb);
+  if ((psched != NULL) && (psched->bg_prio != 0)) {
+    // In background: takes effect when it leaves
+    psched->bg_prio = priority - osPriorityIdle + 1;
+    return osOK;
+  }
+
   res = rt_tsk_prio(                            // Change task priority
     ptcb->task_id,                              // Task ID
     priority - osPriorityIdle + 1               // New task priority
@@ -687,11 +703,17 @@ osStatus svcThreadSetPriority (osThreadId thread_id, osPriority priority) {
 /// Get current priority of an active thread
 IMAGE2_TEXT_SECTION
 osPriority svcThreadGetPriority (osThreadId thread_id) {
-  P_TCB ptcb;
+  P_TCB   ptcb;
+  P_SCHED psched;
 
   ptcb = rt_tid2ptcb(thread_id);                // Get TCB pointer
   if (ptcb == NULL) return osPriorityError;
 
+  psched = rt_ptcb2sched(ptcb);
+  if ((psched != NULL) && (psched->bg_prio != 0)) {
+    // In background: the priority it returns to
+    return (osPriority)(psched->bg_prio - 1 + osPriorityIdle);
+  }
   return (osPriority)(ptcb->prio - 1 + osPriorityIdle);
 }
 
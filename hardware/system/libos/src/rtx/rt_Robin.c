@@ -68,16 +68,28 @@ IMAGE2_TEXT_SECTION
 __weak void rt_chk_robin (void) {
   /* Check if Round Robin timeout expired and switch to the next ready task.*/
   P_TCB p_new;
+  U16   tout;
 
   if (os_robin.task != os_rdy.p_lnk) {
     /* New task was suspended, reset Round Robin timeout. */
     os_robin.task = os_rdy.p_lnk;
-    os_robin.time = (U16)os_time + os_robin.tout - 1;
+    tout = os_robin.tout;
+    if (os_robin.task->task_id <= os_maxtaskrun &&
+        os_tsk_sched[os_robin.task->task_id-1].slice != 0) {
+      /* Task with its own time slice. */
+      tout = os_tsk_sched[os_robin.task->task_id-1].slice;
+    }
+    os_robin.time = (U16)os_time + tout - 1;
   }
   if (os_robin.time == (U16)os_time) {
     /* Round Robin timeout has expired, swap Robin tasks. */
     os_robin.task = NULL;
     p_new = rt_get_first (&os_rdy);
+    if (os_rdy.p_lnk != NULL && os_rdy.p_lnk->prio == p_new->prio &&
+        p_new->task_id <= os_maxtaskrun) {
+      /* Another task of the same priority takes over: slice exhausted. */
+      os_tsk_sched[p_new->task_id-1].slice_exp++;
+    }
     rt_put_prio ((P_XCB)&os_rdy, p_new);
   }
 }
@@ -66,6 +66,10 @@ OS_TID rt_get_TID (void) {
 
   for (tid = 1; tid <= os_maxtaskrun; tid++) {
     if (os_active_TCB[tid-1] == NULL) {
+      /* New task: default time slice, not in background. */
+      os_tsk_sched[tid-1].slice     = 0;
+      os_tsk_sched[tid-1].bg_prio   = 0;
+      os_tsk_sched[tid-1].slice_exp = 0;
       return ((OS_TID)tid);
     }
   }
@@ -225,6 +229,51 @@ run:if (rt_rdy_prio() > new_prio) {
   return (OS_R_OK);
 }
 
+/*--------------------------- rt_tsk_slice ----------------------------------*/
+IMAGE2_TEXT_SECTION
+OS_RESULT rt_tsk_slice (OS_TID task_id, U16 ticks) {
+  /* Set the Round Robin timeout of a task, 0 for the default "os_rrobin". */
+  if (task_id == 0 || task_id > os_maxtaskrun || os_active_TCB[task_id-1] == NULL) {
+    return (OS_R_NOK);
+  }
+  os_tsk_sched[task_id-1].slice = ticks;
+  if (os_robin.task == os_active_TCB[task_id-1]) {
+    /* Running out its slice now: restart it with the new length. */
+    os_robin.task = NULL;
+  }
+  return (OS_R_OK);
+}
+
+
+/*--------------------------- rt_tsk_bg -------------------------------------*/
+IMAGE2_TEXT_SECTION
+OS_RESULT rt_tsk_bg (OS_TID task_id, U32 on) {
+  /* Move a task to background priority, just above the idle demon, or */
+  /* back to the priority it had. */
+  P_SCHED p_sched;
+  U8      prio;
+
+  if (task_id == 0 || task_id > os_maxtaskrun || os_active_TCB[task_id-1] == NULL) {
+    return (OS_R_NOK);
+  }
+  p_sched = &os_tsk_sched[task_id-1];
+  if (on) {
+    if (p_sched->bg_prio != 0) {
+      return (OS_R_OK);
+    }
+    p_sched->bg_prio = ((P_TCB)os_active_TCB[task_id-1])->prio;
+    prio = OS_BG_PRIO;
+  }
+  else {
+    if (p_sched->bg_prio == 0) {
+      return (OS_R_OK);
+    }
+    prio = p_sched->bg_prio;
+    p_sched->bg_prio = 0;
+  }
+  return (rt_tsk_prio (task_id, prio));
+}
+
 /*--------------------------- rt_tsk_delete ---------------------------------*/
 IMAGE2_TEXT_SECTION
 OS_RESULT rt_tsk_delete (OS_TID task_id) {
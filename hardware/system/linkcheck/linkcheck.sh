@@ -0,0 +1,47 @@
+#!/bin/sh
+# linkcheck.sh <out dir> <include flags> <archives> <sources...>
+#
+# Compiles each source with the host compiler, against the board's headers,
+# to assembly only: the Cortex-M inline assembly of CMSIS never reaches an
+# assembler. Every lwIP or RTOS function or variable that the code refers
+# to, and does not define itself, must be defined in one of the archives.
+
+out=$1
+includes=$2
+archives=$3
+shift 3
+
+# Names of the lwIP and CMSIS-RTOS APIs, C linkage
+api='^(lwip_|netconn_|netbuf_|netif_|tcpip_|tcp_|udp_|raw_|pbuf_|mem_|memp_|sys_|dhcp_|dns_|etharp_|igmp_|ipaddr_|inet_|netstats|os[A-Z])'
+
+mkdir -p "$out"
+nm --defined-only $archives 2>/dev/null | awk 'NF == 3 { print $3 }' | sort -u > "$out/archives.sym"
+
+fail=0
+for src in "$@"; do
+	asm="$out/$(basename "$src").s"
+	case "$src" in
+	*.c)	cc="gcc" ;;
+	*)	cc="g++ -std=gnu++11 -fno-exceptions -fno-rtti" ;;
+	esac
+	# -w as on the board; -fpermissive for the SDK's 32-bit pointer casts
+	if ! $cc -S -w -fpermissive -DARDUINO=10600 -DLWIP_TIMEVAL_PRIVATE=0 \
+			$includes "$src" -o "$asm" 2> "$out/error.txt"; then
+		echo "$src: does not compile against the board's headers"
+		grep -m 5 'error' "$out/error.txt"
+		fail=1
+		continue
+	fi
+	# Symbols referred to, minus the labels the file defines
+	grep -oE '[A-Za-z_][A-Za-z0-9_.$]*' "$asm" | grep -E "$api" | sort -u > "$out/used.sym"
+	sed -n 's/^\([A-Za-z_][A-Za-z0-9_.$]*\):.*/\1/p' "$asm" | sort -u > "$out/defined.sym"
+	for sym in $(comm -23 "$out/used.sym" "$out/defined.sym" | comm -23 - "$out/archives.sym"); do
+		echo "$src: $sym is not in the archives"
+		fail=1
+	done
+done
+
+if [ $fail -eq 0 ]; then
+	echo "$# sources: every lwIP and RTOS symbol is in the archives"
+fi
+exit $fail
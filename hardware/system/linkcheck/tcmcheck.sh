@@ -0,0 +1,82 @@
+#!/bin/sh
+# tcmcheck.sh <map file> [objects...]
+#
+# Checks the TCM placement in the map file of a sketch build: every
+# .tcm.code, .tcm.vars and .tcm.bss input section must be in TCM, and each
+# of the objects must have put something there. By default those are the
+# ones of the core that do. Prints the TCM bytes of each object.
+
+map=$1
+shift
+[ $# -gt 0 ] || set -- variant.cpp.o UARTClass.cpp.o RingBuffer.cpp.o
+
+if [ ! -f "$map" ]; then
+	echo "usage: tcmcheck.sh <map file> [objects...]"
+	exit 2
+fi
+
+# An input section is " <name> <address> <size> <file>", with the address
+# on the next line when the name is long. Objects of an archive are
+# "<archive>(<object>)".
+awk -v objects="$*" -v map="$map" '
+function hex(s,    n, i) {
+	n = 0
+	s = tolower(s)
+	sub(/^0x/, "", s)
+	for (i = 1; i <= length(s); i++)
+		n = n * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+	return n
+}
+function object(file) {
+	if (match(file, /\([^()]*\)$/))
+		file = substr(file, RSTART + 1, RLENGTH - 2)
+	sub(/.*\//, "", file)
+	return file
+}
+function input(name, addr, size, file) {
+	if (name !~ /^\.tcm\./ || hex(size) == 0)
+		return
+	if (hex(addr) < TCM_START || hex(addr) >= TCM_END) {
+		printf("%s: %s is at %s, not in TCM\n", object(file), name, addr)
+		fail = 1
+		return
+	}
+	tcm[object(file)] += hex(size)
+	if (name ~ /^\.tcm\.bss/)
+		bss += hex(size)
+	else
+		loaded += hex(size)
+}
+BEGIN {
+	TCM_START = hex("1fff0000")
+	TCM_END = hex("20000000")
+}
+/^Linker script and memory map/ { inmap = 1; next }
+!inmap { next }
+wrapped != "" {
+	if (NF >= 3)
+		input(wrapped, $1, $2, $3)
+	wrapped = ""
+	next
+}
+/^\.tcm +0x/ && hex($2) != TCM_START {
+	printf("%s: .tcm starts at %s, not at the start of TCM\n", map, $2)
+	fail = 1
+}
+$2 == "__tcm_heap_start__" { heap = hex($1) }
+/^ \.[^ ]+$/ { wrapped = $1; next }
+/^ \.[^ ]+ +0x[0-9a-fA-F]+ +0x[0-9a-fA-F]+ / { input($1, $2, $3, $4) }
+END {
+	for (f in tcm)
+		printf("  %-40s %6d\n", f, tcm[f])
+	printf("TCM: %d bytes of code and data, %d of bss, %d left for the TCM heap\n",
+	       loaded, bss, heap ? TCM_END - heap : TCM_END - TCM_START - loaded - bss)
+	n = split(objects, required, " ")
+	for (i = 1; i <= n; i++) {
+		if (!(required[i] in tcm)) {
+			printf("%s: nothing of it is in TCM\n", required[i])
+			fail = 1
+		}
+	}
+	exit fail
+}' "$map"
@@ -0,0 +1,48 @@
+/* Host stand-in for rt_HAL_CM.h, see ../README.md: the kernel lists and
+ * scheduler compile unchanged, interrupts and the NVIC do nothing. */
+
+#define INITIAL_xPSR    0x01000000
+#define MAGIC_WORD      0xE25A2EA5
+
+#define __TARGET_ARCH_6S_M 0
+#define __TARGET_FPU_VFP   0
+
+#define __inline inline
+#define __weak   __attribute__((weak))
+
+static inline void __enable_irq(void) {}
+static inline U32 __disable_irq(void) { return 0; }
+
+#define OS_PEND_IRQ()
+#define OS_LOCK()
+#define OS_UNLOCK()
+#define OS_X_INIT(n)
+
+#define rt_inc(p)     (*p)++;
+#define rt_dec(p)     (*p)--;
+
+static inline U32 rt_inc_qi (U32 size, U8 *count, U8 *first) {
+  U32 cnt,c2;
+
+  if ((cnt = *count) < size) {
+    *count = cnt+1;
+    c2 = (cnt = *first) + 1;
+    if (c2 == size) c2 = 0;
+    *first = c2;
+  }
+  return (cnt);
+}
+
+static inline void rt_systick_init (void) {}
+static inline void rt_svc_init (void) {}
+
+extern void rt_set_PSP (U32 stack);
+extern U32  rt_get_PSP (void);
+
+extern void rt_init_stack (P_TCB p_TCB, FUNCP task_body);
+extern void rt_ret_val  (P_TCB p_TCB, U32 v0);
+extern void rt_ret_val2 (P_TCB p_TCB, U32 v0, U32 v1);
+
+#define DBG_INIT()
+#define DBG_TASK_NOTIFY(p_tcb,create)
+#define DBG_TASK_SWITCH(task_id)
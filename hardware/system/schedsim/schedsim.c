@@ -0,0 +1,377 @@
+/*
+ * Runs the RTX scheduler on the host, see README.md: rt_List.c, rt_Robin.c
+ * and rt_Task.c from libos, driven by a model of the sketch's loop thread,
+ * the lwIP tcpip thread and the 1 ms SysTick.
+ */
+
+#include "rt_TypeDef.h"
+#include "RTX_Conf.h"
+#include "rt_System.h"
+#include "rt_Task.h"
+#include "rt_List.h"
+#include "rt_Robin.h"
+#include "rt_Time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern OS_TID rt_get_TID (void);
+
+#define TASK_CNT    4
+#define TICK_US     1000
+
+/* What the kernel sources need from RTX_CM_lib.h, rt_System.c and rt_Time.c */
+void *os_active_TCB[TASK_CNT];
+struct OS_SCHED os_tsk_sched[TASK_CNT];
+U16 const os_maxtaskrun = TASK_CNT;
+U32 const os_rrobin = (1 << 16) | 5;        // OS_ROBIN 1, OS_ROBINTOUT 5
+U32 idle_task_stack[64];
+U16 const idle_task_stack_size = sizeof(idle_task_stack);
+U32 os_fifo[4*2+1];
+U8  const os_fifo_size = 4;
+int os_tick_irqn;
+U32 os_time;
+
+void os_idle_demon(void) {}
+int  os_tick_init(void) { return -1; }
+void os_error(U32 err_code) { printf("os_error %u\n", err_code); }
+void rt_stk_check(void) {}
+void rt_set_PSP(U32 stack) {}
+U32  rt_get_PSP(void) { return 0; }
+void rt_init_stack(P_TCB p_TCB, FUNCP task_body) {}
+void rt_ret_val(P_TCB p_TCB, U32 v0) {}
+void rt_ret_val2(P_TCB p_TCB, U32 v0, U32 v1) {}
+
+static struct OS_TCB idle, loop_tcb, tcpip_tcb;
+
+static int failures;
+
+static void check(int ok, const char *what)
+{
+    printf("  %-52s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+        failures++;
+}
+
+/* osPriority to RTX priority, as rt_CMSIS.c converts it */
+#define PRIO(p)     ((p) + 3 + 1)
+#define NORMAL      PRIO(0)
+#define ABOVE       PRIO(1)
+
+/* ---- Kernel setup, the parts of rt_sys_init() and rt_tsk_create() used */
+
+static void kernel_init(void)
+{
+    memset(os_active_TCB, 0, sizeof(os_active_TCB));
+    memset(&os_tsk, 0, sizeof(os_tsk));
+    os_rdy.cb_type = HCB;
+    os_rdy.p_lnk = NULL;
+    os_dly.cb_type = HCB;
+    os_dly.p_dlnk = NULL;
+    os_dly.p_blnk = NULL;
+    os_dly.delta_time = 0;
+    os_time = 0;
+    rt_init_robin();
+
+    memset(&idle, 0, sizeof(idle));
+    idle.cb_type = TCB;
+    idle.task_id = 255;
+    idle.prio = 0;
+    idle.state = READY;
+    rt_put_prio(&os_rdy, &idle);
+}
+
+static OS_TID task_create(P_TCB p, U8 prio)
+{
+    OS_TID tid = rt_get_TID();
+
+    memset(p, 0, sizeof(*p));
+    p->cb_type = TCB;
+    p->prio = prio;
+    p->task_id = tid;
+    os_active_TCB[tid-1] = p;
+    return tid;
+}
+
+/* rt_systick() from rt_System.c, without the timers */
+static void systick(void)
+{
+    P_TCB next;
+
+    os_tsk.run->state = READY;
+    rt_put_rdy_first(os_tsk.run);
+    rt_chk_robin();
+    os_time++;
+    rt_dec_dly();
+    next = rt_get_first(&os_rdy);
+    rt_switch_req(next);
+}
+
+/* PendSV: the new task gets the CPU */
+static unsigned switches;
+
+static void pendsv(void)
+{
+    if (os_tsk.new_tsk != NULL && os_tsk.new_tsk != os_tsk.run) {
+        os_tsk.run = os_tsk.new_tsk;
+        switches++;
+    }
+    os_tsk.new_tsk = NULL;
+}
+
+/* ---- The workload */
+
+enum Setup {
+    SETUP_DEFAULT,          // both at osPriorityNormal, 5 ms robin
+    SETUP_YIELD,            // loop() calls yield() every ms
+    SETUP_SLICE,            // rt_tsk_slice(loop, 1 tick)
+    SETUP_BACKGROUND,       // rt_tsk_bg(loop, 1)
+    SETUP_TCPIP_ABOVE,      // tcpip at osPriorityAboveNormal
+};
+
+static const char *setupName[] = {
+    "default", "loop yields 1ms", "loop slice 1ms", "loop background", "tcpip above",
+};
+
+struct Result {
+    unsigned packets;
+    unsigned long latSum;       // us
+    unsigned latMax;
+    unsigned long loopUs, tcpipUs, idleUs;
+    unsigned sliceExp;
+    unsigned switches;
+};
+
+#define SIM_US      (60 * 1000 * 1000)
+#define PKT_US      150     // tcpip time per packet
+#define QUEUE       64
+#define MAX_PKTS    16384
+
+static unsigned lat[MAX_PKTS];
+
+static unsigned lcg;
+
+static unsigned rnd(unsigned n)
+{
+    lcg = lcg * 1103515245 + 12345;
+    return (lcg >> 8) % n;
+}
+
+static int cmp(const void *a, const void *b)
+{
+    unsigned x = *(const unsigned *)a, y = *(const unsigned *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Of the latencies of the last run */
+static unsigned percentile(const struct Result *r, unsigned pct)
+{
+    unsigned n = r->packets < MAX_PKTS ? r->packets : MAX_PKTS;
+
+    qsort(lat, n, sizeof(lat[0]), cmp);
+    return lat[(n - 1) * pct / 100];
+}
+
+/*
+ * The loop thread never blocks: each loop() takes loopUs of CPU, then
+ * main() yields. Packets arrive every 1 to 12 ms; each wakes the tcpip
+ * thread, which needs PKT_US per packet and waits on its mailbox when
+ * the queue is empty.
+ */
+static void run(enum Setup setup, unsigned loopUs, struct Result *r)
+{
+    unsigned long t = 0, nextTick = TICK_US, nextPkt;
+    unsigned long arrival[QUEUE];
+    unsigned head = 0, tail = 0;
+    unsigned loopLeft = loopUs, tcpipLeft = 0;
+    OS_TID loopId;
+
+    memset(r, 0, sizeof(*r));
+    lcg = 1;
+    switches = 0;
+
+    kernel_init();
+    loopId = task_create(&loop_tcb, NORMAL);
+    task_create(&tcpip_tcb, setup == SETUP_TCPIP_ABOVE ? ABOVE : NORMAL);
+    tcpip_tcb.state = WAIT_MBX;
+    loop_tcb.state = RUNNING;
+    os_tsk.run = &loop_tcb;
+
+    if (setup == SETUP_YIELD)
+        loopLeft = loopUs = 1000;
+    if (setup == SETUP_SLICE)
+        rt_tsk_slice(loopId, 1);
+    if (setup == SETUP_BACKGROUND)
+        rt_tsk_bg(loopId, 1);
+
+    nextPkt = 1000 + rnd(12000);
+
+    while (t < SIM_US) {
+        P_TCB cur = os_tsk.run;
+        unsigned long next = nextTick < nextPkt ? nextTick : nextPkt;
+        unsigned long done = ~0UL;
+
+        if (cur == &tcpip_tcb && tcpipLeft == 0 && head != tail) {
+            unsigned us = t - arrival[tail++ % QUEUE];
+
+            if (r->packets < MAX_PKTS)
+                lat[r->packets] = us;
+            r->packets++;
+            r->latSum += us;
+            if (us > r->latMax)
+                r->latMax = us;
+            tcpipLeft = PKT_US;
+        }
+        if (cur == &loop_tcb)
+            done = t + loopLeft;
+        else if (cur == &tcpip_tcb)
+            done = t + tcpipLeft;
+        if (done < next)
+            next = done;
+
+        if (cur == &loop_tcb) {
+            r->loopUs += next - t;
+            loopLeft -= next - t;
+        } else if (cur == &tcpip_tcb) {
+            r->tcpipUs += next - t;
+            tcpipLeft -= next - t;
+        } else {
+            r->idleUs += next - t;
+        }
+        t = next;
+
+        if (t == done) {
+            if (cur == &loop_tcb) {
+                loopLeft = loopUs;
+                rt_tsk_pass();                          // osThreadYield()
+            } else if (head == tail) {
+                rt_block(0xffff, WAIT_MBX);             // osMessageGet()
+            }
+        } else if (t == nextPkt) {
+            arrival[head++ % QUEUE] = t;
+            if (tcpip_tcb.state == WAIT_MBX)
+                rt_dispatch(&tcpip_tcb);                // isr_mbx_send()
+            nextPkt = t + 1000 + rnd(12000);
+        } else {
+            systick();
+            nextTick += TICK_US;
+        }
+        pendsv();
+    }
+
+    r->sliceExp = os_tsk_sched[loopId-1].slice_exp;
+    r->switches = switches;
+}
+
+static void bench(void)
+{
+    static const unsigned loops[] = { 20000, 3000 };
+    struct Result res[5];
+    unsigned l, s;
+
+    printf("60 s, packets every 1-12 ms, %u us each in tcpip\n", PKT_US);
+    for (l = 0; l < sizeof(loops) / sizeof(loops[0]); l++) {
+        printf("\nloop() takes %u us\n", loops[l]);
+        printf("  %-18s %8s %8s %8s %8s %7s %7s %9s\n", "", "mean us", "p99 us", "max us",
+            "loop %", "idle %", "exp", "switches");
+        for (s = 0; s <= SETUP_TCPIP_ABOVE; s++) {
+            struct Result *r = &res[s];
+
+            run(s, loops[l], r);
+            printf("  %-18s %8lu %8u %8u %8.1f %7.1f %7u %9u\n", setupName[s],
+                r->latSum / r->packets, percentile(r, 99), r->latMax,
+                100.0 * r->loopUs / SIM_US, 100.0 * r->idleUs / SIM_US,
+                r->sliceExp, r->switches);
+        }
+        if (l == 0) {
+            check(res[SETUP_DEFAULT].latMax <= 5 * TICK_US + 4 * PKT_US,
+                "default: tcpip waits at most the 5 ms robin");
+            check(res[SETUP_DEFAULT].latMax > 4 * TICK_US,
+                "default: a spinning loop() does hold tcpip off");
+            check(res[SETUP_DEFAULT].sliceExp > 0, "default: exhausted slices are counted");
+            check(res[SETUP_SLICE].latMax <= TICK_US + 4 * PKT_US,
+                "slice 1 ms: tcpip waits at most 1 ms");
+            check(res[SETUP_BACKGROUND].latMax <= 4 * PKT_US,
+                "background: tcpip waits only for itself");
+            check(res[SETUP_BACKGROUND].sliceExp == 0,
+                "background: no slices exhausted");
+            check(res[SETUP_BACKGROUND].loopUs == res[SETUP_DEFAULT].loopUs,
+                "background: loop() gets the same CPU");
+            check(res[SETUP_BACKGROUND].idleUs == 0, "background: idle never runs");
+            check(res[SETUP_BACKGROUND].latSum == res[SETUP_TCPIP_ABOVE].latSum,
+                "background matches raising tcpip");
+        }
+    }
+}
+
+/* ---- The calls themselves */
+
+static void api(void)
+{
+    struct OS_TCB a, b;
+    OS_TID ida, idb;
+
+    printf("\nrt_tsk_slice(), rt_tsk_bg()\n");
+    kernel_init();
+    ida = task_create(&a, NORMAL);
+    idb = task_create(&b, NORMAL);
+    a.state = RUNNING;
+    os_tsk.run = &a;
+    b.state = READY;
+    rt_put_prio(&os_rdy, &b);
+
+    check(rt_tsk_slice(0, 1) == OS_R_NOK && rt_tsk_slice(TASK_CNT + 1, 1) == OS_R_NOK &&
+        rt_tsk_slice(idb + 1, 1) == OS_R_NOK, "slice: unknown tasks are refused");
+    check(rt_tsk_bg(idb + 1, 1) == OS_R_NOK, "bg: unknown tasks are refused");
+
+    /* The running task's slice restarts with the new length */
+    systick();
+    pendsv();
+    check(os_robin.task == &a && os_robin.time == 4, "slice: default robin is 5 ticks");
+    rt_tsk_slice(ida, 2);
+    check(os_robin.task == NULL, "slice: a running slice restarts");
+    systick();
+    pendsv();
+    check(os_robin.time == (U16)os_time, "slice: restarted with 2 ticks");
+    systick();
+    pendsv();
+    check(os_tsk.run == &b && os_tsk_sched[ida-1].slice_exp == 1,
+        "slice: passes the CPU on when it runs out");
+
+    /* Background: b is running, a is ready at the same priority */
+    rt_tsk_bg(idb, 1);
+    pendsv();
+    check(os_tsk.run == &a && b.prio == OS_BG_PRIO && os_tsk_sched[idb-1].bg_prio == NORMAL,
+        "bg: on drops to the background priority");
+    rt_tsk_bg(idb, 1);
+    check(b.prio == OS_BG_PRIO && os_tsk_sched[idb-1].bg_prio == NORMAL,
+        "bg: a second on changes nothing");
+    rt_tsk_bg(idb, 0);
+    pendsv();
+    check(b.prio == NORMAL && os_tsk_sched[idb-1].bg_prio == 0 && os_tsk.run == &a,
+        "bg: off restores the priority, without preempting");
+    check(rt_tsk_bg(idb, 0) == OS_R_OK && b.prio == NORMAL, "bg: a second off changes nothing");
+
+    /* A new task in a freed slot starts from the defaults */
+    os_tsk_sched[idb-1].slice = 3;
+    os_tsk_sched[idb-1].bg_prio = 2;
+    os_active_TCB[idb-1] = NULL;
+    check(rt_get_TID() == idb && os_tsk_sched[idb-1].slice == 0 &&
+        os_tsk_sched[idb-1].bg_prio == 0 && os_tsk_sched[idb-1].slice_exp == 0,
+        "new task: default slice, not in background");
+}
+
+int main(void)
+{
+    bench();
+    api();
+
+    if (failures) {
+        printf("\n%d FAILED\n", failures);
+        return 1;
+    }
+    printf("\nall passed\n");
+    return 0;
+}
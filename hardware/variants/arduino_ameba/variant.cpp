@@ -86,6 +86,7 @@ void serialEvent() __attribute__((weak));
 void serialEvent() { }
 
 // IT handlers
+TCM_TEXT_SECTION
 void UART_Handler(void)
 {
   Serial.IrqHandler();
@@ -192,9 +193,32 @@ static inline void VectorTableSettingForOS(
 
 
 
+extern uint32_t __tcm_load__[];
+extern uint32_t __tcm_start__[];
+extern uint32_t __tcm_end__[];
+extern uint32_t __tcm_bss_start__[];
+extern uint32_t __tcm_bss_end__[];
+
+// Copy .tcm from its load image in BD_RAM and clear .tcm.bss. This runs
+// before anything else, since the kernel vectors may already live there.
+static inline void TcmInit(void)
+{
+    uint32_t *src = __tcm_load__;
+    uint32_t *dst = __tcm_start__;
+
+    while (dst < __tcm_end__) {
+        *dst++ = *src++;
+    }
+    for (dst = __tcm_bss_start__; dst < __tcm_bss_end__; ) {
+        *dst++ = 0;
+    }
+}
+
 // The Main App entry point
 void _AppStart(void)
 {
+    TcmInit();
+
     VectorTableSettingForOS((void*)SVC_Handler,
                        (void*)PendSV_Handler,
                        (void*)SysTick_Handler);